@@ -0,0 +1,371 @@
+/**
+ * @file bench_bus.cpp
+ * @brief Benchmarks of the transaction queue, sweeps, validation, and
+ *        reconnects.
+ *
+ * @details
+ * Every benchmark runs once on a bus with its own thread (`thread`, the
+ * `drainQueue()` path over libmodbus) and once on a bus attached to a
+ * `BusEventLoop` (`loop`). Validation and recovery times are measured per
+ * iteration with manual timing, from the triggering call until the last
+ * device reports ready.
+ */
+
+#include "bench_env.h"
+#include "bus_event_loop.h"
+#include "device_identity_cache.h"
+#include "fronius_bus.h"
+#include "fronius_device.h"
+#include "fronius_types.h"
+#include "inverter.h"
+#include "inverter_registers.h"
+#include "meter.h"
+#include <array>
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+enum class Driver { THREAD, LOOP };
+
+/** @brief Connected bus to the simulator, or null after SkipWithError(). */
+std::shared_ptr<FroniusBus> connectedBus(benchmark::State &state,
+                                         Driver driver, int pipelineDepth) {
+  auto bus = BenchEnv::makeBus(
+      driver == Driver::LOOP ? std::make_shared<BusEventLoop>() : nullptr,
+      pipelineDepth);
+  bus->connect();
+  if (!BenchEnv::waitFor([&] { return bus->isConnected(); })) {
+    state.SkipWithError("bus did not connect to the simulator");
+    return nullptr;
+  }
+  return bus;
+}
+
+/** @brief Read of the I10X block of `slaveId` into `dest`. */
+FroniusBus::Transaction inverterRead(int slaveId, uint16_t *dest) {
+  return {.slaveId = slaveId,
+          .startAddr = I10X::ID.ADDR,
+          .count = I10X::SIZE,
+          .dest = dest,
+          .secTimeout = 1,
+          .usecTimeout = 0};
+}
+
+/* -------------------------------------------------------------------------
+   submit() round trip
+   ------------------------------------------------------------------------- */
+
+/** One transaction at a time: queue, wire, completion. */
+void BM_SubmitRoundTrip(benchmark::State &state, Driver driver) {
+  auto bus = connectedBus(state, driver, 1);
+  if (!bus)
+    return;
+
+  std::array<uint16_t, I10X::SIZE> regs{};
+  const auto t = inverterRead(BenchEnv::FIRST_INVERTER, regs.data());
+  for (auto _ : state) {
+    if (auto res = bus->submit(t).get(); !res) {
+      state.SkipWithError(res.error().describe().c_str());
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_SubmitRoundTrip, thread, Driver::THREAD)->UseRealTime();
+BENCHMARK_CAPTURE(BM_SubmitRoundTrip, loop, Driver::LOOP)->UseRealTime();
+
+/**
+ * One transaction per inverter submitted at once, then all awaited.
+ * Argument: pipeline depth of the loop bus.
+ */
+void BM_SubmitBatch(benchmark::State &state, Driver driver) {
+  auto bus = connectedBus(state, driver, static_cast<int>(state.range(0)));
+  if (!bus)
+    return;
+
+  constexpr int N = BenchEnv::LAST_INVERTER - BenchEnv::FIRST_INVERTER + 1;
+  std::vector<std::array<uint16_t, I10X::SIZE>> regs(N);
+  std::vector<FroniusBus::Completion> pending(N);
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i)
+      pending[i] = bus->submit(
+          inverterRead(BenchEnv::FIRST_INVERTER + i, regs[i].data()));
+    for (auto &c : pending) {
+      if (auto res = c.get(); !res) {
+        state.SkipWithError(res.error().describe().c_str());
+        return;
+      }
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+}
+BENCHMARK_CAPTURE(BM_SubmitBatch, thread, Driver::THREAD)
+    ->Arg(1)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_SubmitBatch, loop, Driver::LOOP)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(8)
+    ->UseRealTime();
+
+/* -------------------------------------------------------------------------
+   Control write behind telemetry
+   ------------------------------------------------------------------------- */
+
+/**
+ * A `Priority::CONTROL` write submitted right after one read per inverter,
+ * timed from its submission until it is confirmed. Argument: pipeline
+ * depth of the loop bus.
+ */
+void BM_ControlWrite(benchmark::State &state, Driver driver) {
+  auto bus = connectedBus(state, driver, static_cast<int>(state.range(0)));
+  if (!bus)
+    return;
+
+  constexpr int N = BenchEnv::LAST_INVERTER - BenchEnv::FIRST_INVERTER + 1;
+  std::vector<std::array<uint16_t, I10X::SIZE>> regs(N);
+  std::vector<FroniusBus::Completion> pending(N);
+
+  const uint16_t enable = 1;
+  FroniusBus::Transaction write{.slaveId = BenchEnv::FIRST_INVERTER,
+                                .startAddr = I123::WMAXLIM_ENA.ADDR,
+                                .count = 1,
+                                .op = FroniusBus::Transaction::Op::WRITE,
+                                .src = &enable,
+                                .secTimeout = 1,
+                                .usecTimeout = 0,
+                                .priority = FroniusTypes::Priority::CONTROL};
+
+  for (auto _ : state) {
+    for (int i = 0; i < N; ++i)
+      pending[i] = bus->submit(
+          inverterRead(BenchEnv::FIRST_INVERTER + i, regs[i].data()));
+
+    const auto start = Clock::now();
+    if (auto res = bus->submit(write).get(); !res) {
+      state.SkipWithError(res.error().describe().c_str());
+      return;
+    }
+    state.SetIterationTime(
+        std::chrono::duration<double>(Clock::now() - start).count());
+
+    for (auto &c : pending)
+      c.get();
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK_CAPTURE(BM_ControlWrite, thread, Driver::THREAD)
+    ->Arg(1)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_ControlWrite, loop, Driver::LOOP)
+    ->Arg(1)
+    ->Arg(8)
+    ->UseManualTime();
+
+/* -------------------------------------------------------------------------
+   Validation time-to-ready
+   ------------------------------------------------------------------------- */
+
+enum class Target { INVERTER, FLOAT_INVERTER, METER };
+
+/**
+ * Fresh bus and device per iteration, timed from `connect()` until the
+ * device is ready. Argument: 1 to serve the identity from a warm
+ * `DeviceIdentityCache`.
+ */
+void BM_ValidateTimeToReady(benchmark::State &state, Driver driver,
+                            Target target) {
+  const bool cached = state.range(0) != 0;
+  auto cache = std::make_shared<DeviceIdentityCache>();
+
+  for (auto _ : state) {
+    auto bus = BenchEnv::makeBus(
+        driver == Driver::LOOP ? std::make_shared<BusEventLoop>() : nullptr);
+    std::shared_ptr<FroniusDevice> device;
+    switch (target) {
+    case Target::INVERTER:
+      device = std::make_shared<Inverter>(
+          bus, BenchEnv::deviceConfig(BenchEnv::FIRST_INVERTER));
+      break;
+    case Target::FLOAT_INVERTER:
+      device = std::make_shared<Inverter>(
+          bus, BenchEnv::deviceConfig(BenchEnv::FLOAT_INVERTER));
+      break;
+    case Target::METER:
+      device = std::make_shared<Meter>(
+          bus, BenchEnv::deviceConfig(BenchEnv::METER));
+      break;
+    }
+    if (cached)
+      device->setIdentityCache(cache);
+    bus->registerDevice(device);
+
+    const auto start = Clock::now();
+    bus->connect();
+    if (!BenchEnv::waitFor([&] { return device->isReady(); })) {
+      state.SkipWithError("device did not become ready");
+      break;
+    }
+    state.SetIterationTime(
+        std::chrono::duration<double>(Clock::now() - start).count());
+  }
+}
+BENCHMARK_CAPTURE(BM_ValidateTimeToReady, thread_inverter, Driver::THREAD,
+                  Target::INVERTER)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_ValidateTimeToReady, loop_inverter, Driver::LOOP,
+                  Target::INVERTER)
+    ->Arg(0)
+    ->Arg(1)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_ValidateTimeToReady, loop_float_inverter, Driver::LOOP,
+                  Target::FLOAT_INVERTER)
+    ->Arg(0)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_ValidateTimeToReady, loop_meter, Driver::LOOP,
+                  Target::METER)
+    ->Arg(0)
+    ->UseManualTime();
+
+/* -------------------------------------------------------------------------
+   Recovery after triggerReconnect()
+   ------------------------------------------------------------------------- */
+
+/**
+ * Timed from `triggerReconnect()` until every inverter has revalidated.
+ * Argument: number of inverters on the bus.
+ */
+void BM_ReconnectRecovery(benchmark::State &state, Driver driver) {
+  auto bus = BenchEnv::makeBus(
+      driver == Driver::LOOP ? std::make_shared<BusEventLoop>() : nullptr);
+
+  std::vector<std::shared_ptr<Inverter>> devices;
+  for (int i = 0; i < state.range(0); ++i) {
+    devices.push_back(std::make_shared<Inverter>(
+        bus, BenchEnv::deviceConfig(BenchEnv::FIRST_INVERTER + i)));
+    bus->registerDevice(devices.back());
+  }
+
+  const auto allReady = [&] {
+    for (const auto &d : devices)
+      if (!d->isReady())
+        return false;
+    return bus->isConnected();
+  };
+
+  bus->connect();
+  if (!BenchEnv::waitFor(allReady)) {
+    state.SkipWithError("devices did not become ready");
+    return;
+  }
+
+  std::vector<uint64_t> before(devices.size());
+  for (auto _ : state) {
+    for (size_t i = 0; i < devices.size(); ++i)
+      before[i] = devices[i]->getValidationCount();
+
+    const auto start = Clock::now();
+    bus->triggerReconnect();
+    const bool recovered = BenchEnv::waitFor([&] {
+      for (size_t i = 0; i < devices.size(); ++i)
+        if (devices[i]->getValidationCount() == before[i])
+          return false;
+      return allReady();
+    });
+    if (!recovered) {
+      state.SkipWithError("devices did not recover");
+      break;
+    }
+    state.SetIterationTime(
+        std::chrono::duration<double>(Clock::now() - start).count());
+  }
+  state.counters["devices"] = static_cast<double>(devices.size());
+}
+BENCHMARK_CAPTURE(BM_ReconnectRecovery, thread, Driver::THREAD)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->UseManualTime();
+BENCHMARK_CAPTURE(BM_ReconnectRecovery, loop, Driver::LOOP)
+    ->Arg(1)
+    ->Arg(4)
+    ->Arg(16)
+    ->UseManualTime();
+
+/* -------------------------------------------------------------------------
+   Bus sweep
+   ------------------------------------------------------------------------- */
+
+enum class Fetch { EACH, SWEEP };
+
+/**
+ * One sample of every device: a blocking fetch per device in turn, or one
+ * `fetchAll()`. Argument: number of inverters, besides the meter.
+ */
+void BM_FetchAll(benchmark::State &state, Driver driver, Fetch fetch) {
+  auto bus = BenchEnv::makeBus(
+      driver == Driver::LOOP ? std::make_shared<BusEventLoop>() : nullptr);
+
+  std::vector<std::shared_ptr<Inverter>> inverters;
+  for (int i = 0; i < state.range(0); ++i) {
+    inverters.push_back(std::make_shared<Inverter>(
+        bus, BenchEnv::deviceConfig(BenchEnv::FIRST_INVERTER + i)));
+    bus->registerDevice(inverters.back());
+  }
+  auto meter =
+      std::make_shared<Meter>(bus, BenchEnv::deviceConfig(BenchEnv::METER));
+  bus->registerDevice(meter);
+
+  bus->connect();
+  if (!BenchEnv::waitFor([&] {
+        for (const auto &d : inverters)
+          if (!d->isReady())
+            return false;
+        return meter->isReady();
+      })) {
+    state.SkipWithError("devices did not become ready");
+    return;
+  }
+
+  for (auto _ : state) {
+    bool ok;
+    if (fetch == Fetch::SWEEP) {
+      ok = bus->fetchAll().ok();
+    } else {
+      ok = meter->fetchMeterRegisters().has_value();
+      for (const auto &d : inverters)
+        ok = d->fetchInverterRegisters().has_value() && ok;
+    }
+    if (!ok) {
+      state.SkipWithError("fetch failed");
+      break;
+    }
+  }
+  state.SetItemsProcessed(state.iterations() * (state.range(0) + 1));
+}
+BENCHMARK_CAPTURE(BM_FetchAll, thread_each, Driver::THREAD, Fetch::EACH)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_FetchAll, thread_sweep, Driver::THREAD, Fetch::SWEEP)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_FetchAll, loop_each, Driver::LOOP, Fetch::EACH)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+BENCHMARK_CAPTURE(BM_FetchAll, loop_sweep, Driver::LOOP, Fetch::SWEEP)
+    ->Arg(1)
+    ->Arg(4)
+    ->UseRealTime();
+
+} // namespace
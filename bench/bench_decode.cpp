@@ -0,0 +1,201 @@
+/**
+ * @file bench_decode.cpp
+ * @brief Benchmarks of the register decode path.
+ *
+ * @details
+ * Each benchmark fetches the registers of one simulated device once and
+ * then decodes from its published snapshot, so only the decode itself is
+ * timed: the runtime `getModbusDouble()` / `getModbusString()` overloads,
+ * the compile-time descriptors, and `Inverter::getEvents()` against its
+ * allocation-free `getEventFlags()`. The aggregates of a `SampleHistory`
+ * are timed on synthetic samples.
+ */
+
+#include "bench_env.h"
+#include "bus_event_loop.h"
+#include "common_registers.h"
+#include "fronius_bus.h"
+#include "inverter.h"
+#include "inverter_registers.h"
+#include "register_codec.h"
+#include "sample_history.h"
+#include <benchmark/benchmark.h>
+#include <chrono>
+#include <cstddef>
+#include <memory>
+#include <string_view>
+
+namespace {
+
+/** Inverter exposing the protected decode helpers. */
+class BenchInverter : public Inverter {
+public:
+  using Inverter::Inverter;
+  using FroniusDevice::getModbusDouble;
+  using FroniusDevice::getModbusString;
+};
+
+/** @brief Ready inverter with fetched registers, or null on failure. */
+std::shared_ptr<BenchInverter> fetchedInverter(benchmark::State &state,
+                                               int slaveId) {
+  auto bus = BenchEnv::makeBus(std::make_shared<BusEventLoop>());
+  auto inverter =
+      std::make_shared<BenchInverter>(bus, BenchEnv::deviceConfig(slaveId));
+  bus->registerDevice(inverter);
+  bus->connect();
+
+  if (!BenchEnv::waitFor([&] { return inverter->isReady(); })) {
+    state.SkipWithError("inverter did not become ready");
+    return nullptr;
+  }
+  if (auto res = inverter->fetchInverterRegisters(); !res) {
+    state.SkipWithError(res.error().describe().c_str());
+    return nullptr;
+  }
+  return inverter;
+}
+
+/* -------------------------------------------------------------------------
+   Numeric values
+   ------------------------------------------------------------------------- */
+
+/** Integer register with a scale-factor register. */
+void BM_DecodeScaled(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, BenchEnv::FIRST_INVERTER);
+  if (!inverter)
+    return;
+
+  const auto snap = inverter->snapshot();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        inverter->getModbusDouble(snap.regs(), I10X::W, I10X::W_SF));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeScaled);
+
+/** Float register. */
+void BM_DecodeFloat(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, BenchEnv::FLOAT_INVERTER);
+  if (!inverter)
+    return;
+
+  const auto snap = inverter->snapshot();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(inverter->getModbusDouble(snap.regs(), I11X::W));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeFloat);
+
+/** Integer register through a compile-time descriptor. */
+void BM_DecodeDescriptor(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, BenchEnv::FIRST_INVERTER);
+  if (!inverter)
+    return;
+
+  const auto snap = inverter->snapshot();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        inverter->getModbusDouble<ScaledValue<I10X::W, I10X::W_SF>>(
+            snap.regs()));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_DecodeDescriptor);
+
+/** Public accessor, including the snapshot acquisition. */
+void BM_GetAcPower(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, BenchEnv::FIRST_INVERTER);
+  if (!inverter)
+    return;
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(
+        inverter->getAcPower(FroniusTypes::Output::ACTIVE));
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetAcPower);
+
+/* -------------------------------------------------------------------------
+   Strings and events
+   ------------------------------------------------------------------------- */
+
+/** 16-register string (C001::MD). */
+void BM_DecodeString(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, BenchEnv::FIRST_INVERTER);
+  if (!inverter)
+    return;
+
+  const auto snap = inverter->snapshot();
+  for (auto _ : state)
+    benchmark::DoNotOptimize(inverter->getModbusString(snap.regs(), C001::MD));
+  state.SetBytesProcessed(state.iterations() * C001::MD.NB * 2);
+}
+BENCHMARK(BM_DecodeString);
+
+/** Argument: 1 for an inverter reporting vendor events, 0 for none. */
+void BM_GetEvents(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, state.range(0)
+                                             ? BenchEnv::EVENT_INVERTER
+                                             : BenchEnv::FIRST_INVERTER);
+  if (!inverter)
+    return;
+
+  for (auto _ : state)
+    benchmark::DoNotOptimize(inverter->getEvents());
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetEvents)->Arg(0)->Arg(1);
+
+/** As `BM_GetEvents`, walking the names of `getEventFlags()`. */
+void BM_GetEventFlags(benchmark::State &state) {
+  auto inverter = fetchedInverter(state, state.range(0)
+                                             ? BenchEnv::EVENT_INVERTER
+                                             : BenchEnv::FIRST_INVERTER);
+  if (!inverter)
+    return;
+
+  for (auto _ : state) {
+    const InverterEvents events = inverter->getEventFlags();
+    for (std::string_view name : events)
+      benchmark::DoNotOptimize(name);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GetEventFlags)->Arg(0)->Arg(1);
+
+/* -------------------------------------------------------------------------
+   Sample history
+   ------------------------------------------------------------------------- */
+
+/**
+ * `stats()` and `integrate()` of the AC power over a full hour of 1 s
+ * samples. Argument: the `HistoryStorage` of the column.
+ */
+void BM_HistoryAggregate(benchmark::State &state) {
+  constexpr size_t N = 3600;
+  SampleHistory<InverterSample> history(N);
+  history.track(&InverterSample::acPowerActive,
+                static_cast<HistoryStorage>(state.range(0)));
+
+  InverterSample sample;
+  for (size_t i = 0; i < N; ++i) {
+    sample.timestamp += std::chrono::seconds(1);
+    sample.acPowerActive = 4000.0 + static_cast<double>(i % 100);
+    history.append(sample);
+  }
+
+  for (auto _ : state) {
+    benchmark::DoNotOptimize(history.stats(&InverterSample::acPowerActive));
+    benchmark::DoNotOptimize(
+        history.integrate(&InverterSample::acPowerActive));
+  }
+  state.SetItemsProcessed(state.iterations() * N);
+  state.counters["bytes/sample"] =
+      static_cast<double>(history.bytesPerSample());
+}
+BENCHMARK(BM_HistoryAggregate)
+    ->Arg(static_cast<int>(HistoryStorage::FLOAT64))
+    ->Arg(static_cast<int>(HistoryStorage::FLOAT32))
+    ->Arg(static_cast<int>(HistoryStorage::FLOAT16))
+    ->Arg(static_cast<int>(HistoryStorage::SCALED16));
+
+} // namespace
@@ -0,0 +1,87 @@
+#include "bench_env.h"
+#include "bus_event_loop.h"
+#include "fronius_types.h"
+#include "sim_device.h"
+#include "sim_server.h"
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+
+namespace BenchEnv {
+
+/* -------------------------------------------------------------------------
+   Simulator
+   ------------------------------------------------------------------------- */
+
+void startSimulator() {
+  static std::once_flag once;
+  static std::unique_ptr<SimServer> server;
+
+  std::call_once(once, [] {
+    SimServerConfig cfg;
+    cfg.firstPort = BENCH_PORT;
+    for (int unit = FIRST_INVERTER; unit <= LAST_INVERTER; ++unit)
+      cfg.devices.push_back(
+          {SimProfile::parse("i103"), static_cast<uint8_t>(unit)});
+    cfg.devices.push_back(
+        {SimProfile::parse("i113"), static_cast<uint8_t>(FLOAT_INVERTER)});
+
+    SimProfile events = SimProfile::parse("i103");
+    events.events = {
+        static_cast<uint32_t>(FroniusTypes::Event_1::GRID_ERROR) |
+            static_cast<uint32_t>(FroniusTypes::Event_1::AC_OVERCURRENT),
+        0x00000003u, 0x80000000u};
+    cfg.devices.push_back({events, static_cast<uint8_t>(EVENT_INVERTER)});
+
+    cfg.devices.push_back(
+        {SimProfile::parse("m213"), static_cast<uint8_t>(METER)});
+
+    server = std::make_unique<SimServer>(cfg);
+  });
+}
+
+/* -------------------------------------------------------------------------
+   Buses and devices
+   ------------------------------------------------------------------------- */
+
+std::shared_ptr<FroniusBus> makeBus(std::shared_ptr<BusEventLoop> loop,
+                                    int pipelineDepth) {
+  startSimulator();
+
+  ModbusBusConfig cfg;
+  cfg.transport = ModbusTcpTransport{"127.0.0.1", BENCH_PORT};
+  cfg.reconnectDelay = 1;
+  cfg.pipelineDepth = pipelineDepth;
+
+  auto bus = loop ? std::make_shared<FroniusBus>(cfg, std::move(loop))
+                  : std::make_shared<FroniusBus>(cfg);
+
+  // Without a disconnect callback the bus thread stops on the first drop
+  bus->addBusDisconnectCallback([](int) {});
+  return bus;
+}
+
+ModbusDeviceConfig deviceConfig(int slaveId) {
+  ModbusDeviceConfig cfg;
+  cfg.slaveId = slaveId;
+  cfg.secTimeout = 1;
+  cfg.usecTimeout = 0;
+  cfg.reconnectDelay = 1;
+  return cfg;
+}
+
+bool waitFor(const std::function<bool()> &done,
+             std::chrono::milliseconds timeout) {
+  const auto until = std::chrono::steady_clock::now() + timeout;
+  while (!done()) {
+    if (std::chrono::steady_clock::now() >= until)
+      return false;
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+  }
+  return true;
+}
+
+} // namespace BenchEnv
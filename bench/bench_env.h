@@ -0,0 +1,68 @@
+/**
+ * @file bench_env.h
+ * @brief Shared setup of the libfronius benchmarks.
+ *
+ * @details
+ * The benchmarks talk to an in-process `SimServer` on the loopback
+ * interface, so they measure the library's own overhead on top of a real
+ * TCP round trip rather than the timing of a physical device. The server
+ * is started once, on first use, and serves the devices below on
+ * `BENCH_PORT`.
+ */
+
+#ifndef BENCH_ENV_H_
+#define BENCH_ENV_H_
+
+#include "fronius_bus.h"
+#include "modbus_config.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+class BusEventLoop;
+
+namespace BenchEnv {
+
+/** @brief Port of the simulated endpoint. */
+constexpr uint16_t BENCH_PORT = 15502;
+
+/** @brief Unit IDs of the integer inverters (i103), first and last. */
+constexpr int FIRST_INVERTER = 1;
+constexpr int LAST_INVERTER = 16;
+
+/** @brief Unit ID of a float inverter (i113). */
+constexpr int FLOAT_INVERTER = 20;
+
+/** @brief Unit ID of an integer inverter reporting vendor events. */
+constexpr int EVENT_INVERTER = 21;
+
+/** @brief Unit ID of a float meter (m213). */
+constexpr int METER = 240;
+
+/** @brief Start the simulator if it is not running yet. */
+void startSimulator();
+
+/**
+ * @brief Bus to the simulator.
+ *
+ * @param loop           Shared event loop, or null for a bus thread.
+ * @param pipelineDepth  Requests kept in flight, see `ModbusBusConfig`.
+ */
+std::shared_ptr<FroniusBus>
+makeBus(std::shared_ptr<BusEventLoop> loop = nullptr, int pipelineDepth = 1);
+
+/** @brief Device configuration for `slaveId` with a generous timeout. */
+ModbusDeviceConfig deviceConfig(int slaveId);
+
+/**
+ * @brief Poll `done` until it returns true or `timeout` expires.
+ *
+ * @return True if `done` returned true.
+ */
+bool waitFor(const std::function<bool()> &done,
+             std::chrono::milliseconds timeout = std::chrono::seconds(10));
+
+} // namespace BenchEnv
+
+#endif /* BENCH_ENV_H_ */
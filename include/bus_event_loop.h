@@ -0,0 +1,364 @@
+/**
+ * @file bus_event_loop.h
+ * @brief One I/O thread driving many Modbus TCP buses.
+ *
+ * @details
+ * By default every `FroniusBus` runs its own bus thread, which spends
+ * almost all of its time blocked in `modbus_read_registers()`. A gateway
+ * talking to dozens of TCP inverters pays one thread per endpoint for
+ * that. A `BusEventLoop` multiplexes the TCP buses constructed with it
+ * over non-blocking sockets and a single `epoll` instance instead, framing
+ * the requests itself (see `modbus_tcp_framer.h`).
+ *
+ * Only the transport moves: each bus keeps its transaction queue, priority
+ * and deadline scheduling, coalescing, metrics, tracing, and callbacks;
+ * `submit()` and the device API are unchanged. The loop reconnects each
+ * bus with the bus's own backoff. Device validation, which blocks, runs on
+ * a `DeviceScheduler` shared by all buses of the loop, so the thread count
+ * does not grow with the number of buses.
+ *
+ * With `ModbusBusConfig::pipelineDepth` above 1 a bus keeps several
+ * requests in flight and matches the responses by MBAP transaction
+ * identifier, in whatever order the server returns them. With
+ * `ModbusBusConfig::connections` above 1 it spreads its reads over a pool
+ * of connections to the same endpoint.
+ *
+ * Hostnames are resolved on the loop thread when a bus connects; use
+ * numeric addresses if name lookups may stall. For more than one loop
+ * thread, create several loops and spread the buses across them.
+ */
+
+#ifndef BUS_EVENT_LOOP_H_
+#define BUS_EVENT_LOOP_H_
+
+#include "device_scheduler.h"
+#include "fronius_bus.h"
+#include "modbus_error.h"
+#include "modbus_tcp_framer.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <modbus/modbus.h>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class BusEventLoop
+ * @brief Epoll-based transport shared by any number of TCP `FroniusBus`es.
+ *
+ * Pass one `std::shared_ptr<BusEventLoop>` to the `FroniusBus` constructor
+ * of every bus it should drive. Each bus keeps the loop alive, so it can
+ * be released by the application at any time. Non-copyable, non-movable.
+ */
+class BusEventLoop {
+public:
+  /**
+   * @brief Create the epoll instance and start the loop thread.
+   *
+   * @param probeThreads  Device validations that may run at once, across
+   *                      all buses of the loop (at least 1).
+   * @throws std::invalid_argument if `probeThreads` is less than 1.
+   * @throws std::system_error if the epoll or wakeup descriptor cannot be
+   *         created.
+   */
+  explicit BusEventLoop(int probeThreads = 2);
+
+  /** @brief Stop and join the loop thread. */
+  ~BusEventLoop();
+
+  // Non-copyable, non-movable.
+  BusEventLoop(const BusEventLoop &) = delete;
+  BusEventLoop &operator=(const BusEventLoop &) = delete;
+  BusEventLoop(BusEventLoop &&) = delete;
+  BusEventLoop &operator=(BusEventLoop &&) = delete;
+
+  /** @brief Number of buses currently driven by the loop. */
+  size_t busCount() const;
+
+private:
+  friend class FroniusBus;
+
+  using Clock = std::chrono::steady_clock;
+
+  // -------------------------------------------------------------------------
+  // Per-bus connection state — loop thread only
+  // -------------------------------------------------------------------------
+
+  /** @brief Upper bound of `ModbusBusConfig::pipelineDepth`. */
+  static constexpr size_t MAX_IN_FLIGHT = 16;
+
+  /**
+   * @struct Request
+   * @brief A request on the wire, awaiting its response.
+   */
+  struct Request {
+    /** @brief Set while the request awaits its response. */
+    bool active{false};
+
+    /** @brief Transactions answered by this request. */
+    std::array<FroniusBus::Slot *, FroniusBus::MAX_COALESCED> group{};
+
+    /** @brief Number of transactions in `group`. */
+    size_t n{0};
+
+    /** @brief Register range actually accessed, covering the whole group. */
+    FroniusBus::Transaction merged;
+
+    /**
+     * @brief Set while a write awaits its response.
+     *
+     * A read-modify-write starts as a read and sends its write from
+     * `dispatch()` once the read is answered.
+     */
+    bool writing{false};
+
+    /** @brief Transaction identifier of the request. */
+    uint16_t tid{0};
+
+    /** @brief Time the (first) request was queued for sending. */
+    Clock::time_point sentAt;
+
+    /** @brief Response deadline, from the merged response timeout. */
+    Clock::time_point deadline;
+
+    /** @brief Receive buffer of a coalesced read. */
+    std::array<uint16_t, MODBUS_MAX_READ_REGISTERS> buf{};
+  };
+
+  struct Channel;
+
+  /**
+   * @struct Connection
+   * @brief One TCP connection of a bus and its in-flight window.
+   */
+  struct Connection {
+    enum class State : uint8_t { IDLE, CONNECTING, CONNECTED };
+
+    /** @brief Channel owning this connection. */
+    Channel *channel{nullptr};
+
+    /** @brief Position in `Channel::connections`; 0 retries while down. */
+    size_t index{0};
+
+    /** @brief Non-blocking socket, or -1 while idle. */
+    int fd{-1};
+
+    State state{State::IDLE};
+
+    /** @brief IDLE: next connect attempt. CONNECTING: connect timeout. */
+    Clock::time_point due;
+
+    /** @brief Reconnect delay in seconds, with backoff applied. */
+    int reconnectDelay{0};
+
+    /** @brief Events currently registered with epoll. */
+    uint32_t events{0};
+
+    /** @brief In-flight window, one entry per `pipelineDepth`. */
+    std::vector<Request> requests;
+
+    /** @brief Number of active entries in `requests`. */
+    size_t inFlight{0};
+
+    /** @brief Transaction identifier of the next request. */
+    uint16_t nextTid{0};
+
+    /** @brief Encoded requests, of which `txSent` bytes were written. */
+    std::array<uint8_t, ModbusTcpFramer::MAX_REQUEST_SIZE * MAX_IN_FLIGHT>
+        tx{};
+    size_t txLen{0};
+    size_t txSent{0};
+
+    /** @brief Received bytes not yet parsed into a response. */
+    std::array<uint8_t, 2 * ModbusTcpFramer::MAX_ADU_SIZE> rx{};
+    size_t rxLen{0};
+  };
+
+  /**
+   * @struct Channel
+   * @brief One bus attached to the loop and its connection pool.
+   */
+  struct Channel {
+    /** @brief The bus served by this channel. */
+    FroniusBus *bus{nullptr};
+
+    /** @brief `ModbusBusConfig::connections` entries, never resized. */
+    std::vector<Connection> connections;
+
+    /** @brief Set while the bus is reported connected. */
+    bool up{false};
+  };
+
+  /** @brief Bound on establishing a connection, as libmodbus does. */
+  static constexpr std::chrono::milliseconds CONNECT_TIMEOUT{500};
+
+  // -------------------------------------------------------------------------
+  // Interface used by FroniusBus
+  // -------------------------------------------------------------------------
+
+  /** @brief Start driving `bus`; its first connect attempt runs at once. */
+  void attach(FroniusBus *bus);
+
+  /**
+   * @brief Stop driving `bus` and close its connection.
+   *
+   * Blocks until the loop thread has let go of the bus, so the bus may be
+   * destroyed afterwards. Outstanding requests are failed with `EINTR`.
+   */
+  void detach(FroniusBus *bus);
+
+  /** @brief Wake the loop to pick up new transactions or state changes. */
+  void wake();
+
+  // -------------------------------------------------------------------------
+  // Loop thread
+  // -------------------------------------------------------------------------
+
+  /** @brief Loop thread body: wait for I/O or timers and service buses. */
+  void run();
+
+  struct Command;
+
+  /** @brief Apply attach/detach requests taken from `commands_`. */
+  void applyCommands(const std::vector<Command> &commands);
+
+  /**
+   * @brief Advance the connections of one channel.
+   *
+   * Expires timed-out requests, starts due connect attempts, and fills the
+   * windows of the connected connections in turns, one request each.
+   */
+  void service(Channel &ch, Clock::time_point now);
+
+  /** @brief Handle readiness reported by epoll for a socket. */
+  void onEvents(Connection &c, uint32_t events);
+
+  /** @brief Open a socket and start a non-blocking connect. */
+  void startConnect(Connection &c, Clock::time_point now);
+
+  /** @brief Complete a connect once the socket turned writable. */
+  void finishConnect(Connection &c);
+
+  /** @brief Close the socket and schedule the next connect attempt. */
+  void failConnect(Connection &c, const ModbusError &err);
+
+  /**
+   * @brief Tear down a connection lost to the transport error `err`.
+   *
+   * If other connections of the bus are up, only this one is closed, its
+   * requests are failed with `err`, and it reconnects right away.
+   * Otherwise `err` is reported as a read error and the bus goes down.
+   */
+  void drop(Connection &c, const ModbusError &err);
+
+  /**
+   * @brief Close every connection of `ch` and take the bus down.
+   *
+   * Fails the outstanding requests with `err` and runs the bus's
+   * disconnect handling; the next connect attempt follows immediately.
+   */
+  void dropAll(Channel &ch, const ModbusError &err);
+
+  /**
+   * @brief Take the next transaction off the bus queue into a free window
+   *        entry.
+   *
+   * The request is encoded into `tx`; `flush()` writes it.
+   *
+   * @return False if the queue held nothing to send.
+   */
+  bool sendNext(Connection &c, Clock::time_point now);
+
+  /**
+   * @brief Append the request of `req` to the unsent bytes of `c`.
+   *
+   * Encodes a write while `req.writing` is set, otherwise a read.
+   */
+  void encode(Connection &c, const Request &req);
+
+  /** @brief Write as much of the encoded requests as the socket accepts. */
+  void flush(Connection &c);
+
+  /** @brief Read from the socket and dispatch complete responses. */
+  void receive(Connection &c);
+
+  /** @brief Complete the request matching a parsed response. */
+  void dispatch(Connection &c, const ModbusTcpFramer::Response &resp);
+
+  /**
+   * @brief Complete an active request and free its window entry.
+   *
+   * @param c    Connection owning `req`.
+   * @param req  Active entry of `c.requests`, answered or timed out.
+   * @param res  Outcome; on success the registers are in `merged.dest`.
+   */
+  void finish(Connection &c, Request &req,
+              std::expected<void, ModbusErrorEvent> res);
+
+  /** @brief Free the window entry of an active request. */
+  void retire(Connection &c, Request &req);
+
+  /** @brief Fail every active request of `c` with `err`, off the wire. */
+  void abortAll(Connection &c, const ModbusError &err);
+
+  /** @brief Close the socket of `c`, if open. */
+  void closeSocket(Connection &c);
+
+  /** @brief Register the events `c` currently waits for with epoll. */
+  void updateEvents(Connection &c);
+
+  // -------------------------------------------------------------------------
+  // State
+  // -------------------------------------------------------------------------
+
+  /** @brief Device scheduler shared by every attached bus. */
+  std::shared_ptr<DeviceScheduler> scheduler_;
+
+  /** @brief epoll instance. */
+  int epollFd_{-1};
+
+  /** @brief eventfd used by `wake()`. */
+  int wakeFd_{-1};
+
+  /** @brief Set while a wakeup is pending, to skip redundant writes. */
+  std::atomic<bool> wakePending_{false};
+
+  /** @brief Cleared by the destructor to stop the loop thread. */
+  std::atomic<bool> running_{true};
+
+  /** @brief Loop thread. */
+  std::thread thread_;
+
+  /** @brief Buses driven by the loop. Loop thread only. */
+  std::vector<std::unique_ptr<Channel>> channels_;
+
+  /** @brief An attach or detach request for the loop thread. */
+  struct Command {
+    FroniusBus *bus;
+    bool attach;
+  };
+
+  /** @brief Protects the command state below. */
+  mutable std::mutex cmdMtx_;
+
+  /** @brief Signals `detach()` callers when commands have been applied. */
+  std::condition_variable cmdCv_;
+
+  /** @brief Requests not yet taken by the loop thread. */
+  std::vector<Command> commands_;
+
+  /** @brief Requests issued and applied so far; `detach()` waits on them. */
+  uint64_t cmdIssued_{0};
+  uint64_t cmdApplied_{0};
+
+  /** @brief Buses driven by the loop, updated after applying commands. */
+  size_t busCount_{0};
+};
+
+#endif /* BUS_EVENT_LOOP_H_ */
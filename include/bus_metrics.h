@@ -0,0 +1,497 @@
+/**
+ * @file bus_metrics.h
+ * @brief Lock-free latency and throughput counters for a `FroniusBus`.
+ *
+ * @details
+ * `BusMetrics` collects round-trip latency histograms (overall, per slave,
+ * and per slave/register block), queue depth and wait time, payload volume, error
+ * counters by `ModbusError::Severity`, connection counts, and the wire
+ * time and end-to-end latency of register writes. Recording
+ * touches only relaxed atomics in storage sized at construction, so it
+ * neither locks nor allocates and can stay enabled in production.
+ *
+ * All counters are monotonic totals since construction. Rates such as
+ * registers per second are derived by the consumer from two snapshots
+ * (e.g. with Prometheus `rate()`), using `Snapshot::uptime` as time base.
+ */
+
+#ifndef BUS_METRICS_H_
+#define BUS_METRICS_H_
+
+#include "modbus_error.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * @class BusMetrics
+ * @brief Instrumentation counters of one Modbus bus.
+ *
+ * Written by the bus thread (and, for queue and pool counters, by
+ * submitting threads), read at any time through `snapshot()`. Individual
+ * counters are exact; a snapshot is not an atomic cut across counters.
+ */
+class BusMetrics {
+public:
+  /** @brief Number of latency histogram buckets. */
+  static constexpr size_t LATENCY_BUCKETS = 24;
+
+  /** @brief Number of distinct slave/register blocks tracked. */
+  static constexpr size_t MAX_BLOCKS = 64;
+
+  /** @brief Highest slave ID tracked per slave. */
+  static constexpr size_t MAX_SLAVE_ID = 247;
+
+  /**
+   * @struct Histogram
+   * @brief Latency distribution with power-of-two microsecond buckets.
+   *
+   * Bucket `i` counts samples below `upperBoundUs(i)` and at or above the
+   * bound of bucket `i - 1`. The last bucket counts everything beyond
+   * about 4.2 s.
+   */
+  struct Histogram {
+    /** @brief Sample count per bucket. */
+    std::array<uint64_t, LATENCY_BUCKETS> buckets{};
+
+    /** @brief Total number of samples. */
+    uint64_t count{0};
+
+    /** @brief Sum of all samples in microseconds. */
+    uint64_t sumUs{0};
+
+    /** @brief Largest sample in microseconds. */
+    uint64_t maxUs{0};
+
+    /** @brief Exclusive upper bound of bucket `i` in microseconds. */
+    static constexpr uint64_t upperBoundUs(size_t i) {
+      return i + 1 < LATENCY_BUCKETS ? uint64_t{1} << i : UINT64_MAX;
+    }
+  };
+
+  /**
+   * @struct SlaveStats
+   * @brief Round trips of all register reads of one slave.
+   */
+  struct SlaveStats {
+    int slaveId{0};
+
+    /** @brief Reads of this slave, successful or not. */
+    uint64_t reads{0};
+
+    /** @brief Failed reads of this slave. */
+    uint64_t errors{0};
+
+    /** @brief Round-trip latency of this slave. */
+    Histogram latency;
+  };
+
+  /**
+   * @struct BlockStats
+   * @brief Round trips of one register read, keyed by slave and range.
+   *
+   * A coalesced read is tracked as its own block.
+   */
+  struct BlockStats {
+    int slaveId{0};
+    int startAddr{0};
+    int count{0};
+
+    /** @brief Reads of this block, successful or not. */
+    uint64_t reads{0};
+
+    /** @brief Failed reads of this block. */
+    uint64_t errors{0};
+
+    /** @brief Round-trip latency of this block. */
+    Histogram latency;
+  };
+
+  /**
+   * @struct Snapshot
+   * @brief Point-in-time copy of all counters.
+   */
+  struct Snapshot {
+    /** @brief Time since the metrics were created. */
+    std::chrono::steady_clock::duration uptime{};
+
+    /** @brief Register reads sent on the wire, coalesced reads count once. */
+    uint64_t reads{0};
+
+    /** @brief Transactions completed by a coalesced read. */
+    uint64_t coalescedTransactions{0};
+
+    /** @brief Registers successfully read. */
+    uint64_t registersRead{0};
+
+    /** @brief Estimated request bytes sent (ADU including framing). */
+    uint64_t bytesSent{0};
+
+    /** @brief Estimated response bytes received (ADU including framing). */
+    uint64_t bytesReceived{0};
+
+    /** @brief Reads that failed with `ETIMEDOUT`. */
+    uint64_t timeouts{0};
+
+    /** @brief Reported bus errors, indexed by `ModbusError::Severity`. */
+    std::array<uint64_t, 3> errors{};
+
+    /** @brief Transactions dropped because their deadline passed. */
+    uint64_t deadlineDrops{0};
+
+    /** @brief Submissions rejected because the slot pool was full. */
+    uint64_t poolExhausted{0};
+
+    /** @brief Successful bus connections, including reconnects. */
+    uint64_t connects{0};
+
+    /** @brief Failed connection attempts. */
+    uint64_t connectFailures{0};
+
+    /** @brief Connection losses detected while connected. */
+    uint64_t disconnects{0};
+
+    /** @brief Queue depth at the last enqueue or dequeue. */
+    uint64_t queueDepth{0};
+
+    /** @brief Largest queue depth observed. */
+    uint64_t queueDepthMax{0};
+
+    /** @brief Round-trip latency of all reads. */
+    Histogram roundTrip;
+
+    /** @brief Register writes sent, read-modify-writes included. */
+    uint64_t writes{0};
+
+    /** @brief Failed register writes. */
+    uint64_t writeErrors{0};
+
+    /** @brief Registers successfully written. */
+    uint64_t registersWritten{0};
+
+    /** @brief Wire time of writes; both requests of a read-modify-write. */
+    Histogram writeRoundTrip;
+
+    /** @brief Time from submitting a write to its completion. */
+    Histogram writeLatency;
+
+    /** @brief Time transactions spent queued before execution. */
+    Histogram queueWait;
+
+    /** @brief Per-slave statistics of the slaves read so far, by ID. */
+    std::vector<SlaveStats> slaves;
+
+    /** @brief Per-block statistics, in first-seen order of their slot. */
+    std::vector<BlockStats> blocks;
+
+    /** @brief Reads not tracked per block because the table was full. */
+    uint64_t untrackedBlockReads{0};
+
+    /** @brief Reported bus errors of one severity. */
+    uint64_t errorCount(ModbusError::Severity sev) const {
+      return errors[static_cast<size_t>(sev)];
+    }
+  };
+
+  /** @brief Start collecting; `Snapshot::uptime` counts from here. */
+  BusMetrics() : start_(std::chrono::steady_clock::now()) {}
+
+  // Non-copyable, non-movable (atomics).
+  BusMetrics(const BusMetrics &) = delete;
+  BusMetrics &operator=(const BusMetrics &) = delete;
+
+  // -------------------------------------------------------------------------
+  // Recording — lock-free, allocation-free
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Record one register read sent on the wire.
+   *
+   * @param slaveId    Slave addressed.
+   * @param startAddr  First register of the read.
+   * @param count      Number of registers requested.
+   * @param rtt        Round-trip time of the read.
+   * @param ok         True if the slave answered with data.
+   * @param txBytes    Request size on the wire.
+   * @param rxBytes    Response size on the wire (counted only if `ok`).
+   */
+  void recordRead(int slaveId, int startAddr, int count,
+                  std::chrono::microseconds rtt, bool ok, size_t txBytes,
+                  size_t rxBytes) noexcept {
+    const auto us = static_cast<uint64_t>(std::max<int64_t>(rtt.count(), 0));
+
+    add(reads_);
+    add(bytesSent_, txBytes);
+    if (ok) {
+      add(registersRead_, static_cast<uint64_t>(count));
+      add(bytesReceived_, rxBytes);
+    }
+    roundTrip_.record(us);
+
+    if (slaveId >= 1 && static_cast<size_t>(slaveId) <= MAX_SLAVE_ID) {
+      Slave &sl = slaves_[static_cast<size_t>(slaveId)];
+      add(sl.reads);
+      if (!ok)
+        add(sl.errors);
+      sl.latency.record(us);
+    }
+
+    Block *b = findBlock(slaveId, startAddr, count);
+    if (!b) {
+      add(untrackedBlockReads_);
+      return;
+    }
+    add(b->reads);
+    if (!ok)
+      add(b->errors);
+    b->latency.record(us);
+  }
+
+  /**
+   * @brief Record one register write sent on the wire.
+   *
+   * @param count    Number of registers written.
+   * @param rtt      Wire time, from the first request to the last response.
+   * @param ok       True if the slave confirmed the write.
+   * @param txBytes  Request bytes on the wire.
+   * @param rxBytes  Response bytes on the wire (counted only if `ok`).
+   */
+  void recordWrite(int count, std::chrono::microseconds rtt, bool ok,
+                   size_t txBytes, size_t rxBytes) noexcept {
+    add(writes_);
+    add(bytesSent_, txBytes);
+    if (ok) {
+      add(registersWritten_, static_cast<uint64_t>(count));
+      add(bytesReceived_, rxBytes);
+    } else {
+      add(writeErrors_);
+    }
+    writeRoundTrip_.record(
+        static_cast<uint64_t>(std::max<int64_t>(rtt.count(), 0)));
+  }
+
+  /** @brief Record the time from submitting a write to its completion. */
+  void recordWriteLatency(std::chrono::microseconds latency) noexcept {
+    writeLatency_.record(
+        static_cast<uint64_t>(std::max<int64_t>(latency.count(), 0)));
+  }
+
+  /** @brief Record a reported bus error. */
+  void recordError(const ModbusErrorEvent &ev) noexcept {
+    add(errors_[static_cast<size_t>(ev.severity)]);
+    if (ev.code == ETIMEDOUT)
+      add(timeouts_);
+  }
+
+  /** @brief Record how long a transaction waited in the queue. */
+  void recordQueueWait(std::chrono::microseconds wait) noexcept {
+    queueWait_.record(
+        static_cast<uint64_t>(std::max<int64_t>(wait.count(), 0)));
+  }
+
+  /** @brief Record the current queue depth. */
+  void recordQueueDepth(size_t depth) noexcept {
+    queueDepth_.store(depth, std::memory_order_relaxed);
+    raise(queueDepthMax_, depth);
+  }
+
+  /** @brief Record `n` transactions completed by one coalesced read. */
+  void recordCoalesced(size_t n) noexcept { add(coalesced_, n); }
+
+  /** @brief Record a transaction dropped past its deadline. */
+  void recordDeadlineDrop() noexcept { add(deadlineDrops_); }
+
+  /** @brief Record a submission rejected by a full slot pool. */
+  void recordPoolExhausted() noexcept { add(poolExhausted_); }
+
+  /** @brief Record a successful bus connection. */
+  void recordConnect() noexcept { add(connects_); }
+
+  /** @brief Record a failed connection attempt. */
+  void recordConnectFailure() noexcept { add(connectFailures_); }
+
+  /** @brief Record the loss of an established connection. */
+  void recordDisconnect() noexcept { add(disconnects_); }
+
+  // -------------------------------------------------------------------------
+  // Snapshot
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Copy all counters.
+   *
+   * Allocates only the per-slave and per-block vectors.
+   */
+  Snapshot snapshot() const {
+    Snapshot s;
+    s.uptime = std::chrono::steady_clock::now() - start_;
+    s.reads = load(reads_);
+    s.coalescedTransactions = load(coalesced_);
+    s.registersRead = load(registersRead_);
+    s.bytesSent = load(bytesSent_);
+    s.bytesReceived = load(bytesReceived_);
+    s.timeouts = load(timeouts_);
+    for (size_t i = 0; i < s.errors.size(); ++i)
+      s.errors[i] = load(errors_[i]);
+    s.deadlineDrops = load(deadlineDrops_);
+    s.poolExhausted = load(poolExhausted_);
+    s.connects = load(connects_);
+    s.connectFailures = load(connectFailures_);
+    s.disconnects = load(disconnects_);
+    s.queueDepth = load(queueDepth_);
+    s.queueDepthMax = load(queueDepthMax_);
+    roundTrip_.copyTo(s.roundTrip);
+    s.writes = load(writes_);
+    s.writeErrors = load(writeErrors_);
+    s.registersWritten = load(registersWritten_);
+    writeRoundTrip_.copyTo(s.writeRoundTrip);
+    writeLatency_.copyTo(s.writeLatency);
+    queueWait_.copyTo(s.queueWait);
+    s.untrackedBlockReads = load(untrackedBlockReads_);
+
+    for (size_t id = 1; id <= MAX_SLAVE_ID; ++id) {
+      const Slave &sl = slaves_[id];
+      if (load(sl.reads) == 0)
+        continue;
+      SlaveStats &ss = s.slaves.emplace_back();
+      ss.slaveId = static_cast<int>(id);
+      ss.reads = load(sl.reads);
+      ss.errors = load(sl.errors);
+      sl.latency.copyTo(ss.latency);
+    }
+
+    for (const auto &b : blocks_) {
+      const uint64_t key = b.key.load(std::memory_order_acquire);
+      if (key == 0)
+        continue;
+      BlockStats &bs = s.blocks.emplace_back();
+      bs.slaveId = static_cast<int>(key >> 32);
+      bs.startAddr = static_cast<int>((key >> 16) & 0xFFFF);
+      bs.count = static_cast<int>(key & 0xFFFF);
+      bs.reads = load(b.reads);
+      bs.errors = load(b.errors);
+      b.latency.copyTo(bs.latency);
+    }
+    return s;
+  }
+
+private:
+  /** @brief Histogram with atomic buckets, updated by `record()`. */
+  struct AtomicHistogram {
+    std::array<std::atomic<uint64_t>, LATENCY_BUCKETS> buckets{};
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> sumUs{0};
+    std::atomic<uint64_t> maxUs{0};
+
+    void record(uint64_t us) noexcept {
+      const size_t i = std::min<size_t>(std::bit_width(us),
+                                        LATENCY_BUCKETS - 1);
+      add(buckets[i]);
+      add(count);
+      add(sumUs, us);
+      raise(maxUs, us);
+    }
+
+    void copyTo(Histogram &h) const {
+      for (size_t i = 0; i < LATENCY_BUCKETS; ++i)
+        h.buckets[i] = load(buckets[i]);
+      h.count = load(count);
+      h.sumUs = load(sumUs);
+      h.maxUs = load(maxUs);
+    }
+  };
+
+  /** @brief Per-slave counters, indexed by slave ID. */
+  struct Slave {
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> errors{0};
+    AtomicHistogram latency;
+  };
+
+  /** @brief Per-block counters; `key` is zero while the slot is unused. */
+  struct Block {
+    std::atomic<uint64_t> key{0};
+    std::atomic<uint64_t> reads{0};
+    std::atomic<uint64_t> errors{0};
+    AtomicHistogram latency;
+  };
+
+  static void add(std::atomic<uint64_t> &c, uint64_t n = 1) noexcept {
+    c.fetch_add(n, std::memory_order_relaxed);
+  }
+
+  static uint64_t load(const std::atomic<uint64_t> &c) noexcept {
+    return c.load(std::memory_order_relaxed);
+  }
+
+  static void raise(std::atomic<uint64_t> &c, uint64_t v) noexcept {
+    uint64_t cur = c.load(std::memory_order_relaxed);
+    while (v > cur &&
+           !c.compare_exchange_weak(cur, v, std::memory_order_relaxed))
+      ;
+  }
+
+  /**
+   * @brief Find or claim the table slot of a block.
+   *
+   * Open addressing with linear probing; slots are claimed by CAS and
+   * never released.
+   *
+   * @return The block's slot, or null if the table is full.
+   */
+  Block *findBlock(int slaveId, int startAddr, int count) noexcept {
+    const uint64_t key = (static_cast<uint64_t>(slaveId) << 32) |
+                         ((static_cast<uint64_t>(startAddr) & 0xFFFF) << 16) |
+                         (static_cast<uint64_t>(count) & 0xFFFF);
+    if (key == 0)
+      return nullptr;
+
+    const size_t home = (key * 0x9E3779B97F4A7C15ULL) >> 58;
+    for (size_t probe = 0; probe < MAX_BLOCKS; ++probe) {
+      Block &b = blocks_[(home + probe) % MAX_BLOCKS];
+      uint64_t cur = b.key.load(std::memory_order_acquire);
+      if (cur == 0 &&
+          b.key.compare_exchange_strong(cur, key, std::memory_order_acq_rel))
+        return &b;
+      if (cur == key)
+        return &b;
+    }
+    return nullptr;
+  }
+
+  const std::chrono::steady_clock::time_point start_;
+
+  std::atomic<uint64_t> reads_{0};
+  std::atomic<uint64_t> coalesced_{0};
+  std::atomic<uint64_t> registersRead_{0};
+  std::atomic<uint64_t> bytesSent_{0};
+  std::atomic<uint64_t> bytesReceived_{0};
+  std::atomic<uint64_t> timeouts_{0};
+  std::array<std::atomic<uint64_t>, 3> errors_{};
+  std::atomic<uint64_t> deadlineDrops_{0};
+  std::atomic<uint64_t> poolExhausted_{0};
+  std::atomic<uint64_t> connects_{0};
+  std::atomic<uint64_t> connectFailures_{0};
+  std::atomic<uint64_t> disconnects_{0};
+  std::atomic<uint64_t> queueDepth_{0};
+  std::atomic<uint64_t> queueDepthMax_{0};
+  std::atomic<uint64_t> untrackedBlockReads_{0};
+  std::atomic<uint64_t> writes_{0};
+  std::atomic<uint64_t> writeErrors_{0};
+  std::atomic<uint64_t> registersWritten_{0};
+
+  AtomicHistogram roundTrip_;
+  AtomicHistogram queueWait_;
+  AtomicHistogram writeRoundTrip_;
+  AtomicHistogram writeLatency_;
+  std::array<Slave, MAX_SLAVE_ID + 1> slaves_;
+  std::array<Block, MAX_BLOCKS> blocks_;
+};
+
+#endif /* BUS_METRICS_H_ */
@@ -0,0 +1,365 @@
+/**
+ * @file bus_recording.h
+ * @brief Recording of the register accesses of a bus, and their replay.
+ *
+ * @details
+ * With `ModbusBusConfig::recordPath` set, a `FroniusBus` appends every
+ * register read, write, and read-modify-write that goes over the wire
+ * (slave, range, the words read or written or the error, and the timing)
+ * to a recording through a `BusRecorder`. A bus configured with a
+ * `ModbusReplayTransport` serves its reads and writes from such a
+ * recording through a `BusReplay` instead of a device, at the recorded
+ * pace, accelerated, or as fast as possible. Everything above the bus
+ * (validation, decoding, change detection, control loops, export) runs
+ * unchanged, so it can be profiled on captured field data and incidents
+ * reproduced offline.
+ *
+ * A recording is a `BusRecordingHeader` followed by `BusRecord`s, each
+ * followed by its response words and padded to 8 bytes, so that every
+ * record is aligned when the file is memory-mapped. Files are append-only;
+ * reopening a recording continues it. Fields are stored in host byte
+ * order, and the header's byte-order mark rejects recordings made on a
+ * machine of the other endianness.
+ */
+
+#ifndef BUS_RECORDING_H_
+#define BUS_RECORDING_H_
+
+#include "modbus_error.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// ---------------------------------------------------------------------------
+// File format
+// ---------------------------------------------------------------------------
+
+/**
+ * @struct BusRecordingHeader
+ * @brief First bytes of a recording file.
+ */
+struct BusRecordingHeader {
+  /** @brief File signature, `"FRNSREC"` and a null byte. */
+  static constexpr std::array<char, 8> MAGIC{'F', 'R', 'N', 'S',
+                                             'R', 'E', 'C', '\0'};
+
+  /** @brief Format version written by this library. */
+  static constexpr uint16_t VERSION = 1;
+
+  /** @brief Value of `byteOrder` as written on the recording machine. */
+  static constexpr uint16_t BYTE_ORDER_MARK = 0x0102;
+
+  std::array<char, 8> magic{MAGIC};
+  uint16_t byteOrder{BYTE_ORDER_MARK};
+  uint16_t version{VERSION};
+
+  /** @brief Size of this header; records start at this offset. */
+  uint32_t headerSize{sizeof(BusRecordingHeader)};
+
+  /** @brief `system_clock` time the recording started, in ns. */
+  int64_t startNs{0};
+
+  uint64_t reserved{0};
+};
+
+static_assert(sizeof(BusRecordingHeader) == 32);
+
+/**
+ * @struct BusRecord
+ * @brief One recorded register access, followed by `words` registers.
+ */
+struct BusRecord {
+  /** @brief Register access recorded. */
+  enum Op : uint8_t {
+    READ = 0,   ///< Words are the registers read
+    WRITE = 1,  ///< Words are the registers written
+    MODIFY = 2, ///< Read-modify-write; words are the registers written
+  };
+
+  /** @brief Time the request was sent, in µs since the recording started. */
+  uint64_t atUs{0};
+
+  /** @brief Time until the response or the failure, in µs. */
+  uint32_t durationUs{0};
+
+  /** @brief 0 on success, otherwise the errno of the failure. */
+  int32_t err{0};
+
+  /** @brief First register accessed. */
+  uint16_t startAddr{0};
+
+  /** @brief Number of registers requested. */
+  uint16_t count{0};
+
+  /** @brief Slave addressed. */
+  uint8_t slaveId{0};
+
+  /** @brief Access recorded, an `Op`. */
+  uint8_t op{READ};
+
+  /** @brief Registers following the record; 0 on failure. */
+  uint16_t words{0};
+
+  /** @brief Size of a record with `words` registers, including padding. */
+  static constexpr size_t size(uint16_t words) {
+    return (sizeof(BusRecord) + 2 * size_t{words} + 7) & ~size_t{7};
+  }
+
+  /** @brief The registers read or written. */
+  const uint16_t *data() const {
+    return reinterpret_cast<const uint16_t *>(this + 1);
+  }
+};
+
+static_assert(sizeof(BusRecord) == 24);
+
+// ---------------------------------------------------------------------------
+// BusRecorder — appends register accesses to a recording
+// ---------------------------------------------------------------------------
+
+/**
+ * @class BusRecorder
+ * @brief Appends register accesses to a recording file.
+ *
+ * Each access is written with one `write()` to a descriptor opened with
+ * `O_APPEND`, from a preallocated buffer, so recording does not allocate.
+ * Not thread-safe; the bus calls it from the thread issuing its reads.
+ */
+class BusRecorder {
+public:
+  /** @brief Largest number of registers a Modbus read or write carries. */
+  static constexpr uint16_t MAX_WORDS = 125;
+
+  /**
+   * @brief Open `path` for recording, creating it if needed.
+   *
+   * An existing recording is continued, with record times relative to its
+   * original start. A record left incomplete by a crash is cut off first.
+   *
+   * @return The recorder, or the error opening, reading, or validating
+   *         the file (`EINVAL` for a file that is not a recording).
+   */
+  static std::expected<std::unique_ptr<BusRecorder>, ModbusError>
+  open(const std::string &path);
+
+  /** @brief Close the file. */
+  ~BusRecorder();
+
+  // Non-copyable, non-movable.
+  BusRecorder(const BusRecorder &) = delete;
+  BusRecorder &operator=(const BusRecorder &) = delete;
+  BusRecorder(BusRecorder &&) = delete;
+  BusRecorder &operator=(BusRecorder &&) = delete;
+
+  /**
+   * @brief Append one register access.
+   *
+   * @param slaveId    Slave addressed.
+   * @param startAddr  First register.
+   * @param count      Number of registers.
+   * @param words      The `count` registers read or written; ignored on
+   *                   failure.
+   * @param err        0 on success, otherwise the error code.
+   * @param start      Time the request was sent.
+   * @param end        Time the response or failure arrived.
+   * @param op         Access performed.
+   * @return Empty expected, or the write error.
+   */
+  std::expected<void, ModbusError>
+  append(int slaveId, int startAddr, int count, const uint16_t *words,
+         int err, std::chrono::steady_clock::time_point start,
+         std::chrono::steady_clock::time_point end,
+         BusRecord::Op op = BusRecord::READ);
+
+  /** @brief Path of the recording. */
+  const std::string &path() const { return path_; }
+
+private:
+  BusRecorder(std::string path, int fd,
+              std::chrono::steady_clock::time_point origin)
+      : path_(std::move(path)), fd_(fd), origin_(origin) {}
+
+  std::string path_;
+  int fd_{-1};
+
+  /** @brief `steady_clock` time of the recording's start. */
+  std::chrono::steady_clock::time_point origin_;
+
+  /** @brief Record being written, sized for the largest access. */
+  alignas(8) std::array<uint8_t, BusRecord::size(MAX_WORDS)> buf_{};
+};
+
+// ---------------------------------------------------------------------------
+// BusReplay — serves register accesses from a recording
+// ---------------------------------------------------------------------------
+
+/**
+ * @class BusReplay
+ * @brief Serves register reads and writes from a memory-mapped recording.
+ *
+ * Reads are matched to recorded reads of the same slave and range; each
+ * match returns the next recorded response for that range, in recorded
+ * order. A read of a range that was not recorded as such is served from a
+ * recorded read of the same slave that contains it, so a replay also
+ * works when coalescing merges reads differently than during recording.
+ * Writes and read-modify-writes are matched the same way to recorded
+ * accesses of the same kind, slave, and range, without the containment
+ * fallback, and return their recorded outcome.
+ *
+ * With a `speed` above 0, each response is due at its recorded time,
+ * divided by `speed`, counted from the first read of the replay. Not
+ * thread-safe; the bus calls it from its thread.
+ */
+class BusReplay {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /**
+   * @struct Response
+   * @brief A recorded response to a read.
+   */
+  struct Response {
+    /** @brief The recorded read; `err` tells success from failure. */
+    const BusRecord *record{nullptr};
+
+    /** @brief The requested registers within the recorded response. */
+    const uint16_t *words{nullptr};
+
+    /** @brief Time to answer at; `time_point::min()` for no pacing. */
+    Clock::time_point due{Clock::time_point::min()};
+  };
+
+  /**
+   * @brief Map a recording for replay.
+   *
+   * @param path   Recording written by a `BusRecorder`.
+   * @param speed  Pace relative to the recording; 0 answers immediately.
+   * @param loop   Start over after the last recorded response of a range.
+   * @return The replay, or the error opening or validating the file
+   *         (`EINVAL` for a file that is not a recording, `ENODATA` for a
+   *         recording without reads or writes).
+   */
+  static std::expected<std::unique_ptr<BusReplay>, ModbusError>
+  open(const std::string &path, double speed, bool loop);
+
+  /** @brief Unmap the recording. */
+  ~BusReplay();
+
+  // Non-copyable, non-movable.
+  BusReplay(const BusReplay &) = delete;
+  BusReplay &operator=(const BusReplay &) = delete;
+  BusReplay(BusReplay &&) = delete;
+  BusReplay &operator=(BusReplay &&) = delete;
+
+  /**
+   * @brief Next recorded response to a read.
+   *
+   * @return The response, `EMBXILADD` if no read of the slave covers the
+   *         range, or `ENODATA` once the responses of a non-looping replay
+   *         are used up.
+   */
+  std::expected<Response, ModbusError> next(int slaveId, int startAddr,
+                                            int count);
+
+  /**
+   * @brief Next recorded outcome of a write or read-modify-write.
+   *
+   * The response's words are the registers written.
+   *
+   * @param op  `BusRecord::WRITE` or `BusRecord::MODIFY`.
+   * @return The response, `ENOTSUP` if no such access of the slave and
+   *         range was recorded, or `ENODATA` once the recorded ones of a
+   *         non-looping replay are used up.
+   */
+  std::expected<Response, ModbusError> nextWrite(BusRecord::Op op,
+                                                 int slaveId, int startAddr,
+                                                 int count);
+
+  /** @brief True once a non-looping replay ran out of responses. */
+  bool finished() const { return finished_; }
+
+  /** @brief Number of recorded reads, writes, and read-modify-writes. */
+  size_t records() const { return records_; }
+
+  /** @brief Path of the recording. */
+  const std::string &path() const { return path_; }
+
+private:
+  /** @brief Recorded responses to one slave and range. */
+  struct Sequence {
+    /** @brief Byte offsets of the records, in recorded order. */
+    std::vector<size_t> records;
+
+    /** @brief Index of the next response. */
+    size_t next{0};
+
+    /** @brief Completed passes over `records`. */
+    uint64_t lap{0};
+  };
+
+  /** @brief A range served from within a longer recorded range. */
+  struct Alias {
+    Sequence *sequence;
+    uint16_t offset;
+  };
+
+  BusReplay(std::string path, double speed, bool loop)
+      : path_(std::move(path)), speed_(speed), loop_(loop) {}
+
+  /** @brief Index key of a slave and range. */
+  static uint64_t key(int slaveId, int startAddr, int count) {
+    return static_cast<uint64_t>(slaveId & 0xFF) << 32 |
+           static_cast<uint64_t>(startAddr & 0xFFFF) << 16 |
+           static_cast<uint64_t>(count & 0xFFFF);
+  }
+
+  /** @brief Find the sequence serving a read, or null. */
+  const Alias *resolve(int slaveId, int startAddr, int count);
+
+  /**
+   * @brief Take the next response of `seq`, paced from its recorded time.
+   *
+   * @return The response, or `ENODATA` once a non-looping replay has used
+   *         up `seq`.
+   */
+  std::expected<Response, ModbusError> take(Sequence &seq, uint16_t offset);
+
+  /** @brief Record at byte offset `at`. */
+  const BusRecord *record(size_t at) const {
+    return reinterpret_cast<const BusRecord *>(base_ + at);
+  }
+
+  std::string path_;
+  double speed_;
+  bool loop_;
+
+  const uint8_t *base_{nullptr};
+  size_t size_{0};
+  size_t records_{0};
+
+  /** @brief Recorded time of the first access and span of one pass, in µs. */
+  uint64_t firstUs_{0};
+  uint64_t spanUs_{0};
+
+  std::unordered_map<uint64_t, Sequence> sequences_;
+
+  /** @brief Recorded writes and read-modify-writes, by op, slave, range. */
+  std::unordered_map<uint64_t, Sequence> writes_;
+
+  /** @brief Reads resolved to a sequence, including exact matches. */
+  std::unordered_map<uint64_t, Alias> aliases_;
+
+  /** @brief Time of the first access; pacing counts from here. */
+  Clock::time_point started_{};
+  bool running_{false};
+  bool finished_{false};
+};
+
+#endif /* BUS_RECORDING_H_ */
@@ -0,0 +1,150 @@
+/**
+ * @file bus_trace.h
+ * @brief Binary trace events of a `FroniusBus` and their ring buffer.
+ *
+ * @details
+ * The bus thread records one fixed-size `BusTraceEvent` per wire read,
+ * register write, slave switch, coalesced read, and dropped transaction
+ * into a preallocated single-producer/single-consumer ring. Recording
+ * copies a few words and never formats, locks, or allocates; the
+ * application drains the ring on its own thread and formats at leisure.
+ * When the ring is full new events are counted and discarded, so a slow
+ * consumer never stalls the bus.
+ */
+
+#ifndef BUS_TRACE_H_
+#define BUS_TRACE_H_
+
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+
+/**
+ * @struct BusTraceEvent
+ * @brief One structured bus trace record.
+ */
+struct BusTraceEvent {
+  /** @brief What the record describes. */
+  enum class Kind : uint8_t {
+    READ,     ///< Register read on the wire; `rc` is 0 or the errno
+    SWITCH,   ///< RTU slave switch; `aux` is the settle delay in µs
+    COALESCE, ///< Merged read; `aux` is the number of transactions merged
+    DROP,     ///< Transaction dropped past its deadline, never sent
+    WRITE,    ///< Register write; `aux` is 1 for a read-modify-write
+  };
+
+  Kind kind{Kind::READ};
+
+  /** @brief Slave addressed. */
+  uint8_t slaveId{0};
+
+  /** @brief First register of the read. */
+  uint16_t startAddr{0};
+
+  /** @brief Number of registers of the read. */
+  uint16_t count{0};
+
+  /** @brief 0 on success, otherwise the errno of the failure. */
+  int32_t rc{0};
+
+  /** @brief Kind-specific value, see `Kind`. */
+  uint32_t aux{0};
+
+  /** @brief `steady_clock` time the operation started, in ns. */
+  int64_t startNs{0};
+
+  /** @brief `steady_clock` time the operation ended, in ns. */
+  int64_t endNs{0};
+};
+
+/**
+ * @class BusTraceRing
+ * @brief Lock-free SPSC ring of `BusTraceEvent`s.
+ *
+ * `push()` must only be called by one producer thread and `pop()` by one
+ * consumer thread at a time. A default-constructed ring has no capacity
+ * and discards everything without counting it.
+ */
+class BusTraceRing {
+public:
+  /** @brief Construct a disabled ring. */
+  BusTraceRing() = default;
+
+  // Non-copyable, non-movable (atomics).
+  BusTraceRing(const BusTraceRing &) = delete;
+  BusTraceRing &operator=(const BusTraceRing &) = delete;
+
+  /**
+   * @brief Allocate room for at least `capacity` events.
+   *
+   * The capacity is rounded up to a power of two; 0 leaves tracing
+   * disabled. Must be called before the ring is shared between threads.
+   */
+  void init(size_t capacity) {
+    if (capacity == 0)
+      return;
+    capacity_ = std::bit_ceil(capacity);
+    events_ = std::make_unique<BusTraceEvent[]>(capacity_);
+  }
+
+  /** @brief True if the ring records events. */
+  bool enabled() const { return capacity_ != 0; }
+
+  /**
+   * @brief Append an event (producer side).
+   *
+   * @return False if the ring is disabled or full; a full ring counts the
+   *         event as dropped.
+   */
+  bool push(const BusTraceEvent &ev) noexcept {
+    if (capacity_ == 0)
+      return false;
+
+    const size_t head = head_.load(std::memory_order_relaxed);
+    if (head - tail_.load(std::memory_order_acquire) == capacity_) {
+      dropped_.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+
+    events_[head & (capacity_ - 1)] = ev;
+    head_.store(head + 1, std::memory_order_release);
+    return true;
+  }
+
+  /**
+   * @brief Remove up to `max` of the oldest events (consumer side).
+   *
+   * @param out  Destination for at least `max` events.
+   * @param max  Maximum number of events to remove.
+   * @return Number of events written to `out`.
+   */
+  size_t pop(BusTraceEvent *out, size_t max) noexcept {
+    const size_t tail = tail_.load(std::memory_order_relaxed);
+    const size_t avail = head_.load(std::memory_order_acquire) - tail;
+    const size_t n = avail < max ? avail : max;
+
+    for (size_t i = 0; i < n; ++i)
+      out[i] = events_[(tail + i) & (capacity_ - 1)];
+
+    tail_.store(tail + n, std::memory_order_release);
+    return n;
+  }
+
+  /** @brief Events discarded because the ring was full. */
+  uint64_t dropped() const {
+    return dropped_.load(std::memory_order_relaxed);
+  }
+
+private:
+  size_t capacity_{0};
+  std::unique_ptr<BusTraceEvent[]> events_;
+
+  // Producer and consumer indices on separate cache lines
+  alignas(64) std::atomic<size_t> head_{0};
+  alignas(64) std::atomic<size_t> tail_{0};
+  std::atomic<uint64_t> dropped_{0};
+};
+
+#endif /* BUS_TRACE_H_ */
@@ -0,0 +1,122 @@
+/**
+ * @file device_identity_cache.h
+ * @brief Cache of validated device identities for fast reconnects.
+ *
+ * @details
+ * Identifying a device walks its whole SunSpec model chain (or probes the
+ * proprietary meter map) on every connect, although the result never
+ * changes for a given unit. A `DeviceIdentityCache` remembers it per bus
+ * endpoint and slave ID. On the next connect the device confirms the
+ * cached identity with a single read — the SunSpec signature, common
+ * block, serial number, and first model header — and becomes ready
+ * without re-probing; on any mismatch the entry is dropped and the device
+ * validates from scratch.
+ *
+ * The cache lives as long as the application keeps it, so it survives bus
+ * reconnects. Constructed with a file path it also persists across
+ * process restarts. One cache may be shared by all devices and buses.
+ */
+
+#ifndef DEVICE_IDENTITY_CACHE_H_
+#define DEVICE_IDENTITY_CACHE_H_
+
+#include "fronius_types.h"
+#include "modbus_config.h"
+#include "modbus_error.h"
+#include "sunspec_discovery.h"
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <utility>
+
+/**
+ * @struct DeviceIdentity
+ * @brief Everything validation learns about one device.
+ */
+struct DeviceIdentity {
+  /** @brief Detected register map (SunSpec or proprietary). */
+  FroniusTypes::RegisterMap map{FroniusTypes::RegisterMap::UNAVAILABLE};
+
+  /** @brief Serial number the identity is confirmed against. */
+  std::string serial;
+
+  /** @brief Inverter or meter model ID (e.g. 103, 213; 0 if proprietary). */
+  int modelId{0};
+
+  /** @brief True for the float-based SunSpec encoding. */
+  bool floatRegisters{false};
+
+  /** @brief Number of MPPT inputs (inverters only). */
+  int inputs{0};
+
+  /** @brief True if a storage block is present (inverters only). */
+  bool hybrid{false};
+
+  /** @brief SunSpec model chain; empty for the proprietary map. */
+  SunSpecModelTable models;
+};
+
+/**
+ * @class DeviceIdentityCache
+ * @brief Thread-safe map from endpoint and slave ID to `DeviceIdentity`.
+ */
+class DeviceIdentityCache {
+public:
+  /**
+   * @brief Construct a cache.
+   *
+   * @param path  File the cache is loaded from by `load()` and written to
+   *              on every change; empty keeps the cache in memory only.
+   */
+  explicit DeviceIdentityCache(std::string path = {})
+      : path_(std::move(path)) {}
+
+  /**
+   * @brief Build the cache key of a device.
+   *
+   * `tcp://host:port/slave`, `rtu://device/slave`, or
+   * `replay://path/slave`.
+   */
+  static std::string key(const ModbusBusConfig &bus, int slaveId);
+
+  /** @brief Cached identity for `key`, if any. */
+  std::optional<DeviceIdentity> lookup(const std::string &key) const;
+
+  /**
+   * @brief Add or replace the identity for `key`.
+   *
+   * @return Empty expected, or the error writing the cache file. The entry
+   *         is kept in memory either way.
+   */
+  std::expected<void, ModbusError> store(const std::string &key,
+                                         const DeviceIdentity &identity);
+
+  /** @brief Drop the identity for `key`; also rewrites the cache file. */
+  std::expected<void, ModbusError> erase(const std::string &key);
+
+  /**
+   * @brief Read the cache file, replacing the entries in memory.
+   *
+   * A missing file is not an error. Malformed lines are skipped.
+   *
+   * @return Empty expected, or the error opening the file.
+   */
+  std::expected<void, ModbusError> load();
+
+  /** @brief Number of cached identities. */
+  size_t size() const;
+
+private:
+  mutable std::mutex mtx_;
+  std::map<std::string, DeviceIdentity> entries_;
+  const std::string path_;
+
+  /** @brief Write all entries to `path_`. Caller holds `mtx_`. */
+  std::expected<void, ModbusError> save() const;
+};
+
+#endif /* DEVICE_IDENTITY_CACHE_H_ */
@@ -0,0 +1,163 @@
+/**
+ * @file device_scheduler.h
+ * @brief Threads running device validation and per-device retry backoff.
+ *
+ * @details
+ * Validating a device (`FroniusDevice::onBusConnected()`) submits reads
+ * and blocks on their completions, so it cannot run on the thread that
+ * executes them. A `DeviceScheduler` keeps the pending attempts of every
+ * device in one deadline-ordered heap and serves them from a fixed set
+ * of threads, retrying failed devices with their configured backoff until
+ * they become ready or their bus drops.
+ *
+ * Each `FroniusBus` driven by its own bus thread owns a scheduler with one
+ * thread. Buses attached to a `BusEventLoop` share the loop's scheduler,
+ * so the thread count stays flat however many buses there are.
+ */
+
+#ifndef DEVICE_SCHEDULER_H_
+#define DEVICE_SCHEDULER_H_
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class FroniusBus;
+class FroniusDevice;
+
+/**
+ * @class DeviceScheduler
+ * @brief Deadline-ordered device probes, shared by one or more buses.
+ *
+ * Non-copyable, non-movable. All methods are safe to call from any thread.
+ */
+class DeviceScheduler {
+public:
+  /**
+   * @brief Start the probe threads.
+   *
+   * @param threads  Number of probes that may run at once (at least 1).
+   * @throws std::invalid_argument if `threads` is less than 1.
+   */
+  explicit DeviceScheduler(int threads = 1);
+
+  /**
+   * @brief Stop and join the probe threads; pending attempts are dropped.
+   *
+   * May run on a probe thread, when a probe drops the last reference to
+   * its device and bus; that thread is detached instead of joined.
+   */
+  ~DeviceScheduler();
+
+  // Non-copyable, non-movable.
+  DeviceScheduler(const DeviceScheduler &) = delete;
+  DeviceScheduler &operator=(const DeviceScheduler &) = delete;
+  DeviceScheduler(DeviceScheduler &&) = delete;
+  DeviceScheduler &operator=(DeviceScheduler &&) = delete;
+
+  /**
+   * @brief Queue an immediate `onBusConnected()` attempt for `device`.
+   *
+   * Failed attempts are retried with the device's backoff while `bus`
+   * stays connected. No-op if an attempt for the device is already
+   * pending or running.
+   */
+  void schedule(FroniusBus &bus, std::shared_ptr<FroniusDevice> device);
+
+  /**
+   * @brief Drop all pending attempts of `bus` after it disconnected.
+   *
+   * Probes in progress finish, but are not requeued.
+   */
+  void cancel(const FroniusBus &bus);
+
+  /**
+   * @brief Forget `bus` before it is destroyed.
+   *
+   * Like `cancel()`, then waits until no probe of `bus` is running on any
+   * other thread.
+   */
+  void remove(const FroniusBus &bus);
+
+private:
+  /**
+   * @struct Retry
+   * @brief One pending `onBusConnected()` attempt.
+   */
+  struct Retry {
+    /** @brief When the attempt is due. */
+    std::chrono::steady_clock::time_point due;
+
+    /** @brief Device to probe; dropped if it has been destroyed. */
+    std::weak_ptr<FroniusDevice> device;
+
+    /** @brief Identity of the device in `inProgress_`. */
+    FroniusDevice *key{nullptr};
+
+    /** @brief Bus of the device. */
+    FroniusBus *bus{nullptr};
+
+    /** @brief Backoff in seconds before the attempt after this one. */
+    int delay{0};
+
+    /** @brief Epoch of the bus at scheduling; stale after a disconnect. */
+    uint64_t epoch{0};
+  };
+
+  /** @brief Heap order of `retries_`: the earliest deadline on top. */
+  static bool retryLater(const Retry &a, const Retry &b) {
+    return a.due > b.due;
+  }
+
+  /** @brief Remove the pending attempts of `bus`. Caller holds `mtx_`. */
+  void dropRetries(const FroniusBus &bus);
+
+  /** @brief Body of probe thread `worker`. */
+  void run(size_t worker);
+
+  /** @brief Protects everything below. */
+  std::mutex mtx_;
+
+  /** @brief Wakes the probe threads when `retries_` changes. */
+  std::condition_variable cv_;
+
+  /** @brief Signals `remove()` callers when a probe finishes. */
+  std::condition_variable idleCv_;
+
+  /** @brief Pending attempts, a min-heap on `Retry::due`. */
+  std::vector<Retry> retries_;
+
+  /**
+   * @brief Devices with an attempt pending or running, and their bus.
+   *
+   * Prevents concurrent `onBusConnected()` calls for the same device when
+   * several error callbacks fire in quick succession.
+   */
+  std::map<FroniusDevice *, const FroniusBus *> inProgress_;
+
+  /** @brief Per-bus counter, bumped on every disconnect. */
+  std::map<const FroniusBus *, uint64_t> epochs_;
+
+  /** @brief Bus being probed by each thread, or null while idle. */
+  std::vector<const FroniusBus *> probing_;
+
+  /**
+   * @brief Flag in the frame of each thread's `run()`, set when the
+   *        scheduler is destroyed from that thread.
+   */
+  std::vector<bool *> orphaned_;
+
+  /** @brief Cleared by the destructor to stop the threads. */
+  bool running_{true};
+
+  /** @brief Probe threads. */
+  std::vector<std::thread> threads_;
+};
+
+#endif /* DEVICE_SCHEDULER_H_ */
@@ -0,0 +1,129 @@
+/**
+ * @file error_limiter.h
+ * @brief Coalescing of repeated identical errors.
+ *
+ * @details
+ * When a site goes dark, every poll of every device fails the same way
+ * again. A `ModbusErrorLimiter` lets the first occurrence of an error
+ * through and holds back identical ones for a hold-off period; the next
+ * occurrence after it carries the number of errors held back in between.
+ * The limiter keeps a small fixed table and never allocates, so deciding
+ * costs next to nothing even in an outage storm.
+ */
+
+#ifndef ERROR_LIMITER_H_
+#define ERROR_LIMITER_H_
+
+#include "modbus_error.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+
+/**
+ * @class ModbusErrorLimiter
+ * @brief Hold-off filter for identical errors.
+ *
+ * Errors are identical if their code, slave, register range, and a
+ * caller-supplied tag match. Only `TRANSIENT` errors are held back; fatal
+ * and shutdown errors always get through, so that recovery hooks reacting
+ * to them are not delayed. The table remembers the `SLOTS` most recently
+ * delivered kinds of error; beyond that the kind least recently delivered
+ * is forgotten. A default-constructed limiter lets everything through.
+ * Thread-safe.
+ */
+class ModbusErrorLimiter {
+public:
+  using Clock = std::chrono::steady_clock;
+
+  /** @brief Number of distinct errors tracked at once. */
+  static constexpr size_t SLOTS = 16;
+
+  /** @brief Construct a limiter that lets everything through. */
+  ModbusErrorLimiter() = default;
+
+  // Non-copyable, non-movable (mutex and atomics).
+  ModbusErrorLimiter(const ModbusErrorLimiter &) = delete;
+  ModbusErrorLimiter &operator=(const ModbusErrorLimiter &) = delete;
+
+  /**
+   * @brief Set the hold-off period; 0 lets everything through.
+   *
+   * Must be called before the limiter is shared between threads.
+   */
+  void init(std::chrono::milliseconds holdoff) { holdoff_ = holdoff; }
+
+  /** @brief True if errors are held back at all. */
+  bool enabled() const { return holdoff_.count() > 0; }
+
+  /**
+   * @brief Decide whether an error is delivered.
+   *
+   * @param ev   The error; on delivery `ev.repeats` is set to the number
+   *             of identical errors held back since the last delivery.
+   * @param tag  Further distinguishes errors, e.g. the operation failing.
+   * @param now  Current time.
+   * @return True if the error should be delivered.
+   */
+  bool admit(ModbusErrorEvent &ev, uint64_t tag = 0,
+             Clock::time_point now = Clock::now()) {
+    if (!enabled() || ev.severity != ModbusError::Severity::TRANSIENT)
+      return true;
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    Entry *oldest = &entries_[0];
+    for (Entry &e : entries_) {
+      if (e.used && e.code == ev.code && e.slaveId == ev.slaveId &&
+          e.startAddr == ev.startAddr && e.count == ev.count && e.tag == tag) {
+        if (now < e.until) {
+          ++e.repeats;
+          suppressed_.fetch_add(1, std::memory_order_relaxed);
+          return false;
+        }
+        ev.repeats = e.repeats;
+        e.repeats = 0;
+        e.until = now + holdoff_;
+        return true;
+      }
+      if (!e.used || (oldest->used && e.until < oldest->until))
+        oldest = &e;
+    }
+
+    *oldest = Entry{true,        ev.code, ev.slaveId, ev.startAddr,
+                    ev.count,    tag,     0,          now + holdoff_};
+    ev.repeats = 0;
+    return true;
+  }
+
+  /** @brief Errors held back since construction. */
+  uint64_t suppressed() const {
+    return suppressed_.load(std::memory_order_relaxed);
+  }
+
+private:
+  /** @brief One kind of error and its hold-off. */
+  struct Entry {
+    bool used{false};
+    int code{0};
+    int slaveId{0};
+    int startAddr{0};
+    int count{0};
+    uint64_t tag{0};
+
+    /** @brief Occurrences held back since the last delivery. */
+    uint32_t repeats{0};
+
+    /** @brief End of the hold-off. */
+    Clock::time_point until{};
+  };
+
+  std::chrono::milliseconds holdoff_{0};
+  std::mutex mtx_;
+  std::array<Entry, SLOTS> entries_{};
+  std::atomic<uint64_t> suppressed_{0};
+};
+
+#endif /* ERROR_LIMITER_H_ */
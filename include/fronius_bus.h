@@ -12,9 +12,27 @@
  * `FroniusBus`; devices on different ports or on TCP each get their own.
  *
  * Reads are submitted via `submit()`, which always returns immediately
- * with a `std::future`. The bus thread executes one transaction at a time
- * — `modbus_set_slave()` followed by `modbus_read_registers()` — and
- * fulfils the promise on completion or timeout.
+ * with a `Completion` handle. The bus thread executes one transaction at a
+ * time — `modbus_set_slave()` followed by `modbus_read_registers()` — and
+ * completes the handle on success or timeout. The queue is served by
+ * priority class, then earliest deadline; reads past their deadline are
+ * dropped. Queued reads of the same slave with neighbouring ranges are
+ * coalesced into a single request.
+ * Transactions live in a fixed pool of slots allocated once at
+ * construction, so a poll cycle performs no heap allocation.
+ *
+ * Register writes go through the same queue, usually at
+ * `Priority::CONTROL`, so a control command overtakes queued telemetry
+ * instead of competing with it for the socket or serial line. Writes are
+ * never coalesced, and queued reads of the same slave are not merged
+ * ahead of them.
+ *
+ * TCP buses may instead be driven by a shared `BusEventLoop`, which
+ * multiplexes many of them over non-blocking sockets on one thread; the
+ * queue and the device API behave the same either way.
+ *
+ * The reads of a bus can be recorded to a file and a bus can serve its
+ * reads from such a recording instead of a device, see `bus_recording.h`.
  *
  * Devices register themselves via `registerDevice()` during construction.
  * `FroniusBus` holds only `weak_ptr`s; on connect/disconnect it walks the
@@ -27,24 +45,36 @@
 #ifndef FRONIUS_BUS_H_
 #define FRONIUS_BUS_H_
 
+#include "bus_metrics.h"
+#include "bus_recording.h"
+#include "bus_trace.h"
+#include "error_limiter.h"
 #include "fronius_device.h"
 #include "fronius_types.h"
 #include "modbus_config.h"
 #include "modbus_error.h"
+#include "slave_health.h"
+#include <array>
 #include <atomic>
+#include <bitset>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <functional>
-#include <future>
 #include <memory>
 #include <modbus/modbus.h>
 #include <mutex>
-#include <queue>
-#include <set>
+#include <optional>
+#include <span>
 #include <string>
 #include <thread>
 #include <vector>
 
+class BusEventLoop;
+class DeviceScheduler;
+
 /**
  * @class FroniusBus
  * @brief Owns and manages one shared Modbus bus (RTU or TCP).
@@ -54,39 +84,74 @@
  * be heap-allocated via `std::shared_ptr`. Non-copyable, non-movable.
  */
 class FroniusBus {
+private:
+  struct Slot;
+
 public:
   // -------------------------------------------------------------------------
-  // Transaction — one Modbus register read submitted to the queue
+  // Transaction — one Modbus register access submitted to the queue
   // -------------------------------------------------------------------------
 
   /**
    * @struct Transaction
-   * @brief A single Modbus register-read request submitted to the bus queue.
-   *
-   * Created by device fetch methods and queued via `FroniusBus::submit()`.
-   * The bus thread fulfils `promise` after the read completes or times out.
+   * @brief A single Modbus register read or write submitted to the bus queue.
    *
-   * @note `promise` is move-only; `Transaction` is therefore move-only too.
+   * Created by device fetch and control methods and queued via
+   * `FroniusBus::submit()`, which copies it into a preallocated pool slot.
+   * The outcome is reported through the `Completion` returned by
+   * `submit()`.
    */
   struct Transaction {
+    /** @brief Register access performed by a transaction. */
+    enum class Op : uint8_t {
+      READ,   ///< Read holding registers into `dest`
+      WRITE,  ///< Write `count` words from `src`
+      MODIFY, ///< Read into `dest`, overlay `src` by `mask`, write back
+    };
+
     /** @brief Modbus slave ID to address for this transaction. */
     int slaveId{0};
 
-    /** @brief Starting Modbus register address to read from. */
+    /** @brief Starting Modbus register address to access. */
     int startAddr{0};
 
-    /** @brief Number of consecutive 16-bit registers to read. */
+    /**
+     * @brief Number of consecutive 16-bit registers to access.
+     *
+     * At most `MODBUS_MAX_WRITE_REGISTERS` for a write, and at most
+     * `MAX_MODIFY_REGISTERS` for a read-modify-write.
+     */
     int count{0};
 
     /**
      * @brief Destination buffer; the bus thread writes `count` words
-     *        starting at `dest[startAddr]`.
+     *        starting at `dest[0]`.
      *
-     * Must remain valid until the future is fulfilled. Typically points
-     * into the device's own `regs_` buffer.
+     * Must remain valid until the completion is ready. Typically points
+     * at `startAddr` inside the register update of a device. For `MODIFY`
+     * it receives the registers as written. A null destination is rejected
+     * by `submit()`, except for `WRITE`, which does not use it.
      */
     uint16_t *dest{nullptr};
 
+    /** @brief Register access to perform; reads unless set otherwise. */
+    Op op{Op::READ};
+
+    /**
+     * @brief Source of the `count` words to write, for `WRITE` and `MODIFY`.
+     *
+     * Must remain valid until the completion is ready.
+     */
+    const uint16_t *src{nullptr};
+
+    /**
+     * @brief Registers a `MODIFY` takes from `src`; bit `i` selects
+     *        register `startAddr + i`.
+     *
+     * The other registers are written back with the values just read.
+     */
+    uint64_t mask{0};
+
     /**
      * @brief Per-transaction response timeout (whole seconds component).
      *
@@ -99,13 +164,102 @@ public:
     /** @brief Per-transaction response timeout (microseconds, 0–999999). */
     int usecTimeout{200000};
 
+    /** @brief Scheduling class; the most urgent queued class runs first. */
+    FroniusTypes::Priority priority{FroniusTypes::Priority::NORMAL};
+
+    /**
+     * @brief Latest time at which the transaction may still be sent.
+     *
+     * Within a priority class the earliest deadline runs first. If the
+     * deadline passes while the transaction is queued it is completed
+     * with `ETIMEDOUT` without reaching the wire. `time_point::max()`
+     * means no deadline.
+     */
+    std::chrono::steady_clock::time_point deadline{
+        std::chrono::steady_clock::time_point::max()};
+
     /**
-     * @brief Fulfilled by the bus thread with the outcome of the read.
+     * @brief Validation probe; sent even while the slave is parked.
+     *
+     * See `ModbusDeviceConfig::breakerThreshold`.
+     */
+    bool probe{false};
+  };
+
+  /** @brief Largest register range of a `Transaction::Op::MODIFY`. */
+  static constexpr int MAX_MODIFY_REGISTERS = 64;
+
+  /**
+   * @brief Callback receiving the outcome of an asynchronous submission.
+   */
+  using CompletionCallback =
+      std::function<void(const std::expected<void, ModbusError> &)>;
+
+  // -------------------------------------------------------------------------
+  // Completion — handle to the outcome of a submitted transaction
+  // -------------------------------------------------------------------------
+
+  /**
+   * @class Completion
+   * @brief Move-only handle to the outcome of a submitted transaction.
+   *
+   * Refers to the pool slot holding the transaction. Waiting blocks on the
+   * slot's atomic state word, so no shared state is allocated and no
+   * mutex or condition variable is involved. `get()` hands the slot back
+   * to the pool; destroying an unconsumed handle returns the slot as soon
+   * as the bus thread has finished with it.
+   *
+   * @note The bus must outlive every `Completion` it returned.
+   */
+  class Completion {
+  public:
+    /** @brief Construct an empty handle (`valid()` returns false). */
+    Completion() = default;
+
+    /** @brief Release the slot, or hand it back once the bus completes it. */
+    ~Completion();
+
+    Completion(Completion &&other) noexcept;
+    Completion &operator=(Completion &&other) noexcept;
+    Completion(const Completion &) = delete;
+    Completion &operator=(const Completion &) = delete;
+
+    /** @brief Returns true until the result has been retrieved. */
+    bool valid() const { return slot_ != nullptr || immediate_.has_value(); }
+
+    /** @brief Returns true if the result is available without blocking. */
+    bool ready() const;
+
+    /** @brief Block until the transaction has executed or been cancelled. */
+    void wait() const;
+
+    /**
+     * @brief Block until the transaction completes and return its outcome.
      *
      * On success: empty value. On failure: `ModbusError` describing the
-     * error (transport, timeout, or bus shutdown).
+     * error (transport, timeout, or bus shutdown). May be called once;
+     * afterwards the handle is no longer `valid()`.
      */
-    std::promise<std::expected<void, ModbusError>> promise;
+    std::expected<void, ModbusError> get();
+
+  private:
+    friend class FroniusBus;
+
+    /** @brief Handle bound to a queued pool slot. */
+    explicit Completion(Slot *slot) : slot_(slot) {}
+
+    /** @brief Handle that is already complete (rejected submission). */
+    explicit Completion(std::expected<void, ModbusError> res)
+        : immediate_(std::move(res)) {}
+
+    /** @brief Release the slot (if any) according to its state. */
+    void release();
+
+    /** @brief Pool slot of the transaction, or null for immediate handles. */
+    Slot *slot_{nullptr};
+
+    /** @brief Outcome of a submission rejected before it was queued. */
+    std::optional<std::expected<void, ModbusError>> immediate_;
   };
 
   // -------------------------------------------------------------------------
@@ -115,13 +269,29 @@ public:
   /**
    * @brief Construct a FroniusBus with the given bus-level configuration.
    *
-   * Validates the configuration immediately.
+   * Validates the configuration immediately, and opens the recording of
+   * `cfg.recordPath` or the replay transport, if configured.
    *
    * @param cfg  Bus-level configuration (transport, reconnect policy, debug).
    * @throws std::invalid_argument if `cfg.validate()` fails.
+   * @throws std::system_error if the recording cannot be opened.
    */
   explicit FroniusBus(const ModbusBusConfig &cfg);
 
+  /**
+   * @brief Construct a TCP bus driven by a shared event loop.
+   *
+   * No bus thread is started; `loop` performs the connection handling and
+   * the register reads for this bus on its own thread. The bus keeps the
+   * loop alive. `cfg.debug` has no effect, as libmodbus is not involved.
+   *
+   * @param cfg   Bus-level configuration with a TCP transport.
+   * @param loop  Event loop to attach to on `connect()`.
+   * @throws std::invalid_argument if `cfg.validate()` fails, the transport
+   *         is not TCP, or `loop` is null.
+   */
+  FroniusBus(const ModbusBusConfig &cfg, std::shared_ptr<BusEventLoop> loop);
+
   /**
    * @brief Stop the bus thread, cancel pending transactions, close the
    *        Modbus context.
@@ -141,9 +311,12 @@ public:
   /**
    * @brief Start the asynchronous connection loop in a background thread.
    *
-   * Returns immediately after launching the thread. The bus attempts to
-   * connect, notifies registered devices on success, and falls back to
-   * the configured backoff on failure.
+   * Returns immediately after launching the thread, or after attaching the
+   * bus to its event loop. A TCP bus with `pipelineDepth` or
+   * `connections` above 1 and no shared loop attaches to a private
+   * `BusEventLoop` instead of starting a bus thread. The bus attempts to
+   * connect, notifies registered devices on success, and falls back to the
+   * configured backoff on failure.
    *
    * Calling `connect()` more than once is a no-op (guarded internally).
    * Call after constructing all devices and registering all callbacks.
@@ -171,10 +344,11 @@ public:
   /**
    * @brief Schedule a per-device reconnect without touching the shared bus.
    *
-   * Spawns a background thread that retries `device->onBusConnected()`
-   * with exponential backoff (governed by the device's own
-   * `ModbusDeviceConfig::reconnectDelay` parameters) until the device
-   * becomes ready or the physical bus drops.
+   * Queues the device on the bus's device scheduler, which retries
+   * `device->onBusConnected()` with exponential backoff (governed by the
+   * device's own `ModbusDeviceConfig::reconnectDelay` parameters) until
+   * the device becomes ready or the physical bus drops. No thread is
+   * created per retry.
    *
    * Unlike `triggerReconnect()`, this does *not* close the serial port or
    * disturb other devices on the bus. No-op if a retry is already in
@@ -184,6 +358,36 @@ public:
    */
   void scheduleDeviceRetry(std::shared_ptr<FroniusDevice> device);
 
+  /**
+   * @brief True while the breaker of `slaveId` holds its reads back.
+   *
+   * See `ModbusDeviceConfig::breakerThreshold`.
+   */
+  bool isParked(int slaveId) const {
+    const SlaveHealth *h = health(slaveId);
+    return h && h->parked();
+  }
+
+  /**
+   * @brief Response timeout currently applied to reads of `slaveId`.
+   *
+   * The derived timeout with `ModbusDeviceConfig::adaptiveTimeout`,
+   * otherwise `configured`.
+   *
+   * @param slaveId     Slave of the device.
+   * @param configured  Timeout configured for the device.
+   */
+  std::chrono::microseconds
+  responseTimeout(int slaveId, std::chrono::microseconds configured) const {
+    const SlaveHealth *h = health(slaveId);
+    return h ? h->timeout(configured) : configured;
+  }
+
+  /**
+   * @brief Returns the bus configuration passed at construction.
+   */
+  const ModbusBusConfig &getConfig() const { return cfg_; }
+
   /**
    * @brief Returns the remote TCP endpoint of the active connection.
    *
@@ -202,7 +406,9 @@ public:
    *
    * Called by `FroniusDevice`-derived constructors via `weak_from_this()`.
    * `FroniusBus` holds only a `weak_ptr` — expired entries are pruned the
-   * next time the bus walks the registry.
+   * next time the bus walks the registry. A live device with an adaptive
+   * timeout or a breaker also gets its slave tracked; the first device
+   * registered for a slave sets the policy.
    *
    * @param device  Weak pointer to the device to register.
    */
@@ -213,21 +419,135 @@ public:
   // -------------------------------------------------------------------------
 
   /**
-   * @brief Submit a register-read transaction to the bus queue.
+   * @brief Submit a register read or write transaction to the bus queue.
    *
-   * Non-blocking. The transaction is queued and a future is returned
-   * immediately. The bus thread executes queued transactions in submission
-   * order. Call `.get()` on the future when the result is needed.
+   * Non-blocking. The transaction is copied into a free pool slot and a
+   * `Completion` is returned immediately. The bus thread executes queued
+   * transactions by priority, then deadline, then submission order. Call
+   * `.get()` on the completion when the result is needed.
    *
    * If the bus is disconnected at submission time the transaction is still
-   * queued and will run when the bus reconnects. If the bus is shutting
-   * down the promise is fulfilled immediately with a shutdown error.
+   * queued and will run when the bus reconnects. If all
+   * `ModbusBusConfig::queueCapacity` slots are in use, waits up to
+   * `ModbusBusConfig::poolWaitMs` for one to be freed; called from a bus
+   * thread, it does not wait. If the bus is shutting down, no slot became
+   * free (`ENOBUFS`), or the transaction lacks the buffers or exceeds the
+   * range its `op` requires, the completion is returned already failed.
+   *
+   * @param t  The transaction to submit.
+   * @return   A completion that becomes ready when the transaction has
+   *           executed (or been cancelled).
+   */
+  Completion submit(const Transaction &t);
+
+  /**
+   * @brief Submit a transaction and get notified on completion.
+   *
+   * Counterpart of `submit(const Transaction &)` that does not wait for
+   * the result. `cb` runs on the bus thread once the transaction has
+   * executed or been cancelled; it may call `submit()` again but must not
+   * block. Waits for a free pool slot like `submit(const Transaction &)`.
+   * If the submission is rejected (shutdown, full pool, no destination)
+   * `cb` runs immediately on the calling thread.
+   *
+   * @param t   The transaction to submit.
+   * @param cb  Callback receiving the outcome.
+   */
+  void submit(const Transaction &t, CompletionCallback cb);
+
+  /**
+   * @brief Submit a transaction unless the pool is full.
+   *
+   * Like `submit(const Transaction &)`, but fails with `ENOBUFS` at once
+   * instead of waiting when all pool slots are in use.
+   */
+  Completion trySubmit(const Transaction &t);
+
+  /**
+   * @brief Submit a transaction with a callback unless the pool is full.
    *
-   * @param t  The transaction to submit. Moved into the queue.
-   * @return   A future that becomes ready when the transaction has executed
-   *           (or been cancelled).
+   * Like `submit(const Transaction &, CompletionCallback)`, but `cb`
+   * receives `ENOBUFS` at once instead of waiting when all pool slots are
+   * in use.
    */
-  std::future<std::expected<void, ModbusError>> submit(Transaction t);
+  void trySubmit(const Transaction &t, CompletionCallback cb);
+
+  // -------------------------------------------------------------------------
+  // Bus sweep
+  // -------------------------------------------------------------------------
+
+  /**
+   * @struct Sweep
+   * @brief Outcome of `fetchAll()`: one sample of every device, taken together.
+   */
+  struct Sweep {
+    /** @brief One device's part of the sweep. */
+    struct Sample {
+      /** @brief The device read. */
+      std::shared_ptr<FroniusDevice> device;
+
+      /** @brief Outcome of its fetch. */
+      std::expected<void, ModbusError> result;
+
+      /**
+       * @brief Registers published by its fetch; empty if the fetch failed.
+       *
+       * Declared after `device`, so it is released before the device.
+       */
+      FroniusDevice::Snapshot snapshot;
+    };
+
+    /** @brief Wall-clock time the sweep was submitted. */
+    std::chrono::system_clock::time_point timestamp;
+
+    /** @brief Time from submission until the last device completed. */
+    std::chrono::steady_clock::duration duration{};
+
+    /** @brief One sample per device, in the order their reads were queued. */
+    std::vector<Sample> samples;
+
+    /** @brief True if every device's fetch succeeded. */
+    bool ok() const;
+
+    /** @brief Spread of the publication times of the successful samples. */
+    std::chrono::system_clock::duration skew() const;
+  };
+
+  /**
+   * @brief Refresh every ready device on the bus in one sweep.
+   *
+   * Queues the fetches of all registered, ready devices in one go, ordered
+   * by slave ID, and holds the queue back until the last of them is in.
+   * The bus thread therefore sees the whole sweep at once: reads of one
+   * slave are coalesced across blocks and, on an RTU bus with
+   * `groupBySlave`, served back to back, and the samples of all devices
+   * are published within one pass over the bus instead of N independent
+   * fetches interleaved with other traffic. Each device reads
+   * `blocks & defaultBlocks()`; devices with none of `blocks` are left out.
+   *
+   * Blocks until every fetch has completed. A device whose fetch is
+   * already running fails with `EINPROGRESS`, one whose reads no longer
+   * fit the pool with `ENOBUFS`; the other devices are unaffected.
+   *
+   * @param blocks  Blocks to read, limited to each device's defaults.
+   * @return The samples of the devices swept, empty if none was ready.
+   * @note Must not be called from the bus thread or a fetch callback.
+   *       Release the snapshots promptly, see `FroniusDevice::Snapshot`.
+   */
+  Sweep fetchAll(FroniusTypes::Block blocks = FroniusTypes::Block::ALL);
+
+  // -------------------------------------------------------------------------
+  // Instrumentation
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Snapshot of the bus latency and throughput counters.
+   *
+   * Counters are recorded lock-free and without allocation on every
+   * transaction. Safe to call from any thread, e.g. from a Prometheus
+   * scrape handler.
+   */
+  BusMetrics::Snapshot getMetrics() const { return metrics_.snapshot(); }
 
   // -------------------------------------------------------------------------
   // Bus-level callback setters
@@ -275,6 +595,29 @@ public:
     onBusError_.push_back(std::move(cb));
   }
 
+  /**
+   * @brief Register a callback invoked on failed reads, in compact form.
+   *
+   * Fired for the same read errors as `addBusErrorCallback()`, right
+   * before it, with a `ModbusErrorEvent` that formats its message only on
+   * demand. Subject to the hold-off of `ModbusBusConfig::errorHoldoffMs`,
+   * like the other error callbacks.
+   *
+   * @param cb  Callback receiving the compact error.
+   */
+  void
+  addBusErrorEventCallback(std::function<void(const ModbusErrorEvent &)> cb) {
+    onBusErrorEvent_.push_back(std::move(cb));
+  }
+
+  /**
+   * @brief Read errors held back by `ModbusBusConfig::errorHoldoffMs`.
+   *
+   * Counted since the bus was created; `getMetrics()` still counts them as
+   * errors.
+   */
+  uint64_t suppressedErrors() const { return errorLimiter_.suppressed(); }
+
   /**
    * @brief Register a single callback for internal bus diagnostic messages.
    *
@@ -294,7 +637,50 @@ public:
     onBusLog_.push_back(std::move(cb));
   }
 
+  /**
+   * @brief Restrict which diagnostic messages reach the log callback.
+   *
+   * Messages below `minLevel` or outside `categories` are discarded before
+   * they are formatted, so a filtered message costs a single comparison.
+   * Defaults to every message. Safe to call from any thread.
+   *
+   * @param minLevel    Lowest level passed on; `LogLevel::OFF` mutes all.
+   * @param categories  Categories passed on, combined with `|`.
+   */
+  void setLogFilter(
+      FroniusTypes::LogLevel minLevel,
+      FroniusTypes::LogCategory categories = FroniusTypes::LogCategory::ALL) {
+    logLevel_.store(minLevel, std::memory_order_relaxed);
+    logCategories_.store(static_cast<uint32_t>(categories),
+                         std::memory_order_relaxed);
+  }
+
+  // -------------------------------------------------------------------------
+  // Binary trace
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Move the oldest recorded trace events into `out`.
+   *
+   * Requires `ModbusBusConfig::traceCapacity` > 0. Call periodically from
+   * one application thread and format the events there, off the bus
+   * thread. Events recorded while the ring was full are lost and counted
+   * by `traceDropped()`.
+   *
+   * @param out  Destination buffer.
+   * @return Number of events written to the front of `out`.
+   */
+  size_t drainTrace(std::span<BusTraceEvent> out) {
+    std::lock_guard<std::mutex> lock(traceMtx_);
+    return trace_.pop(out.data(), out.size());
+  }
+
+  /** @brief Trace events discarded because the ring was full. */
+  uint64_t traceDropped() const { return trace_.dropped(); }
+
 private:
+  friend class BusEventLoop;
+
   // -------------------------------------------------------------------------
   // Configuration and libmodbus context
   // -------------------------------------------------------------------------
@@ -313,6 +699,17 @@ private:
   /** @brief Remote TCP endpoint, captured after a successful TCP connect. */
   FroniusTypes::RemoteEndpoint remoteEndpoint_;
 
+  /** @brief Latency and throughput counters, see `getMetrics()`. */
+  BusMetrics metrics_;
+
+  /**
+   * @brief Event loop driving this bus, or null for a bus thread.
+   *
+   * In loop mode `ctx_` and `busThread_` stay unused and every member
+   * documented as bus thread only belongs to the loop thread instead.
+   */
+  std::shared_ptr<BusEventLoop> loop_;
+
   // -------------------------------------------------------------------------
   // Connection thread state
   // -------------------------------------------------------------------------
@@ -332,6 +729,53 @@ private:
   /** @brief True when the physical transport is connected. */
   std::atomic<bool> connected_{false};
 
+  // -------------------------------------------------------------------------
+  // Transaction pool
+  // -------------------------------------------------------------------------
+
+  /**
+   * @struct Slot
+   * @brief Preallocated storage for one in-flight transaction.
+   *
+   * `state` moves `FREE -> PENDING` in `submit()`, `PENDING -> DONE` when
+   * the bus thread completes the transaction, and back to `FREE` when the
+   * owning `Completion` retrieves the result. A `Completion` destroyed
+   * while its slot is pending marks it `ABANDONED` instead; the bus thread
+   * then frees the slot on completion. Slots submitted with a callback have
+   * no `Completion`: they go straight back to `FREE` when the callback is
+   * invoked.
+   */
+  struct Slot {
+    enum State : uint8_t { FREE, PENDING, DONE, ABANDONED };
+
+    /** @brief The submitted request. */
+    Transaction tx;
+
+    /** @brief Outcome, written by the bus thread before `state` is DONE. */
+    std::expected<void, ModbusError> result;
+
+    /**
+     * @brief Wire failure, set instead of `result` by `fail()`; formatted
+     *        only when the `Completion` retrieves it.
+     */
+    std::optional<ModbusErrorEvent> failure;
+
+    /** @brief Time the transaction was queued, for queue-wait metrics. */
+    std::chrono::steady_clock::time_point queuedAt;
+
+    /** @brief Completion callback of an asynchronous submission, if any. */
+    CompletionCallback callback;
+
+    /** @brief Slot lifecycle state; waited on by `Completion`. */
+    std::atomic<uint8_t> state{FREE};
+  };
+
+  /** @brief Slot pool sized to `cfg_.queueCapacity`, allocated once. */
+  std::unique_ptr<Slot[]> slots_;
+
+  /** @brief Index at which the next free-slot search starts. */
+  std::atomic<size_t> slotHint_{0};
+
   // -------------------------------------------------------------------------
   // Device registry
   // -------------------------------------------------------------------------
@@ -343,25 +787,77 @@ private:
    */
   std::vector<std::weak_ptr<FroniusDevice>> devices_;
 
+  // -------------------------------------------------------------------------
+  // Device scheduler
+  // -------------------------------------------------------------------------
+
   /**
-   * @brief Set of devices currently undergoing a per-device retry loop.
+   * @brief Runs all device probes and their backoff.
    *
-   * Protected by `mtx_`. Prevents concurrent `onBusConnected()` calls for
-   * the same device when multiple error callbacks fire in quick succession.
+   * Device probes block on `Completion::get()`, so they cannot run on the
+   * bus thread. Created by `connect()` with one thread, or shared with the
+   * other buses of the event loop.
    */
-  std::set<FroniusDevice *> retriesInProgress_;
+  std::shared_ptr<DeviceScheduler> scheduler_;
 
   // -------------------------------------------------------------------------
   // Transaction queue
   // -------------------------------------------------------------------------
 
   /**
-   * @brief Queue of pending read transactions.
+   * @brief Queue of pending read transactions, in submission order.
+   *
+   * Holds pointers into `slots_`. Capacity is reserved for the whole pool
+   * at construction, so pushing never reallocates. Protected by `mtx_`.
+   * The bus thread is the sole consumer; any thread may produce via
+   * `submit()`.
+   */
+  std::vector<Slot *> txQueue_;
+
+  /**
+   * @brief Transactions taken off the queue because their deadline passed.
    *
-   * Protected by `mtx_`. The bus thread is the sole consumer; any thread
-   * may produce via `submit()`.
+   * Bus thread only; capacity reserved for the whole pool at construction.
    */
-  std::queue<Transaction> txQueue_;
+  std::vector<Slot *> expired_;
+
+  /**
+   * @brief Transactions taken off the queue because their slave is parked.
+   *
+   * Bus thread only; capacity reserved for the whole pool at construction.
+   */
+  std::vector<Slot *> held_;
+
+  /**
+   * @brief Number of `fetchAll()` calls currently queueing their reads.
+   *
+   * While non-zero and nobody waits in `awaitSlot()`, nothing is dequeued.
+   * Protected by `mtx_`.
+   */
+  int sweepHold_{0};
+
+  /** @brief Submitters waiting in `awaitSlot()` for a free slot. */
+  std::atomic<int> poolWaiters_{0};
+
+  /**
+   * @brief True on threads that complete transactions: bus threads and
+   *        event loop threads.
+   *
+   * Submissions from them must not wait for a slot: no transaction can
+   * complete and free one meanwhile.
+   */
+  static thread_local bool onBusThread_;
+
+  /**
+   * @brief Health of each slave with an adaptive timeout or a breaker.
+   *
+   * Indexed by slave ID; null for untracked slaves. Entries are set once
+   * under `mtx_` and never change, so readers need no lock.
+   */
+  std::array<std::atomic<SlaveHealth *>, 248> health_{};
+
+  /** @brief Owns the entries of `health_`. Protected by `mtx_`. */
+  std::vector<std::unique_ptr<SlaveHealth>> healthStore_;
 
   /**
    * @brief Slave ID of the most recently executed transaction.
@@ -371,6 +867,75 @@ private:
    */
   int lastSlaveId_{0};
 
+  /**
+   * @brief Consecutive dequeues that overtook the oldest queued read.
+   *
+   * Bounded by `MAX_SLAVE_BYPASS` when `cfg_.groupBySlave` is set.
+   */
+  int slaveBypass_{0};
+
+  /** @brief Times the oldest queued read may be overtaken in a row. */
+  static constexpr int MAX_SLAVE_BYPASS = 8;
+
+  /**
+   * @brief Consecutive dequeues of a more urgent class that overtook an
+   *        older read of a less urgent one.
+   */
+  int priorityBypass_{0};
+
+  /** @brief Reads that may overtake an older, less urgent one in a row. */
+  static constexpr int MAX_PRIORITY_BYPASS = 8;
+
+  // -------------------------------------------------------------------------
+  // RTU slave switching — bus thread only
+  // -------------------------------------------------------------------------
+
+  /** @brief Learned settle delay for switching from one slave to another. */
+  struct SwitchGuard {
+    int from;
+    int to;
+    std::chrono::microseconds delay;
+  };
+
+  /** @brief Slave pairs reserved for up front in `switchGuards_`. */
+  static constexpr size_t MAX_SWITCH_GUARDS = 16;
+
+  /** @brief Per-pair delays learned in adaptive mode. */
+  std::vector<SwitchGuard> switchGuards_;
+
+  /** @brief Modbus 3.5-character time; floor of the adaptive delay. */
+  std::chrono::microseconds interFrameDelay_{0};
+
+  // -------------------------------------------------------------------------
+  // Read coalescing — bus thread only
+  // -------------------------------------------------------------------------
+
+  /** @brief Upper bound on transactions merged into one register read. */
+  static constexpr size_t MAX_COALESCED = 16;
+
+  /** @brief Set of slave IDs, indexed by ID. */
+  using SlaveSet = std::bitset<256>;
+
+  /** @brief Register range of one read request. */
+  struct Span {
+    int slaveId;
+    int startAddr;
+    int count;
+  };
+
+  /** @brief Upper bound on remembered rejected spans. */
+  static constexpr size_t MAX_REJECTED_SPANS = 32;
+
+  /**
+   * @brief Merged ranges a slave answered with an address exception.
+   *
+   * Reads forming one of these spans again are executed individually.
+   */
+  std::vector<Span> rejectedSpans_;
+
+  /** @brief Receive buffer for coalesced reads. */
+  std::array<uint16_t, MODBUS_MAX_READ_REGISTERS> coalesceBuf_{};
+
   // -------------------------------------------------------------------------
   // Bus-level callbacks
   // -------------------------------------------------------------------------
@@ -385,9 +950,46 @@ private:
   /** @brief Fired on bus-level Modbus errors. */
   std::vector<std::function<void(const ModbusError &)>> onBusError_;
 
+  /** @brief Fired on failed reads with the compact error. */
+  std::vector<std::function<void(const ModbusErrorEvent &)>> onBusErrorEvent_;
+
+  /** @brief Holds back repeated read errors, see `cfg_.errorHoldoffMs`. */
+  ModbusErrorLimiter errorLimiter_;
+
   /** @brief Fired on bus log messages */
   std::vector<std::function<void(const std::string &)>> onBusLog_;
 
+  /** @brief Lowest log level passed to `onBusLog_`. */
+  std::atomic<FroniusTypes::LogLevel> logLevel_{FroniusTypes::LogLevel::DEBUG};
+
+  /** @brief Mask of `LogCategory` bits passed to `onBusLog_`. */
+  std::atomic<uint32_t> logCategories_{
+      static_cast<uint32_t>(FroniusTypes::LogCategory::ALL)};
+
+  // -------------------------------------------------------------------------
+  // Binary trace
+  // -------------------------------------------------------------------------
+
+  /** @brief Trace ring sized by `cfg_.traceCapacity`; bus thread produces. */
+  BusTraceRing trace_;
+
+  /** @brief Serialises `drainTrace()` callers, the ring's consumer side. */
+  std::mutex traceMtx_;
+
+  // -------------------------------------------------------------------------
+  // Recording and replay
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Recording of `cfg_.recordPath`, or null.
+   *
+   * Written by whichever thread issues the reads; reset when a write fails.
+   */
+  std::unique_ptr<BusRecorder> recorder_;
+
+  /** @brief Recording served instead of a device on a replay bus, or null. */
+  std::unique_ptr<BusReplay> replay_;
+
   // -------------------------------------------------------------------------
   // Private methods — run exclusively on the bus thread
   // -------------------------------------------------------------------------
@@ -430,32 +1032,400 @@ private:
   /**
    * @brief Drain the transaction queue while the bus stays connected.
    *
-   * Pops one transaction at a time, executes it, and fulfils its promise
-   * before moving on. Returns when the bus disconnects or `running_` is
-   * cleared.
+   * Pops the next transaction together with any queued reads it can be
+   * coalesced with, executes them, and completes their slots before moving
+   * on. Returns when the bus disconnects or `running_` is cleared.
    */
   void drainQueue();
 
+  /**
+   * @brief Take the next transaction and the reads it merges with.
+   *
+   * Under `mtx_`, removes expired reads and picks the next transaction by
+   * priority, deadline, and slave grouping, plus any reads it can be
+   * coalesced with. Outside the lock, fails the expired reads with
+   * `ETIMEDOUT` and records queue wait times. Shared by `drainQueue()`
+   * and `BusEventLoop`.
+   *
+   * @param group  Receives the transactions to execute.
+   * @param busy   Slaves to skip, e.g. those with reads in flight on
+   *               another pooled connection; null to consider all.
+   * @return Number of transactions in `group`; 0 if the queue held
+   *         nothing eligible.
+   */
+  size_t dequeue(std::array<Slot *, MAX_COALESCED> &group,
+                 const SlaveSet *busy = nullptr);
+
+  /**
+   * @brief Put transactions back at the front of the queue, in order.
+   *
+   * Used when a merged read has to be split up again.
+   */
+  void requeueFront(std::span<Slot *const> slots);
+
+  /**
+   * @brief Move queued reads that can merge with `group[0]` into `group`.
+   *
+   * Picks transactions of the same slave and priority class whose ranges
+   * overlap, touch, or lie within `cfg_.coalesceGap` registers of the
+   * merged range, as long as the merged range stays within
+   * `MODBUS_MAX_READ_REGISTERS`. Must be called with `mtx_` held.
+   *
+   * @param group  Transactions to merge; holds the head transaction.
+   * @return Number of transactions now in `group`.
+   */
+  size_t takeCoalescable(std::array<Slot *, MAX_COALESCED> &group);
+
+  /**
+   * @brief Move queued transactions past their deadline into `expired_`,
+   *        and those of parked slaves into `held_`.
+   *
+   * Must be called with `mtx_` held.
+   */
+  void takeExpired();
+
+  /** @brief Health of `slaveId`, or null if it is not tracked. */
+  SlaveHealth *health(int slaveId) const {
+    if (slaveId < 0 || slaveId >= static_cast<int>(health_.size()))
+      return nullptr;
+    return health_[static_cast<size_t>(slaveId)].load(
+        std::memory_order_acquire);
+  }
+
+  /**
+   * @brief Update the health of the read's slave with its outcome.
+   *
+   * Parks the slave when its breaker opens, marks its devices unavailable,
+   * and schedules their revalidation.
+   */
+  void recordHealth(const Transaction &t, int err,
+                    std::chrono::microseconds elapsed);
+
+  /** @brief Response timeout configured on a transaction. */
+  static std::chrono::microseconds configuredTimeout(const Transaction &t) {
+    return std::chrono::seconds(t.secTimeout) +
+           std::chrono::microseconds(t.usecTimeout);
+  }
+
+  /**
+   * @brief Response timeout to apply to a transaction on the wire.
+   *
+   * Reads use `responseTimeout()`. Writes keep the configured timeout: a
+   * write answered late has usually taken effect, so cutting it short
+   * would only report a command as failed that was applied.
+   */
+  std::chrono::microseconds requestTimeout(const Transaction &t) const {
+    return t.op == Transaction::Op::READ
+               ? responseTimeout(t.slaveId, configuredTimeout(t))
+               : configuredTimeout(t);
+  }
+
+  /**
+   * @brief Overlay the registers a `MODIFY` selects from `t.src` onto the
+   *        values read into `t.dest`.
+   */
+  static void applyModify(const Transaction &t) {
+    for (int i = 0; i < t.count; ++i)
+      if (t.mask & (uint64_t{1} << i))
+        t.dest[i] = t.src[i];
+  }
+
+  /**
+   * @brief Index of the queued transaction to execute next.
+   *
+   * Picks the most urgent priority class present, then the earliest
+   * deadline within it. After `MAX_PRIORITY_BYPASS` reads in a row have
+   * overtaken an older read of a less urgent class, that read's class is
+   * picked instead; `CONTROL` writes are never held back for it. Without
+   * deadlines the oldest transaction of the class runs, unless
+   * `cfg_.groupBySlave` is set and a read of the current slave is queued
+   * behind it. Transactions of slaves in `busy` are skipped, and nothing
+   * is eligible while a sweep is being queued. Must be called with `mtx_`
+   * held.
+   *
+   * @return Index into `txQueue_`, or its size if nothing is eligible.
+   */
+  size_t nextQueueIndex(const SlaveSet *busy);
+
+  /**
+   * @brief Settle delay before switching from slave `from` to slave `to`.
+   *
+   * `cfg_.slaveSwitchDelayMs`, or the learned per-pair delay in adaptive
+   * mode.
+   */
+  std::chrono::microseconds switchDelay(int from, int to);
+
+  /**
+   * @brief Double the learned delay for a slave pair after a timeout.
+   *
+   * Capped at `cfg_.slaveSwitchDelayMs`.
+   */
+  void backOffSwitchDelay(int from, int to);
+
   /**
    * @brief Execute a single transaction on the bus.
    *
-   * Sets the slave ID, applies the per-transaction response timeout,
-   * performs the register read, and fulfils the transaction's promise.
+   * Performs the register read or write and completes the slot.
+   *
+   * @param slot  Pool slot holding the transaction to execute.
+   */
+  void executeTransaction(Slot &slot);
+
+  /**
+   * @brief Execute several transactions with a single register read.
+   *
+   * Reads the merged range into `coalesceBuf_` and copies each
+   * transaction's share to its destination. Falls back to individual
+   * reads if the slave rejects the merged range.
+   *
+   * @param group  Transactions to merge, all for the same slave.
+   * @param n      Number of transactions in `group`.
+   */
+  void executeCoalesced(const std::array<Slot *, MAX_COALESCED> &group,
+                        size_t n);
+
+  /**
+   * @brief Build the read covering every transaction in a group.
+   *
+   * Uses the longest response timeout among them.
+   *
+   * @param group  Transactions to merge, all for the same slave.
+   * @param n      Number of transactions in `group`.
+   * @param dest   Receive buffer of `MODBUS_MAX_READ_REGISTERS` words.
+   */
+  Transaction mergeGroup(const std::array<Slot *, MAX_COALESCED> &group,
+                         size_t n, uint16_t *dest) const;
+
+  /** @brief True if the slave rejected this merged range before. */
+  bool spanRejected(const Transaction &merged) const;
+
+  /** @brief Remember a merged range the slave answered with an exception. */
+  void rejectSpan(const Transaction &merged);
+
+  /**
+   * @brief Hand each transaction its share of a completed merged read.
+   *
+   * @param group   Transactions covered by `merged`.
+   * @param n       Number of transactions in `group`.
+   * @param merged  The merged read; `merged.dest` holds the registers.
+   * @param start   Time the merged read started, for the trace.
+   */
+  void completeMerged(const std::array<Slot *, MAX_COALESCED> &group,
+                      size_t n, const Transaction &merged,
+                      std::chrono::steady_clock::time_point start);
+
+  /**
+   * @brief Address the slave of a transaction on the libmodbus context.
+   *
    * On RTU buses inserts a settle delay if the slave ID changed since the
-   * previous transaction.
+   * previous transaction. Then sets the slave ID and applies `timeout`.
+   *
+   * @param t        The transaction about to be sent.
+   * @param timeout  Response timeout to apply.
+   * @return The slave addressed before if this switched slaves, otherwise
+   *         0; the error if the slave ID could not be set.
+   */
+  std::expected<int, ModbusErrorEvent>
+  selectSlave(const Transaction &t, std::chrono::microseconds timeout);
+
+  /**
+   * @brief Perform one register read on the bus.
+   *
+   * Sets the slave ID, applies the transaction's response timeout, and
+   * reads into `t.dest`. On RTU buses inserts a settle delay if the slave
+   * ID changed since the previous read. A replay bus answers from its
+   * recording instead, see `replayRegisters()`. Errors are returned but not
+   * yet reported; see `reportReadError()`.
+   *
+   * Failures are returned in compact form, so that a storm of them does
+   * not format a message each.
+   *
+   * @param t  Register range, slave, timeout, and destination.
+   * @return Empty expected on success, the failure otherwise.
+   */
+  std::expected<void, ModbusErrorEvent> readRegisters(const Transaction &t);
+
+  /**
+   * @brief Perform one register write, or read-modify-write, on the bus.
+   *
+   * A `MODIFY` reads the range into `t.dest`, applies `applyModify()`, and
+   * writes `t.dest` back right away, with no other transaction in between.
+   * A replay bus answers from its recording instead, see
+   * `replayWrite()`. Errors are returned but not yet reported; see
+   * `reportReadError()`.
+   *
+   * @param t  Register range, slave, timeout, and buffers.
+   * @return Empty expected on success, the failure otherwise.
+   */
+  std::expected<void, ModbusErrorEvent> writeRegisters(const Transaction &t);
+
+  /**
+   * @brief Serve one register read from the replayed recording.
+   *
+   * Waits until the response is due, copies the recorded registers into
+   * `t.dest`, and returns the recorded failure, if any.
+   *
+   * @param t  Register range, slave, and destination.
+   * @return Empty expected on success, the failure otherwise; `EINTR` if
+   *         the bus shuts down while waiting.
+   */
+  std::expected<void, ModbusErrorEvent>
+  replayRegisters(const Transaction &t);
+
+  /**
+   * @brief Serve one register write, or read-modify-write, from the
+   *        replayed recording.
+   *
+   * Waits until the recorded outcome is due and returns it; a `MODIFY`
+   * gets the recorded registers as written in `t.dest`.
+   *
+   * @param t  Register range, slave, and buffers.
+   * @return Empty expected on success, the failure otherwise; `ENOTSUP`
+   *         if no such write was recorded, `EINTR` if the bus shuts down
+   *         while waiting.
+   */
+  std::expected<void, ModbusErrorEvent> replayWrite(const Transaction &t);
+
+  /**
+   * @brief Account for one register read that went over the wire.
+   *
+   * Records the trace event and the metrics, appends the read to the
+   * recording, if any, and logs the response.
+   *
+   * @param t      The read as sent.
+   * @param err    0 on success, otherwise the error code.
+   * @param start  Time the request was sent.
+   * @param end    Time the response (or the failure) arrived.
+   */
+  void recordRead(const Transaction &t, int err,
+                  std::chrono::steady_clock::time_point start,
+                  std::chrono::steady_clock::time_point end);
+
+  /**
+   * @brief Account for one register write that went over the wire.
+   *
+   * Records the trace event and the metrics, appends the registers
+   * written to the recording, if any, and logs the response. Writes do
+   * not feed the slave's health.
+   *
+   * @param t      The write as sent.
+   * @param err    0 on success, otherwise the error code.
+   * @param start  Time the (first) request was sent.
+   * @param end    Time the (last) response, or the failure, arrived.
+   */
+  void recordWrite(const Transaction &t, int err,
+                   std::chrono::steady_clock::time_point start,
+                   std::chrono::steady_clock::time_point end);
+
+  /**
+   * @brief Report a failed read or write to the bus error callbacks.
+   *
+   * Marks the bus disconnected if the error is fatal or signals shutdown.
+   * The callbacks are skipped while an identical error is held back, see
+   * `ModbusBusConfig::errorHoldoffMs`. The message is formatted only for
+   * an admitted error with `onBusError_` callbacks registered.
+   *
+   * @param ev   The failure; slave and range are 0 for a connection-wide
+   *             failure.
+   * @param err  The failure already formatted, if it was; otherwise
+   *             formatted from `ev`.
+   */
+  void reportReadError(ModbusErrorEvent ev, const ModbusError *err = nullptr);
+
+  /**
+   * @brief Validate a transaction, claim a slot for it, and queue it.
+   *
+   * Shared by the `submit()` and `trySubmit()` overloads. `cb` is moved
+   * into the slot only if the transaction is queued; on rejection it is
+   * left untouched.
+   *
+   * @param t     The transaction to queue.
+   * @param cb    Completion callback to attach, or empty for a `Completion`.
+   * @param wait  Wait up to `poolWaitMs` for a slot if the pool is full.
+   * @return The queued slot, or the reason the submission was rejected.
+   */
+  std::expected<Slot *, ModbusError>
+  enqueue(const Transaction &t, CompletionCallback &cb, bool wait);
+
+  /**
+   * @brief Wait for a pool slot to be freed and claim it.
+   *
+   * Polls `acquireSlot()` until `poolWaitMs` have passed or the bus stops.
+   * Lifts the hold of a running `fetchAll()` meanwhile, so the queue keeps
+   * draining.
+   *
+   * @return The claimed slot, or null if none became free.
+   */
+  Slot *awaitSlot();
+
+  /**
+   * @brief Claim a free pool slot for a new transaction.
+   *
+   * Lock-free: scans the pool from `slotHint_` and claims the first `FREE`
+   * slot with a compare-and-swap.
+   *
+   * @return The claimed slot in state `PENDING`, or null if all are in use.
+   */
+  Slot *acquireSlot();
+
+  /**
+   * @brief Publish the outcome of a transaction and wake its waiter.
+   *
+   * Invokes the slot's callback for asynchronous submissions. Frees the
+   * slot directly if its `Completion` has been abandoned. Must not be
+   * called with `mtx_` held.
+   *
+   * @param slot  Pool slot of the finished transaction.
+   * @param res   Outcome to hand to the `Completion`.
+   */
+  static void complete(Slot &slot, std::expected<void, ModbusError> res);
+
+  /**
+   * @brief Fail a transaction with a compact error.
+   *
+   * Like `complete()`, but the message is formatted only when the
+   * callback is invoked or `Completion::get()` retrieves the result.
    *
-   * @param t  The transaction to execute.
+   * @param slot     Pool slot of the failed transaction.
+   * @param failure  The failure.
    */
-  void executeTransaction(Transaction &t);
+  static void fail(Slot &slot, const ModbusErrorEvent &failure);
 
   /**
    * @brief Cancel all queued transactions with a shutdown error.
    *
    * Invoked during destruction or after a disconnect so that callers
-   * blocked on `future.get()` are unblocked promptly.
+   * blocked on `Completion::get()` are unblocked promptly.
    */
   void cancelPendingTransactions();
 
+  /**
+   * @brief Mark the bus connected and run the connect notifications.
+   *
+   * Fires the connect callbacks, resets `reconnectDelay` if backoff is
+   * exponential, and queues every device for validation.
+   */
+  void markConnected(int &reconnectDelay);
+
+  /**
+   * @brief Account for a failed connection attempt.
+   *
+   * Fires the error callbacks with `err` and the disconnect callbacks with
+   * the delay before the next attempt.
+   */
+  void reportConnectFailure(const ModbusError &err, int reconnectDelay);
+
+  /**
+   * @brief Handle a connection that dropped while the bus was running.
+   *
+   * Cancels queued transactions, notifies the devices, and fires the
+   * disconnect callbacks.
+   */
+  void handleDisconnect(int reconnectDelay);
+
+  /** @brief Final disconnect notification when the bus shuts down. */
+  void handleShutdown();
+
   /**
    * @brief Notify all registered devices that the bus has connected.
    *
@@ -470,27 +1440,47 @@ private:
   void notifyDevicesDisconnected();
 
   /**
-   * @brief Per-device reconnect loop (runs in a detached background thread).
-   *
-   * Calls `device->onBusConnected()` and retries with exponential backoff
-   * until the device becomes ready or the bus drops. Removes the device
-   * from `retriesInProgress_` on exit.
+   * @brief Returns true if a message of this category and level would be
+   *        delivered to the log sink.
    *
-   * @param device  The device to re-validate.
+   * Use to skip computing expensive log arguments.
    */
-  void deviceConnectLoop(std::shared_ptr<FroniusDevice> device);
+  bool logEnabled(FroniusTypes::LogCategory cat,
+                  FroniusTypes::LogLevel level) const {
+    return !onBusLog_.empty() &&
+           level >= logLevel_.load(std::memory_order_relaxed) &&
+           (logCategories_.load(std::memory_order_relaxed) &
+            static_cast<uint32_t>(cat)) != 0;
+  }
 
   /**
    * @brief Format a log message and dispatch it to the registered log sink.
+   *
+   * Returns before formatting if the message is filtered out.
    */
   template <typename... Args>
-  void busLog(std::format_string<Args...> fmt, Args &&...args) {
-    if (onBusLog_.empty())
+  void busLog(FroniusTypes::LogCategory cat, FroniusTypes::LogLevel level,
+              std::format_string<Args...> fmt, Args &&...args) {
+    if (!logEnabled(cat, level))
       return;
     std::string msg = std::format(fmt, std::forward<Args>(args)...);
     for (auto &cb : onBusLog_)
       cb(msg);
   }
+
+  /**
+   * @brief Record a binary trace event if tracing is enabled.
+   *
+   * @param kind   What the event describes.
+   * @param t      Transaction supplying slave, address, and count.
+   * @param rc     0 or the errno of a failure.
+   * @param aux    Kind-specific value, see `BusTraceEvent::Kind`.
+   * @param start  Time the operation started.
+   * @param end    Time the operation ended.
+   */
+  void trace(BusTraceEvent::Kind kind, const Transaction &t, int rc,
+             uint32_t aux, std::chrono::steady_clock::time_point start,
+             std::chrono::steady_clock::time_point end);
 };
 
 #endif /* FRONIUS_BUS_H_ */
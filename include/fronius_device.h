@@ -16,17 +16,26 @@
 #ifndef FRONIUS_DEVICE_H_
 #define FRONIUS_DEVICE_H_
 
+#include "error_limiter.h"
 #include "fronius_types.h"
 #include "modbus_config.h"
 #include "modbus_error.h"
 #include "register_base.h"
+#include "register_buffer.h"
+#include "register_codec.h"
+#include <array>
 #include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <functional>
+#include <initializer_list>
 #include <memory>
 #include <optional>
 #include <string>
-#include <vector>
+
+class DeviceIdentityCache;
 
 /**
  * @class FroniusDevice
@@ -38,17 +47,84 @@
  * `setUnavailable()`.
  */
 class FroniusDevice : public std::enable_shared_from_this<FroniusDevice> {
+private:
+  struct Generation;
+
 public:
+  /**
+   * @brief Callback receiving the outcome of an asynchronous fetch.
+   */
+  using FetchCallback =
+      std::function<void(const std::expected<void, ModbusError> &)>;
+
+  // -------------------------------------------------------------------------
+  // Snapshot — immutable view of the last published registers
+  // -------------------------------------------------------------------------
+
+  /**
+   * @class Snapshot
+   * @brief Read-only view of one published register generation.
+   *
+   * Obtained from `snapshot()`. The registers it refers to stay unchanged
+   * for as long as the handle lives, no matter how many fetches complete
+   * meanwhile, so values and their scale factors always come from the same
+   * poll cycle. Move-only; release it promptly, since a held generation
+   * cannot be reused for the next fetch. Must not outlive its device.
+   */
+  class Snapshot {
+  public:
+    /** @brief Construct an empty handle. */
+    Snapshot() = default;
+
+    /** @brief Release the generation. */
+    ~Snapshot();
+
+    Snapshot(Snapshot &&other) noexcept;
+    Snapshot &operator=(Snapshot &&other) noexcept;
+    Snapshot(const Snapshot &) = delete;
+    Snapshot &operator=(const Snapshot &) = delete;
+
+    /** @brief Register contents of the generation. */
+    const RegisterBuffer &regs() const;
+
+    /**
+     * @brief Time the generation was published.
+     *
+     * The epoch for the initial, not yet fetched generation.
+     */
+    std::chrono::system_clock::time_point timestamp() const;
+
+    /** @brief Number of generations published before this one. */
+    uint64_t sequence() const;
+
+  private:
+    friend class FroniusDevice;
+    explicit Snapshot(const Generation *gen) : gen_(gen) {}
+
+    const Generation *gen_{nullptr};
+  };
+
+  /**
+   * @brief Acquire a view of the most recently published registers.
+   *
+   * Lock-free and wait-free in practice: any number of threads may hold
+   * snapshots while the bus thread fetches into a separate buffer.
+   */
+  Snapshot snapshot() const;
+
   /**
    * @brief Construct a FroniusDevice with the given per-device configuration.
    *
-   * @param cfg Per-device Modbus configuration (slave ID, response timeout).
+   * @param cfg    Per-device Modbus configuration (slave ID, response timeout).
+   * @param layout Register ranges the device reads; only these are stored
+   *               in each register generation.
    *
    * @note Derived class constructors must call
    *       `bus->registerDevice(weak_from_this())` after constructing the
    *       base, once `shared_from_this()` is safe to call.
    */
-  explicit FroniusDevice(const ModbusDeviceConfig &cfg);
+  FroniusDevice(const ModbusDeviceConfig &cfg,
+                std::initializer_list<RegisterBuffer::Segment> layout);
 
   /**
    * @brief Virtual destructor.
@@ -91,6 +167,29 @@ public:
    */
   virtual void onBusDisconnected() = 0;
 
+  // -------------------------------------------------------------------------
+  // Data fetch
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Refresh selected register blocks without blocking.
+   *
+   * Like the device's `fetchAsync()`, but reads only `blocks`; all other
+   * registers keep their published values in the new generation. Blocks
+   * the device or its register map does not have are skipped, and a set
+   * with none of its blocks completes at once without publishing.
+   *
+   * @param blocks  Blocks to read.
+   * @param done    Callback receiving the outcome of the fetch.
+   * @note `done` normally runs on the bus thread; keep it lightweight. It
+   *       runs on the calling thread if the fetch is rejected up front.
+   */
+  virtual void fetchBlocksAsync(FroniusTypes::Block blocks,
+                                FetchCallback done) = 0;
+
+  /** @brief Blocks read by the device's full fetch. */
+  virtual FroniusTypes::Block defaultBlocks() const = 0;
+
   // -------------------------------------------------------------------------
   // Device-level callback setters — called by the application
   // -------------------------------------------------------------------------
@@ -133,6 +232,14 @@ public:
     onDeviceError_ = std::move(cb);
   }
 
+  /** @brief Per-device configuration the device was constructed with. */
+  const ModbusDeviceConfig &config() const { return cfg_; }
+
+  /**
+   * @brief Errors held back by `ModbusDeviceConfig::errorHoldoffMs`.
+   */
+  uint64_t suppressedErrors() const { return errorLimiter_.suppressed(); }
+
   /**
    * @brief Set a callback invoked before each per-device reconnect delay.
    *
@@ -145,11 +252,25 @@ public:
     onDeviceRetry_ = std::move(cb);
   }
 
+  /**
+   * @brief Attach a cache of validated device identities.
+   *
+   * With a cache, a device that has been validated before confirms its
+   * cached identity with a single read on connect instead of probing the
+   * full register map. Set it before `FroniusBus::connect()`; the cache may
+   * be shared between devices.
+   *
+   * @param cache Identity cache, or null to always validate from scratch.
+   */
+  void setIdentityCache(std::shared_ptr<DeviceIdentityCache> cache) {
+    identityCache_ = std::move(cache);
+  }
+
   /**
    * @brief Fire the retry callback before a per-device reconnect delay.
    *
-   * Called by `FroniusBus::deviceConnectLoop` — not part of the application
-   * API; exposed publicly because `FroniusBus` is not a friend.
+   * Called by the `DeviceScheduler` of the bus — not part of the application
+   * API; exposed publicly because the scheduler is not a friend.
    *
    * @param delay Seconds until the next `onBusConnected()` attempt.
    */
@@ -158,6 +279,17 @@ public:
       onDeviceRetry_(delay);
   }
 
+  /**
+   * @brief Mark the device as not ready after its slave was parked.
+   *
+   * Called by `FroniusBus` when the breaker opens, so that the scheduler
+   * revalidates the device — not part of the application API; exposed
+   * publicly because the bus is not a friend. Unlike `onBusDisconnected()`
+   * it keeps the detected register layout, which getters on other threads
+   * may be reading; the next `onBusConnected()` resets it.
+   */
+  void markParked();
+
   // -------------------------------------------------------------------------
   // Device state queries
   // -------------------------------------------------------------------------
@@ -179,6 +311,14 @@ public:
    */
   FroniusTypes::RegisterMap getRegisterMap() const { return registerMap_; }
 
+  /**
+   * @brief Returns the number of successful validations so far.
+   *
+   * Changes whenever the device became ready again, even if `isReady()` was
+   * never observed false in between.
+   */
+  uint64_t getValidationCount() const { return validations_.load(); }
+
   /**
    * @brief Returns the per-device Modbus configuration (slave ID, timeouts).
    */
@@ -222,16 +362,6 @@ protected:
   /** @brief Per-device Modbus configuration (slave ID, response timeout). */
   const ModbusDeviceConfig cfg_;
 
-  /**
-   * @brief Per-device register buffer.
-   *
-   * Sized to cover the full 16-bit Modbus address space (0x0000–0xFFFF).
-   * All fetch functions write into this buffer; accessor functions read
-   * from it. The buffer belongs exclusively to this device — it is never
-   * shared with other devices on the same bus.
-   */
-  std::vector<uint16_t> regs_;
-
   /**
    * @brief Register map type detected during the last successful validation.
    *
@@ -255,9 +385,16 @@ protected:
   /** @brief Fired when a device-level Modbus error occurs. */
   std::function<void(const ModbusError &)> onDeviceError_;
 
+  /** @brief Holds back repeated errors, see `cfg_.errorHoldoffMs`. */
+  mutable ModbusErrorLimiter errorLimiter_;
+
   /** @brief Fired before each per-device reconnect delay. */
   std::function<void(int)> onDeviceRetry_;
 
+  /** @brief Optional cache of validated identities; see
+   * `setIdentityCache()`. */
+  std::shared_ptr<DeviceIdentityCache> identityCache_;
+
   // -------------------------------------------------------------------------
   // Helpers for concrete device implementations
   // -------------------------------------------------------------------------
@@ -289,16 +426,118 @@ protected:
    *
    * @tparam T Expected value type.
    * @param res The result to inspect and potentially report.
+   * @param startAddr First register concerned, if any.
+   * @param count Number of registers concerned, if any.
    * @return The same result, unmodified.
    */
   template <typename T>
   std::expected<T, ModbusError>
-  reportError(std::expected<T, ModbusError> res) const {
-    if (!res && onDeviceError_)
-      onDeviceError_(res.error());
+  reportError(std::expected<T, ModbusError> res, int startAddr = 0,
+              int count = 0) const {
+    if (!res)
+      notifyError(res.error(), startAddr, count);
     return res;
   }
 
+  /**
+   * @brief Pass an error to `onDeviceError_`, if set.
+   *
+   * Skipped while an error with the same code and register range is held
+   * back, see `ModbusDeviceConfig::errorHoldoffMs`. The first one delivered
+   * after a hold-off has " (repeated N times)" appended to its message.
+   */
+  void notifyError(const ModbusError &err, int startAddr = 0,
+                   int count = 0) const;
+
+  /**
+   * @brief Open a register update.
+   *
+   * Picks a generation no reader holds, fills it with a copy of the
+   * published registers, and makes it the target of `updateRegs()`. Reads
+   * submitted during the update write into it; `publishUpdate()` then
+   * makes it visible to `snapshot()` in one atomic step. Only one update
+   * per device is open at a time.
+   *
+   * @param wait  Block until a concurrent update finishes; otherwise fail
+   *              with `EINPROGRESS`.
+   * @return Empty expected once the update is open; `EBUSY` if readers
+   *         hold every other generation.
+   */
+  std::expected<void, ModbusError> beginUpdate(bool wait = true);
+
+  /**
+   * @brief Register buffer of the open update.
+   *
+   * Transaction destinations point into it, and validation code reads
+   * back what it fetched from it. Only valid between `beginUpdate()` and
+   * `publishUpdate()` / `abortUpdate()`.
+   */
+  RegisterBuffer &updateRegs();
+
+  /**
+   * @brief Publish the open update as the current generation.
+   *
+   * Every transaction writing into the update must have completed. Calls
+   * `onPublished()` once the generation is visible, before the next update
+   * can be opened.
+   */
+  void publishUpdate();
+
+  /**
+   * @brief Hook run by `publishUpdate()` after each publication.
+   *
+   * Runs on the thread that published, usually a bus thread, so it must
+   * not block. Calls do not overlap and follow the order of publication.
+   * Does nothing by default.
+   *
+   * @param snap  The generation just published.
+   */
+  virtual void onPublished(const Snapshot &snap) { (void)snap; }
+
+  /**
+   * @brief Discard the open update; readers keep the previous generation.
+   *
+   * Every transaction writing into the update must have completed.
+   */
+  void abortUpdate();
+
+  /**
+   * @brief Start an asynchronous fetch and open its register update.
+   *
+   * Concrete `fetchAsync()` implementations call this before building
+   * their transactions, then `armAsyncFetch()` with the number of
+   * transactions, and route every transaction outcome to
+   * `completeAsyncFetch()`. If an update is already open the fetch fails
+   * immediately with `EINPROGRESS`.
+   *
+   * @param done  Callback invoked once the fetch has completed.
+   * @return True if the caller should go on and build its transactions;
+   *         false if `done` has already been invoked with the error.
+   */
+  bool beginAsyncFetch(FetchCallback done);
+
+  /**
+   * @brief Announce how many transactions the asynchronous fetch submits.
+   *
+   * A fetch with no parts completes immediately with success.
+   *
+   * @param parts  Number of transactions about to be submitted.
+   * @return True if the caller should now submit its transactions.
+   */
+  bool armAsyncFetch(int parts);
+
+  /**
+   * @brief Record the outcome of one transaction of an asynchronous fetch.
+   *
+   * The last outcome finishes the fetch: the update is published on
+   * success, or discarded, with the device marked unavailable and the first
+   * error reported through `onDeviceError_`, mirroring the blocking fetch
+   * functions. Then the fetch callback runs. Safe to call from any thread.
+   *
+   * @param res Outcome of one transaction.
+   */
+  void completeAsyncFetch(const std::expected<void, ModbusError> &res);
+
   /**
    * @brief Decode a Modbus register range into a printable ASCII string.
    *
@@ -307,12 +546,12 @@ protected:
    * `Register::Type::STRING` and that all characters are printable. Null
    * bytes are treated as string terminators.
    *
-   * @param regs  Register buffer to read from (typically `regs_`).
+   * @param regs  Register buffer to read from (a snapshot or `updateRegs()`).
    * @param reg   Register descriptor specifying address, length, and type.
    * @return Decoded string on success, or a `ModbusError` on failure.
    */
   std::expected<std::string, ModbusError>
-  getModbusString(const std::vector<uint16_t> &regs, const Register &reg) const;
+  getModbusString(const RegisterBuffer &regs, const Register &reg) const;
 
   /**
    * @brief Retrieve a scaled double value from Modbus registers.
@@ -321,13 +560,13 @@ protected:
    * provided. Supports `INT16`, `UINT16`, `UINT32`, and `FLOAT` register
    * types; `FLOAT` registers are read in ABCD byte order and ignore `sf`.
    *
-   * @param regs  Register buffer to read from (typically `regs_`).
+   * @param regs  Register buffer to read from (a snapshot or `updateRegs()`).
    * @param reg   Register descriptor for the value.
    * @param sf    Optional scale-factor register; omit for no scaling.
    * @return Scaled double on success, or a `ModbusError` on failure.
    */
   std::expected<double, ModbusError>
-  getModbusDouble(const std::vector<uint16_t> &regs, const Register &reg,
+  getModbusDouble(const RegisterBuffer &regs, const Register &reg,
                   std::optional<Register> sf = std::nullopt) const;
 
   /**
@@ -338,21 +577,119 @@ protected:
    * are fixed constants and values are stored in INT32 with swapped word
    * order.
    *
-   * @param regs  Register buffer to read from (typically `regs_`).
+   * @param regs  Register buffer to read from (a snapshot or `updateRegs()`).
    * @param reg   Register descriptor (must be `Register::Type::INT32`).
    * @param sf    Fixed-point scale factor (e.g. `0.1`, `0.001`).
    * @return Scaled double on success, or a `ModbusError` on failure.
    */
   std::expected<double, ModbusError>
-  getModbusDouble(const std::vector<uint16_t> &regs, const Register &reg,
+  getModbusDouble(const RegisterBuffer &regs, const Register &reg,
                   double sf) const;
 
+  /**
+   * @brief Retrieve a value described at compile time.
+   *
+   * Same result as the runtime overloads, without dispatching on the
+   * register type or scale factor: `Desc` is a `ScaledValue` or
+   * `FixedScaledValue`, e.g. `ScaledValue<I10X::W, I10X::W_SF>`.
+   *
+   * @param regs    Register buffer to read from.
+   * @param offset  Added to every register address, for blocks relocated
+   *                as found in the SunSpec model chain.
+   * @return Scaled double on success, or `EINVAL` if a register is not
+   *         stored.
+   */
+  template <typename Desc>
+  std::expected<double, ModbusError> getModbusDouble(const RegisterBuffer &regs,
+                                                     int16_t offset = 0) const {
+    const uint16_t *src =
+        regs.data(static_cast<uint16_t>(Desc::VALUE.ADDR + offset),
+                  Desc::VALUE.NB);
+    if constexpr (requires { Desc::SCALE; }) {
+      const uint16_t *sf =
+          Desc::SCALED
+              ? regs.data(static_cast<uint16_t>(Desc::SCALE.ADDR + offset))
+              : nullptr;
+      if (!src || (Desc::SCALED && !sf))
+        return rangeError(Desc::VALUE.withOffset(offset));
+      return Desc::decode(src, sf);
+    } else {
+      if (!src)
+        return rangeError(Desc::VALUE.withOffset(offset));
+      return Desc::decode(src);
+    }
+  }
+
+  /** @brief Report `reg` as out of bounds of the register buffer. */
+  std::expected<double, ModbusError> rangeError(const Register &reg) const;
+
 private:
   /**
    * @brief Atomic flag reflecting whether this device has been successfully
    *        validated and is ready to serve data.
    */
   std::atomic<bool> ready_{false};
+
+  /** @brief Successful validations, bumped before `ready_` is set. */
+  std::atomic<uint64_t> validations_{0};
+
+  // -------------------------------------------------------------------------
+  // Register generations
+  // -------------------------------------------------------------------------
+
+  /** @brief Number of register buffers rotated between readers and writer. */
+  static constexpr size_t GENERATIONS = 3;
+
+  /**
+   * @brief One register buffer with its reader count and publication data.
+   *
+   * Covers only the register ranges declared by the concrete device's
+   * layout, indexed by Modbus address. Immutable while published or held
+   * by a snapshot; written only while it is the target of an open update.
+   */
+  struct Generation {
+    RegisterBuffer regs;
+
+    /** @brief Snapshots currently holding this generation. */
+    mutable std::atomic<uint32_t> readers{0};
+
+    /** @brief Time of publication. */
+    std::chrono::system_clock::time_point timestamp{};
+
+    /** @brief Publication counter. */
+    uint64_t sequence{0};
+  };
+
+  /** @brief Register generations; one published, the others spare. */
+  std::array<Generation, GENERATIONS> generations_;
+
+  /** @brief Index of the published generation. */
+  std::atomic<uint32_t> published_{0};
+
+  /** @brief Target of the open update, or null. */
+  Generation *update_{nullptr};
+
+  /** @brief True while an update is open; waited on by `beginUpdate()`. */
+  std::atomic<bool> updating_{false};
+
+  // -------------------------------------------------------------------------
+  // Asynchronous fetch state
+  // -------------------------------------------------------------------------
+
+  /** @brief Transactions of the in-flight fetch still outstanding. */
+  std::atomic<int> fetchRemaining_{0};
+
+  /** @brief Set by the first failing part; guards `fetchError_`. */
+  std::atomic<bool> fetchFailed_{false};
+
+  /** @brief First error of the in-flight fetch. */
+  std::optional<ModbusError> fetchError_;
+
+  /** @brief Callback of the in-flight fetch. */
+  FetchCallback fetchDone_;
+
+  /** @brief Keeps the device alive until the in-flight fetch completes. */
+  std::shared_ptr<FroniusDevice> fetchKeepAlive_;
 };
 
 #endif /* FRONIUS_DEVICE_H_ */
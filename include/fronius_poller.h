@@ -0,0 +1,185 @@
+/**
+ * @file fronius_poller.h
+ * @brief Periodic polling of device register blocks at individual rates.
+ *
+ * @details
+ * Without a poller the application calls `fetchInverterRegisters()` or
+ * `fetchMeterRegisters()` itself, and every call re-reads every block. A
+ * `FroniusPoller` instead refreshes each register block of a device at
+ * its own interval — e.g. state code and AC values every second, MPPT
+ * values every ten seconds, the nameplate once per validation — so that
+ * slowly changing data stops consuming bus time.
+ *
+ * Reads are issued with `FroniusDevice::fetchBlocksAsync()`, so one poller
+ * thread serves any number of devices and buses. Schedules run at a fixed
+ * rate from the moment a device becomes ready, independent of how long
+ * each fetch takes; cycles missed while the bus was busy are skipped, not
+ * made up in a burst. Blocks falling due on the same tick are read in one
+ * fetch and published as one snapshot.
+ */
+
+#ifndef FRONIUS_POLLER_H_
+#define FRONIUS_POLLER_H_
+
+#include "fronius_device.h"
+#include "fronius_types.h"
+#include "modbus_error.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <initializer_list>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/**
+ * @class FroniusPoller
+ * @brief Timer thread refreshing device blocks at per-block intervals.
+ *
+ * Non-copyable, non-movable. All methods are safe to call from any thread
+ * except the sample callbacks, which must not call `remove()`.
+ */
+class FroniusPoller {
+public:
+  /**
+   * @brief Callback receiving the blocks a completed poll has published.
+   *
+   * Runs on the bus thread once the new registers are visible through the
+   * device's getters, `snapshot()`, and `decodeAll()`; keep it short.
+   */
+  using SampleCallback =
+      std::function<void(FroniusDevice &device, FroniusTypes::Block blocks)>;
+
+  /**
+   * @struct Rate
+   * @brief Refresh interval of a set of blocks.
+   */
+  struct Rate {
+    /** @brief Blocks refreshed together at this rate. */
+    FroniusTypes::Block blocks{FroniusTypes::Block::NONE};
+
+    /**
+     * @brief Time between refreshes.
+     *
+     * Zero reads the blocks once each time the device becomes ready.
+     */
+    std::chrono::milliseconds interval{0};
+  };
+
+  /** @brief Start the poller thread. */
+  FroniusPoller();
+
+  /**
+   * @brief Stop the poller thread.
+   *
+   * Waits for polls in flight, so no sample callback runs afterwards.
+   */
+  ~FroniusPoller();
+
+  // Non-copyable, non-movable.
+  FroniusPoller(const FroniusPoller &) = delete;
+  FroniusPoller &operator=(const FroniusPoller &) = delete;
+  FroniusPoller(FroniusPoller &&) = delete;
+  FroniusPoller &operator=(FroniusPoller &&) = delete;
+
+  /**
+   * @brief Poll `device` with the given block rates.
+   *
+   * Polling starts once the device is ready and pauses while it is not.
+   * The poller holds the device weakly and forgets it once destroyed.
+   *
+   * @param device    Device to poll.
+   * @param rates     Block rates; a block listed twice is read at both.
+   * @param onSample  Optional callback after every successful poll.
+   * @param phase     Delay of the first periodic poll after the device
+   *                  became ready. Giving devices on one bus different
+   *                  phases spreads their reads instead of bunching them.
+   * @throws std::invalid_argument if `device` is null or already polled,
+   *         `rates` is empty, a rate has no blocks, or an interval or
+   *         `phase` is negative.
+   */
+  void add(std::shared_ptr<FroniusDevice> device,
+           std::initializer_list<Rate> rates, SampleCallback onSample = {},
+           std::chrono::milliseconds phase = std::chrono::milliseconds(0));
+
+  /**
+   * @brief Stop polling `device`.
+   *
+   * Waits for a poll of the device in flight. No-op if it is not polled.
+   */
+  void remove(const FroniusDevice &device);
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /** @brief Upper bound on sleeping, so readiness changes are noticed. */
+  static constexpr std::chrono::seconds READY_CHECK{1};
+
+  /** @brief Next refresh of one `Rate`. */
+  struct Schedule {
+    FroniusTypes::Block blocks;
+    std::chrono::milliseconds interval;
+
+    /** @brief Due time; `time_point::max()` once a one-off read ran. */
+    Clock::time_point due;
+  };
+
+  /** @brief One polled device. */
+  struct Entry {
+    std::weak_ptr<FroniusDevice> device;
+
+    /** @brief Identity of the device for `add()` and `remove()`. */
+    const FroniusDevice *key{nullptr};
+
+    std::vector<Schedule> schedules;
+    SampleCallback onSample;
+    std::chrono::milliseconds phase{0};
+
+    /** @brief Validation count the schedules were started for. */
+    uint64_t validation{0};
+
+    /** @brief Set while a poll of the device is in flight. */
+    bool inFlight{false};
+
+    /** @brief Set by `remove()`; erased once no poll is in flight. */
+    bool removed{false};
+
+    /** @brief Blocks that fell due while busy, read on the next pass. */
+    FroniusTypes::Block deferred{FroniusTypes::Block::NONE};
+  };
+
+  /** @brief Poller thread body. */
+  void run();
+
+  /** @brief Completion of a poll; runs on the bus thread. */
+  void onFetched(Entry &entry, const std::shared_ptr<FroniusDevice> &device,
+                 FroniusTypes::Block blocks,
+                 const std::expected<void, ModbusError> &res);
+
+  /** @brief Protects everything below. */
+  std::mutex mtx_;
+
+  /** @brief Wakes the poller thread and `remove()` or destructor waits. */
+  std::condition_variable cv_;
+
+  /** @brief Polled devices. */
+  std::vector<std::unique_ptr<Entry>> entries_;
+
+  /** @brief Set when the poller thread must re-evaluate before sleeping. */
+  bool dirty_{false};
+
+  /** @brief Polls in flight across all devices. */
+  size_t inFlight_{0};
+
+  /** @brief Cleared by the destructor to stop the thread. */
+  bool running_{true};
+
+  /** @brief Poller thread. */
+  std::thread thread_;
+};
+
+#endif /* FRONIUS_POLLER_H_ */
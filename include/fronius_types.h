@@ -4,8 +4,10 @@
  *
  * @details
  * Defines the public enums for phases, inverter inputs, output quantities,
- * energy direction, operating state, vendor-specific event flags, and the
- * detected register map. Each enum has a `toString()` overload for logging.
+ * energy direction, operating state, vendor-specific event flags, the
+ * detected register map, the bus transaction priority, the bus log
+ * filter, and the register blocks of a device. The enums describing device
+ * data have a `toString()` overload for logging.
  */
 
 #ifndef FRONIUS_TYPES_H_
@@ -680,5 +682,126 @@ struct FroniusTypes {
     }
     return "unknown";
   }
+
+  /**
+   * @brief Scheduling class of a bus transaction.
+   *
+   * The bus thread always serves the most urgent class present in its
+   * queue first.
+   */
+  enum class Priority {
+    CONTROL, ///< Register writes of a control loop; overtake every read
+    HIGH,    ///< Control-loop reads that must not wait behind polling
+    NORMAL,  ///< Regular telemetry polling
+    LOW,     ///< Device validation and other background probes
+  };
+
+  /**
+   * @brief Convert a Priority value to a human-readable string.
+   *
+   * @param prio The priority to convert.
+   * @return A null-terminated string: "control", "high", "normal", or
+   *         "low".
+   */
+  static constexpr const char *toString(Priority prio) {
+    switch (prio) {
+    case Priority::CONTROL:
+      return "control";
+    case Priority::HIGH:
+      return "high";
+    case Priority::NORMAL:
+      return "normal";
+    case Priority::LOW:
+      return "low";
+    }
+    return "unknown";
+  }
+
+  /**
+   * @brief Severity of a bus diagnostic message.
+   */
+  enum class LogLevel {
+    DEBUG, ///< Per-transaction detail (dequeue, send, receive)
+    INFO,  ///< Notable state changes (learned delays, rejected merges)
+    WARN,  ///< Failed or dropped transactions
+    OFF,   ///< Filter level that suppresses all messages
+  };
+
+  /**
+   * @brief Convert a LogLevel value to a human-readable string.
+   *
+   * @param level The level to convert.
+   * @return A null-terminated string: "debug", "info", "warn", or "off".
+   */
+  static constexpr const char *toString(LogLevel level) {
+    switch (level) {
+    case LogLevel::DEBUG:
+      return "debug";
+    case LogLevel::INFO:
+      return "info";
+    case LogLevel::WARN:
+      return "warn";
+    case LogLevel::OFF:
+      return "off";
+    }
+    return "unknown";
+  }
+
+  /**
+   * @brief Subsystem a bus diagnostic message belongs to.
+   *
+   * Values are bit flags; combine them with `|` to build a filter mask.
+   */
+  enum class LogCategory : uint32_t {
+    QUEUE = 1u << 0,    ///< Queue scheduling: dequeue, deadline drops
+    WIRE = 1u << 1,     ///< Register reads sent and answered
+    SWITCH = 1u << 2,   ///< RTU slave switching delays
+    COALESCE = 1u << 3, ///< Merged reads
+    POOL = 1u << 4,     ///< Pooled TCP connections coming and going
+    RECORD = 1u << 5,   ///< Recording of register reads
+    ALL = 0xFFFFFFFFu,  ///< Every category
+  };
+
+  /** @brief Combine two log categories into a filter mask. */
+  friend constexpr LogCategory operator|(LogCategory a, LogCategory b) {
+    return static_cast<LogCategory>(static_cast<uint32_t>(a) |
+                                    static_cast<uint32_t>(b));
+  }
+
+  /**
+   * @brief Register block a device can refresh on its own.
+   *
+   * Values are bit flags; combine them with `|` to select several blocks
+   * for `fetchBlocksAsync()` or a `FroniusPoller` schedule. Blocks the
+   * device or its detected register map does not have are ignored.
+   */
+  enum class Block : uint32_t {
+    NONE = 0,              ///< No block
+    STATE = 1u << 0,       ///< Inverter: Fronius active state code
+    INVERTER = 1u << 1,    ///< Inverter: AC/DC values, energy, state (I10X)
+    MPPT = 1u << 2,        ///< Inverter: per-input DC values (I160)
+    NAMEPLATE = 1u << 3,   ///< Inverter: ratings (I120)
+    METER = 1u << 4,       ///< Meter: SunSpec model, or proprietary summary
+    METER_PHASE = 1u << 5, ///< Meter, proprietary map: per-phase values
+    METER_ENERGY = 1u << 6, ///< Meter, proprietary map: energy counters
+    ALL = 0xFFFFFFFFu,      ///< Every block
+  };
+
+  /** @brief Combine two block sets. */
+  friend constexpr Block operator|(Block a, Block b) {
+    return static_cast<Block>(static_cast<uint32_t>(a) |
+                              static_cast<uint32_t>(b));
+  }
+
+  /** @brief Blocks present in both sets. */
+  friend constexpr Block operator&(Block a, Block b) {
+    return static_cast<Block>(static_cast<uint32_t>(a) &
+                              static_cast<uint32_t>(b));
+  }
+
+  /** @brief True if `set` contains any block of `blocks`. */
+  static constexpr bool has(Block set, Block blocks) {
+    return (set & blocks) != Block::NONE;
+  }
 };
 #endif /* FRONIUS_TYPES_H_ */
@@ -11,11 +11,225 @@
 #include "fronius_types.h"
 #include "modbus_config.h"
 #include "modbus_error.h"
+#include "sample_decoder.h"
+#include "sample_history.h"
+#include "sunspec_discovery.h"
+#include <array>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
+#include <iterator>
+#include <limits>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <vector>
 
+/**
+ * @struct InverterSample
+ * @brief All inverter measurements of one poll cycle.
+ *
+ * Filled in one pass by `Inverter::decodeAll()`. Units and sign
+ * conventions match the corresponding getters. Values the device does not
+ * provide (phases beyond its model, a second input it lacks) are NaN.
+ */
+struct InverterSample {
+  /** @brief Marker of a value the device does not provide. */
+  static constexpr double NO_VALUE = std::numeric_limits<double>::quiet_NaN();
+
+  /** @brief Publication time of the decoded registers. */
+  std::chrono::system_clock::time_point timestamp{};
+
+  /** @brief Sequence number of the decoded registers. */
+  uint64_t sequence{0};
+
+  /** @brief Vendor state code, see `Inverter::getActiveStateCode()`. */
+  int activeStateCode{0};
+
+  double acCurrent{NO_VALUE};  ///< AC current total [A]
+  double acCurrentA{NO_VALUE}; ///< AC current phase A [A]
+  double acCurrentB{NO_VALUE}; ///< AC current phase B [A]
+  double acCurrentC{NO_VALUE}; ///< AC current phase C [A]
+
+  double acVoltageA{NO_VALUE};  ///< AC voltage phase A to neutral [V]
+  double acVoltageB{NO_VALUE};  ///< AC voltage phase B to neutral [V]
+  double acVoltageC{NO_VALUE};  ///< AC voltage phase C to neutral [V]
+  double acVoltageAB{NO_VALUE}; ///< AC voltage phase AB [V]
+  double acVoltageBC{NO_VALUE}; ///< AC voltage phase BC [V]
+  double acVoltageCA{NO_VALUE}; ///< AC voltage phase CA [V]
+
+  double acPowerActive{NO_VALUE};   ///< AC active power [W]
+  double acPowerApparent{NO_VALUE}; ///< AC apparent power [VA]
+  double acPowerReactive{NO_VALUE}; ///< AC reactive power [VAr]
+  double acPowerFactor{NO_VALUE};   ///< AC power factor
+  double acFrequency{NO_VALUE};     ///< AC frequency [Hz]
+  double acEnergy{NO_VALUE};        ///< AC lifetime energy [Wh]
+
+  double dcCurrent{NO_VALUE}; ///< DC current total [A]
+  double dcVoltage{NO_VALUE}; ///< DC voltage [V]
+  double dcPower{NO_VALUE};   ///< DC power total [W]
+
+  double dcCurrentA{NO_VALUE}; ///< DC current input A [A]
+  double dcVoltageA{NO_VALUE}; ///< DC voltage input A [V]
+  double dcPowerA{NO_VALUE};   ///< DC power input A [W]
+  double dcEnergyA{NO_VALUE};  ///< DC lifetime energy input A [Wh]
+
+  double dcCurrentB{NO_VALUE}; ///< DC current input B [A]
+  double dcVoltageB{NO_VALUE}; ///< DC voltage input B [V]
+  double dcPowerB{NO_VALUE};   ///< DC power input B [W]
+  double dcEnergyB{NO_VALUE};  ///< DC lifetime energy input B [Wh]
+};
+
+/**
+ * @struct InverterEvents
+ * @brief The three vendor event groups of an inverter as raw bitmasks.
+ *
+ * Returned by `Inverter::getEventFlags()`. Testing for faults and walking
+ * the names of the active events does not allocate: iterating yields a
+ * `std::string_view` per known set bit, in group and bit order, pointing
+ * into a compile-time table built from `FroniusTypes::toString()`. Bits
+ * without a known meaning are skipped and reported by `unknown()`.
+ *
+ * ```cpp
+ * auto events = inverter->getEventFlags();
+ * if (events.has(FroniusTypes::Event_1::GRID_ERROR)) { ... }
+ * for (std::string_view name : events) { ... }
+ * ```
+ */
+struct InverterEvents {
+  /** @brief Number of event groups (EVTVND1 to EVTVND3). */
+  static constexpr size_t GROUPS = 3;
+
+  /** @brief Names of the bits of each group; null for unknown bits. */
+  static constexpr std::array<std::array<const char *, 32>, GROUPS> NAMES =
+      [] {
+        std::array<std::array<const char *, 32>, GROUPS> names{};
+        for (uint32_t bit = 0; bit < 32; ++bit) {
+          const uint32_t mask = 1u << bit;
+          names[0][bit] =
+              FroniusTypes::toString(static_cast<FroniusTypes::Event_1>(mask))
+                  .value_or(nullptr);
+          names[1][bit] =
+              FroniusTypes::toString(static_cast<FroniusTypes::Event_2>(mask))
+                  .value_or(nullptr);
+          names[2][bit] =
+              FroniusTypes::toString(static_cast<FroniusTypes::Event_3>(mask))
+                  .value_or(nullptr);
+        }
+        return names;
+      }();
+
+  /** @brief Bits of each group that have a name. */
+  static constexpr std::array<uint32_t, GROUPS> KNOWN = [] {
+    std::array<uint32_t, GROUPS> known{};
+    for (size_t group = 0; group < GROUPS; ++group)
+      for (uint32_t bit = 0; bit < 32; ++bit)
+        if (NAMES[group][bit])
+          known[group] |= 1u << bit;
+    return known;
+  }();
+
+  /** @brief Raw EVTVND1, EVTVND2, and EVTVND3 registers. */
+  std::array<uint32_t, GROUPS> groups{};
+
+  /** @brief True if any event bit is set, known or not. */
+  constexpr bool any() const {
+    return (groups[0] | groups[1] | groups[2]) != 0;
+  }
+
+  /** @brief True if the flag of group 1 is set. */
+  constexpr bool has(FroniusTypes::Event_1 event) const {
+    return (groups[0] & static_cast<uint32_t>(event)) != 0;
+  }
+
+  /** @brief True if the flag of group 2 is set. */
+  constexpr bool has(FroniusTypes::Event_2 event) const {
+    return (groups[1] & static_cast<uint32_t>(event)) != 0;
+  }
+
+  /** @brief True if the flag of group 3 is set. */
+  constexpr bool has(FroniusTypes::Event_3 event) const {
+    return (groups[2] & static_cast<uint32_t>(event)) != 0;
+  }
+
+  /** @brief Set bits of `group` (0-2) without a known meaning. */
+  constexpr uint32_t unknown(size_t group) const {
+    return groups[group] & ~KNOWN[group];
+  }
+
+  /** @brief Number of known events that are set. */
+  constexpr size_t count() const {
+    size_t n = 0;
+    for (size_t group = 0; group < GROUPS; ++group)
+      n += static_cast<size_t>(std::popcount(groups[group] & KNOWN[group]));
+    return n;
+  }
+
+  /**
+   * @class iterator
+   * @brief Forward iterator over the names of the known set events.
+   */
+  class iterator {
+  public:
+    using value_type = std::string_view;
+    using difference_type = std::ptrdiff_t;
+    using iterator_concept = std::forward_iterator_tag;
+
+    constexpr iterator() = default;
+
+    constexpr value_type operator*() const {
+      return NAMES[group_][std::countr_zero(bits_)];
+    }
+
+    constexpr iterator &operator++() {
+      bits_ &= bits_ - 1;
+      settle();
+      return *this;
+    }
+
+    constexpr iterator operator++(int) {
+      iterator prev = *this;
+      ++*this;
+      return prev;
+    }
+
+    constexpr bool operator==(const iterator &) const = default;
+
+  private:
+    friend struct InverterEvents;
+
+    constexpr iterator(const InverterEvents *events, size_t group)
+        : events_(events), group_(group) {
+      if (group_ < GROUPS)
+        bits_ = events_->groups[group_] & KNOWN[group_];
+      settle();
+    }
+
+    /** @brief Move on to the next group with a known event, or the end. */
+    constexpr void settle() {
+      while (bits_ == 0 && group_ < GROUPS) {
+        if (++group_ < GROUPS)
+          bits_ = events_->groups[group_] & KNOWN[group_];
+      }
+    }
+
+    const InverterEvents *events_{nullptr};
+    size_t group_{GROUPS};
+    uint32_t bits_{0};
+  };
+
+  /** @brief First known set event. */
+  constexpr iterator begin() const { return iterator(this, 0); }
+
+  /** @brief Past the last known set event. */
+  constexpr iterator end() const { return iterator(this, GROUPS); }
+};
+
+static_assert(std::forward_iterator<InverterEvents::iterator>);
+
 /**
  * @class Inverter
  * @brief Represents a Fronius Modbus-compatible inverter.
@@ -78,11 +292,40 @@ public:
    * @brief Fetch the complete inverter register map from the device.
    *
    * Submits the necessary register-read transactions and blocks until they
-   * complete. After a successful call, all `getXxx()` accessors reflect
-   * fresh values.
+   * complete. The registers are read into a spare buffer and published in
+   * one step on success, so concurrent `getXxx()` calls and snapshots see
+   * either the previous or the new poll cycle, never a mix. A fetch started
+   * while another one of the same device is in flight waits for it.
    */
   std::expected<void, ModbusError> fetchInverterRegisters();
 
+  /**
+   * @brief Fetch the complete inverter register map without blocking.
+   *
+   * Submits the same register-read transactions as
+   * `fetchInverterRegisters()` and returns immediately. `done` is invoked
+   * once every block has been refreshed, or with the first error (the
+   * device is then marked unavailable, as with the blocking fetch). Lets
+   * a single scheduler thread keep many bus queues busy.
+   *
+   * @param done Callback receiving the outcome of the fetch.
+   * @note `done` normally runs on the bus thread; keep it lightweight. It
+   *       runs on the calling thread if the fetch is rejected up front.
+   */
+  void fetchAsync(FetchCallback done);
+
+  /**
+   * @brief Refresh selected inverter blocks without blocking.
+   *
+   * Supports `STATE`, `INVERTER`, `MPPT`, and `NAMEPLATE`; see
+   * `FroniusDevice::fetchBlocksAsync()`.
+   */
+  void fetchBlocksAsync(FroniusTypes::Block blocks,
+                        FetchCallback done) override;
+
+  /** @brief `STATE`, `INVERTER`, and `MPPT`: the blocks of a full fetch. */
+  FroniusTypes::Block defaultBlocks() const override;
+
   // -------------------------------------------------------------------------
   // Device identity
   // -------------------------------------------------------------------------
@@ -115,6 +358,13 @@ public:
    */
   bool isHybrid() const { return hybrid_; }
 
+  /**
+   * @brief SunSpec models found in the device's register map.
+   *
+   * Empty until the device has been validated.
+   */
+  const SunSpecModelTable &getModels() const { return models_; }
+
   /**
    * @brief Get the detected inverter model ID (e.g. 101, 113).
    *
@@ -123,8 +373,8 @@ public:
   int getId() const { return id_; }
 
   // -------------------------------------------------------------------------
-  // Electrical measurements — all read from regs_ populated by
-  // fetchInverterRegisters()
+  // Electrical measurements — all read from the last register snapshot
+  // published by fetchInverterRegisters() or fetchAsync()
   // -------------------------------------------------------------------------
 
   /**
@@ -209,6 +459,15 @@ public:
    */
   std::expected<std::string, ModbusError> getState() const;
 
+  /**
+   * @brief Get the current operational state as an enum.
+   *
+   * Allocation-free counterpart of `getState()` for checks on every poll.
+   *
+   * @return The state, or `EINVAL` for a code outside `FroniusTypes::State`.
+   */
+  std::expected<FroniusTypes::State, ModbusError> getOperatingState() const;
+
   /**
    * @brief Get all active inverter events as human-readable strings.
    *
@@ -217,6 +476,94 @@ public:
    */
   std::expected<std::vector<std::string>, ModbusError> getEvents() const;
 
+  /**
+   * @brief Get the three event registers as raw bitmasks.
+   *
+   * Allocation-free counterpart of `getEvents()`: test flags with
+   * `InverterEvents::has()` and iterate the result for the names of the
+   * active events. Unknown bits are not an error; see
+   * `InverterEvents::unknown()`.
+   */
+  InverterEvents getEventFlags() const;
+
+  // -------------------------------------------------------------------------
+  // Bulk decode
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Decode every measurement of the last published fetch at once.
+   *
+   * Cheaper than calling the getters one by one: the register encoding is
+   * resolved once at validation time, and each scale factor is evaluated
+   * once per call. All values come from the same snapshot.
+   *
+   * @param sample  Struct to fill; fields the device lacks are set to NaN.
+   * @return Empty expected, or `ENODATA` before the device is ready.
+   */
+  std::expected<void, ModbusError> decodeAll(InverterSample &sample) const;
+
+  /**
+   * @brief Report the measurements that changed since the last call.
+   *
+   * Compares the registers of the last published fetch with those seen by
+   * the previous call on `tracker` and decodes only the fields whose
+   * registers differ; fields that moved beyond their deadband are listed
+   * in `tracker.changes()`. Repeated calls on an unchanged snapshot report
+   * nothing.
+   *
+   * @param tracker  Consumer state; the first call reports every field.
+   * @return Empty expected, or `ENODATA` before the device is ready.
+   */
+  std::expected<void, ModbusError>
+  decodeChanges(SampleTracker<InverterSample> &tracker) const;
+
+  /**
+   * @brief Keep a history of every fetch the device publishes.
+   *
+   * Each published fetch is decoded and its tracked fields are appended
+   * to `history`, on the thread that completed the fetch, before the
+   * fetch callback runs. Set it before `FroniusBus::connect()`; null
+   * detaches the history.
+   *
+   * @param history  History shared with the application, which queries it.
+   */
+  void setHistory(std::shared_ptr<SampleHistory<InverterSample>> history) {
+    history_ = std::move(history);
+  }
+
+  // -------------------------------------------------------------------------
+  // Power control — writes to the immediate controls block (I123)
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Limit the active power output to a share of `WMax`.
+   *
+   * Sets `WMaxLimPct`, its revert timeout, and `WMaxLim_Ena` in one
+   * read-modify-write at `Priority::CONTROL`, so the command overtakes
+   * queued polling; the time window and ramp time keep the values set on
+   * the inverter. The scale factor is read once per connection. Blocks
+   * until the inverter has confirmed the write.
+   *
+   * @param pct     Limit in percent of `WMax` (0-100).
+   * @param revert  Time after which the inverter drops the limit by itself
+   *                (0-28800 s); 0 keeps it until cleared.
+   * @return Empty expected on success; `EINVAL` for an argument out of
+   *         range or a limit that does not fit the register at the
+   *         inverter's scale factor, `ENODATA` before the device is ready,
+   *         `ENOTSUP` without an immediate controls block, or the bus error.
+   */
+  std::expected<void, ModbusError>
+  setPowerLimit(double pct,
+                std::chrono::seconds revert = std::chrono::seconds(0));
+
+  /**
+   * @brief Lift the limit set by `setPowerLimit()`.
+   *
+   * Clears `WMaxLim_Ena` with a single register write at
+   * `Priority::CONTROL`. Blocks until the inverter has confirmed it.
+   */
+  std::expected<void, ModbusError> clearPowerLimit();
+
 private:
   /** @brief Shared bus this device communicates over. */
   std::shared_ptr<FroniusBus> bus_;
@@ -235,74 +582,191 @@ private:
   /** @brief True if the inverter has hybrid storage registers. */
   bool hybrid_{false};
 
+  /**
+   * @brief Decode plan of `decodeAll()`, built by `buildDecoder()`.
+   *
+   * Replaced as a whole on revalidation, so readers on other threads keep
+   * the plan they loaded.
+   */
+  std::atomic<std::shared_ptr<const SampleDecoder<InverterSample>>> decoder_;
+
+  /** @brief History fed by `onPublished()`, see `setHistory()`. */
+  std::shared_ptr<SampleHistory<InverterSample>> history_;
+
+  /** @brief Append the published fetch to `history_`, if set. */
+  void onPublished(const Snapshot &snap) override;
+
+  /** @brief Fill `sample` from `snap` with `plan`. */
+  void decode(const SampleDecoder<InverterSample> &plan, const Snapshot &snap,
+              InverterSample &sample) const;
+
+  /** @brief SunSpec model chain found by `validateDevice()`. */
+  SunSpecModelTable models_;
+
+  /** @brief Shift of the nameplate block (I120) from its documented
+   * integer-map address. */
+  int16_t nameplateOffset_{0};
+
+  /** @brief Shift of the multi MPPT block (I160) from its documented
+   * integer-map address. */
+  int16_t mpptOffset_{0};
+
+  /** @brief `limitScale_` before the scale factor has been read. */
+  static constexpr int NO_SCALE = std::numeric_limits<int>::min();
+
+  /** @brief Cached `WMaxLimPct_SF`, or `NO_SCALE`; reset on (re)connect. */
+  std::atomic<int> limitScale_{NO_SCALE};
+
   /**
    * @brief Run all validation steps to identify the inverter.
    *
-   * Probes the SunSpec common, inverter, multi-MPPT, storage, nameplate,
-   * and end blocks in sequence. On success, sets `id_`,
-   * `useFloatRegisters_`, `inputs_`, and `hybrid_`.
+   * Walks the SunSpec model chain with a `SunSpecDiscovery` — a few
+   * pipelined reads instead of one round trip per block — then checks the
+   * common, inverter, multi-MPPT, storage, and nameplate blocks against
+   * the resulting model table. On success, sets `id_`,
+   * `useFloatRegisters_`, `inputs_`, `hybrid_`, and the block offsets.
    */
   std::expected<void, ModbusError> validateDevice();
 
   /**
    * @brief Validate the SunSpec common block (C001).
    *
-   * Reads the common block, verifies the SunSpec identifier ("SunS"), and
-   * checks that the model ID and length match the SunSpec spec.
+   * Checks that the model ID and length match the SunSpec spec and makes
+   * sure the whole block has been read.
    */
-  std::expected<void, ModbusError> validateCommonRegisters();
+  std::expected<void, ModbusError>
+  validateCommonRegisters(SunSpecDiscovery &discovery);
 
   /**
    * @brief Validate the inverter model block (I101–103 / I111–113).
    *
-   * Reads the model ID register and rejects anything outside the known
-   * SunSpec inverter IDs. Sets `id_` and `useFloatRegisters_`.
+   * Rejects model IDs outside the known SunSpec inverter IDs. Sets `id_`
+   * and `useFloatRegisters_`.
    */
   std::expected<void, ModbusError> validateInverterRegisters();
 
   /**
    * @brief Validate the Multi-MPPT extension block (I160).
    *
-   * Verifies block ID and size, then reads the second input string name to
-   * decide whether `inputs_` is 1 or 2.
+   * Locates the block in the model table and verifies its size, then reads
+   * the second input string name to decide whether `inputs_` is 1 or 2.
+   * Sets `mpptOffset_`.
    */
-  std::expected<void, ModbusError> validateMultiMpptRegisters();
+  std::expected<void, ModbusError>
+  validateMultiMpptRegisters(SunSpecDiscovery &discovery);
 
   /**
    * @brief Validate the basic storage control block (I124).
    *
-   * Sets `hybrid_ = true` if the block is present and valid; sets
-   * `hybrid_ = false` if the SunSpec end-of-map marker is found at this
-   * address instead.
+   * Sets `hybrid_ = true` if the model chain contains a valid storage
+   * block, `hybrid_ = false` if it has none.
    */
   std::expected<void, ModbusError> validateStorageRegisters();
 
   /**
    * @brief Validate the nameplate block (I120).
    *
-   * Verifies the block ID (120) and size. Nameplate data is available via
+   * Locates the block in the model table and verifies its size. Sets
+   * `nameplateOffset_`; nameplate data is available via
    * `getAcPowerRating()` once this succeeds.
    */
   std::expected<void, ModbusError> validateNameplateRegisters();
 
   /**
-   * @brief Validate the SunSpec end-of-map block.
+   * @brief Restore the identity cached for this endpoint and slave ID.
+   *
+   * Confirms the cached model chain and serial number with a single read
+   * and, if they still match, sets all identity members without probing.
+   * Drops a stale entry.
    *
-   * Confirms that the end-block ID is `0xFFFF` and length is `0` at the
-   * address that corresponds to the detected register encoding (integer
-   * vs. float) and storage variant (hybrid vs. non-hybrid).
+   * @return True if the identity was restored, false if the device must
+   *         be validated from scratch; or the bus error.
    */
-  std::expected<void, ModbusError> validateEndRegisters();
+  std::expected<bool, ModbusError> restoreIdentity();
+
+  /** @brief Remember the validated identity in the attached cache. */
+  void storeIdentity();
 
   /**
    * @brief Build a Transaction targeting this device's slave ID and timeouts.
    *
    * @param startAddr  Starting Modbus register address.
-   * @param count      Number of registers to read.
-   * @param dest       Pointer into `regs_` where results are written.
+   * @param count      Number of registers to read; results are written into
+   *                   the open register update at the same addresses.
    */
-  FroniusBus::Transaction makeTransaction(int startAddr, int count,
-                                          uint16_t *dest);
+  FroniusBus::Transaction makeTransaction(uint16_t startAddr, uint16_t count);
+
+  /**
+   * @brief Build a register write of `count` words from `src`.
+   *
+   * Queued at `Priority::CONTROL` without a deadline: a control command
+   * overtakes every read and is never dropped unsent.
+   */
+  FroniusBus::Transaction makeControlTransaction(uint16_t startAddr,
+                                                 uint16_t count,
+                                                 const uint16_t *src);
+
+  /**
+   * @brief Shift of the immediate controls block (I123) from its
+   *        documented address.
+   *
+   * @return The offset; `ENODATA` before the device is ready, `ENOTSUP` if
+   *         the model chain has no immediate controls block.
+   */
+  std::expected<int16_t, ModbusError> controlsOffset() const;
+
+  /**
+   * @brief Scale factor of `WMaxLimPct`, read on first use.
+   *
+   * @param offset  Shift of the immediate controls block.
+   */
+  std::expected<int, ModbusError> powerLimitScale(int16_t offset);
+
+  /**
+   * @brief Build a validation-probe transaction for a register range.
+   *
+   * Like `makeTransaction()`, but queued at `Priority::LOW` without a
+   * deadline so probing never delays regular fetches, and marked as a
+   * probe so it is still sent while the slave is parked.
+   */
+  FroniusBus::Transaction makeProbeTransaction(uint16_t startAddr,
+                                               uint16_t count);
+
+  /**
+   * @brief Build the register-read transactions of a fetch.
+   *
+   * One transaction per selected block, in the order active state code,
+   * main inverter block, multi-MPPT extension block, and nameplate block,
+   * using the encoding and offsets detected during validation.
+   *
+   * @param blocks  Blocks to read.
+   * @param plan    Receives the transactions.
+   * @return Number of transactions in `plan`.
+   */
+  size_t fetchPlan(FroniusTypes::Block blocks,
+                   std::array<FroniusBus::Transaction, 4> &plan);
+
+  /**
+   * @brief Build the `decodeAll()` plan for the detected encoding.
+   *
+   * Called once validation has set `useFloatRegisters_`, `id_`, and
+   * `inputs_`.
+   */
+  std::expected<void, ModbusError> buildDecoder();
+
+  /**
+   * @brief Read a main-block value in the detected encoding.
+   *
+   * @tparam Int  Integer-model register (I10X).
+   * @tparam Sf   Scale-factor register of `Int`.
+   * @tparam Flt  Float-model register (I11X).
+   */
+  template <Register Int, Register Sf, Register Flt>
+  std::expected<double, ModbusError>
+  getValue(const RegisterBuffer &regs) const {
+    return useFloatRegisters_ ? getModbusDouble<ScaledValue<Flt>>(regs)
+                              : getModbusDouble<ScaledValue<Int, Sf>>(regs);
+  }
 };
 
 #endif /* INVERTER_H_ */
@@ -11,10 +11,90 @@
 #include "fronius_types.h"
 #include "modbus_config.h"
 #include "modbus_error.h"
+#include "sample_decoder.h"
+#include "sample_history.h"
+#include "sunspec_discovery.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
+#include <limits>
 #include <memory>
+#include <optional>
 #include <string>
 
+/**
+ * @struct MeterSample
+ * @brief All meter measurements of one poll cycle.
+ *
+ * Filled in one pass by `Meter::decodeAll()`. Units and sign conventions
+ * match the corresponding getters. Values the register map or the meter
+ * model does not provide are NaN.
+ */
+struct MeterSample {
+  /** @brief Marker of a value the device does not provide. */
+  static constexpr double NO_VALUE = std::numeric_limits<double>::quiet_NaN();
+
+  /** @brief Publication time of the decoded registers. */
+  std::chrono::system_clock::time_point timestamp{};
+
+  /** @brief Sequence number of the decoded registers. */
+  uint64_t sequence{0};
+
+  double acCurrent{NO_VALUE};  ///< AC current total [A]; SunSpec only
+  double acCurrentA{NO_VALUE}; ///< AC current phase A [A]
+  double acCurrentB{NO_VALUE}; ///< AC current phase B [A]
+  double acCurrentC{NO_VALUE}; ///< AC current phase C [A]
+
+  double acVoltage{NO_VALUE};   ///< AC voltage phase to neutral average [V]
+  double acVoltageA{NO_VALUE};  ///< AC voltage phase A to neutral [V]
+  double acVoltageB{NO_VALUE};  ///< AC voltage phase B to neutral [V]
+  double acVoltageC{NO_VALUE};  ///< AC voltage phase C to neutral [V]
+  double acVoltagePP{NO_VALUE}; ///< AC voltage phase to phase average [V]
+  double acVoltageAB{NO_VALUE}; ///< AC voltage phase AB [V]
+  double acVoltageBC{NO_VALUE}; ///< AC voltage phase BC [V]
+  double acVoltageCA{NO_VALUE}; ///< AC voltage phase CA [V]
+
+  double acFrequency{NO_VALUE}; ///< AC frequency [Hz]
+
+  double acPowerActive{NO_VALUE};  ///< AC active power total [W]
+  double acPowerActiveA{NO_VALUE}; ///< AC active power phase A [W]
+  double acPowerActiveB{NO_VALUE}; ///< AC active power phase B [W]
+  double acPowerActiveC{NO_VALUE}; ///< AC active power phase C [W]
+
+  double acPowerApparent{NO_VALUE};  ///< AC apparent power total [VA]
+  double acPowerApparentA{NO_VALUE}; ///< AC apparent power phase A [VA]
+  double acPowerApparentB{NO_VALUE}; ///< AC apparent power phase B [VA]
+  double acPowerApparentC{NO_VALUE}; ///< AC apparent power phase C [VA]
+
+  double acPowerReactive{NO_VALUE};  ///< AC reactive power total [VAr]
+  double acPowerReactiveA{NO_VALUE}; ///< AC reactive power phase A [VAr]
+  double acPowerReactiveB{NO_VALUE}; ///< AC reactive power phase B [VAr]
+  double acPowerReactiveC{NO_VALUE}; ///< AC reactive power phase C [VAr]
+
+  double acPowerFactor{NO_VALUE};  ///< AC power factor average
+  double acPowerFactorA{NO_VALUE}; ///< AC power factor phase A
+  double acPowerFactorB{NO_VALUE}; ///< AC power factor phase B
+  double acPowerFactorC{NO_VALUE}; ///< AC power factor phase C
+
+  double acEnergyActiveImport{NO_VALUE}; ///< Active energy import [Wh]
+  double acEnergyActiveExport{NO_VALUE}; ///< Active energy export [Wh]
+
+  /** @brief Apparent energy import [VAh]; SunSpec only. */
+  double acEnergyApparentImport{NO_VALUE};
+
+  /** @brief Apparent energy export [VAh]; SunSpec only. */
+  double acEnergyApparentExport{NO_VALUE};
+
+  /** @brief Reactive energy import [VArh]; proprietary map only. */
+  double acEnergyReactiveImport{NO_VALUE};
+
+  /** @brief Reactive energy export [VArh]; proprietary map only. */
+  double acEnergyReactiveExport{NO_VALUE};
+};
+
 /**
  * @class Meter
  * @brief Represents a Fronius Modbus-compatible power meter.
@@ -67,11 +147,39 @@ public:
    * @brief Fetch the complete meter register map from the device.
    *
    * Submits the necessary register-read transactions and blocks until they
-   * complete. After a successful call, all `getXxx()` accessors reflect
-   * fresh values.
+   * complete. The registers are read into a spare buffer and published in
+   * one step on success, so concurrent `getXxx()` calls and snapshots see
+   * either the previous or the new poll cycle, never a mix. A fetch started
+   * while another one of the same device is in flight waits for it.
    */
   std::expected<void, ModbusError> fetchMeterRegisters();
 
+  /**
+   * @brief Fetch the complete meter register map without blocking.
+   *
+   * Submits the same register-read transactions as `fetchMeterRegisters()`
+   * and returns immediately. `done` is invoked once every block has been
+   * refreshed, or with the first error (the device is then marked
+   * unavailable, as with the blocking fetch).
+   *
+   * @param done Callback receiving the outcome of the fetch.
+   * @note `done` normally runs on the bus thread; keep it lightweight. It
+   *       runs on the calling thread if the fetch is rejected up front.
+   */
+  void fetchAsync(FetchCallback done);
+
+  /**
+   * @brief Refresh selected meter blocks without blocking.
+   *
+   * Supports `METER` and, on the proprietary map, `METER_PHASE` and
+   * `METER_ENERGY`; see `FroniusDevice::fetchBlocksAsync()`.
+   */
+  void fetchBlocksAsync(FroniusTypes::Block blocks,
+                        FetchCallback done) override;
+
+  /** @brief `METER`, `METER_PHASE`, and `METER_ENERGY`. */
+  FroniusTypes::Block defaultBlocks() const override;
+
   // -------------------------------------------------------------------------
   // Device identity
   // -------------------------------------------------------------------------
@@ -104,6 +212,13 @@ public:
    */
   int getId() const { return id_; }
 
+  /**
+   * @brief SunSpec models found in the meter's register map.
+   *
+   * Empty until the device has been validated, and for the proprietary map.
+   */
+  const SunSpecModelTable &getModels() const { return models_; }
+
   /**
    * @brief Get the Modbus slave address reported by the device.
    *
@@ -148,8 +263,8 @@ public:
   std::expected<std::string, ModbusError> getFwVersion();
 
   // -------------------------------------------------------------------------
-  // Electrical measurements — all read from regs_ populated by
-  // fetchMeterRegisters()
+  // Electrical measurements — all read from the last register snapshot
+  // published by fetchMeterRegisters() or fetchAsync()
   // -------------------------------------------------------------------------
 
   /**
@@ -224,6 +339,51 @@ public:
   std::expected<double, ModbusError>
   getAcEnergyReactive(FroniusTypes::EnergyDirection direction) const;
 
+  // -------------------------------------------------------------------------
+  // Bulk decode
+  // -------------------------------------------------------------------------
+
+  /**
+   * @brief Decode every measurement of the last published fetch at once.
+   *
+   * Cheaper than calling the getters one by one: the register map and
+   * encoding are resolved once at validation time, and each scale factor
+   * is evaluated once per call. All values come from the same snapshot.
+   *
+   * @param sample  Struct to fill; fields the meter lacks are set to NaN.
+   * @return Empty expected, or `ENODATA` before the device is ready.
+   */
+  std::expected<void, ModbusError> decodeAll(MeterSample &sample) const;
+
+  /**
+   * @brief Report the measurements that changed since the last call.
+   *
+   * Compares the registers of the last published fetch with those seen by
+   * the previous call on `tracker` and decodes only the fields whose
+   * registers differ; fields that moved beyond their deadband are listed
+   * in `tracker.changes()`. Repeated calls on an unchanged snapshot report
+   * nothing.
+   *
+   * @param tracker  Consumer state; the first call reports every field.
+   * @return Empty expected, or `ENODATA` before the device is ready.
+   */
+  std::expected<void, ModbusError>
+  decodeChanges(SampleTracker<MeterSample> &tracker) const;
+
+  /**
+   * @brief Keep a history of every fetch the meter publishes.
+   *
+   * Each published fetch is decoded and its tracked fields are appended
+   * to `history`, on the thread that completed the fetch, before the
+   * fetch callback runs. Set it before `FroniusBus::connect()`; null
+   * detaches the history.
+   *
+   * @param history  History shared with the application, which queries it.
+   */
+  void setHistory(std::shared_ptr<SampleHistory<MeterSample>> history) {
+    history_ = std::move(history);
+  }
+
 private:
   /** @brief Shared bus this device communicates over. */
   std::shared_ptr<FroniusBus> bus_;
@@ -235,13 +395,36 @@ private:
    * unknown). */
   int id_{0};
 
+  /**
+   * @brief Decode plan of `decodeAll()`, built by `buildDecoder()`.
+   *
+   * Replaced as a whole on revalidation, so readers on other threads keep
+   * the plan they loaded.
+   */
+  std::atomic<std::shared_ptr<const SampleDecoder<MeterSample>>> decoder_;
+
+  /** @brief History fed by `onPublished()`, see `setHistory()`. */
+  std::shared_ptr<SampleHistory<MeterSample>> history_;
+
+  /** @brief Append the published fetch to `history_`, if set. */
+  void onPublished(const Snapshot &snap) override;
+
+  /** @brief Fill `sample` from `snap` with `plan`. */
+  void decode(const SampleDecoder<MeterSample> &plan, const Snapshot &snap,
+              MeterSample &sample) const;
+
+  /** @brief SunSpec model chain found by `validateDevice()`; empty for the
+   * proprietary map. */
+  SunSpecModelTable models_;
+
   /**
    * @brief Probe the device to determine its register map.
    *
-   * Tries the proprietary RTU map first; falls back to the SunSpec common
-   * block. Within SunSpec, dispatches to `detectFloatOrIntRegisters()` to
-   * pick between the M20X (integer + scale factor) and M21X (float)
-   * variants. Sets `registerMap_`, `id_`, and `useFloatRegisters_`.
+   * Tries the proprietary RTU map first; falls back to walking the SunSpec
+   * model chain with a `SunSpecDiscovery`. Within SunSpec, dispatches to
+   * `detectFloatOrIntRegisters()` to pick between the M20X (integer + scale
+   * factor) and M21X (float) variants. Sets `registerMap_`, `id_`, and
+   * `useFloatRegisters_`.
    *
    * @return The detected register map on success.
    */
@@ -250,19 +433,26 @@ private:
   /**
    * @brief Detect float vs. integer SunSpec meter model.
    *
-   * Reads the meter model ID register and matches it against the known
-   * SunSpec IDs (201–203 integer, 211–213 float). Sets `id_` and
-   * `useFloatRegisters_`.
+   * Matches the meter model ID register against the known SunSpec IDs
+   * (201–203 integer, 211–213 float). Sets `id_` and `useFloatRegisters_`.
    */
   std::expected<void, ModbusError> detectFloatOrIntRegisters();
 
   /**
-   * @brief Validate the SunSpec end-of-map block.
+   * @brief Restore the identity cached for this endpoint and slave ID.
+   *
+   * Confirms the cached register map and serial number with a single
+   * round trip and, if they still match, sets all identity members
+   * without probing. Drops a stale entry.
    *
-   * Confirms that the end-block ID is `0xFFFF` and length is `0` at the
-   * address that corresponds to the detected encoding (integer vs. float).
+   * @return The register map if the identity was restored, `nullopt` if
+   *         the device must be validated from scratch; or the bus error.
    */
-  std::expected<void, ModbusError> validateEndRegisters();
+  std::expected<std::optional<FroniusTypes::RegisterMap>, ModbusError>
+  restoreIdentity();
+
+  /** @brief Remember the validated identity in the attached cache. */
+  void storeIdentity(FroniusTypes::RegisterMap map);
 
   /**
    * @brief Read a value from the register that matches the detected map.
@@ -270,25 +460,83 @@ private:
    * Dispatches to the proprietary, SunSpec-integer, or SunSpec-float
    * variant based on `registerMap_` and `useFloatRegisters_`.
    *
-   * @param regProp  Proprietary register (INT32, swapped word order).
-   * @param sfProp   Compile-time scale factor for the proprietary register.
-   * @param regInt   SunSpec integer register.
-   * @param sfInt    SunSpec scale-factor register for `regInt`.
-   * @param regFlt   SunSpec float register.
+   * @tparam Prop    Proprietary register (INT32, swapped word order).
+   * @tparam PropSf  Compile-time scale factor for `Prop`.
+   * @tparam Int     SunSpec integer register.
+   * @tparam IntSf   SunSpec scale-factor register for `Int`.
+   * @tparam Flt     SunSpec float register.
+   */
+  template <Register Prop, double PropSf, Register Int, Register IntSf,
+            Register Flt>
+  std::expected<double, ModbusError> getRegValue() const {
+    const Snapshot snap = snapshot();
+    const RegisterBuffer &regs = snap.regs();
+
+    if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY)
+      return getModbusDouble<FixedScaledValue<Prop, PropSf>>(regs);
+    if (registerMap_ == FroniusTypes::RegisterMap::SUNSPEC)
+      return getSunSpecValue<Int, IntSf, Flt>(regs);
+    return noMapError();
+  }
+
+  /** @brief Read a SunSpec value in the detected integer or float model. */
+  template <Register Int, Register IntSf, Register Flt>
+  std::expected<double, ModbusError>
+  getSunSpecValue(const RegisterBuffer &regs) const {
+    return useFloatRegisters_ ? getModbusDouble<ScaledValue<Flt>>(regs)
+                              : getModbusDouble<ScaledValue<Int, IntSf>>(regs);
+  }
+
+  /**
+   * @brief Read a proprietary energy counter split into kilo and unit
+   *        registers, in Wh (or VArh).
    */
+  template <Register Kilo, Register Unit>
   std::expected<double, ModbusError>
-  getRegValue(const Register &regProp, double sfProp, const Register &regInt,
-              const Register &sfInt, const Register &regFlt) const;
+  getSplitEnergy(const RegisterBuffer &regs) const;
+
+  /** @brief `ENODATA` of `getRegValue()` before a map was detected. */
+  std::expected<double, ModbusError> noMapError() const;
 
   /**
    * @brief Build a Transaction targeting this device's slave ID and timeouts.
    *
    * @param startAddr  Starting Modbus register address.
-   * @param count      Number of registers to read.
-   * @param dest       Pointer into `regs_` where results are written.
+   * @param count      Number of registers to read; results are written into
+   *                   the open register update at the same addresses.
+   */
+  FroniusBus::Transaction makeTransaction(uint16_t startAddr, uint16_t count);
+
+  /**
+   * @brief Build a validation-probe transaction for a register range.
+   *
+   * Like `makeTransaction()`, but queued at `Priority::LOW` without a
+   * deadline so probing never delays regular fetches, and marked as a
+   * probe so it is still sent while the slave is parked.
+   */
+  FroniusBus::Transaction makeProbeTransaction(uint16_t startAddr,
+                                               uint16_t count);
+
+  /**
+   * @brief Build the register-read transactions of a fetch.
+   *
+   * Up to three blocks for the proprietary map, one for SunSpec, none
+   * while the register map is unknown.
+   *
+   * @param blocks  Blocks to read.
+   * @param plan    Receives the transactions.
+   * @return Number of transactions written to `plan`.
+   */
+  size_t fetchPlan(FroniusTypes::Block blocks,
+                   std::array<FroniusBus::Transaction, 3> &plan);
+
+  /**
+   * @brief Build the `decodeAll()` plan for the detected register map.
+   *
+   * @param map  Register map found by `validateDevice()`.
    */
-  FroniusBus::Transaction makeTransaction(int startAddr, int count,
-                                          uint16_t *dest);
+  std::expected<void, ModbusError>
+  buildDecoder(FroniusTypes::RegisterMap map);
 };
 
 #endif /* METER_H_ */
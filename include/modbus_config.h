@@ -21,6 +21,8 @@
 #ifndef MODBUS_CONFIG_H_
 #define MODBUS_CONFIG_H_
 
+#include "fronius_types.h"
+#include <cmath>
 #include <stdexcept>
 #include <string>
 #include <variant>
@@ -62,6 +64,34 @@ struct ModbusRtuTransport {
   char parity{'N'};
 };
 
+/**
+ * @struct ModbusReplayTransport
+ * @brief Replay of a recording made with `ModbusBusConfig::recordPath`.
+ *
+ * The bus serves its reads and writes from the recording instead of a
+ * device; see `BusReplay` for how they are matched to recorded ones.
+ */
+struct ModbusReplayTransport {
+  /** @brief Path of the recording. */
+  std::string path;
+
+  /**
+   * @brief Pace relative to the recording.
+   *
+   * 1 replays in real time, 10 ten times faster; 0 answers every read
+   * immediately.
+   */
+  double speed{0.0};
+
+  /**
+   * @brief Start the responses of a range over after the last one.
+   *
+   * Without looping the bus disconnects once a range runs out of
+   * responses and does not reconnect.
+   */
+  bool loop{true};
+};
+
 // ---------------------------------------------------------------------------
 // Bus-level config  (one per physical bus / TCP connection -> FroniusBus)
 // ---------------------------------------------------------------------------
@@ -78,8 +108,9 @@ struct ModbusRtuTransport {
  * each remote host gets its own instance. Pass to `FroniusBus`.
  */
 struct ModbusBusConfig {
-  /** @brief Transport: either a TCP connection or an RTU serial bus. */
-  std::variant<ModbusTcpTransport, ModbusRtuTransport> transport;
+  /** @brief Transport: a TCP connection, an RTU serial bus, or a replay. */
+  std::variant<ModbusTcpTransport, ModbusRtuTransport, ModbusReplayTransport>
+      transport;
 
   /** @brief Enable libmodbus debug logging for this bus. */
   bool debug{false};
@@ -95,6 +126,143 @@ struct ModbusBusConfig {
   /** @brief Use exponential backoff for reconnect if true. */
   bool exponential{true};
 
+  // --- Transaction queue ---
+
+  /**
+   * @brief Number of preallocated transaction slots (1-4096).
+   *
+   * Bounds the transactions that can be queued or awaiting retrieval at
+   * once. When every slot is in use, `submit()` waits up to `poolWaitMs`
+   * for one to be freed.
+   */
+  int queueCapacity{64};
+
+  /**
+   * @brief Longest wait of `submit()` for a free slot, in ms (0-600000).
+   *
+   * `submit()` fails with `ENOBUFS` once it has waited this long, and
+   * without waiting when 0, when called from a bus thread (e.g. in a
+   * completion callback), or through `trySubmit()`.
+   */
+  int poolWaitMs{5000};
+
+  /**
+   * @brief Merge queued reads of the same slave into one request.
+   *
+   * Transactions whose register ranges overlap, touch, or are separated by
+   * at most `coalesceGap` registers are read with a single
+   * `modbus_read_registers()` call of up to 125 registers.
+   */
+  bool coalesce{true};
+
+  /**
+   * @brief Largest register gap bridged when coalescing reads (0-123).
+   *
+   * Bridged registers are read and discarded. If a slave rejects a merged
+   * range with an illegal-address or illegal-value exception, the bus
+   * falls back to the individual reads and stops merging that range.
+   */
+  int coalesceGap{16};
+
+  /**
+   * @brief Serve queued reads of the current slave first (RTU only).
+   *
+   * Reduces slave switches when several devices poll at once. A read of
+   * another slave is overtaken at most a few times in a row, so no slave
+   * starves.
+   */
+  bool groupBySlave{true};
+
+  // --- TCP pipelining and pooling ---
+
+  /**
+   * @brief Requests kept in flight at once on a TCP bus (1-16).
+   *
+   * Above 1, queued reads are sent back to back without waiting for the
+   * previous response, and the responses are matched to their requests by
+   * MBAP transaction identifier, saving a round trip per read on slow
+   * links. Each request still times out after its device's response
+   * timeout. Only for servers that accept several outstanding requests.
+   *
+   * Pipelined buses run on the `BusEventLoop` transport: a bus constructed
+   * without a loop creates a private one on `connect()`, and `debug` has
+   * no effect.
+   */
+  int pipelineDepth{1};
+
+  /**
+   * @brief TCP connections kept open to the endpoint (1-8).
+   *
+   * Above 1, queued reads are spread over the connections, so that
+   * devices behind one gateway, such as several inverters and meters
+   * reached through a Fronius Datamanager, are read in parallel. A slave
+   * with reads in flight on one connection is served only by that
+   * connection until they complete, which keeps the reads of each slave
+   * in order. Each connection holds up to `pipelineDepth` requests.
+   *
+   * The bus counts as connected while any connection is up. Every
+   * connection reconnects with the backoff above; while all are down only
+   * the first one retries, so callbacks fire as for a single connection.
+   * Uses the `BusEventLoop` transport like `pipelineDepth`.
+   */
+  int connections{1};
+
+  // --- RTU slave switching ---
+
+  /**
+   * @brief Settle delay before addressing a different slave, in ms (0-5000).
+   *
+   * Some Fronius devices need a pause after another slave has answered
+   * before they reliably respond. With `adaptiveSwitchDelay` this is the
+   * upper bound of the learned delay.
+   */
+  int slaveSwitchDelayMs{500};
+
+  /**
+   * @brief Learn the shortest safe slave-switch delay per slave pair.
+   *
+   * Each pair starts at the Modbus 3.5-character inter-frame time for the
+   * configured baud rate (1.75 ms above 19200 baud) and doubles its delay,
+   * up to `slaveSwitchDelayMs`, whenever a read right after switching to
+   * that slave times out.
+   */
+  bool adaptiveSwitchDelay{false};
+
+  // --- Diagnostics ---
+
+  /**
+   * @brief Capacity of the binary trace ring in events (0-65536).
+   *
+   * When non-zero the bus thread records a `BusTraceEvent` for every wire
+   * read, slave switch, coalesced read, and dropped transaction, to be
+   * collected with `FroniusBus::drainTrace()`. Rounded up to a power of
+   * two. 0 disables tracing.
+   */
+  int traceCapacity{0};
+
+  /**
+   * @brief Recording every wire read, write, and read-modify-write is
+   *        appended to; empty disables.
+   *
+   * Each access is stored with its slave, range, the registers read or
+   * written or the error, and timing, for replay with a
+   * `ModbusReplayTransport`. An existing
+   * recording is continued. Not available on a replay bus.
+   */
+  std::string recordPath;
+
+  /**
+   * @brief Hold-off for repeated identical read errors in ms (0-3600000).
+   *
+   * After a read error is reported to the bus error callbacks, errors with
+   * the same code, slave, and register range are held back for this long;
+   * the next one reported after it carries the number held back in
+   * `ModbusErrorEvent::repeats`. Only transient errors are held back;
+   * fatal and shutdown errors are always reported. Metrics still count
+   * every error. 0 reports every error.
+   */
+  int errorHoldoffMs{0};
+
   // --- Convenience accessors ---
 
   /** @brief Returns true when the active transport is TCP. */
@@ -107,6 +275,11 @@ struct ModbusBusConfig {
     return std::holds_alternative<ModbusRtuTransport>(transport);
   }
 
+  /** @brief Returns true when the bus replays a recording. */
+  [[nodiscard]] bool isReplay() const noexcept {
+    return std::holds_alternative<ModbusReplayTransport>(transport);
+  }
+
   /**
    * @brief Access the TCP transport parameters.
    * @throws std::bad_variant_access if the active transport is not TCP.
@@ -123,6 +296,14 @@ struct ModbusBusConfig {
     return std::get<ModbusRtuTransport>(transport);
   }
 
+  /**
+   * @brief Access the replay transport parameters.
+   * @throws std::bad_variant_access if the active transport is not replay.
+   */
+  [[nodiscard]] const ModbusReplayTransport &replay() const {
+    return std::get<ModbusReplayTransport>(transport);
+  }
+
   /**
    * @brief Validate bus configuration parameters.
    * @throws std::invalid_argument if any parameter is out of allowed range.
@@ -148,12 +329,45 @@ struct ModbusBusConfig {
         throw std::invalid_argument("TCP port must be in range 1-65535");
     }
 
+    if (isReplay()) {
+      const auto &r = replay();
+
+      if (r.path.empty())
+        throw std::invalid_argument("Replay path must not be empty");
+      if (!std::isfinite(r.speed) || r.speed < 0.0)
+        throw std::invalid_argument("Replay speed must be 0 or positive");
+      if (!recordPath.empty())
+        throw std::invalid_argument("recordPath cannot be used with replay");
+    }
+
     if (reconnectDelay <= 0 || reconnectDelayMax <= 0)
       throw std::invalid_argument(
           "reconnectDelay and reconnectDelayMax must be positive");
     if (reconnectDelay >= reconnectDelayMax)
       throw std::invalid_argument(
           "reconnectDelay must be less than reconnectDelayMax");
+    if (queueCapacity < 1 || queueCapacity > 4096)
+      throw std::invalid_argument("queueCapacity must be in range 1-4096");
+    if (poolWaitMs < 0 || poolWaitMs > 600000)
+      throw std::invalid_argument("poolWaitMs must be in range 0-600000");
+    if (coalesceGap < 0 || coalesceGap > 123)
+      throw std::invalid_argument("coalesceGap must be in range 0-123");
+    if (pipelineDepth < 1 || pipelineDepth > 16)
+      throw std::invalid_argument("pipelineDepth must be in range 1-16");
+    if (pipelineDepth > 1 && !isTcp())
+      throw std::invalid_argument("pipelineDepth above 1 requires TCP");
+    if (connections < 1 || connections > 8)
+      throw std::invalid_argument("connections must be in range 1-8");
+    if (connections > 1 && !isTcp())
+      throw std::invalid_argument("connections above 1 requires TCP");
+    if (slaveSwitchDelayMs < 0 || slaveSwitchDelayMs > 5000)
+      throw std::invalid_argument(
+          "slaveSwitchDelayMs must be in range 0-5000");
+    if (traceCapacity < 0 || traceCapacity > 65536)
+      throw std::invalid_argument("traceCapacity must be in range 0-65536");
+    if (errorHoldoffMs < 0 || errorHoldoffMs > 3600000)
+      throw std::invalid_argument(
+          "errorHoldoffMs must be in range 0-3600000");
   }
 };
 
@@ -196,6 +410,68 @@ struct ModbusDeviceConfig {
   /** @brief Use exponential backoff for reconnect if true. */
   bool exponential{true};
 
+  // --- Scheduling ---
+
+  /**
+   * @brief Queue priority of this device's register fetches.
+   *
+   * Use `HIGH` for devices driving a control loop (e.g. zero-export power
+   * limiting) so their reads overtake other devices' polling. Validation
+   * probes always run at `LOW`.
+   */
+  FroniusTypes::Priority priority{FroniusTypes::Priority::NORMAL};
+
+  /**
+   * @brief Deadline for register fetches in ms after submission (0-60000).
+   *
+   * A fetch still queued when its deadline passes is dropped with
+   * `ETIMEDOUT` instead of being sent, so the bus does not spend time on
+   * stale reads. Among equal-priority reads the earliest deadline is served
+   * first. 0 disables the deadline.
+   */
+  int deadlineMs{0};
+
+  /**
+   * @brief Hold-off for repeated identical device errors in ms (0-3600000).
+   *
+   * After an error is reported to the device error callback, errors with
+   * the same code and register range are held back for this long; the
+   * next one reported has " (repeated N times)" appended to its message.
+   * Only transient errors are held back. Note that a callback calling
+   * `scheduleDeviceRetry` is not called for held-back errors either. 0
+   * reports every error.
+   */
+  int errorHoldoffMs{0};
+
+  // --- Adaptive timeout and circuit breaker ---
+
+  /**
+   * @brief Derive the response timeout from the observed latency.
+   *
+   * The bus applies the 99th percentile of the device's recent answer
+   * times, multiplied by `timeoutMargin` and at least `minTimeoutMs`, so a
+   * slave that stopped answering costs less than the full timeout. The
+   * configured `secTimeout`/`usecTimeout` remain the upper bound and apply
+   * until enough answers were seen. A timeout doubles the derived value.
+   */
+  bool adaptiveTimeout{false};
+
+  /** @brief Factor on the latency percentile (1.0-100.0). */
+  double timeoutMargin{3.0};
+
+  /** @brief Lowest derived timeout in ms (1-60000). */
+  int minTimeoutMs{20};
+
+  /**
+   * @brief Consecutive timeouts that park the device (0-1000).
+   *
+   * A parked device's reads fail with `EHOSTDOWN` without being sent. The
+   * bus marks the device unavailable and schedules its revalidation with
+   * `scheduleDeviceRetry`; the first answered read lifts it. 0 never parks
+   * the device.
+   */
+  int breakerThreshold{0};
+
   /**
    * @brief Validate device configuration parameters.
    * @throws std::invalid_argument if any parameter is out of allowed range.
@@ -215,6 +491,18 @@ struct ModbusDeviceConfig {
     if (reconnectDelay >= reconnectDelayMax)
       throw std::invalid_argument(
           "reconnectDelay must be less than reconnectDelayMax");
+    if (deadlineMs < 0 || deadlineMs > 60000)
+      throw std::invalid_argument("deadlineMs must be in range 0-60000");
+    if (errorHoldoffMs < 0 || errorHoldoffMs > 3600000)
+      throw std::invalid_argument(
+          "errorHoldoffMs must be in range 0-3600000");
+    if (!std::isfinite(timeoutMargin) || timeoutMargin < 1.0 ||
+        timeoutMargin > 100.0)
+      throw std::invalid_argument("timeoutMargin must be in range 1-100");
+    if (minTimeoutMs < 1 || minTimeoutMs > 60000)
+      throw std::invalid_argument("minTimeoutMs must be in range 1-60000");
+    if (breakerThreshold < 0 || breakerThreshold > 1000)
+      throw std::invalid_argument("breakerThreshold must be in range 0-1000");
   }
 };
 
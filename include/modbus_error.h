@@ -7,12 +7,17 @@
  * formatted context message, and a severity (`TRANSIENT`, `FATAL`, or
  * `SHUTDOWN`). Factory methods build instances from `errno` or from a
  * caller-supplied code, with `std::format`-based message templates.
+ *
+ * `ModbusErrorEvent` is the compact form of a failed read: a few integers
+ * and a static context string, with the message only formatted when asked
+ * for. Error callbacks fed by it stay cheap when many devices fail at once.
  */
 
 #ifndef MODBUS_ERROR_H_
 #define MODBUS_ERROR_H_
 
 #include <cerrno>
+#include <cstdint>
 #include <expected>
 #include <format>
 #include <modbus/modbus.h>
@@ -125,6 +130,8 @@ public:
   }
 
 private:
+  friend struct ModbusErrorEvent;
+
   /**
    * @brief Map an error code to a `Severity`.
    *
@@ -170,4 +177,76 @@ private:
   }
 };
 
+/**
+ * @struct ModbusErrorEvent
+ * @brief Compact, allocation-free description of a failed operation.
+ *
+ * Carries what identifies an error — code, severity, and the slave and
+ * register range involved — instead of a formatted message. `message()`
+ * and `toError()` format on demand. Trivially copyable.
+ */
+struct ModbusErrorEvent {
+  /** @brief Modbus or system error code (as set in `errno`). */
+  int code{0};
+
+  /** @brief Classified severity, as `ModbusError` would deduce it. */
+  ModbusError::Severity severity{ModbusError::Severity::TRANSIENT};
+
+  /** @brief Slave addressed; 0 for a connection-wide error. */
+  int slaveId{0};
+
+  /** @brief First register of the failed read; 0 if none. */
+  int startAddr{0};
+
+  /** @brief Number of registers of the failed read; 0 if none. */
+  int count{0};
+
+  /**
+   * @brief Identical errors suppressed since the previous delivery.
+   *
+   * Set by a `ModbusErrorLimiter`; 0 for an error reported as it
+   * happened.
+   */
+  uint32_t repeats{0};
+
+  /** @brief Failed operation; must be a string literal. */
+  const char *where{""};
+
+  /**
+   * @brief Describe an error of `code`.
+   *
+   * @param code       Error code.
+   * @param where      Failed operation, a string literal.
+   * @param slaveId    Slave addressed, or 0.
+   * @param startAddr  First register, or 0.
+   * @param count      Number of registers, or 0.
+   */
+  static ModbusErrorEvent of(int code, const char *where, int slaveId = 0,
+                             int startAddr = 0, int count = 0) {
+    return {code,    ModbusError::deduceSeverity(code),
+            slaveId, startAddr,
+            count,   0,
+            where};
+  }
+
+  /**
+   * @brief Format the error as `"<where>: <text> [slave=…, addr=…, count=…]"`.
+   *
+   * `<text>` comes from `modbus_strerror(code)`; the range is left out for
+   * connection-wide errors, the repeat count when there were none.
+   */
+  std::string message() const {
+    std::string msg = std::format("{}: {}", where, modbus_strerror(code));
+    if (slaveId != 0)
+      msg += std::format(" [slave={}, addr={}, count={}]", slaveId, startAddr,
+                         count);
+    if (repeats != 0)
+      msg += std::format(" (repeated {} times)", repeats);
+    return msg;
+  }
+
+  /** @brief Expand into a full `ModbusError`. */
+  ModbusError toError() const { return {code, message(), severity}; }
+};
+
 #endif /* MODBUS_ERROR_H_ */
\ No newline at end of file
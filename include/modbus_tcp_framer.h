@@ -0,0 +1,245 @@
+/**
+ * @file modbus_tcp_framer.h
+ * @brief Minimal Modbus TCP (MBAP) framing for the event-loop transport.
+ *
+ * @details
+ * `BusEventLoop` drives TCP buses over non-blocking sockets instead of
+ * libmodbus, so it frames requests and parses responses itself; the
+ * device simulator splits its request stream with the same code. Only the
+ * functions the library needs are supported: read holding registers
+ * (0x03), write multiple registers (0x10), and their exception responses.
+ * Everything here is allocation-free and works on caller-provided buffers.
+ */
+
+#ifndef MODBUS_TCP_FRAMER_H_
+#define MODBUS_TCP_FRAMER_H_
+
+#include "modbus_error.h"
+#include <array>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <modbus/modbus.h>
+#include <span>
+
+/**
+ * @namespace ModbusTcpFramer
+ * @brief Build requests and split a byte stream into responses.
+ */
+namespace ModbusTcpFramer {
+
+/** @brief Size of the MBAP header: transaction, protocol, length, unit. */
+constexpr size_t MBAP_SIZE = 7;
+
+/** @brief Size of a read holding registers request ADU. */
+constexpr size_t REQUEST_SIZE = 12;
+
+/** @brief Largest Modbus TCP ADU (MBAP header plus 253-byte PDU). */
+constexpr size_t MAX_ADU_SIZE = 260;
+
+/** @brief Size of a write multiple registers request ADU without data. */
+constexpr size_t WRITE_HEADER_SIZE = 13;
+
+/** @brief Largest request ADU, a write of `MODBUS_MAX_WRITE_REGISTERS`. */
+constexpr size_t MAX_REQUEST_SIZE =
+    WRITE_HEADER_SIZE + 2 * MODBUS_MAX_WRITE_REGISTERS;
+
+/** @brief Function code of read holding registers. */
+constexpr uint8_t READ_HOLDING_REGISTERS = 0x03;
+
+/** @brief Function code of write multiple registers. */
+constexpr uint8_t WRITE_MULTIPLE_REGISTERS = 0x10;
+
+/** @brief Bit set in the function code of an exception response. */
+constexpr uint8_t EXCEPTION_BIT = 0x80;
+
+/**
+ * @struct Response
+ * @brief One parsed response ADU; `data` points into the parsed buffer.
+ */
+struct Response {
+  /** @brief Transaction identifier echoed from the request. */
+  uint16_t tid{0};
+
+  /** @brief Unit identifier (slave ID) echoed from the request. */
+  uint8_t unit{0};
+
+  /** @brief Function code without the exception bit. */
+  uint8_t function{0};
+
+  /** @brief Exception code, or 0 for a normal response. */
+  uint8_t exception{0};
+
+  /**
+   * @brief Register payload, big-endian, two bytes per register.
+   *
+   * For a write: the echoed start address and register count.
+   */
+  std::span<const uint8_t> data;
+};
+
+/**
+ * @brief Encode a read holding registers request.
+ *
+ * @param tid    Transaction identifier matched against the response.
+ * @param unit   Unit identifier (slave ID).
+ * @param addr   First register address.
+ * @param count  Number of registers (1-125).
+ */
+inline std::array<uint8_t, REQUEST_SIZE>
+readRequest(uint16_t tid, uint8_t unit, uint16_t addr, uint16_t count) {
+  return {static_cast<uint8_t>(tid >> 8),
+          static_cast<uint8_t>(tid & 0xFF),
+          0x00, // protocol identifier
+          0x00,
+          0x00, // length of unit identifier and PDU
+          0x06,
+          unit,
+          READ_HOLDING_REGISTERS,
+          static_cast<uint8_t>(addr >> 8),
+          static_cast<uint8_t>(addr & 0xFF),
+          static_cast<uint8_t>(count >> 8),
+          static_cast<uint8_t>(count & 0xFF)};
+}
+
+/**
+ * @brief Encode a write multiple registers request.
+ *
+ * @param out    Receives the request; at least `WRITE_HEADER_SIZE` plus
+ *               two bytes per register.
+ * @param tid    Transaction identifier matched against the response.
+ * @param unit   Unit identifier (slave ID).
+ * @param addr   First register address.
+ * @param count  Number of registers (1-123).
+ * @param src    The `count` registers to write.
+ * @return Size of the request written to `out`.
+ */
+inline size_t writeRequest(std::span<uint8_t> out, uint16_t tid, uint8_t unit,
+                           uint16_t addr, uint16_t count,
+                           const uint16_t *src) {
+  const size_t bytes = 2 * static_cast<size_t>(count);
+  const size_t length = 7 + bytes; // unit identifier and PDU
+
+  out[0] = static_cast<uint8_t>(tid >> 8);
+  out[1] = static_cast<uint8_t>(tid & 0xFF);
+  out[2] = 0x00; // protocol identifier
+  out[3] = 0x00;
+  out[4] = static_cast<uint8_t>(length >> 8);
+  out[5] = static_cast<uint8_t>(length & 0xFF);
+  out[6] = unit;
+  out[7] = WRITE_MULTIPLE_REGISTERS;
+  out[8] = static_cast<uint8_t>(addr >> 8);
+  out[9] = static_cast<uint8_t>(addr & 0xFF);
+  out[10] = static_cast<uint8_t>(count >> 8);
+  out[11] = static_cast<uint8_t>(count & 0xFF);
+  out[12] = static_cast<uint8_t>(bytes);
+  for (size_t i = 0; i < count; ++i) {
+    out[WRITE_HEADER_SIZE + 2 * i] = static_cast<uint8_t>(src[i] >> 8);
+    out[WRITE_HEADER_SIZE + 2 * i + 1] = static_cast<uint8_t>(src[i] & 0xFF);
+  }
+  return WRITE_HEADER_SIZE + bytes;
+}
+
+/**
+ * @brief Size of the ADU at the start of `in`, from its MBAP header.
+ *
+ * Checks only the header, so it splits request and response streams
+ * alike.
+ *
+ * @param in  Received bytes, starting on a frame boundary.
+ * @return Size of the ADU, 0 if `in` does not hold all of it yet, or
+ *         `EMBBADDATA` if the header is not valid Modbus TCP — the frame
+ *         boundaries are lost and the connection must be dropped.
+ */
+inline std::expected<size_t, ModbusError>
+frameSize(std::span<const uint8_t> in) {
+  if (in.size() < MBAP_SIZE + 1)
+    return 0;
+
+  const uint16_t protocol = static_cast<uint16_t>((in[2] << 8) | in[3]);
+  const uint16_t length = static_cast<uint16_t>((in[4] << 8) | in[5]);
+  if (protocol != 0 || length < 2 || length > MAX_ADU_SIZE - MBAP_SIZE + 1)
+    return std::unexpected(ModbusError::custom(
+        EMBBADDATA, "frameSize(): Invalid MBAP header [protocol={}, length={}]",
+        protocol, length));
+
+  const size_t size = MBAP_SIZE - 1 + length;
+  return in.size() < size ? 0 : size;
+}
+
+/**
+ * @brief Parse the first response ADU at the start of `in`.
+ *
+ * @param in   Received bytes, starting on a frame boundary.
+ * @param out  Filled in when a complete frame was parsed.
+ * @return Bytes consumed by the frame, 0 if `in` holds no complete frame
+ *         yet, or `EMBBADDATA` if the stream is not valid Modbus TCP — the
+ *         frame boundaries are lost and the connection must be dropped.
+ */
+inline std::expected<size_t, ModbusError>
+parse(std::span<const uint8_t> in, Response &out) {
+  auto framed = frameSize(in);
+  if (!framed || *framed == 0)
+    return framed;
+
+  const size_t size = *framed;
+  const uint16_t length = static_cast<uint16_t>(size - MBAP_SIZE + 1);
+
+  out.tid = static_cast<uint16_t>((in[0] << 8) | in[1]);
+  out.unit = in[6];
+  out.function = in[7] & ~EXCEPTION_BIT;
+  out.exception = 0;
+  out.data = {};
+
+  if (in[7] & EXCEPTION_BIT) {
+    if (length != 3)
+      return std::unexpected(ModbusError::custom(
+          EMBBADDATA, "parse(): Invalid exception response length {}",
+          length));
+    out.exception = in[8];
+    return size;
+  }
+
+  if (out.function == WRITE_MULTIPLE_REGISTERS) {
+    if (length != 6)
+      return std::unexpected(ModbusError::custom(
+          EMBBADDATA, "parse(): Invalid write response length {}", length));
+    out.data = in.subspan(MBAP_SIZE + 1, 4);
+    return size;
+  }
+
+  if (out.function != READ_HOLDING_REGISTERS)
+    return std::unexpected(ModbusError::custom(
+        EMBBADDATA, "parse(): Unexpected function code 0x{:02X}",
+        out.function));
+
+  // A read response carries at least its byte count after the function
+  if (length < 3)
+    return std::unexpected(ModbusError::custom(
+        EMBBADDATA, "parse(): Invalid read response length {}", length));
+
+  const uint8_t byteCount = in[8];
+  if (length != 3 + byteCount || byteCount % 2 != 0)
+    return std::unexpected(ModbusError::custom(
+        EMBBADDATA, "parse(): Invalid byte count {} for length {}", byteCount,
+        length));
+
+  out.data = in.subspan(MBAP_SIZE + 2, byteCount);
+  return size;
+}
+
+/**
+ * @brief Convert a big-endian register payload to host registers.
+ *
+ * @param data  Payload of a `Response`.
+ * @param dest  Receives `data.size() / 2` registers.
+ */
+inline void decodeRegisters(std::span<const uint8_t> data, uint16_t *dest) {
+  for (size_t i = 0; i + 1 < data.size(); i += 2)
+    dest[i / 2] = static_cast<uint16_t>((data[i] << 8) | data[i + 1]);
+}
+
+} // namespace ModbusTcpFramer
+
+#endif /* MODBUS_TCP_FRAMER_H_ */
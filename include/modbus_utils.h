@@ -4,9 +4,13 @@
  *
  * @details
  * Free functions that read 32- and 64-bit integers from register arrays
- * (with optional word/byte swap), produce hex strings, retrieve TCP peer
- * info, and pack typed or scaled-floating-point values into a
- * `modbus_mapping_t` (server-side write helpers).
+ * (with optional word/byte swap), decode whole blocks of 32-bit values in
+ * one pass, produce hex strings, retrieve TCP peer info, and pack typed or
+ * scaled-floating-point values into a `modbus_mapping_t` (server-side
+ * write helpers).
+ *
+ * The block decoders use SSE2 on x86-64 and NEON on ARM, both part of the
+ * baseline instruction set there, and a scalar loop elsewhere.
  */
 
 #ifndef MODBUS_UTILS_H_
@@ -14,13 +18,23 @@
 
 #include "fronius_types.h"
 #include "modbus_error.h"
+#include <algorithm>
 #include <arpa/inet.h>
+#include <bit>
 #include <cmath>
+#include <cstddef>
 #include <cstdint>
 #include <cstring>
 #include <modbus/modbus.h>
 #include <netinet/in.h>
 #include <string>
+#include <utility>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
 
 /**
  * @namespace detail
@@ -139,6 +153,130 @@ inline int64_t modbus_get_int64(const uint16_t *regs, bool word_swap = false,
   return static_cast<int64_t>(modbus_get_uint64(regs, word_swap, byte_swap));
 }
 
+// --- decode blocks of 32-bit values ---
+
+/**
+ * @brief Decode `count` consecutive 32-bit unsigned integers.
+ *
+ * Same result as `modbus_get_uint32(regs + 2 * i, word_swap)` for every
+ * `i`, four values per vector instruction.
+ *
+ * @param regs       Pointer to `2 * count` 16-bit Modbus registers
+ * @param count      Number of values to decode
+ * @param dst        Output array of `count` values
+ * @param word_swap  True for little-endian word order
+ */
+inline void modbus_get_uint32_block(const uint16_t *regs, size_t count,
+                                    uint32_t *dst, bool word_swap = false) {
+  size_t i = 0;
+
+  // On a little-endian host a register pair loads as the word-swapped
+  // value, so big-endian word order only exchanges the halves of a lane
+  if constexpr (std::endian::native == std::endian::little) {
+#if defined(__SSE2__)
+    for (; i + 4 <= count; i += 4) {
+      __m128i v =
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(regs + 2 * i));
+      if (!word_swap)
+        v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16));
+      _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), v);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+      uint16x8_t v = vld1q_u16(regs + 2 * i);
+      if (!word_swap)
+        v = vrev32q_u16(v);
+      vst1q_u32(dst + i, vreinterpretq_u32_u16(v));
+    }
+#endif
+  }
+
+  for (; i < count; ++i)
+    dst[i] = modbus_get_uint32(regs + 2 * i, word_swap);
+}
+
+/**
+ * @brief Decode `count` consecutive 32-bit signed integers.
+ *
+ * Same result as `modbus_get_int32(regs + 2 * i, word_swap)` for every `i`.
+ *
+ * @param regs       Pointer to `2 * count` 16-bit Modbus registers
+ * @param count      Number of values to decode
+ * @param dst        Output array of `count` values
+ * @param word_swap  True for little-endian word order (proprietary map)
+ */
+inline void modbus_get_int32_block(const uint16_t *regs, size_t count,
+                                   int32_t *dst, bool word_swap = false) {
+  modbus_get_uint32_block(regs, count, reinterpret_cast<uint32_t *>(dst),
+                          word_swap);
+}
+
+/**
+ * @brief Decode `count` consecutive IEEE 754 floats in ABCD byte order.
+ *
+ * Same result as `modbus_get_float_abcd(regs + 2 * i)` for every `i`.
+ *
+ * @param regs   Pointer to `2 * count` 16-bit Modbus registers
+ * @param count  Number of values to decode
+ * @param dst    Output array of `count` values
+ */
+inline void modbus_get_float_abcd_block(const uint16_t *regs, size_t count,
+                                        float *dst) {
+  static_assert(sizeof(float) == sizeof(uint32_t));
+
+  // Decode the bit patterns in chunks and copy them over, which keeps the
+  // type punning well-defined
+  constexpr size_t CHUNK = 32;
+  uint32_t bits[CHUNK];
+  for (size_t i = 0; i < count; i += CHUNK) {
+    const size_t n = std::min(CHUNK, count - i);
+    modbus_get_uint32_block(regs + 2 * i, n, bits);
+    std::memcpy(dst + i, bits, n * sizeof(float));
+  }
+}
+
+/**
+ * @brief Decode `count` consecutive 32-bit signed integers, scaled.
+ *
+ * @param regs       Pointer to `2 * count` 16-bit Modbus registers
+ * @param count      Number of values to decode
+ * @param dst        Output array of `count` values
+ * @param scale      Multiplier applied to every value
+ * @param word_swap  True for little-endian word order (proprietary map)
+ */
+inline void modbus_get_int32_block(const uint16_t *regs, size_t count,
+                                   double *dst, double scale = 1.0,
+                                   bool word_swap = false) {
+  constexpr size_t CHUNK = 32;
+  int32_t values[CHUNK];
+  for (size_t i = 0; i < count; i += CHUNK) {
+    const size_t n = std::min(CHUNK, count - i);
+    modbus_get_int32_block(regs + 2 * i, n, values, word_swap);
+    for (size_t k = 0; k < n; ++k)
+      dst[i + k] = values[k] * scale;
+  }
+}
+
+/**
+ * @brief Decode `count` consecutive ABCD floats, widened and scaled.
+ *
+ * @param regs   Pointer to `2 * count` 16-bit Modbus registers
+ * @param count  Number of values to decode
+ * @param dst    Output array of `count` values
+ * @param scale  Multiplier applied to every value
+ */
+inline void modbus_get_float_abcd_block(const uint16_t *regs, size_t count,
+                                        double *dst, double scale = 1.0) {
+  constexpr size_t CHUNK = 32;
+  float values[CHUNK];
+  for (size_t i = 0; i < count; i += CHUNK) {
+    const size_t n = std::min(CHUNK, count - i);
+    modbus_get_float_abcd_block(regs + 2 * i, n, values);
+    for (size_t k = 0; k < n; ++k)
+      dst[i + k] = values[k] * scale;
+  }
+}
+
 /**
  * @brief Convert a 16-bit value to a hexadecimal string.
  * @param val 16-bit value
@@ -199,6 +337,7 @@ inline FroniusTypes::RemoteEndpoint getSocketInfo(int socket) {
  * | INT16    | integral         | cast to `int16_t`, 1 register              |
  * | UINT16   | integral         | 1 register                                 |
  * | UINT32   | integral         | big-endian word order, 2 registers         |
+ * | INT32    | integral         | little-endian word order, 2 registers      |
  * | UINT64   | integral         | big-endian word order, 4 registers         |
  * | FLOAT    | floating-point   | IEEE 754 ABCD byte order, 2 registers      |
  * | STRING   | `std::string`    | ASCII, hi-byte first, zero-padded to NB    |
@@ -240,6 +379,15 @@ std::expected<void, ModbusError> packToModbus(modbus_mapping_t *dest,
     if constexpr (std::is_integral_v<T>)
       detail::packInteger<uint32_t>(&dest->tab_registers[reg.ADDR], value);
     break;
+  case Register::Type::INT32:
+    // Only the proprietary meter map uses INT32, with swapped words
+    if constexpr (std::is_integral_v<T>) {
+      detail::packInteger<uint32_t>(&dest->tab_registers[reg.ADDR],
+                                    static_cast<uint32_t>(value));
+      std::swap(dest->tab_registers[reg.ADDR],
+                dest->tab_registers[reg.ADDR + 1]);
+    }
+    break;
   case Register::Type::UINT64:
     if constexpr (std::is_integral_v<T>)
       detail::packInteger<uint64_t>(&dest->tab_registers[reg.ADDR], value);
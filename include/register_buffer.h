@@ -0,0 +1,172 @@
+/**
+ * @file register_buffer.h
+ * @brief Compact, segmented storage for Modbus holding registers.
+ *
+ * @details
+ * `RegisterBuffer` stores only the register ranges a device actually reads
+ * instead of mirroring the full 16-bit Modbus address space. The ranges are
+ * declared once from the device's register map layout and packed into one
+ * contiguous word array, so a device needs a few hundred words instead of
+ * 64K and its hot blocks stay within a handful of cache lines.
+ *
+ * Address lookups resolve to a segment with a short linear scan — devices
+ * declare only a few segments, which is faster than any indexed structure
+ * at that size.
+ */
+
+#ifndef REGISTER_BUFFER_H_
+#define REGISTER_BUFFER_H_
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+/**
+ * @class RegisterBuffer
+ * @brief Sparse register store covering a fixed set of address ranges.
+ *
+ * Every register inside a declared segment is pre-zeroed and addressable
+ * through `data()` or `operator[]`. Addresses outside all segments are not
+ * stored: `data()` returns `nullptr` and `operator[]` reads as zero.
+ */
+class RegisterBuffer {
+public:
+  /**
+   * @struct Segment
+   * @brief One contiguous register range of a device layout.
+   */
+  struct Segment {
+    /** @brief First Modbus register address of the range. */
+    uint16_t addr{0};
+
+    /** @brief Number of consecutive 16-bit registers in the range. */
+    uint16_t count{0};
+  };
+
+  /** @brief Construct an empty buffer that stores no registers. */
+  RegisterBuffer() = default;
+
+  /**
+   * @brief Construct a buffer covering the given register ranges.
+   *
+   * Segments may be passed in any order; overlapping and adjacent ranges
+   * are merged. Empty segments are ignored.
+   *
+   * @param layout Register ranges to store.
+   */
+  RegisterBuffer(std::initializer_list<Segment> layout) {
+    std::vector<Slot> ranges;
+    ranges.reserve(layout.size());
+    for (const auto &seg : layout)
+      if (seg.count > 0)
+        ranges.push_back(
+            {seg.addr, static_cast<uint32_t>(seg.addr) + seg.count, 0});
+
+    std::sort(ranges.begin(), ranges.end(),
+              [](const Slot &a, const Slot &b) { return a.first < b.first; });
+
+    uint32_t offset = 0;
+    for (const auto &r : ranges) {
+      if (!slots_.empty() && r.first <= slots_.back().last) {
+        Slot &prev = slots_.back();
+        if (r.last > prev.last) {
+          offset += r.last - prev.last;
+          prev.last = r.last;
+        }
+        continue;
+      }
+      slots_.push_back({r.first, r.last, offset});
+      offset += r.last - r.first;
+    }
+
+    words_.assign(offset, 0);
+  }
+
+  /**
+   * @brief Pointer to `count` consecutive registers starting at `addr`.
+   *
+   * @return Pointer into the buffer, or `nullptr` if the range is not
+   *         fully contained in one stored segment.
+   */
+  uint16_t *data(uint16_t addr, uint16_t count = 1) {
+    const Slot *s = find(addr, count);
+    return s ? words_.data() + s->offset + (addr - s->first) : nullptr;
+  }
+
+  /** @copydoc data(uint16_t, uint16_t) */
+  const uint16_t *data(uint16_t addr, uint16_t count = 1) const {
+    const Slot *s = find(addr, count);
+    return s ? words_.data() + s->offset + (addr - s->first) : nullptr;
+  }
+
+  /**
+   * @brief Returns true if `count` registers starting at `addr` are stored.
+   */
+  bool contains(uint16_t addr, uint16_t count = 1) const {
+    return find(addr, count) != nullptr;
+  }
+
+  /**
+   * @brief Read one register.
+   *
+   * Unstored addresses read as zero, matching the pre-zeroed contents of
+   * registers that have not been fetched yet.
+   */
+  uint16_t operator[](uint16_t addr) const {
+    const uint16_t *p = data(addr);
+    return p ? *p : 0;
+  }
+
+  /**
+   * @brief Position of `addr` in the packed word array.
+   *
+   * Buffers built from the same layout share their positions, so an offset
+   * resolved once can index `words()` of any of them.
+   *
+   * @return Offset of `addr`, or -1 if `[addr, addr + count)` is not fully
+   *         contained in one stored segment.
+   */
+  int offsetOf(uint16_t addr, uint16_t count = 1) const {
+    const Slot *s = find(addr, count);
+    return s ? static_cast<int>(s->offset + (addr - s->first)) : -1;
+  }
+
+  /** @brief Packed register contents of all segments; see `offsetOf()`. */
+  const uint16_t *words() const { return words_.data(); }
+
+  /** @brief Total number of registers stored across all segments. */
+  size_t size() const { return words_.size(); }
+
+  /** @brief Reset every stored register to zero. */
+  void clear() { std::fill(words_.begin(), words_.end(), 0); }
+
+private:
+  /**
+   * @brief Resolved segment: half-open address range `[first, last)` and
+   *        its position in `words_`.
+   */
+  struct Slot {
+    uint32_t first;
+    uint32_t last;
+    uint32_t offset;
+  };
+
+  /** @brief Segments sorted by address, non-overlapping. */
+  std::vector<Slot> slots_;
+
+  /** @brief Register contents of all segments, packed back to back. */
+  std::vector<uint16_t> words_;
+
+  /** @brief Find the segment that fully contains `[addr, addr + count)`. */
+  const Slot *find(uint16_t addr, uint16_t count) const {
+    const uint32_t end = static_cast<uint32_t>(addr) + count;
+    for (const auto &s : slots_)
+      if (addr >= s.first && end <= s.last)
+        return &s;
+    return nullptr;
+  }
+};
+
+#endif /* REGISTER_BUFFER_H_ */
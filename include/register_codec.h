@@ -0,0 +1,136 @@
+/**
+ * @file register_codec.h
+ * @brief Compile-time decoders for typed register values.
+ *
+ * @details
+ * The runtime `getModbusDouble()` overloads switch on `Register::TYPE` and
+ * take the scale-factor register as a `std::optional`, so every call pays
+ * for the type dispatch and the optional. When the register is a constant
+ * of the register-map headers, both are known at compile time: a
+ * `RegisterCodec` specialisation decodes one value type directly, and
+ * `ScaledValue` / `FixedScaledValue` pair a value register with its
+ * scale-factor register or constant. A decode then reduces to a load, the
+ * byte swap, and one multiply.
+ */
+
+#ifndef REGISTER_CODEC_H_
+#define REGISTER_CODEC_H_
+
+#include "modbus_utils.h"
+#include "register_base.h"
+#include <cmath>
+#include <cstdint>
+#include <modbus/modbus.h>
+
+/**
+ * @brief 10^sf for a SunSpec scale-factor exponent.
+ *
+ * Served from a table for the range SunSpec devices use.
+ */
+inline double scaleFactor(int16_t sf) {
+  static constexpr double table[] = {1e-10, 1e-9, 1e-8, 1e-7, 1e-6, 1e-5,
+                                     1e-4,  1e-3, 1e-2, 1e-1, 1e0,  1e1,
+                                     1e2,   1e3,  1e4,  1e5,  1e6,  1e7,
+                                     1e8,   1e9,  1e10};
+  if (sf >= -10 && sf <= 10)
+    return table[sf + 10];
+  return std::pow(10.0, static_cast<double>(sf));
+}
+
+/**
+ * @struct RegisterCodec
+ * @brief Decoder of one numeric `Register::Type`.
+ *
+ * Specialised for the types the register maps use for measurements;
+ * instantiating another type is a compile error.
+ */
+template <Register::Type T> struct RegisterCodec;
+
+/** @brief 16-bit unsigned integer. */
+template <> struct RegisterCodec<Register::Type::UINT16> {
+  static double decode(const uint16_t *src) { return *src; }
+};
+
+/** @brief 16-bit signed integer. */
+template <> struct RegisterCodec<Register::Type::INT16> {
+  static double decode(const uint16_t *src) {
+    return static_cast<int16_t>(*src);
+  }
+};
+
+/** @brief 32-bit unsigned integer, big-endian word order (SunSpec). */
+template <> struct RegisterCodec<Register::Type::UINT32> {
+  static double decode(const uint16_t *src) {
+    return ModbusUtils::modbus_get_uint32(src);
+  }
+};
+
+/**
+ * @brief 32-bit signed integer, little-endian word order.
+ *
+ * Only the proprietary Fronius meter map uses INT32 values.
+ */
+template <> struct RegisterCodec<Register::Type::INT32> {
+  static double decode(const uint16_t *src) {
+    return ModbusUtils::modbus_get_int32(src, /*word_swap=*/true);
+  }
+};
+
+/** @brief IEEE 754 float in ABCD byte order (SunSpec float models). */
+template <> struct RegisterCodec<Register::Type::FLOAT> {
+  static double decode(const uint16_t *src) {
+    return modbus_get_float_abcd(src);
+  }
+};
+
+/**
+ * @struct ScaledValue
+ * @brief A value register and its optional SunSpec scale-factor register.
+ *
+ * @tparam Value  Value register; its type selects the `RegisterCodec`.
+ * @tparam Scale  INT16 scale-factor register, or a default `Register` for
+ *                an unscaled value (e.g. of a float model).
+ */
+template <Register Value,
+          Register Scale = Register(0, 0, Register::Type::UNKNOWN)>
+struct ScaledValue {
+  static constexpr Register VALUE = Value;
+  static constexpr Register SCALE = Scale;
+
+  /** @brief True if the value is multiplied by 10^SF. */
+  static constexpr bool SCALED = Scale.NB != 0;
+
+  static_assert(!SCALED || Scale.TYPE == Register::Type::INT16,
+                "ScaledValue: scale factor must be an INT16 register");
+
+  /**
+   * @brief Decode the value at `src`, scaled by the exponent at `sf`.
+   *
+   * `sf` is ignored for an unscaled value and may be null then.
+   */
+  static double decode(const uint16_t *src, const uint16_t *sf) {
+    const double value = RegisterCodec<Value.TYPE>::decode(src);
+    if constexpr (SCALED)
+      return value * scaleFactor(static_cast<int16_t>(*sf));
+    else
+      return value;
+  }
+};
+
+/**
+ * @struct FixedScaledValue
+ * @brief A value register with a constant scale (proprietary meter map).
+ *
+ * @tparam Value   Value register; its type selects the `RegisterCodec`.
+ * @tparam Factor  Constant multiplier.
+ */
+template <Register Value, double Factor> struct FixedScaledValue {
+  static constexpr Register VALUE = Value;
+
+  /** @brief Decode the value at `src`. */
+  static double decode(const uint16_t *src) {
+    return RegisterCodec<Value.TYPE>::decode(src) * Factor;
+  }
+};
+
+#endif /* REGISTER_CODEC_H_ */
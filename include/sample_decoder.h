@@ -0,0 +1,456 @@
+/**
+ * @file sample_decoder.h
+ * @brief Precompiled decode plan turning a register buffer into a sample.
+ *
+ * @details
+ * The per-value getters resolve the register map, look up the register,
+ * switch on its type and recompute the scale factor on every call. A
+ * `SampleDecoder` does that work once, when a device has been validated:
+ * every field of a measurement struct is bound to a resolved word offset,
+ * a value encoding, and either a scale-factor register or a fixed scale.
+ * Decoding a full sample is then a single pass over the plan, with each
+ * distinct scale-factor register evaluated once.
+ *
+ * A `SampleTracker` adds change detection on top: `decodeChanges()`
+ * compares the registers of each new snapshot with the previous one and
+ * decodes only the fields whose registers differ, reporting those that
+ * moved beyond their deadband.
+ */
+
+#ifndef SAMPLE_DECODER_H_
+#define SAMPLE_DECODER_H_
+
+#include "modbus_error.h"
+#include "register_base.h"
+#include "register_buffer.h"
+#include "register_codec.h"
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <optional>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+template <typename Sample> class SampleDecoder;
+
+/**
+ * @class SampleTracker
+ * @brief Last reported sample of one consumer, for change detection.
+ *
+ * @tparam Sample Measurement struct of the tracked device.
+ *
+ * Pass the tracker to the device's `decodeChanges()` after each fetch. It
+ * keeps the registers of the previous call and the values last reported
+ * through `changes()`; a field is reported again once its value differs
+ * from the reported one by more than its deadband. Each consumer (an MQTT
+ * exporter, a database writer) owns its own tracker. Not thread-safe.
+ */
+template <typename Sample> class SampleTracker {
+public:
+  /** @brief Member of `Sample` holding one decoded value. */
+  using Field = double Sample::*;
+
+  /**
+   * @brief Report `field` only once it moved by more than `deadband`.
+   *
+   * The deadband is absolute, in the unit of the field. The default of 0
+   * reports every change of the value.
+   *
+   * @throws std::invalid_argument if `deadband` is negative or NaN.
+   */
+  void setDeadband(Field field, double deadband) {
+    if (!(deadband >= 0.0))
+      throw std::invalid_argument(
+          "SampleTracker: deadband must not be negative");
+
+    for (auto &entry : deadbands_)
+      if (entry.first == field) {
+        entry.second = deadband;
+        return;
+      }
+    deadbands_.emplace_back(field, deadband);
+  }
+
+  /** @brief Forget all state; the next update reports every field. */
+  void reset() {
+    words_.clear();
+    changes_.clear();
+    decoder_ = nullptr;
+    sample_ = Sample{};
+  }
+
+  /**
+   * @brief Values as last reported.
+   *
+   * Fields not listed in `changes()` keep the value of the update that
+   * last reported them. Header members such as the timestamp are always
+   * those of the latest update.
+   */
+  const Sample &sample() const { return sample_; }
+
+  /** @brief Fields reported by the latest update. */
+  std::span<const Field> changes() const { return changes_; }
+
+  /** @brief True if the latest update changed a non-`double` member. */
+  bool headerChanged() const { return headerChanged_; }
+
+private:
+  friend class SampleDecoder<Sample>;
+
+  /** @brief Deadband of `field`, 0 if none was set. */
+  double deadband(Field field) const {
+    for (const auto &entry : deadbands_)
+      if (entry.first == field)
+        return entry.second;
+    return 0.0;
+  }
+
+  Sample sample_{};
+  std::vector<Field> changes_;
+  bool headerChanged_{false};
+  std::vector<std::pair<Field, double>> deadbands_;
+
+  /** @brief Registers of the previous update, in the decoder's layout. */
+  std::vector<uint16_t> words_;
+
+  /** @brief Plan the registers were compared with, and its build. */
+  const SampleDecoder<Sample> *decoder_{nullptr};
+  uint64_t build_{0};
+};
+
+/**
+ * @class SampleDecoder
+ * @brief Decode plan for one plain measurement struct.
+ *
+ * @tparam Sample Struct whose `double` members receive the decoded values.
+ *
+ * Built with `add()` against the device's register layout, then applied
+ * with `decode()` to any register buffer sharing that layout. Fields that
+ * are not part of the plan are left untouched. A plan is not changed once
+ * it is shared with other threads; a device builds a new one instead.
+ */
+template <typename Sample> class SampleDecoder {
+public:
+  /** @brief Member of `Sample` receiving one decoded value. */
+  using Field = double Sample::*;
+
+  /** @brief Distinct scale-factor registers a plan can reference. */
+  static constexpr size_t MAX_SCALE_FACTORS = 16;
+
+  /** @brief Remove all steps. */
+  void clear() {
+    steps_.clear();
+    sfCount_ = 0;
+    build_ = nextBuild();
+  }
+
+  /** @brief True if no field is decoded. */
+  bool empty() const { return steps_.empty(); }
+
+  /**
+   * @brief Decode a SunSpec value, optionally scaled by 10^SF.
+   *
+   * @param layout  Register buffer of the device; fixes the word offsets.
+   * @param field   Member receiving the value.
+   * @param reg     Value register (INT16, UINT16, UINT32, or FLOAT).
+   * @param sf      Scale-factor register, if any.
+   * @return Empty expected, or `EINVAL` if a register is not stored or has
+   *         an unsupported type.
+   */
+  std::expected<void, ModbusError> add(const RegisterBuffer &layout,
+                                       Field field, const Register &reg,
+                                       std::optional<Register> sf = {}) {
+    Step step{};
+    step.field = field;
+
+    if (auto res = resolve(layout, reg, step); !res)
+      return res;
+    if (step.kind == Kind::INT32_SWAPPED)
+      return unsupported(reg);
+
+    if (sf.has_value()) {
+      auto slot = scaleSlot(layout, *sf);
+      if (!slot)
+        return std::unexpected(slot.error());
+      step.sfSlot = *slot;
+    }
+
+    steps_.push_back(step);
+    return {};
+  }
+
+  /**
+   * @brief Decode a proprietary INT32 value with a fixed scale.
+   *
+   * @param layout      Register buffer of the device.
+   * @param field       Member receiving the value.
+   * @param reg         INT32 register in little-endian word order.
+   * @param scale       Constant multiplier.
+   * @param accumulate  Add to the field instead of overwriting it, for
+   *                    values split over two registers (kWh + Wh).
+   */
+  std::expected<void, ModbusError> add(const RegisterBuffer &layout,
+                                       Field field, const Register &reg,
+                                       double scale, bool accumulate = false) {
+    Step step{};
+    step.field = field;
+    step.scale = scale;
+    step.accumulate = accumulate;
+
+    if (auto res = resolve(layout, reg, step); !res)
+      return res;
+    if (step.kind != Kind::INT32_SWAPPED)
+      return unsupported(reg);
+
+    steps_.push_back(step);
+    return {};
+  }
+
+  /**
+   * @brief Decode every planned field from `regs` into `out`.
+   *
+   * @param regs  Buffer with the same layout the plan was built against.
+   * @param out   Sample to fill.
+   */
+  void decode(const RegisterBuffer &regs, Sample &out) const {
+    const uint16_t *words = regs.words();
+
+    std::array<double, MAX_SCALE_FACTORS> scales;
+    for (size_t i = 0; i < sfCount_; ++i)
+      scales[i] = scaleFactor(static_cast<int16_t>(words[sfOffsets_[i]]));
+
+    for (const Step &step : steps_) {
+      const double value = valueOf(step, words, scales);
+      if (step.accumulate)
+        out.*step.field += value;
+      else
+        out.*step.field = value;
+    }
+  }
+
+  /**
+   * @brief Update `tracker` from `regs`, decoding only changed fields.
+   *
+   * Fields whose value and scale-factor registers equal those of the
+   * previous update are skipped without decoding. The others are decoded
+   * and listed in `tracker.changes()` if they moved beyond their deadband
+   * from the reported value, or turned NaN or back. The first update, and
+   * the first after the plan was rebuilt, reports every planned field.
+   *
+   * @param regs    Buffer with the same layout the plan was built against.
+   * @param tracker Consumer state to update.
+   * @param header  Callable `bool(Sample &)` setting the non-`double`
+   *                members; returns true if one of them changed.
+   */
+  template <typename Header>
+  void decodeChanges(const RegisterBuffer &regs, SampleTracker<Sample> &tracker,
+                     Header &&header) const {
+    tracker.changes_.clear();
+    const uint16_t *words = regs.words();
+    const size_t count = regs.size();
+
+    const bool fresh = tracker.decoder_ != this ||
+                       tracker.build_ != build_ ||
+                       tracker.words_.size() != count;
+    if (fresh) {
+      tracker.sample_ = Sample{};
+      tracker.headerChanged_ = true;
+      header(tracker.sample_);
+      decode(regs, tracker.sample_);
+      for (const Step &step : steps_)
+        if (!step.accumulate)
+          tracker.changes_.push_back(step.field);
+
+      tracker.words_.assign(words, words + count);
+      tracker.decoder_ = this;
+      tracker.build_ = build_;
+      return;
+    }
+
+    tracker.headerChanged_ = header(tracker.sample_);
+
+    // Unchanged snapshots are the common case for slow data
+    const uint16_t *prev = tracker.words_.data();
+    if (std::memcmp(words, prev, count * sizeof(uint16_t)) == 0)
+      return;
+
+    std::array<double, MAX_SCALE_FACTORS> scales;
+    uint32_t sfChanged = 0;
+    for (size_t i = 0; i < sfCount_; ++i) {
+      scales[i] = scaleFactor(static_cast<int16_t>(words[sfOffsets_[i]]));
+      if (words[sfOffsets_[i]] != prev[sfOffsets_[i]])
+        sfChanged |= 1u << i;
+    }
+
+    // A field and the accumulating steps following it form one group
+    for (size_t i = 0; i < steps_.size();) {
+      size_t end = i + 1;
+      while (end < steps_.size() && steps_[end].accumulate)
+        ++end;
+
+      bool changed = false;
+      for (size_t k = i; k < end && !changed; ++k) {
+        const Step &step = steps_[k];
+        changed = std::memcmp(words + step.offset, prev + step.offset,
+                              width(step.kind) * sizeof(uint16_t)) != 0 ||
+                  (step.sfSlot >= 0 && (sfChanged >> step.sfSlot) & 1u);
+      }
+
+      if (changed) {
+        double value = 0.0;
+        for (size_t k = i; k < end; ++k)
+          value += valueOf(steps_[k], words, scales);
+
+        const Field field = steps_[i].field;
+        double &reported = tracker.sample_.*field;
+        const double band = tracker.deadband(field);
+        bool moved;
+        if (std::isnan(value) || std::isnan(reported))
+          moved = std::isnan(value) != std::isnan(reported);
+        else
+          moved = band > 0.0 ? std::abs(value - reported) > band
+                             : value != reported;
+        if (moved) {
+          reported = value;
+          tracker.changes_.push_back(field);
+        }
+      }
+      i = end;
+    }
+
+    std::memcpy(tracker.words_.data(), words, count * sizeof(uint16_t));
+  }
+
+private:
+  /** @brief Value encoding, resolved from `Register::Type`. */
+  enum class Kind : uint8_t { INT16, UINT16, UINT32, INT32_SWAPPED, FLOAT };
+
+  /** @brief One field of the plan. */
+  struct Step {
+    Field field{nullptr};
+    uint16_t offset{0};
+    Kind kind{Kind::UINT16};
+    bool accumulate{false};
+    int8_t sfSlot{-1};
+    double scale{1.0};
+  };
+
+  std::vector<Step> steps_;
+  std::array<uint16_t, MAX_SCALE_FACTORS> sfOffsets_{};
+  size_t sfCount_{0};
+
+  /**
+   * @brief Identity of the plan, unique among all plans and renewed by
+   *        `clear()`, so trackers notice a rebuilt or replaced plan.
+   */
+  uint64_t build_{nextBuild()};
+
+  /** @brief Next unused plan identity. */
+  static uint64_t nextBuild() {
+    static std::atomic<uint64_t> next{0};
+    return next.fetch_add(1, std::memory_order_relaxed) + 1;
+  }
+
+  /** @brief Registers occupied by a value of `kind`. */
+  static size_t width(Kind kind) {
+    return kind == Kind::INT16 || kind == Kind::UINT16 ? 1 : 2;
+  }
+
+  /** @brief Scaled value of one step. */
+  static double valueOf(const Step &step, const uint16_t *words,
+                        const std::array<double, MAX_SCALE_FACTORS> &scales) {
+    const uint16_t *src = words + step.offset;
+    double value = 0.0;
+
+    switch (step.kind) {
+    case Kind::INT16:
+      value = RegisterCodec<Register::Type::INT16>::decode(src);
+      break;
+    case Kind::UINT16:
+      value = RegisterCodec<Register::Type::UINT16>::decode(src);
+      break;
+    case Kind::UINT32:
+      value = RegisterCodec<Register::Type::UINT32>::decode(src);
+      break;
+    case Kind::INT32_SWAPPED:
+      value = RegisterCodec<Register::Type::INT32>::decode(src);
+      break;
+    case Kind::FLOAT:
+      value = RegisterCodec<Register::Type::FLOAT>::decode(src);
+      break;
+    }
+
+    return step.sfSlot >= 0 ? value * scales[step.sfSlot]
+                            : value * step.scale;
+  }
+
+  static std::expected<void, ModbusError> unsupported(const Register &reg) {
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SampleDecoder::add(): Unsupported register {}",
+        reg.describe()));
+  }
+
+  static std::expected<void, ModbusError> outOfBounds(const Register &reg) {
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SampleDecoder::add(): Register range out of bounds {}",
+        reg.describe()));
+  }
+
+  /** @brief Fill offset and kind of `step` from `reg`. */
+  static std::expected<void, ModbusError>
+  resolve(const RegisterBuffer &layout, const Register &reg, Step &step) {
+    const int offset = layout.offsetOf(reg.ADDR, reg.NB);
+    if (offset < 0)
+      return outOfBounds(reg);
+    step.offset = static_cast<uint16_t>(offset);
+
+    switch (reg.TYPE) {
+    case Register::Type::INT16:
+      step.kind = Kind::INT16;
+      return {};
+    case Register::Type::UINT16:
+      step.kind = Kind::UINT16;
+      return {};
+    case Register::Type::UINT32:
+      step.kind = Kind::UINT32;
+      return {};
+    case Register::Type::INT32:
+      step.kind = Kind::INT32_SWAPPED;
+      return {};
+    case Register::Type::FLOAT:
+      step.kind = Kind::FLOAT;
+      return {};
+    default:
+      return unsupported(reg);
+    }
+  }
+
+  /** @brief Slot of scale-factor register `sf`, adding it if new. */
+  std::expected<int8_t, ModbusError> scaleSlot(const RegisterBuffer &layout,
+                                               const Register &sf) {
+    const int offset = layout.offsetOf(sf.ADDR);
+    if (offset < 0)
+      return std::unexpected(outOfBounds(sf).error());
+
+    for (size_t i = 0; i < sfCount_; ++i)
+      if (sfOffsets_[i] == offset)
+        return static_cast<int8_t>(i);
+
+    if (sfCount_ == MAX_SCALE_FACTORS)
+      return std::unexpected(ModbusError::custom(
+          EOVERFLOW, "SampleDecoder::add(): More than {} scale factors",
+          MAX_SCALE_FACTORS));
+
+    sfOffsets_[sfCount_] = static_cast<uint16_t>(offset);
+    return static_cast<int8_t>(sfCount_++);
+  }
+};
+
+#endif /* SAMPLE_DECODER_H_ */
@@ -0,0 +1,428 @@
+/**
+ * @file sample_history.h
+ * @brief Fixed-capacity columnar history of decoded samples.
+ *
+ * @details
+ * Energy balances, ramp rates, and min/max displays need the recent past
+ * of a few quantities, not of whole samples. A `SampleHistory` keeps one
+ * contiguous column per tracked field of an `InverterSample` or
+ * `MeterSample`, stored as `double`, `float`, IEEE half floats, or 16-bit
+ * integers of a fixed resolution, and one column of timestamp deltas in
+ * milliseconds. Tracking three power values as half floats costs 10 bytes
+ * per sample instead of the 240 bytes of an `InverterSample`.
+ *
+ * Attached to a device with `setHistory()`, the history is appended to
+ * after every fetch the device publishes, from the thread that published
+ * it. Windowed aggregates run over the contiguous columns in at most two
+ * runs, one on each side of the ring's wrap point.
+ */
+
+#ifndef SAMPLE_HISTORY_H_
+#define SAMPLE_HISTORY_H_
+
+#include "modbus_error.h"
+#include <algorithm>
+#include <bit>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <limits>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <variant>
+#include <vector>
+
+/**
+ * @brief Storage of one column of a `SampleHistory`.
+ */
+enum class HistoryStorage : uint8_t {
+  FLOAT64,  ///< `double`, exact; for lifetime energy counters
+  FLOAT32,  ///< `float`, about 7 significant digits
+  FLOAT16,  ///< IEEE half float, about 3 significant digits, up to 65504
+  SCALED16, ///< 16-bit integer times a fixed resolution
+};
+
+namespace HistoryCodec {
+
+/** @brief Round `value` to the nearest IEEE half float. */
+inline uint16_t toHalf(float value) {
+  const uint32_t bits = std::bit_cast<uint32_t>(value);
+  const auto sign = static_cast<uint16_t>((bits >> 16) & 0x8000);
+  const uint32_t mag = bits & 0x7fffffff;
+
+  if (mag > 0x7f800000) // NaN
+    return sign | 0x7e00;
+  if (mag >= 0x477ff000) // rounds beyond 65504
+    return sign | 0x7c00;
+  if (mag < 0x38800000) { // subnormal: multiples of 2^-24
+    const float units = std::bit_cast<float>(mag) * 0x1p24f;
+    return sign | static_cast<uint16_t>(std::nearbyint(units));
+  }
+
+  // Rebias the exponent and round the mantissa to nearest even
+  const uint32_t h = mag - 0x38000000;
+  return sign | static_cast<uint16_t>((h + 0x0fff + ((h >> 13) & 1)) >> 13);
+}
+
+/** @brief Widen an IEEE half float. */
+inline float fromHalf(uint16_t half) {
+  const uint32_t sign = uint32_t{half & 0x8000u} << 16;
+  const uint32_t exp = (half >> 10) & 0x1f;
+  const uint32_t mant = half & 0x3ff;
+
+  if (exp == 0) {
+    const float v = static_cast<float>(mant) * 0x1p-24f;
+    return sign ? -v : v;
+  }
+  if (exp == 31)
+    return std::bit_cast<float>(sign | 0x7f800000 | (mant << 13));
+  return std::bit_cast<float>(sign | ((exp + 112) << 23) | (mant << 13));
+}
+
+/** @brief Marker of a missing value in a `SCALED16` column. */
+inline constexpr int16_t SCALED_NAN = std::numeric_limits<int16_t>::min();
+
+} // namespace HistoryCodec
+
+/**
+ * @class SampleHistory
+ * @brief Ring of the most recent values of selected sample fields.
+ *
+ * @tparam Sample Measurement struct of the device, `InverterSample` or
+ *                `MeterSample`.
+ *
+ * Fields are chosen with `track()`; samples are added by the device the
+ * history is attached to, or by `append()`. Once `capacity()` samples are
+ * kept, each new one replaces the oldest. Missing values (NaN) are kept
+ * as such and skipped by the aggregates. Thread-safe.
+ */
+template <typename Sample> class SampleHistory {
+public:
+  /** @brief Member of `Sample` holding one decoded value. */
+  using Field = double Sample::*;
+
+  using Clock = std::chrono::system_clock;
+
+  /**
+   * @struct Stats
+   * @brief Aggregates of one field over a window.
+   */
+  struct Stats {
+    /** @brief Values aggregated; NaN values are not counted. */
+    size_t count{0};
+
+    double mean{std::numeric_limits<double>::quiet_NaN()};
+    double min{std::numeric_limits<double>::quiet_NaN()};
+    double max{std::numeric_limits<double>::quiet_NaN()};
+  };
+
+  /**
+   * @brief Construct an empty history of `capacity` samples.
+   *
+   * @throws std::invalid_argument if `capacity` is 0.
+   */
+  explicit SampleHistory(size_t capacity) : deltas_(capacity) {
+    if (capacity == 0)
+      throw std::invalid_argument("SampleHistory: capacity must not be 0");
+  }
+
+  // Non-copyable, non-movable (mutex).
+  SampleHistory(const SampleHistory &) = delete;
+  SampleHistory &operator=(const SampleHistory &) = delete;
+
+  /**
+   * @brief Keep the values of `field`.
+   *
+   * Samples already kept have no value for the field. Tracking a field
+   * again changes its storage and forgets its values.
+   *
+   * @param field       Field to keep.
+   * @param storage     How its values are stored.
+   * @param resolution  Value of one step of a `SCALED16` column, e.g. 0.1
+   *                    for 0.1 V; values beyond ±32767 steps are clamped.
+   * @throws std::invalid_argument if `resolution` is not positive.
+   */
+  void track(Field field, HistoryStorage storage = HistoryStorage::FLOAT32,
+             double resolution = 1.0) {
+    if (!(resolution > 0.0))
+      throw std::invalid_argument(
+          "SampleHistory: resolution must be positive");
+
+    Column col{field, storage, resolution, {}};
+    const size_t n = capacity();
+    switch (storage) {
+    case HistoryStorage::FLOAT64:
+      col.data = std::vector<double>(n, NAN);
+      break;
+    case HistoryStorage::FLOAT32:
+      col.data = std::vector<float>(n, NAN);
+      break;
+    case HistoryStorage::FLOAT16:
+      col.data = std::vector<uint16_t>(n, HistoryCodec::toHalf(NAN));
+      break;
+    case HistoryStorage::SCALED16:
+      col.data = std::vector<int16_t>(n, HistoryCodec::SCALED_NAN);
+      break;
+    }
+
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (Column &c : columns_)
+      if (c.field == field) {
+        c = std::move(col);
+        return;
+      }
+    columns_.push_back(std::move(col));
+  }
+
+  /** @brief Add a sample, replacing the oldest once the ring is full. */
+  void append(const Sample &sample) {
+    const int64_t ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+                           sample.timestamp.time_since_epoch())
+                           .count();
+
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // A clock stepping back counts as no time passing
+    const int64_t delta =
+        size_ == 0 ? 0 : std::clamp<int64_t>(ms - newestMs_, 0, UINT32_MAX);
+    newestMs_ = size_ == 0 ? ms : newestMs_ + delta;
+    deltas_[head_] = static_cast<uint32_t>(delta);
+
+    for (Column &c : columns_)
+      std::visit(
+          [&](auto &data) {
+            using T = typename std::remove_cvref_t<decltype(data)>::value_type;
+            data[head_] = encode<T>(c, sample.*c.field);
+          },
+          c.data);
+
+    head_ = (head_ + 1) % capacity();
+    size_ = std::min(size_ + 1, capacity());
+  }
+
+  /** @brief Forget every sample; tracked fields stay tracked. */
+  void clear() {
+    std::lock_guard<std::mutex> lock(mtx_);
+    head_ = 0;
+    size_ = 0;
+  }
+
+  /** @brief Samples the ring holds at most. */
+  size_t capacity() const { return deltas_.size(); }
+
+  /** @brief Samples currently kept. */
+  size_t size() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    return size_;
+  }
+
+  /** @brief Time of the newest sample, if any. */
+  std::optional<Clock::time_point> newest() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    if (size_ == 0)
+      return std::nullopt;
+    return Clock::time_point(std::chrono::milliseconds(newestMs_));
+  }
+
+  /** @brief Bytes kept per sample: the tracked columns and the timestamp. */
+  size_t bytesPerSample() const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    size_t bytes = sizeof(uint32_t);
+    for (const Column &c : columns_)
+      bytes += std::visit(
+          [](const auto &data) { return sizeof(data.front()); }, c.data);
+    return bytes;
+  }
+
+  /**
+   * @brief Count, mean, minimum, and maximum of `field`.
+   *
+   * @param field   A tracked field.
+   * @param window  Span of time back from the newest sample to include;
+   *                the whole history by default.
+   * @return The aggregates, or `EINVAL` if `field` is not tracked,
+   *         `ENODATA` if the history is empty.
+   */
+  std::expected<Stats, ModbusError>
+  stats(Field field, std::chrono::milliseconds window =
+                         std::chrono::milliseconds::max()) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto col = find(field, "stats()");
+    if (!col)
+      return std::unexpected(std::move(col.error()));
+
+    Stats s;
+    double sum = 0.0;
+    double lo = std::numeric_limits<double>::infinity();
+    double hi = -std::numeric_limits<double>::infinity();
+    const size_t n = samplesIn(window);
+    forEachRun(size_ - n, n, [&](size_t begin, size_t end) {
+      std::visit(
+          [&](const auto &data) {
+            for (size_t i = begin; i < end; ++i) {
+              const double v = decode(**col, data[i]);
+              if (std::isnan(v))
+                continue;
+              ++s.count;
+              sum += v;
+              lo = std::min(lo, v);
+              hi = std::max(hi, v);
+            }
+          },
+          (*col)->data);
+    });
+
+    if (s.count > 0) {
+      s.mean = sum / static_cast<double>(s.count);
+      s.min = lo;
+      s.max = hi;
+    }
+    return s;
+  }
+
+  /**
+   * @brief Integral of `field` over time by the trapezoidal rule.
+   *
+   * In the field's unit times hours, e.g. Wh for a power in W. Intervals
+   * with a missing value at either end are left out.
+   *
+   * @param field   A tracked field.
+   * @param window  As for `stats()`.
+   * @return The integral, or `EINVAL` if `field` is not tracked, `ENODATA`
+   *         if the history is empty.
+   */
+  std::expected<double, ModbusError>
+  integrate(Field field, std::chrono::milliseconds window =
+                             std::chrono::milliseconds::max()) const {
+    std::lock_guard<std::mutex> lock(mtx_);
+    auto col = find(field, "integrate()");
+    if (!col)
+      return std::unexpected(std::move(col.error()));
+
+    // Sum of (a + b) * dt over the intervals, in unit * ms
+    double area = 0.0;
+    double prev = std::numeric_limits<double>::quiet_NaN();
+    const size_t n = samplesIn(window);
+    forEachRun(size_ - n, n, [&](size_t begin, size_t end) {
+      std::visit(
+          [&](const auto &data) {
+            for (size_t i = begin; i < end; ++i) {
+              const double v = decode(**col, data[i]);
+              area += std::isnan(prev) || std::isnan(v)
+                          ? 0.0
+                          : (prev + v) * static_cast<double>(deltas_[i]);
+              prev = v;
+            }
+          },
+          (*col)->data);
+    });
+    return area / 2.0 / 3.6e6;
+  }
+
+private:
+  /** @brief Values of one tracked field, indexed like `deltas_`. */
+  struct Column {
+    Field field;
+    HistoryStorage storage;
+    double resolution;
+    std::variant<std::vector<double>, std::vector<float>,
+                 std::vector<uint16_t>, std::vector<int16_t>>
+        data;
+  };
+
+  static double decode(const Column &, double v) { return v; }
+  static double decode(const Column &, float v) { return v; }
+  static double decode(const Column &, uint16_t v) {
+    return HistoryCodec::fromHalf(v);
+  }
+  static double decode(const Column &c, int16_t v) {
+    if (v == HistoryCodec::SCALED_NAN)
+      return std::numeric_limits<double>::quiet_NaN();
+    return v * c.resolution;
+  }
+
+  /** @brief `v` as stored in a column of `T`s. */
+  template <typename T> static T encode(const Column &c, double v) {
+    if constexpr (std::is_same_v<T, uint16_t>) {
+      return HistoryCodec::toHalf(static_cast<float>(v));
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+      if (std::isnan(v))
+        return HistoryCodec::SCALED_NAN;
+      return static_cast<int16_t>(
+          std::clamp(std::round(v / c.resolution), -32767.0, 32767.0));
+    } else {
+      return static_cast<T>(v);
+    }
+  }
+
+  /** @brief Column of `field`; `what` names the caller. */
+  std::expected<const Column *, ModbusError> find(Field field,
+                                                  const char *what) const {
+    if (size_ == 0)
+      return std::unexpected(ModbusError::custom(
+          ENODATA, "SampleHistory::{}: No samples kept yet", what));
+    for (const Column &c : columns_)
+      if (c.field == field)
+        return &c;
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SampleHistory::{}: Field is not tracked", what));
+  }
+
+  /** @brief Ring index of the `i`-th oldest sample. */
+  size_t slot(size_t i) const {
+    return (head_ + capacity() - size_ + i) % capacity();
+  }
+
+  /** @brief Newest samples no older than `window` before the newest one. */
+  size_t samplesIn(std::chrono::milliseconds window) const {
+    size_t n = 1;
+    int64_t age = 0;
+    for (; n < size_; ++n) {
+      // The delta of a sample is its distance to the one before it
+      age += deltas_[slot(size_ - n)];
+      if (age > window.count())
+        break;
+    }
+    return n;
+  }
+
+  /**
+   * @brief Call `fn(begin, end)` for the contiguous runs of ring indexes
+   *        holding `count` samples from the `first`-th oldest on.
+   */
+  template <typename Fn>
+  void forEachRun(size_t first, size_t count, Fn fn) const {
+    const size_t begin = slot(first);
+    const size_t end = begin + count;
+    if (end <= capacity()) {
+      fn(begin, end);
+    } else {
+      fn(begin, capacity());
+      fn(0, end - capacity());
+    }
+  }
+
+  mutable std::mutex mtx_;
+  std::vector<Column> columns_;
+
+  /**
+   * @brief Milliseconds since the previous sample, by ring index.
+   *
+   * Unused for the oldest sample kept, whose predecessor is gone.
+   */
+  std::vector<uint32_t> deltas_;
+
+  /** @brief Index the next sample is written to. */
+  size_t head_{0};
+  size_t size_{0};
+
+  /** @brief Time of the newest sample, in ms since the epoch. */
+  int64_t newestMs_{0};
+};
+
+#endif /* SAMPLE_HISTORY_H_ */
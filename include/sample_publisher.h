@@ -0,0 +1,415 @@
+/**
+ * @file sample_publisher.h
+ * @brief Publication of decoded samples to other processes through shared
+ *        memory.
+ *
+ * @details
+ * Only one process may talk to a Datamanager or an RS-485 bus, yet an
+ * exporter, a controller, and a web UI on the same gateway all want its
+ * values. A `SamplePublisher` in the process that owns the bus writes
+ * each decoded `InverterSample` or `MeterSample` into a POSIX shared
+ * memory segment; any number of local processes open it with a
+ * `SampleReader` and read the latest values without a syscall, a lock, or
+ * a Modbus request.
+ *
+ * The segment is a `SampleShmHeader` followed by one `SampleShmChannel`
+ * per device, each followed by a ring of `SampleShmEntry`s. Every entry
+ * is guarded by a sequence lock: the writer makes its version odd, stores
+ * the sample, and makes it even again, and a reader accepts a copy only
+ * if the version was even and unchanged around it. The writer fills the
+ * entry after the latest, so readers of the latest sample are not
+ * disturbed until the ring wraps, and a reader that fell behind can still
+ * fetch the samples it missed while they are in the ring. Readers never
+ * write to the segment, so a stalled reader cannot hold the publisher up.
+ * Fields are stored in host byte order.
+ */
+
+#ifndef SAMPLE_PUBLISHER_H_
+#define SAMPLE_PUBLISHER_H_
+
+#include "inverter.h"
+#include "meter.h"
+#include "modbus_error.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <sys/types.h>
+#include <type_traits>
+#include <utility>
+
+// ---------------------------------------------------------------------------
+// Segment layout
+// ---------------------------------------------------------------------------
+
+/**
+ * @struct SampleShmHeader
+ * @brief First bytes of a sample segment.
+ */
+struct SampleShmHeader {
+  /** @brief Segment signature, `"FRNSSHM"` and a null byte. */
+  static constexpr std::array<char, 8> MAGIC{'F', 'R', 'N', 'S',
+                                             'S', 'H', 'M', '\0'};
+
+  /** @brief Layout version written by this library. */
+  static constexpr uint16_t VERSION = 1;
+
+  /** @brief Value of `byteOrder` as written by the publisher. */
+  static constexpr uint16_t BYTE_ORDER_MARK = 0x0102;
+
+  std::array<char, 8> magic{MAGIC};
+  uint16_t byteOrder{BYTE_ORDER_MARK};
+  uint16_t version{VERSION};
+
+  /** @brief Size of this header; the first channel starts at this offset. */
+  uint32_t headerSize{0};
+
+  /** @brief Number of channels. */
+  uint32_t channels{0};
+
+  /** @brief Entries in the ring of each channel. */
+  uint32_t ringSize{0};
+
+  /** @brief Size of a channel including its ring; a multiple of 64. */
+  uint32_t channelSize{0};
+
+  /**
+   * @brief Non-zero once the publisher has laid out the segment.
+   *
+   * Accessed atomically; a reader opening the segment before then gets
+   * `EAGAIN`.
+   */
+  uint32_t ready{0};
+
+  uint64_t reserved{0};
+};
+
+static_assert(sizeof(SampleShmHeader) == 40);
+
+/**
+ * @struct SampleShmEntry
+ * @brief One ring entry: a sample as 64-bit words under a sequence lock.
+ */
+struct SampleShmEntry {
+  /** @brief Words of the largest sample type. */
+  static constexpr size_t WORDS =
+      (std::max(sizeof(InverterSample), sizeof(MeterSample)) + 7) / 8;
+
+  /**
+   * @brief `2n` once publication `n` is complete, `2n - 1` while it is
+   *        being written. Accessed atomically.
+   */
+  uint64_t version{0};
+
+  /** @brief The sample's bytes. Accessed atomically, word by word. */
+  std::array<uint64_t, WORDS> words{};
+};
+
+/**
+ * @struct SampleShmChannel
+ * @brief Samples of one device, followed by `ringSize` entries.
+ */
+struct SampleShmChannel {
+  /** @brief Sample type a channel carries. */
+  enum class Kind : uint32_t {
+    INVERTER = 1, ///< `InverterSample`
+    METER = 2,    ///< `MeterSample`
+  };
+
+  /** @brief Longest channel name, excluding the null byte. */
+  static constexpr size_t MAX_NAME = 31;
+
+  /** @brief Null-terminated channel name. */
+  std::array<char, MAX_NAME + 1> name{};
+
+  Kind kind{Kind::INVERTER};
+
+  /** @brief `sizeof` the sample type, as compiled into the publisher. */
+  uint32_t sampleSize{0};
+
+  /** @brief Samples published so far. Accessed atomically. */
+  uint64_t published{0};
+
+  uint64_t reserved{0};
+
+  /** @brief The ring entries following the channel. */
+  SampleShmEntry *entries() {
+    return reinterpret_cast<SampleShmEntry *>(this + 1);
+  }
+
+  /** @brief The ring entries following the channel. */
+  const SampleShmEntry *entries() const {
+    return reinterpret_cast<const SampleShmEntry *>(this + 1);
+  }
+};
+
+static_assert(sizeof(SampleShmChannel) == 56);
+static_assert(std::atomic_ref<uint64_t>::is_always_lock_free,
+              "the sequence locks need lock-free 64-bit atomics");
+static_assert(std::is_trivially_copyable_v<InverterSample> &&
+              std::is_trivially_copyable_v<MeterSample>);
+
+// ---------------------------------------------------------------------------
+// SamplePublisher — writes samples to a segment
+// ---------------------------------------------------------------------------
+
+/**
+ * @class SamplePublisher
+ * @brief Creates a sample segment and publishes samples into it.
+ *
+ * The channels are fixed when the segment is created. Publishing does not
+ * allocate and takes no lock; calls for different channels may run
+ * concurrently, e.g. from the threads of different buses, but calls for
+ * the same channel must not overlap. A device's poller callback or fetch
+ * callback satisfies that.
+ */
+class SamplePublisher {
+public:
+  /** @brief Entries per channel unless given otherwise. */
+  static constexpr size_t DEFAULT_RING_SIZE = 8;
+
+  /**
+   * @struct Channel
+   * @brief A channel to create.
+   */
+  struct Channel {
+    /** @brief Name readers look the channel up by, at most `MAX_NAME`. */
+    std::string name;
+
+    /** @brief Sample type the channel carries. */
+    SampleShmChannel::Kind kind{SampleShmChannel::Kind::INVERTER};
+  };
+
+  /**
+   * @brief Create the segment `name` with the given channels.
+   *
+   * A segment of the same name left by an earlier publisher is replaced;
+   * readers still mapping it notice through `SampleReader::stale()`.
+   *
+   * @param name      POSIX shared memory name, e.g. `"/fronius"`.
+   * @param channels  Channels in the order of their indexes.
+   * @param ringSize  Entries per channel, at least 2.
+   * @return The publisher, or the error creating the segment (`EINVAL`
+   *         for an invalid name, channel, or ring size).
+   */
+  static std::expected<std::unique_ptr<SamplePublisher>, ModbusError>
+  create(const std::string &name, std::span<const Channel> channels,
+         size_t ringSize = DEFAULT_RING_SIZE);
+
+  /**
+   * @brief Unmap the segment and remove it, unless a later publisher has
+   *        replaced it meanwhile.
+   */
+  ~SamplePublisher();
+
+  // Non-copyable, non-movable.
+  SamplePublisher(const SamplePublisher &) = delete;
+  SamplePublisher &operator=(const SamplePublisher &) = delete;
+  SamplePublisher(SamplePublisher &&) = delete;
+  SamplePublisher &operator=(SamplePublisher &&) = delete;
+
+  /**
+   * @brief Publish an inverter sample.
+   *
+   * @return Empty expected, or `EINVAL` if `channel` does not exist or
+   *         carries meter samples.
+   */
+  std::expected<void, ModbusError> publish(size_t channel,
+                                           const InverterSample &sample);
+
+  /**
+   * @brief Publish a meter sample.
+   *
+   * @return Empty expected, or `EINVAL` if `channel` does not exist or
+   *         carries inverter samples.
+   */
+  std::expected<void, ModbusError> publish(size_t channel,
+                                           const MeterSample &sample);
+
+  /**
+   * @brief Decode the latest snapshot of `inverter` and publish it.
+   *
+   * @return Empty expected, or the error of `decodeAll()` or `publish()`.
+   */
+  std::expected<void, ModbusError> publish(size_t channel,
+                                           const Inverter &inverter);
+
+  /**
+   * @brief Decode the latest snapshot of `meter` and publish it.
+   *
+   * @return Empty expected, or the error of `decodeAll()` or `publish()`.
+   */
+  std::expected<void, ModbusError> publish(size_t channel,
+                                           const Meter &meter);
+
+  /** @brief Name of the segment. */
+  const std::string &name() const { return name_; }
+
+private:
+  SamplePublisher(std::string name, void *base, size_t size, dev_t dev,
+                  ino_t ino)
+      : name_(std::move(name)), base_(base), size_(size), dev_(dev),
+        ino_(ino) {}
+
+  /** @brief Write one sample of type `kind` to `channel`. */
+  std::expected<void, ModbusError> write(size_t channel,
+                                         SampleShmChannel::Kind kind,
+                                         const void *sample, size_t size);
+
+  std::string name_;
+  void *base_{nullptr};
+  size_t size_{0};
+
+  /** @brief Device and inode of the segment as created. */
+  dev_t dev_{0};
+  ino_t ino_{0};
+};
+
+// ---------------------------------------------------------------------------
+// SampleReader — reads samples from a segment
+// ---------------------------------------------------------------------------
+
+/**
+ * @class SampleReader
+ * @brief Maps a sample segment read-only and reads samples from it.
+ *
+ * Reading copies the sample straight out of the mapping, checked by the
+ * entry's sequence lock; it neither allocates nor enters the kernel.
+ * Thread-safe: the reader itself has no mutable state.
+ */
+class SampleReader {
+public:
+  /**
+   * @brief Open the segment `name` created by a `SamplePublisher`.
+   *
+   * @return The reader, or the error opening the segment: `ENOENT` if no
+   *         publisher created it, `EAGAIN` if it is still being laid out,
+   *         `EINVAL` if it was written by an incompatible publisher.
+   */
+  static std::expected<std::unique_ptr<SampleReader>, ModbusError>
+  open(const std::string &name);
+
+  /** @brief Unmap the segment. */
+  ~SampleReader();
+
+  // Non-copyable, non-movable.
+  SampleReader(const SampleReader &) = delete;
+  SampleReader &operator=(const SampleReader &) = delete;
+  SampleReader(SampleReader &&) = delete;
+  SampleReader &operator=(SampleReader &&) = delete;
+
+  /** @brief Number of channels. */
+  size_t channels() const { return header().channels; }
+
+  /** @brief Index of the channel called `name`, if any. */
+  std::optional<size_t> find(std::string_view name) const;
+
+  /** @brief Name of `channel`, which must exist. */
+  std::string_view channelName(size_t channel) const {
+    const auto &name = at(channel).name;
+    return {name.data(), strnlen(name.data(), name.size())};
+  }
+
+  /** @brief Sample type of `channel`, which must exist. */
+  SampleShmChannel::Kind kind(size_t channel) const { return at(channel).kind; }
+
+  /**
+   * @brief Samples published to `channel` so far.
+   *
+   * One atomic load; poll it to see whether a new sample arrived.
+   */
+  uint64_t published(size_t channel) const;
+
+  /**
+   * @brief Copy the latest inverter sample of `channel` into `out`.
+   *
+   * @return Its publication number, counted from 1, or `ENODATA` if none
+   *         was published yet, `EINVAL` if `channel` does not exist or
+   *         carries meter samples, `EAGAIN` if the publisher kept
+   *         overwriting the entry being read.
+   */
+  std::expected<uint64_t, ModbusError> latest(size_t channel,
+                                              InverterSample &out) const;
+
+  /** @brief Meter counterpart of `latest(size_t, InverterSample &)`. */
+  std::expected<uint64_t, ModbusError> latest(size_t channel,
+                                              MeterSample &out) const;
+
+  /**
+   * @brief Copy publication `n` of `channel` into `out`.
+   *
+   * Lets a reader that polls slower than the publisher catch up on the
+   * samples it missed, as long as they are still in the ring.
+   *
+   * @return Empty expected, or `ENODATA` if `n` was not published yet or
+   *         has been overwritten, `EINVAL` as for `latest()`.
+   */
+  std::expected<void, ModbusError> read(size_t channel, uint64_t n,
+                                        InverterSample &out) const;
+
+  /** @brief Meter counterpart of `read(size_t, uint64_t, InverterSample &)`. */
+  std::expected<void, ModbusError> read(size_t channel, uint64_t n,
+                                        MeterSample &out) const;
+
+  /**
+   * @brief True if the publisher removed or replaced the segment.
+   *
+   * Costs an `fstat()`; check it on a slow timer, or when `published()`
+   * stops advancing, and reopen the segment if it returns true.
+   */
+  bool stale() const;
+
+  /** @brief Name of the segment. */
+  const std::string &name() const { return name_; }
+
+private:
+  SampleReader(std::string name, int fd, const void *base, size_t size)
+      : name_(std::move(name)), fd_(fd), base_(base), size_(size) {}
+
+  const SampleShmHeader &header() const {
+    return *static_cast<const SampleShmHeader *>(base_);
+  }
+
+  const SampleShmChannel &at(size_t channel) const {
+    const auto *base = static_cast<const uint8_t *>(base_);
+    return *reinterpret_cast<const SampleShmChannel *>(
+        base + header().headerSize + channel * header().channelSize);
+  }
+
+  /**
+   * @brief `channel`, if it exists and carries `kind` samples of `size`
+   *        bytes; `what` names the caller.
+   */
+  std::expected<const SampleShmChannel *, ModbusError>
+  checked(size_t channel, SampleShmChannel::Kind kind, size_t size,
+          const char *what) const;
+
+  /** @brief Latest sample of type `kind`, see `latest()`. */
+  std::expected<uint64_t, ModbusError>
+  readLatest(size_t channel, SampleShmChannel::Kind kind, void *out,
+             size_t size) const;
+
+  /** @brief Publication `n` of type `kind`, see `read()`. */
+  std::expected<void, ModbusError> readAt(size_t channel,
+                                          SampleShmChannel::Kind kind,
+                                          uint64_t n, void *out,
+                                          size_t size) const;
+
+  std::string name_;
+
+  /** @brief Kept open for `stale()`. */
+  int fd_{-1};
+
+  const void *base_{nullptr};
+  size_t size_{0};
+};
+
+#endif /* SAMPLE_PUBLISHER_H_ */
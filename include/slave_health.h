@@ -0,0 +1,158 @@
+/**
+ * @file slave_health.h
+ * @brief Adaptive response timeout and circuit breaker of one slave.
+ *
+ * @details
+ * A fixed response timeout has to cover the slowest answer a slave ever
+ * gives, so a slave that stopped answering costs that much on every poll,
+ * and on a shared RTU bus every device queued behind it waits as well.
+ * `SlaveHealth` keeps the latencies of a slave's recent successful reads
+ * and derives its timeout from them: a high quantile times a margin,
+ * bounded by a floor and by the configured timeout. A timeout doubles the
+ * derived value until answers come back, so a slave that merely got
+ * slower is not starved. After a run of timeouts the breaker parks the
+ * slave: its reads fail at once until a validation probe gets an answer.
+ */
+
+#ifndef SLAVE_HEALTH_H_
+#define SLAVE_HEALTH_H_
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @class SlaveHealth
+ * @brief Latency window, derived timeout, and breaker state of a slave.
+ *
+ * The `record*()` methods must be called from one thread at a time, the
+ * thread issuing the bus's reads. `timeout()` and `parked()` may be read
+ * from any thread.
+ */
+class SlaveHealth {
+public:
+  /** @brief Latencies kept for the quantile. */
+  static constexpr size_t WINDOW = 128;
+
+  /** @brief Successful reads between two recomputations. */
+  static constexpr size_t REFRESH = 16;
+
+  /** @brief Quantile of the window the timeout is derived from. */
+  static constexpr double QUANTILE = 0.99;
+
+  /**
+   * @struct Policy
+   * @brief How the timeout is derived and when the breaker opens.
+   */
+  struct Policy {
+    /** @brief Derive the timeout from observed latency. */
+    bool adaptive{false};
+
+    /** @brief Factor applied to the latency quantile. */
+    double margin{3.0};
+
+    /** @brief Lowest derived timeout. */
+    std::chrono::microseconds minTimeout{20000};
+
+    /** @brief Consecutive timeouts that park the slave; 0 never does. */
+    int breakerThreshold{0};
+  };
+
+  /** @brief Start with no samples and the breaker closed. */
+  explicit SlaveHealth(const Policy &policy) : policy_(policy) {}
+
+  /**
+   * @brief Response timeout to apply to a read.
+   *
+   * @param configured  Timeout configured for the device; the upper bound.
+   * @return The derived timeout, or `configured` while not adaptive or
+   *         before the first `REFRESH` answers.
+   */
+  std::chrono::microseconds
+  timeout(std::chrono::microseconds configured) const {
+    const int64_t derived = derivedUs_.load(std::memory_order_relaxed);
+    if (derived == 0)
+      return configured;
+    return std::min(configured, std::chrono::microseconds(derived));
+  }
+
+  /** @brief True while the breaker holds the slave's reads back. */
+  bool parked() const { return parked_.load(std::memory_order_acquire); }
+
+  /**
+   * @brief Account for an answered read.
+   *
+   * Closes the breaker, and every `REFRESH` answers recomputes the
+   * derived timeout from the window.
+   */
+  void recordSuccess(std::chrono::microseconds latency) {
+    timeouts_ = 0;
+    parked_.store(false, std::memory_order_release);
+    if (!policy_.adaptive)
+      return;
+
+    window_[next_++ % WINDOW] = static_cast<uint32_t>(
+        std::clamp<int64_t>(latency.count(), 0, UINT32_MAX));
+    if (next_ % REFRESH != 0)
+      return;
+
+    // Quantile of the filled part of the window
+    const size_t n = std::min(next_, WINDOW);
+    std::array<uint32_t, WINDOW> sorted = window_;
+    const size_t k = static_cast<size_t>(
+        std::ceil(QUANTILE * static_cast<double>(n))) - 1;
+    std::nth_element(sorted.begin(), sorted.begin() + k, sorted.begin() + n);
+
+    const double us = static_cast<double>(sorted[k]) * policy_.margin;
+    const int64_t floorUs = policy_.minTimeout.count();
+    derivedUs_.store(std::max(static_cast<int64_t>(us), floorUs),
+                     std::memory_order_relaxed);
+  }
+
+  /**
+   * @brief Account for a read that timed out.
+   *
+   * Doubles the derived timeout and counts towards the breaker.
+   *
+   * @param configured  Timeout configured for the device; the upper bound.
+   * @return True if this timeout parked the slave.
+   */
+  bool recordTimeout(std::chrono::microseconds configured) {
+    const int64_t derived = derivedUs_.load(std::memory_order_relaxed);
+    if (derived != 0)
+      derivedUs_.store(std::min<int64_t>(derived * 2, configured.count()),
+                       std::memory_order_relaxed);
+
+    if (policy_.breakerThreshold == 0 || parked())
+      return false;
+    if (++timeouts_ < policy_.breakerThreshold)
+      return false;
+
+    parked_.store(true, std::memory_order_release);
+    return true;
+  }
+
+  /** @brief Account for a read that failed other than by a timeout. */
+  void recordFailure() { timeouts_ = 0; }
+
+private:
+  const Policy policy_;
+
+  /** @brief Latest answer latencies in µs, a ring indexed by `next_`. */
+  std::array<uint32_t, WINDOW> window_{};
+  size_t next_{0};
+
+  /** @brief Consecutive timeouts. */
+  int timeouts_{0};
+
+  /** @brief Derived timeout in µs; 0 until there are enough samples. */
+  std::atomic<int64_t> derivedUs_{0};
+
+  std::atomic<bool> parked_{false};
+};
+
+#endif /* SLAVE_HEALTH_H_ */
@@ -0,0 +1,218 @@
+/**
+ * @file sunspec_discovery.h
+ * @brief SunSpec model-chain discovery with pipelined reads.
+ *
+ * @details
+ * A SunSpec register map is a chain of models, each starting with an ID
+ * and a length register, terminated by the end marker `0xFFFF, 0`. Instead
+ * of probing every model at a hardcoded address with one blocking read per
+ * step, `SunSpecDiscovery` reads the part of the map every supported device
+ * has in maximally sized transactions that are all queued before the first
+ * one is awaited, then walks the model headers in memory. The resulting
+ * `SunSpecModelTable` records where each model actually sits, so devices
+ * derive register addresses from the chain rather than from fixed
+ * float/storage offsets.
+ *
+ * Models beyond the initial sweep (the float encoding, a storage block)
+ * are read while walking: the remainder of the current model together
+ * with the next header, one round trip per model. The walk never reads
+ * past the end marker, which a device would reject with an illegal-address
+ * exception.
+ */
+
+#ifndef SUNSPEC_DISCOVERY_H_
+#define SUNSPEC_DISCOVERY_H_
+
+#include "fronius_bus.h"
+#include "modbus_error.h"
+#include "register_base.h"
+#include "register_buffer.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <expected>
+#include <functional>
+#include <initializer_list>
+#include <utility>
+#include <vector>
+
+/**
+ * @class SunSpecModelTable
+ * @brief Models found in a device's SunSpec chain, in chain order.
+ */
+class SunSpecModelTable {
+public:
+  /**
+   * @struct Model
+   * @brief One model of the chain.
+   */
+  struct Model {
+    /** @brief SunSpec model ID. */
+    uint16_t id{0};
+
+    /** @brief Address of the model's ID register. */
+    uint16_t addr{0};
+
+    /** @brief Value of the model's length register (body size). */
+    uint16_t length{0};
+  };
+
+  /** @brief Maximum number of models a chain may contain. */
+  static constexpr size_t MAX_MODELS = 16;
+
+  /** @brief Remove all models. */
+  void clear() {
+    count_ = 0;
+    endAddr_ = 0;
+  }
+
+  /** @brief Number of models, excluding the end marker. */
+  size_t size() const { return count_; }
+
+  const Model *begin() const { return models_.data(); }
+  const Model *end() const { return models_.data() + count_; }
+
+  /** @brief Address of the end marker, or 0 before a complete walk. */
+  uint16_t endAddr() const { return endAddr_; }
+
+  /**
+   * @brief Append a model to the chain.
+   *
+   * @return False if the table already holds `MAX_MODELS` models.
+   */
+  bool append(const Model &model) {
+    if (count_ == MAX_MODELS)
+      return false;
+    models_[count_++] = model;
+    return true;
+  }
+
+  /** @brief Record the address of the end marker. */
+  void terminate(uint16_t endAddr) { endAddr_ = endAddr; }
+
+  /** @brief First model with the given ID, or null. */
+  const Model *find(uint16_t id) const {
+    for (const Model &m : *this)
+      if (m.id == id)
+        return &m;
+    return nullptr;
+  }
+
+  /** @brief First model whose ID is one of `ids`, or null. */
+  const Model *findAny(std::initializer_list<uint16_t> ids) const {
+    for (const Model &m : *this)
+      for (uint16_t id : ids)
+        if (m.id == id)
+          return &m;
+    return nullptr;
+  }
+
+  /**
+   * @brief Distance between a model's actual and documented position.
+   *
+   * Register definitions carry the addresses of one reference map; adding
+   * the offset to them yields the addresses on this device.
+   *
+   * @param model       Model found in this table.
+   * @param documented  The model's ID register in the reference map.
+   */
+  static int16_t offset(const Model &model, const Register &documented) {
+    return static_cast<int16_t>(model.addr - documented.ADDR);
+  }
+
+private:
+  std::array<Model, MAX_MODELS> models_{};
+  size_t count_{0};
+  uint16_t endAddr_{0};
+};
+
+/**
+ * @class SunSpecDiscovery
+ * @brief Reads and walks the SunSpec model chain of one device.
+ *
+ * Writes into the device's open register update; every address it reads
+ * must be stored in that buffer. Blocks the calling thread, so it must
+ * not run on the bus thread.
+ */
+class SunSpecDiscovery {
+public:
+  /** @brief Builds a read transaction for `count` registers at `start`. */
+  using MakeTransaction =
+      std::function<FroniusBus::Transaction(uint16_t start, uint16_t count)>;
+
+  /**
+   * @brief Bind the discovery to a bus and a destination buffer.
+   *
+   * @param bus   Bus the device is attached to.
+   * @param regs  Register update of the device, as filled by the
+   *              transactions `make` builds.
+   * @param make  Transaction factory of the device (slave ID, timeouts).
+   */
+  SunSpecDiscovery(FroniusBus &bus, const RegisterBuffer &regs,
+                   MakeTransaction make)
+      : bus_(bus), regs_(regs), make_(std::move(make)) {}
+
+  /**
+   * @brief Walk the model chain starting at `start`.
+   *
+   * `start` is the address of the `SunS` signature. Verifies the
+   * signature and that the chain is terminated before `end`.
+   *
+   * @param start  Address of the SunSpec signature.
+   * @param known  End of the range every supported map contains; read up
+   *               front in one pipelined sweep.
+   * @param end    Limit for the end marker; the chain is read on demand
+   *               up to here.
+   * @return The model table, or the first bus error or `EINVAL` for a
+   *         malformed map.
+   */
+  std::expected<SunSpecModelTable, ModbusError>
+  discover(uint16_t start, uint16_t known, uint16_t end);
+
+  /**
+   * @brief Make sure `count` registers at `addr` have been read.
+   *
+   * No-op if a successful read of this discovery already covered the
+   * range; otherwise reads all of it.
+   */
+  std::expected<void, ModbusError> ensure(uint16_t addr, uint16_t count);
+
+  /**
+   * @brief Check a previously discovered chain against the device.
+   *
+   * Reads from `start` up to and including the header of the second
+   * model — the signature, the common block, and the device's own model
+   * header — in one request, and compares the headers with `table`.
+   *
+   * @return True if they match, false if the device has changed; or the
+   *         bus error.
+   */
+  std::expected<bool, ModbusError> confirm(uint16_t start,
+                                           const SunSpecModelTable &table);
+
+private:
+  FroniusBus &bus_;
+  const RegisterBuffer &regs_;
+  MakeTransaction make_;
+
+  /** @brief Half-open address range `[first, last)` read successfully. */
+  struct Range {
+    uint32_t first;
+    uint32_t last;
+  };
+
+  /** @brief Ranges read so far. */
+  std::vector<Range> covered_;
+
+  /** @brief Read `[first, last)` in maximum-size chunks, all queued at
+   * once. */
+  std::expected<void, ModbusError> read(uint32_t first, uint32_t last);
+
+  /** @brief End of the covered range containing `addr`, or `addr`. */
+  uint32_t coveredUntil(uint32_t addr) const;
+
+  /** @brief True if `[first, last)` lies within one covered range. */
+  bool isCovered(uint32_t first, uint32_t last) const;
+};
+
+#endif /* SUNSPEC_DISCOVERY_H_ */
@@ -0,0 +1,249 @@
+/**
+ * @file fronius_sim.cpp
+ * @brief Command-line front end of the Fronius device simulator.
+ *
+ * @details
+ * Serves simulated inverters and meters on a range of Modbus TCP ports
+ * until interrupted, spreading the endpoints over one or more server
+ * threads, and prints request counters at a fixed interval. Run with
+ * `--help` for the options.
+ */
+
+#include "sim_device.h"
+#include "sim_server.h"
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <csignal>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <exception>
+#include <format>
+#include <memory>
+#include <pthread.h>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+namespace {
+
+constexpr const char *USAGE = R"(Usage: fronius-sim [options]
+
+Serve simulated Fronius inverters and meters over Modbus TCP.
+
+Options:
+  -a, --address ADDR        IPv4 address to listen on (default 127.0.0.1)
+  -p, --port PORT           port of the first endpoint (default 1502)
+  -n, --endpoints N         endpoints on consecutive ports (default 1)
+  -d, --device PROFILE@IDS  devices of every endpoint, repeatable, e.g.
+                            i103@1, i113-hybrid@1, m203@240, ts65a3@2-4
+                            (default i103@1 and m203@240)
+  -t, --threads N           server threads sharing the endpoints (default 1)
+      --latency MS          fixed response delay (default 0)
+      --jitter MS           maximum random extra delay (default 0)
+      --timeout-rate P      share of requests never answered (default 0)
+      --busy-rate P         share answered with "device busy" (default 0)
+      --drop-rate P         share answered by closing the connection
+                            (default 0)
+      --update MS           measurement update interval (default 1000)
+      --stats S             print counters every S seconds, 0 to disable
+                            (default 10)
+      --seed N              seed of values and faults (default 1)
+  -h, --help                show this help
+
+Profiles: i101-i103, i111-i113 (inverters, -hybrid adds storage),
+          m201-m203, m211-m213 (SunSpec meters), ts65a3 (proprietary map)
+)";
+
+/** Parse a number, throwing `std::invalid_argument` naming `option`. */
+template <typename T> T number(std::string_view option, std::string_view s) {
+  T value{};
+  const auto [end, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  if (ec != std::errc() || end != s.data() + s.size())
+    throw std::invalid_argument(
+        std::format("{}: invalid number '{}'", option, s));
+  return value;
+}
+
+/** Parse a delay in milliseconds, fractions allowed. */
+std::chrono::microseconds delay(std::string_view option, std::string_view s) {
+  const double ms = number<double>(option, s);
+  if (ms < 0)
+    throw std::invalid_argument(
+        std::format("{}: must not be negative", option));
+  return std::chrono::microseconds(static_cast<int64_t>(ms * 1000.0));
+}
+
+/** Parse `PROFILE@IDS`, where IDS is a list of IDs and ID ranges. */
+void addDevices(std::string_view spec,
+                std::vector<SimServerConfig::Device> &devices) {
+  const size_t at = spec.find('@');
+  if (at == std::string_view::npos)
+    throw std::invalid_argument(
+        std::format("--device: expected PROFILE@IDS, got '{}'", spec));
+
+  const SimProfile profile = SimProfile::parse(spec.substr(0, at));
+  std::string_view ids = spec.substr(at + 1);
+  while (!ids.empty()) {
+    const size_t comma = ids.find(',');
+    const std::string_view item = ids.substr(0, comma);
+    ids = comma == std::string_view::npos ? std::string_view{}
+                                          : ids.substr(comma + 1);
+
+    const size_t dash = item.find('-');
+    const int first = number<int>("--device", item.substr(0, dash));
+    const int last = dash == std::string_view::npos
+                         ? first
+                         : number<int>("--device", item.substr(dash + 1));
+    if (first < 1 || last > 247 || first > last)
+      throw std::invalid_argument(std::format(
+          "--device: invalid unit IDs '{}', expected 1-247", item));
+    for (int unit = first; unit <= last; ++unit)
+      devices.push_back({profile, static_cast<uint8_t>(unit)});
+  }
+}
+
+/** Print the summed counters of all servers. */
+void printStats(const std::vector<std::unique_ptr<SimServer>> &servers,
+                SimServer::Stats &last, double seconds) {
+  SimServer::Stats s;
+  for (const auto &server : servers) {
+    const SimServer::Stats t = server->stats();
+    s.connections += t.connections;
+    s.requests += t.requests;
+    s.responses += t.responses;
+    s.exceptions += t.exceptions;
+    s.timeouts += t.timeouts;
+    s.drops += t.drops;
+  }
+  std::printf("connections=%llu requests=%llu (%.0f/s) responses=%llu "
+              "exceptions=%llu timeouts=%llu drops=%llu\n",
+              static_cast<unsigned long long>(s.connections),
+              static_cast<unsigned long long>(s.requests),
+              static_cast<double>(s.requests - last.requests) / seconds,
+              static_cast<unsigned long long>(s.responses),
+              static_cast<unsigned long long>(s.exceptions),
+              static_cast<unsigned long long>(s.timeouts),
+              static_cast<unsigned long long>(s.drops));
+  std::fflush(stdout);
+  last = s;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  SimServerConfig cfg;
+  int threads = 1;
+  int statsInterval = 10;
+
+  try {
+    for (int i = 1; i < argc; ++i) {
+      const std::string_view arg = argv[i];
+      if (arg == "-h" || arg == "--help") {
+        std::fputs(USAGE, stdout);
+        return 0;
+      }
+      if (i + 1 >= argc)
+        throw std::invalid_argument(
+            std::format("{}: unknown option or missing value", arg));
+      const std::string_view value = argv[++i];
+
+      if (arg == "-a" || arg == "--address")
+        cfg.address = value;
+      else if (arg == "-p" || arg == "--port")
+        cfg.firstPort = number<uint16_t>(arg, value);
+      else if (arg == "-n" || arg == "--endpoints")
+        cfg.endpoints = number<int>(arg, value);
+      else if (arg == "-d" || arg == "--device")
+        addDevices(value, cfg.devices);
+      else if (arg == "-t" || arg == "--threads")
+        threads = number<int>(arg, value);
+      else if (arg == "--latency")
+        cfg.faults.latency = delay(arg, value);
+      else if (arg == "--jitter")
+        cfg.faults.jitter = delay(arg, value);
+      else if (arg == "--timeout-rate")
+        cfg.faults.timeoutRate = number<double>(arg, value);
+      else if (arg == "--busy-rate")
+        cfg.faults.busyRate = number<double>(arg, value);
+      else if (arg == "--drop-rate")
+        cfg.faults.dropRate = number<double>(arg, value);
+      else if (arg == "--update")
+        cfg.updateInterval =
+            std::chrono::milliseconds(number<int>(arg, value));
+      else if (arg == "--stats")
+        statsInterval = number<int>(arg, value);
+      else if (arg == "--seed")
+        cfg.seed = number<uint32_t>(arg, value);
+      else
+        throw std::invalid_argument(std::format("{}: unknown option", arg));
+    }
+
+    if (cfg.devices.empty()) {
+      addDevices("i103@1", cfg.devices);
+      addDevices("m203@240", cfg.devices);
+    }
+    if (threads < 1 || threads > cfg.endpoints)
+      throw std::invalid_argument(
+          std::format("--threads: expected 1-{} for {} endpoints",
+                      std::max(cfg.endpoints, 1), cfg.endpoints));
+    if (statsInterval < 0)
+      throw std::invalid_argument("--stats: must not be negative");
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "fronius-sim: %s\n%s", e.what(), USAGE);
+    return 2;
+  }
+
+  // Handle the stop signals synchronously; the server threads inherit the
+  // blocked mask
+  sigset_t stop;
+  sigemptyset(&stop);
+  sigaddset(&stop, SIGINT);
+  sigaddset(&stop, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &stop, nullptr);
+
+  // Endpoints are split into consecutive port ranges, one per thread
+  std::vector<std::unique_ptr<SimServer>> servers;
+  try {
+    int port = cfg.firstPort;
+    for (int t = 0; t < threads; ++t) {
+      SimServerConfig part = cfg;
+      part.firstPort = static_cast<uint16_t>(port);
+      part.endpoints = cfg.endpoints / threads + (t < cfg.endpoints % threads);
+      part.seed = cfg.seed + static_cast<uint32_t>(t);
+      port += part.endpoints;
+      servers.push_back(std::make_unique<SimServer>(part));
+    }
+  } catch (const std::exception &e) {
+    std::fprintf(stderr, "fronius-sim: %s\n", e.what());
+    return 1;
+  }
+
+  std::string units;
+  for (const auto &d : cfg.devices)
+    units += std::format(" {}@{}", d.profile.toString(), d.unit);
+  std::printf("fronius-sim: %d endpoint(s) on %s:%d-%d, %d thread(s),"
+              " devices:%s\n",
+              cfg.endpoints, cfg.address.c_str(), cfg.firstPort,
+              cfg.firstPort + cfg.endpoints - 1, threads, units.c_str());
+  std::fflush(stdout);
+
+  SimServer::Stats last;
+  for (;;) {
+    int sig = 0;
+    if (statsInterval == 0) {
+      sigwait(&stop, &sig);
+      break;
+    }
+    timespec ts{statsInterval, 0};
+    if (sigtimedwait(&stop, nullptr, &ts) != -1)
+      break;
+    printStats(servers, last, statsInterval);
+  }
+
+  servers.clear();
+  return 0;
+}
@@ -0,0 +1,603 @@
+#include "sim_device.h"
+#include "common_registers.h"
+#include "inverter_registers.h"
+#include "meter_registers.h"
+#include "modbus_utils.h"
+#include "register_base.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <format>
+#include <modbus/modbus.h>
+#include <new>
+#include <numbers>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/** Registers of an inverter map, up to the end block of a hybrid. */
+constexpr int INVERTER_REGISTERS = I_END::L.ADDR + I_END::FLOAT_OFFSET +
+                                   I_END::STORAGE_OFFSET + I_END::L.NB;
+
+/** Registers of a SunSpec meter map, up to the float end block. */
+constexpr int METER_REGISTERS =
+    M_END::L.ADDR + M_END::FLOAT_OFFSET + M_END::L.NB;
+
+/** Registers of the proprietary map, up to the serial number. */
+constexpr int TS65A3_REGISTERS = REG::SN.ADDR + REG::SN.NB;
+
+/** Period of the simulated power curve in seconds. */
+constexpr double CYCLE = 600.0;
+
+/** Nominal phase voltage and grid frequency. */
+constexpr double VOLTAGE = 230.0;
+constexpr double FREQUENCY = 50.0;
+
+/** Device type reported by a TS 65A-3 in REG::ID. */
+constexpr uint16_t TS65A3_ID = 731;
+
+/** SunSpec operating states (I10X::ST). */
+constexpr uint16_t STATE_SLEEPING = 2;
+constexpr uint16_t STATE_MPPT = 4;
+
+/** Model ID and length of the SunSpec common block and end marker. */
+constexpr uint16_t COMMON_ID = 1;
+constexpr uint16_t END_ID = 0xFFFF;
+
+/** Length of model 121 (basic settings), which has no register header. */
+constexpr uint16_t I121_SIZE = 30;
+
+/** Ratio of line-to-line to line-to-neutral voltage. */
+constexpr double LINE_TO_LINE = std::numbers::sqrt3;
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   SimProfile
+   ------------------------------------------------------------------------- */
+
+SimProfile SimProfile::parse(std::string_view name) {
+  SimProfile profile;
+  if (name == "ts65a3") {
+    profile.family = Family::TS65A3;
+    profile.modelId = 0;
+    return profile;
+  }
+
+  std::string_view base = name;
+  constexpr std::string_view HYBRID = "-hybrid";
+  if (base.ends_with(HYBRID)) {
+    profile.hybrid = true;
+    base.remove_suffix(HYBRID.size());
+  }
+
+  const auto invalid = [name] {
+    return std::invalid_argument(
+        std::format("SimProfile: Unknown device profile '{}'", name));
+  };
+
+  if (base.size() != 4 ||
+      !std::all_of(base.begin() + 1, base.end(),
+                   [](char c) { return c >= '0' && c <= '9'; }))
+    throw invalid();
+
+  const uint16_t id = static_cast<uint16_t>((base[1] - '0') * 100 +
+                                            (base[2] - '0') * 10 +
+                                            (base[3] - '0'));
+  const int phases = id % 10;
+  const int encoding = id / 10 % 10;
+  if (phases < 1 || phases > 3 || encoding > 1)
+    throw invalid();
+
+  if (base[0] == 'i' && id / 100 == 1) {
+    profile.family = Family::INVERTER;
+  } else if (base[0] == 'm' && id / 100 == 2 && !profile.hybrid) {
+    profile.family = Family::METER;
+  } else {
+    throw invalid();
+  }
+  profile.modelId = id;
+  return profile;
+}
+
+std::string SimProfile::toString() const {
+  switch (family) {
+  case Family::INVERTER:
+    return std::format("i{}{}", modelId, hybrid ? "-hybrid" : "");
+  case Family::METER:
+    return std::format("m{}", modelId);
+  case Family::TS65A3:
+    return "ts65a3";
+  }
+  return "unknown";
+}
+
+/* -------------------------------------------------------------------------
+   Construction / destruction
+   ------------------------------------------------------------------------- */
+
+SimDevice::SimDevice(const SimProfile &profile, uint8_t unit, uint32_t seed)
+    : profile_(profile), unit_(unit), rng_(seed) {
+  phase_ = std::uniform_real_distribution<double>(0.0, 1.0)(rng_);
+  float_ = profile_.floatModel();
+
+  int registers = INVERTER_REGISTERS;
+  if (profile_.family == SimProfile::Family::METER)
+    registers = METER_REGISTERS;
+  else if (profile_.family == SimProfile::Family::TS65A3)
+    registers = TS65A3_REGISTERS;
+
+  mb_ = modbus_mapping_new(0, 0, registers, 0);
+  if (!mb_)
+    throw std::bad_alloc();
+
+  switch (profile_.family) {
+  case SimProfile::Family::INVERTER:
+    buildInverter();
+    break;
+  case SimProfile::Family::METER:
+    buildMeter();
+    break;
+  case SimProfile::Family::TS65A3:
+    buildProprietary();
+    break;
+  }
+  update(0.0, 0.0);
+}
+
+SimDevice::~SimDevice() { modbus_mapping_free(mb_); }
+
+/* -------------------------------------------------------------------------
+   Requests
+   ------------------------------------------------------------------------- */
+
+uint8_t SimDevice::read(uint16_t addr, uint16_t count, uint8_t *out) const {
+  const uint32_t last = static_cast<uint32_t>(addr) + count;
+  const bool implemented =
+      std::any_of(ranges_.begin(), ranges_.end(), [&](const Range &r) {
+        return addr >= r.first && last <= r.last;
+      });
+  if (!implemented)
+    return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+  for (uint16_t i = 0; i < count; ++i) {
+    const uint16_t v = mb_->tab_registers[addr + i];
+    out[2 * i] = static_cast<uint8_t>(v >> 8);
+    out[2 * i + 1] = static_cast<uint8_t>(v & 0xFF);
+  }
+  return 0;
+}
+
+uint8_t SimDevice::write(uint16_t addr, uint16_t count, const uint8_t *in) {
+  const uint32_t last = static_cast<uint32_t>(addr) + count;
+  const bool implemented =
+      std::any_of(ranges_.begin(), ranges_.end(), [&](const Range &r) {
+        return addr >= r.first && last <= r.last;
+      });
+  if (!implemented)
+    return MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS;
+
+  for (uint16_t i = 0; i < count; ++i)
+    mb_->tab_registers[addr + i] =
+        static_cast<uint16_t>(in[2 * i] << 8 | in[2 * i + 1]);
+  return 0;
+}
+
+/* -------------------------------------------------------------------------
+   Map construction
+   ------------------------------------------------------------------------- */
+
+void SimDevice::expose(uint16_t first, uint16_t count) {
+  ranges_.push_back({first, static_cast<uint32_t>(first) + count});
+  std::sort(ranges_.begin(), ranges_.end(),
+            [](const Range &a, const Range &b) { return a.first < b.first; });
+
+  std::vector<Range> merged;
+  for (const Range &r : ranges_) {
+    if (!merged.empty() && r.first <= merged.back().last)
+      merged.back().last = std::max(merged.back().last, r.last);
+    else
+      merged.push_back(r);
+  }
+  ranges_ = std::move(merged);
+}
+
+uint16_t SimDevice::model(uint16_t addr, uint16_t id, uint16_t length) {
+  mb_->tab_registers[addr] = id;
+  mb_->tab_registers[addr + 1] = length;
+  return static_cast<uint16_t>(addr + 2 + length);
+}
+
+template <typename T> void SimDevice::pack(Register reg, T value) {
+  check(ModbusUtils::packToModbus(mb_, reg, value), reg);
+}
+
+void SimDevice::pack(Register reg, Register sf, double value, int decimals) {
+  check(ModbusUtils::packToModbus(mb_, reg, sf, value, decimals), reg);
+}
+
+void SimDevice::check(const std::expected<void, ModbusError> &res,
+                      const Register &reg) const {
+  // The constructor writes every register once, so a register the map
+  // cannot hold fails the setup instead of being served incomplete
+  if (!res)
+    throw std::logic_error(std::format("SimDevice: Cannot encode {} for {}: {}",
+                                       reg.describe(), profile_.toString(),
+                                       res.error().message));
+}
+
+void SimDevice::put(Register intReg, Register sf, Register floatReg,
+                    double value, int decimals) {
+  if (float_)
+    pack(floatReg, value);
+  else
+    pack(intReg, sf, value, decimals);
+}
+
+void SimDevice::buildCommon(const std::string &name) {
+  pack(C001::SID, 0x53756E53u);
+  model(C001::ID.ADDR, COMMON_ID, C001::SIZE);
+  pack(C001::MN, std::string("Fronius"));
+  pack(C001::MD, name);
+  pack(C001::OPT, std::string("3.28.1-3"));
+  pack(C001::VR, std::string("1.30.7-1"));
+  pack(C001::SN, std::format("{:08}", rng_() % 100000000));
+  pack(C001::DA, unit_);
+}
+
+void SimDevice::buildInverter() {
+  const int phases = profile_.phases();
+  const bool hybrid = profile_.hybrid;
+  offset_ = float_ ? I120::FLOAT_OFFSET : 0;
+  rating_ = phases == 1 ? 5000.0 : 10000.0;
+
+  const char *name = hybrid        ? "Symo GEN24 10.0 Plus"
+                     : phases == 1 ? "Primo 5.0-1"
+                                   : "Symo 10.0-3-M";
+  buildCommon(name);
+
+  // Fronius registers outside the SunSpec map
+  expose(F::DELETE_DATA.ADDR,
+         F::STORAGE_RESTRICTIONS_VIEW_MODE.ADDR + 1 - F::DELETE_DATA.ADDR);
+  expose(F::SITE_POWER.ADDR, F::SITE_ENERGY_TOTAL.ADDR +
+                                 F::SITE_ENERGY_TOTAL.NB - F::SITE_POWER.ADDR);
+  pack(F::MODEL_TYPE, float_ ? 1 : 2);
+
+  // Model chain, in the order of a Datamanager
+  uint16_t next = model(I10X::ID.ADDR, profile_.modelId,
+                        float_ ? I11X::SIZE : I10X::SIZE);
+  next = model(next, 120, I120::SIZE);
+  next = model(next, 121, I121_SIZE);
+  next = model(next, 122, I122::SIZE);
+  next = model(next, 123, I123::SIZE);
+  next = model(next, 160, I160::SIZE);
+  if (hybrid)
+    next = model(next, 124, I124::SIZE - I124::ID.NB - I124::L.NB);
+  next = model(next, END_ID, 0);
+  expose(C001::SID.ADDR, static_cast<uint16_t>(next - C001::SID.ADDR));
+
+  const auto at = [this](Register reg) { return reg.withOffset(offset_); };
+
+  // Vendor events, fixed for the lifetime of the device
+  pack(float_ ? I11X::EVTVND1 : I10X::EVTVND1, profile_.events[0]);
+  pack(float_ ? I11X::EVTVND2 : I10X::EVTVND2, profile_.events[1]);
+  pack(float_ ? I11X::EVTVND3 : I10X::EVTVND3, profile_.events[2]);
+
+  // Nameplate
+  pack(at(I120::DERTYP), hybrid ? 82 : 4);
+  pack(at(I120::WRTG), at(I120::WRTG_SF), rating_, 0);
+  pack(at(I120::VARTG), at(I120::VARTG_SF), rating_, 0);
+  pack(at(I120::VARRTGQ1), at(I120::VARRTG_SF), rating_ * 0.6, 0);
+  pack(at(I120::VARRTGQ4), at(I120::VARRTG_SF), -rating_ * 0.6, 0);
+  pack(at(I120::ARTG), at(I120::ARTG_SF), rating_ / (phases * VOLTAGE), 2);
+  pack(at(I120::PFRTGQ1), at(I120::PFRTG_SF), 0.85, 2);
+  pack(at(I120::PFRTGQ4), at(I120::PFRTG_SF), -0.85, 2);
+  if (hybrid) {
+    pack(at(I120::WHRTG), at(I120::WHRTG_SF), 10240.0, 0);
+    pack(at(I120::MAXCHARTE), at(I120::MAXCHARTE_SF), rating_ / 2, 0);
+    pack(at(I120::MAXDISCHARTE), at(I120::MAXDISCHARTE_SF), rating_ / 2, 0);
+  }
+
+  // Extended measurements and immediate controls
+  pack(at(I122::PVCONN), 7);
+  pack(at(I122::STORCONN), hybrid ? 7 : 0);
+  pack(at(I122::ECPCONN), 1);
+  pack(at(I123::CONN), 1);
+  pack(at(I123::WMAXLIMPCT), at(I123::WMAXLIMPCT_SF), 100.0, 2);
+  pack(at(I123::OUTPFSET), at(I123::OUTPFSET_SF), 1.0, 3);
+  pack(at(I123::VARMAXPCT), at(I123::VARPCT_SF), 0.0, 0);
+
+  // Two MPPT inputs
+  pack(at(I160::N), 2);
+  pack(at(I160::ID_1), 1);
+  pack(at(I160::IDSTR_1), std::string("String 1"));
+  pack(at(I160::ID_2), 2);
+  pack(at(I160::IDSTR_2), std::string("String 2"));
+
+  // Storage
+  if (hybrid) {
+    pack(at(I124::WCHAMAX), at(I124::WCHAMAX_SF), rating_ / 2, 0);
+    pack(at(I124::WCHAGRA), at(I124::WCHADISCHAGRA_SF), 100.0, 0);
+    pack(at(I124::WDISCHAGRA), at(I124::WCHADISCHAGRA_SF), 100.0, 0);
+    pack(at(I124::MINRSVPCT), at(I124::MINRSVPCT_SF), 5.0, 2);
+    pack(at(I124::OUTWRTE), at(I124::INOUTWRTE_SF), 100.0, 2);
+    pack(at(I124::INWRTE), at(I124::INOUTWRTE_SF), 100.0, 2);
+    pack(at(I124::CHAGRISET), 1);
+  }
+}
+
+void SimDevice::buildMeter() {
+  rating_ = profile_.phases() == 1 ? 4000.0 : 12000.0;
+  buildCommon("Smart Meter 63A");
+
+  uint16_t next = model(M20X::ID.ADDR, profile_.modelId,
+                        float_ ? M21X::SIZE : M20X::SIZE);
+  next = model(next, END_ID, 0);
+  expose(C001::SID.ADDR, static_cast<uint16_t>(next - C001::SID.ADDR));
+}
+
+void SimDevice::buildProprietary() {
+  rating_ = 12000.0;
+
+  // Identification, measurement and energy blocks of the register map
+  expose(REG::ID.ADDR, REG::ID.NB);
+  expose(REG::SN.ADDR, REG::SN.NB);
+  expose(REG::VR_MAJOR.ADDR, REG::VR_MAJOR.NB + REG::VR_MINOR.NB);
+  expose(REG::PHV.ADDR, REG::PFPHC.ADDR + REG::PFPHC.NB - REG::PHV.ADDR);
+  expose(REG::TOT_KWH_IMP.ADDR,
+         REG::TOT_VARH_EXP.ADDR + REG::TOT_VARH_EXP.NB - REG::TOT_KWH_IMP.ADDR);
+
+  pack(REG::ID, TS65A3_ID);
+  pack(REG::SN, static_cast<uint32_t>(rng_() % 100000000));
+  pack(REG::VR_MAJOR, 1);
+  pack(REG::VR_MINOR, 7);
+}
+
+/* -------------------------------------------------------------------------
+   Measurements
+   ------------------------------------------------------------------------- */
+
+void SimDevice::update(double t, double dt) {
+  const double angle = 2 * std::numbers::pi * (t / CYCLE + phase_);
+  const double level =
+      std::clamp(0.5 + 0.45 * std::sin(angle) + 0.01 * noise(), 0.0, 1.0);
+
+  switch (profile_.family) {
+  case SimProfile::Family::INVERTER:
+    updateInverter(level, dt);
+    break;
+  case SimProfile::Family::METER:
+    updateMeter(level, dt);
+    break;
+  case SimProfile::Family::TS65A3:
+    updateProprietary(level, dt);
+    break;
+  }
+}
+
+void SimDevice::updateInverter(double level, double dt) {
+  const int phases = profile_.phases();
+  const double power = rating_ * level;
+  energy_ += power * dt / 3600.0;
+
+  std::array<double, 3> voltage{};
+  for (int i = 0; i < phases; ++i)
+    voltage[i] = VOLTAGE + 0.5 * noise();
+  const double current = power / (phases * VOLTAGE);
+  const double reactive = 0.02 * rating_ * noise();
+  const double apparent = std::hypot(power, reactive);
+  const double pf = apparent > 0 ? 100.0 * power / apparent : 100.0;
+
+  // AC side
+  put(I10X::A, I10X::A_SF, I11X::A, current * phases, 2);
+  const std::array<Register, 3> amps{I10X::APHA, I10X::APHB, I10X::APHC};
+  const std::array<Register, 3> ampsF{I11X::APHA, I11X::APHB, I11X::APHC};
+  const std::array<Register, 3> volts{I10X::PHVPHA, I10X::PHVPHB,
+                                      I10X::PHVPHC};
+  const std::array<Register, 3> voltsF{I11X::PHVPHA, I11X::PHVPHB,
+                                       I11X::PHVPHC};
+  const std::array<Register, 3> lines{I10X::PPVPHAB, I10X::PPVPHBC,
+                                      I10X::PPVPHCA};
+  const std::array<Register, 3> linesF{I11X::PPVPHAB, I11X::PPVPHBC,
+                                       I11X::PPVPHCA};
+  for (int i = 0; i < 3; ++i) {
+    const bool present = i < phases;
+    put(amps[i], I10X::A_SF, ampsF[i], present ? current : 0.0, 2);
+    put(volts[i], I10X::V_SF, voltsF[i], voltage[i], 1);
+    put(lines[i], I10X::V_SF, linesF[i],
+        phases == 3 ? voltage[i] * LINE_TO_LINE : 0.0, 1);
+  }
+  put(I10X::W, I10X::W_SF, I11X::W, power, 0);
+  put(I10X::FREQ, I10X::FREQ_SF, I11X::FREQ, FREQUENCY + 0.01 * noise(), 2);
+  put(I10X::VA, I10X::VA_SF, I11X::VA, apparent, 0);
+  put(I10X::VAR, I10X::VAR_SF, I11X::VAR, reactive, 0);
+  put(I10X::PF, I10X::PF_SF, I11X::PF, pf, 1);
+  put(I10X::WH, I10X::WH_SF, I11X::WH, energy_, 0);
+
+  // DC side, split unevenly over the two inputs
+  const double dcPower = power / 0.97;
+  const double dcVoltage = 620.0 + 5.0 * noise();
+  put(I10X::DCA, I10X::DCA_SF, I11X::DCA, dcPower / dcVoltage, 2);
+  put(I10X::DCV, I10X::DCV_SF, I11X::DCV, dcVoltage, 1);
+  put(I10X::DCW, I10X::DCW_SF, I11X::DCW, dcPower, 0);
+
+  const uint16_t state = power > 0 ? STATE_MPPT : STATE_SLEEPING;
+  pack(float_ ? I11X::ST : I10X::ST, state);
+  pack(float_ ? I11X::STVND : I10X::STVND, state);
+
+  const auto at = [this](Register reg) { return reg.withOffset(offset_); };
+  const std::array<double, 2> share{0.55, 0.45};
+  const std::array<Register, 2> dca{I160::DCA_1, I160::DCA_2};
+  const std::array<Register, 2> dcv{I160::DCV_1, I160::DCV_2};
+  const std::array<Register, 2> dcw{I160::DCW_1, I160::DCW_2};
+  const std::array<Register, 2> dcwh{I160::DCWH_1, I160::DCWH_2};
+  const std::array<Register, 2> tmp{I160::TMP_1, I160::TMP_2};
+  const std::array<Register, 2> dcst{I160::DCST_1, I160::DCST_2};
+  for (size_t i = 0; i < 2; ++i) {
+    const double w = dcPower * share[i];
+    const double v = dcVoltage - 20.0 * static_cast<double>(i);
+    mpptEnergy_[i] += w * dt / 3600.0;
+    pack(at(dca[i]), at(I160::DCA_SF), w / v, 2);
+    pack(at(dcv[i]), at(I160::DCV_SF), v, 1);
+    pack(at(dcw[i]), at(I160::DCW_SF), w, 0);
+    pack(at(dcwh[i]), at(I160::DCWH_SF), mpptEnergy_[i], 0);
+    pack(at(tmp[i]), static_cast<int16_t>(std::lround(35 + 10 * level)));
+    pack(at(dcst[i]), state);
+  }
+
+  if (profile_.hybrid)
+    pack(at(I124::CHASTATE), at(I124::CHASTATE_SF), 10.0 + 80.0 * level, 2);
+
+  pack(F::SITE_POWER, static_cast<uint32_t>(std::lround(power)));
+  pack(F::SITE_ENERGY_DAY, static_cast<uint64_t>(energy_));
+  pack(F::SITE_ENERGY_YEAR, static_cast<uint64_t>(energy_));
+  pack(F::SITE_ENERGY_TOTAL, static_cast<uint64_t>(energy_));
+}
+
+void SimDevice::updateMeter(double level, double dt) {
+  const int phases = profile_.phases();
+
+  // Positive while importing from the grid, negative while feeding in
+  const double power = rating_ * (0.5 - level);
+  if (power > 0)
+    energyImport_ += power * dt / 3600.0;
+  else
+    energyExport_ -= power * dt / 3600.0;
+
+  const double reactive = 0.02 * rating_ * noise();
+  const double apparent = std::hypot(power, reactive);
+  const double pf = apparent > 0 ? 100.0 * power / apparent : 100.0;
+  const double share = 1.0 / phases;
+
+  std::array<double, 3> voltage{};
+  for (int i = 0; i < phases; ++i)
+    voltage[i] = VOLTAGE + 0.5 * noise();
+  const double mean = (voltage[0] + voltage[1] + voltage[2]) / phases;
+
+  put(M20X::A, M20X::A_SF, M21X::A, power / VOLTAGE, 2);
+  put(M20X::PHV, M20X::V_SF, M21X::PHV, mean, 1);
+  put(M20X::PPV, M20X::V_SF, M21X::PPV,
+      phases == 3 ? mean * LINE_TO_LINE : 0.0, 1);
+  put(M20X::FREQ, M20X::FREQ_SF, M21X::FREQ, FREQUENCY + 0.01 * noise(), 2);
+  put(M20X::W, M20X::W_SF, M21X::W, power, 0);
+  put(M20X::VA, M20X::VA_SF, M21X::VA, apparent, 0);
+  put(M20X::VAR, M20X::VAR_SF, M21X::VAR, reactive, 0);
+  put(M20X::PF, M20X::PF_SF, M21X::PF, pf, 1);
+  put(M20X::TOT_WH_IMP, M20X::TOT_WH_SF, M21X::TOT_WH_IMP, energyImport_, 0);
+  put(M20X::TOT_WH_EXP, M20X::TOT_WH_SF, M21X::TOT_WH_EXP, energyExport_, 0);
+  put(M20X::TOT_VAH_IMP, M20X::TOT_VAH_SF, M21X::TOT_VAH_IMP, energyImport_,
+      0);
+  put(M20X::TOT_VAH_EXP, M20X::TOT_VAH_SF, M21X::TOT_VAH_EXP, energyExport_,
+      0);
+
+  struct Phase {
+    Register a, v, ppv, w, va, var, pf, whImp, whExp, vahImp, vahExp;
+  };
+  const std::array<Phase, 3> reg{{
+      {M20X::APHA, M20X::PHVPHA, M20X::PPVPHAB, M20X::WPHA, M20X::VAPHA,
+       M20X::VARPHA, M20X::PFPHA, M20X::TOT_WH_IMPPHA, M20X::TOT_WH_EXPPHA,
+       M20X::TOT_VAH_IMPPHA, M20X::TOT_VAH_EXPPHA},
+      {M20X::APHB, M20X::PHVPHB, M20X::PPVPHBC, M20X::WPHB, M20X::VAPHB,
+       M20X::VARPHB, M20X::PFPHB, M20X::TOT_WH_IMPPHB, M20X::TOT_WH_EXPPHB,
+       M20X::TOT_VAH_IMPPHB, M20X::TOT_VAH_EXPPHB},
+      {M20X::APHC, M20X::PHVPHC, M20X::PPVPHCA, M20X::WPHC, M20X::VAPHC,
+       M20X::VARPHC, M20X::PFPHC, M20X::TOT_WH_IMPPHC, M20X::TOT_WH_EXPPHC,
+       M20X::TOT_VAH_IMPPHC, M20X::TOT_VAH_EXPPHC},
+  }};
+  const std::array<Phase, 3> regF{{
+      {M21X::APHA, M21X::PHVPHA, M21X::PPVPHAB, M21X::WPHA, M21X::VAPHA,
+       M21X::VARPHA, M21X::PFPHA, M21X::TOT_WH_IMPPHA, M21X::TOT_WH_EXPPHA,
+       M21X::TOT_VAH_IMPPHA, M21X::TOT_VAH_EXPPHA},
+      {M21X::APHB, M21X::PHVPHB, M21X::PPVPHBC, M21X::WPHB, M21X::VAPHB,
+       M21X::VARPHB, M21X::PFPHB, M21X::TOT_WH_IMPPHB, M21X::TOT_WH_EXPPHB,
+       M21X::TOT_VAH_IMPPHB, M21X::TOT_VAH_EXPPHB},
+      {M21X::APHC, M21X::PHVPHC, M21X::PPVPHCA, M21X::WPHC, M21X::VAPHC,
+       M21X::VARPHC, M21X::PFPHC, M21X::TOT_WH_IMPPHC, M21X::TOT_WH_EXPPHC,
+       M21X::TOT_VAH_IMPPHC, M21X::TOT_VAH_EXPPHC},
+  }};
+
+  for (int i = 0; i < phases; ++i) {
+    const Phase &r = reg[i];
+    const Phase &f = regF[i];
+    const double w = power * share;
+    put(r.a, M20X::A_SF, f.a, w / voltage[i], 2);
+    put(r.v, M20X::V_SF, f.v, voltage[i], 1);
+    put(r.ppv, M20X::V_SF, f.ppv,
+        phases == 3 ? voltage[i] * LINE_TO_LINE : 0.0, 1);
+    put(r.w, M20X::W_SF, f.w, w, 0);
+    put(r.va, M20X::VA_SF, f.va, apparent * share, 0);
+    put(r.var, M20X::VAR_SF, f.var, reactive * share, 0);
+    put(r.pf, M20X::PF_SF, f.pf, pf, 1);
+    put(r.whImp, M20X::TOT_WH_SF, f.whImp, energyImport_ * share, 0);
+    put(r.whExp, M20X::TOT_WH_SF, f.whExp, energyExport_ * share, 0);
+    put(r.vahImp, M20X::TOT_VAH_SF, f.vahImp, energyImport_ * share, 0);
+    put(r.vahExp, M20X::TOT_VAH_SF, f.vahExp, energyExport_ * share, 0);
+  }
+}
+
+void SimDevice::updateProprietary(double level, double dt) {
+  const double power = rating_ * (0.5 - level);
+  if (power > 0)
+    energyImport_ += power * dt / 3600.0;
+  else
+    energyExport_ -= power * dt / 3600.0;
+
+  const double reactive = 0.02 * rating_ * noise();
+  const double apparent = std::hypot(power, reactive);
+  const double pf = apparent > 0 ? 100.0 * power / apparent : 100.0;
+
+  // Values are stored in units of the map's constant scale factors
+  const auto pack32 = [this](Register reg, double value, double scale) {
+    pack(reg, static_cast<int32_t>(std::lround(value / scale)));
+  };
+
+  std::array<double, 3> voltage{};
+  for (double &v : voltage)
+    v = VOLTAGE + 0.5 * noise();
+  const double mean = (voltage[0] + voltage[1] + voltage[2]) / 3;
+
+  pack32(REG::A, power / VOLTAGE, REG::A_SF);
+  pack32(REG::PHV, mean, REG::V_SF);
+  pack32(REG::PPV, mean * LINE_TO_LINE, REG::V_SF);
+  pack32(REG::FREQ, FREQUENCY + 0.01 * noise(), REG::FREQ_SF);
+  pack32(REG::W, power, REG::W_SF);
+  pack32(REG::VA, apparent, REG::VA_SF);
+  pack32(REG::VAR, reactive, REG::VAR_SF);
+  pack32(REG::PF, pf, REG::PF_SF);
+
+  struct Phase {
+    Register a, v, ppv, w, va, var, pf;
+  };
+  const std::array<Phase, 3> reg{{
+      {REG::APHA, REG::PHVPHA, REG::PPVPHAB, REG::WPHA, REG::VAPHA,
+       REG::VARPHA, REG::PFPHA},
+      {REG::APHB, REG::PHVPHB, REG::PPVPHBC, REG::WPHB, REG::VAPHB,
+       REG::VARPHB, REG::PFPHB},
+      {REG::APHC, REG::PHVPHC, REG::PPVPHCA, REG::WPHC, REG::VAPHC,
+       REG::VARPHC, REG::PFPHC},
+  }};
+  for (size_t i = 0; i < reg.size(); ++i) {
+    const Phase &r = reg[i];
+    pack32(r.a, power / 3 / voltage[i], REG::A_SF);
+    pack32(r.v, voltage[i], REG::V_SF);
+    pack32(r.ppv, voltage[i] * LINE_TO_LINE, REG::V_SF);
+    pack32(r.w, power / 3, REG::W_SF);
+    pack32(r.va, apparent / 3, REG::VA_SF);
+    pack32(r.var, reactive / 3, REG::VAR_SF);
+    pack32(r.pf, pf, REG::PF_SF);
+  }
+
+  // Energy counters are split into whole kilowatt-hours and a remainder
+  const auto packEnergy = [&](Register kilo, Register unit, double wh) {
+    const double kwh = std::floor(wh / 1000.0);
+    pack32(kilo, kwh, REG::TOT_SF);
+    pack32(unit, wh - kwh * 1000.0, REG::TOT_SF);
+  };
+  packEnergy(REG::TOT_KWH_IMP, REG::TOT_WH_IMP, energyImport_);
+  packEnergy(REG::TOT_KWH_EXP, REG::TOT_WH_EXP, energyExport_);
+}
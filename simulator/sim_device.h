@@ -0,0 +1,217 @@
+/**
+ * @file sim_device.h
+ * @brief Simulated Fronius inverter or meter register map.
+ *
+ * @details
+ * A `SimDevice` holds the holding registers of one simulated device in a
+ * libmodbus `modbus_mapping_t`, written with `ModbusUtils::packToModbus()`
+ * from the same register constants the library decodes. The maps follow
+ * the layout of real devices: the SunSpec chain of an inverter (common
+ * block, I10X/I11X, I120–I123, I160, optionally I124, end block) plus the
+ * Fronius registers at 211 and 499, the SunSpec chain of a meter (common
+ * block, M20X/M21X, end block), or the proprietary TS 65A-3 map. Reads
+ * outside the implemented ranges are answered with an illegal-address
+ * exception, as the devices do.
+ *
+ * Measurements follow a slow sine with some noise, and energy counters
+ * integrate power, so change detection and deadbands see realistic data.
+ */
+
+#ifndef SIM_DEVICE_H_
+#define SIM_DEVICE_H_
+
+#include "modbus_error.h"
+#include "register_base.h"
+#include <array>
+#include <cstdint>
+#include <expected>
+#include <modbus/modbus.h>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+/**
+ * @struct SimProfile
+ * @brief Kind of simulated device.
+ */
+struct SimProfile {
+  enum class Family : uint8_t {
+    INVERTER, ///< SunSpec inverter (models 101–103, 111–113)
+    METER,    ///< SunSpec meter (models 201–203, 211–213)
+    TS65A3    ///< Smart Meter TS 65A-3 with the proprietary map
+  };
+
+  Family family{Family::INVERTER};
+
+  /** @brief SunSpec model ID; unused for `TS65A3`. */
+  uint16_t modelId{103};
+
+  /** @brief Inverter with a storage block (I124). */
+  bool hybrid{false};
+
+  /** @brief Vendor event flags (EVTVND1–EVTVND3) set on an inverter. */
+  std::array<uint32_t, 3> events{};
+
+  /**
+   * @brief Parse a profile name.
+   *
+   * Accepts `i101`–`i103` and `i111`–`i113` for inverters, optionally
+   * suffixed by `-hybrid`, `m201`–`m203` and `m211`–`m213` for meters, and
+   * `ts65a3`.
+   *
+   * @throws std::invalid_argument if `name` is none of them.
+   */
+  static SimProfile parse(std::string_view name);
+
+  /** @brief Profile name as accepted by `parse()`. */
+  std::string toString() const;
+
+  /** @brief True for the float models (I11X, M21X). */
+  bool floatModel() const { return modelId / 10 % 10 == 1; }
+
+  /** @brief Number of AC phases, 3 for `TS65A3`. */
+  int phases() const { return family == Family::TS65A3 ? 3 : modelId % 10; }
+};
+
+/**
+ * @class SimDevice
+ * @brief Register map of one simulated device.
+ *
+ * Not thread-safe; the owning `SimServer` updates and reads it on its
+ * thread. Non-copyable, non-movable.
+ */
+class SimDevice {
+public:
+  /**
+   * @brief Build the register map of `profile`.
+   *
+   * @param profile  Kind of device.
+   * @param unit     Modbus unit ID (slave ID), reported in C001::DA.
+   * @param seed     Seed of the measurement noise and phase.
+   * @throws std::bad_alloc if the register mapping cannot be allocated.
+   * @throws std::logic_error if a register of the profile cannot be
+   *         encoded.
+   */
+  SimDevice(const SimProfile &profile, uint8_t unit, uint32_t seed);
+
+  ~SimDevice();
+
+  // Non-copyable, non-movable.
+  SimDevice(const SimDevice &) = delete;
+  SimDevice &operator=(const SimDevice &) = delete;
+  SimDevice(SimDevice &&) = delete;
+  SimDevice &operator=(SimDevice &&) = delete;
+
+  const SimProfile &profile() const { return profile_; }
+  uint8_t unit() const { return unit_; }
+
+  /**
+   * @brief Advance the measurements to time `t`.
+   *
+   * @param t   Seconds since the simulation started.
+   * @param dt  Seconds since the previous update, integrated into the
+   *            energy counters.
+   */
+  void update(double t, double dt);
+
+  /**
+   * @brief Serve a read holding registers request.
+   *
+   * @param addr   First register address.
+   * @param count  Number of registers (1-125).
+   * @param out    Receives `2 * count` bytes, big-endian.
+   * @return 0, or `MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS` if the range is
+   *         not implemented.
+   */
+  uint8_t read(uint16_t addr, uint16_t count, uint8_t *out) const;
+
+  /**
+   * @brief Serve a write multiple registers request.
+   *
+   * Written measurements are overwritten by the next `update()`; control
+   * registers keep the written values.
+   *
+   * @param addr   First register address.
+   * @param count  Number of registers (1-123).
+   * @param in     The `2 * count` bytes to write, big-endian.
+   * @return 0, or `MODBUS_EXCEPTION_ILLEGAL_DATA_ADDRESS` if the range is
+   *         not implemented.
+   */
+  uint8_t write(uint16_t addr, uint16_t count, const uint8_t *in);
+
+private:
+  /** @brief A range of implemented registers. */
+  struct Range {
+    uint32_t first;
+    uint32_t last;
+  };
+
+  /** @brief Mark `[first, first + count)` as implemented. */
+  void expose(uint16_t first, uint16_t count);
+
+  /** @brief Write a model header and return the address of the next one. */
+  uint16_t model(uint16_t addr, uint16_t id, uint16_t length);
+
+  /** @brief Encode `value` into `reg`. */
+  template <typename T> void pack(Register reg, T value);
+
+  /** @brief Encode `value` scaled by 10^decimals, with its scale factor. */
+  void pack(Register reg, Register sf, double value, int decimals);
+
+  /** @brief Throw `std::logic_error` if encoding `reg` failed. */
+  void check(const std::expected<void, ModbusError> &res,
+             const Register &reg) const;
+
+  /**
+   * @brief Encode `value` into the register of the device's encoding.
+   *
+   * Integer models scale it into `intReg` with `sf`, float models store it
+   * in `floatReg`.
+   */
+  void put(Register intReg, Register sf, Register floatReg, double value,
+           int decimals);
+
+  void buildCommon(const std::string &name);
+  void buildInverter();
+  void buildMeter();
+  void buildProprietary();
+
+  void updateInverter(double level, double dt);
+  void updateMeter(double level, double dt);
+  void updateProprietary(double level, double dt);
+
+  /** @brief Unit noise sample. */
+  double noise() { return noise_(rng_); }
+
+  SimProfile profile_;
+  uint8_t unit_;
+
+  modbus_mapping_t *mb_{nullptr};
+
+  /** @brief Implemented ranges, sorted and merged. */
+  std::vector<Range> ranges_;
+
+  /** @brief Register offset of the float models, 0 for integer models. */
+  uint16_t offset_{0};
+
+  /** @brief True for the float models (I11X, M21X). */
+  bool float_{false};
+
+  std::mt19937 rng_;
+  std::normal_distribution<double> noise_{0.0, 1.0};
+
+  /** @brief Phase of the power curve in cycles, so devices differ. */
+  double phase_{0.0};
+
+  /** @brief Rated power in watts. */
+  double rating_{0.0};
+
+  /** @brief Energy counters in watt-hours. */
+  double energy_{0.0};
+  double energyImport_{0.0};
+  double energyExport_{0.0};
+  double mpptEnergy_[2]{0.0, 0.0};
+};
+
+#endif /* SIM_DEVICE_H_ */
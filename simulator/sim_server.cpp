@@ -0,0 +1,515 @@
+#include "sim_server.h"
+#include "sim_device.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <array>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <format>
+#include <memory>
+#include <modbus/modbus.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+/** Events fetched from epoll per wakeup. */
+constexpr int MAX_EVENTS = 64;
+
+/** Tag of the wakeup descriptor in the epoll data. */
+constexpr uint64_t WAKE_TAG = 0;
+
+/** Bit marking a listening socket; the rest is the endpoint index. */
+constexpr uint64_t LISTENER_TAG = uint64_t{1} << 63;
+
+// Framing shared with the client side, so the two cannot drift apart
+using ModbusTcpFramer::EXCEPTION_BIT;
+using ModbusTcpFramer::MAX_ADU_SIZE;
+using ModbusTcpFramer::MBAP_SIZE;
+using ModbusTcpFramer::READ_HOLDING_REGISTERS;
+using ModbusTcpFramer::REQUEST_SIZE;
+using ModbusTcpFramer::WRITE_HEADER_SIZE;
+using ModbusTcpFramer::WRITE_MULTIPLE_REGISTERS;
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   Construction / destruction
+   ------------------------------------------------------------------------- */
+
+SimServer::SimServer(const SimServerConfig &cfg) : cfg_(cfg), rng_(cfg.seed) {
+  if (cfg_.endpoints < 1)
+    throw std::invalid_argument("SimServer: endpoints must be at least 1");
+  if (cfg_.firstPort == 0 || cfg_.firstPort + cfg_.endpoints - 1 > 65535)
+    throw std::invalid_argument(
+        std::format("SimServer: ports {}-{} out of range", cfg_.firstPort,
+                    cfg_.firstPort + cfg_.endpoints - 1));
+  if (cfg_.devices.empty())
+    throw std::invalid_argument("SimServer: devices must not be empty");
+
+  std::array<bool, 256> used{};
+  for (const auto &d : cfg_.devices) {
+    if (d.unit < 1 || d.unit > 247)
+      throw std::invalid_argument(std::format(
+          "SimServer: unit ID {} out of range, expected 1-247", d.unit));
+    if (used[d.unit])
+      throw std::invalid_argument(
+          std::format("SimServer: unit ID {} used twice", d.unit));
+    used[d.unit] = true;
+  }
+
+  const SimFaults &f = cfg_.faults;
+  if (f.latency.count() < 0 || f.jitter.count() < 0)
+    throw std::invalid_argument(
+        "SimServer: latency and jitter must not be negative");
+  for (double rate : {f.timeoutRate, f.busyRate, f.dropRate})
+    if (!(rate >= 0.0 && rate <= 1.0))
+      throw std::invalid_argument(
+          "SimServer: fault rates must be between 0 and 1");
+  if (f.timeoutRate + f.busyRate + f.dropRate > 1.0)
+    throw std::invalid_argument(
+        "SimServer: fault rates must not add up to more than 1");
+  if (cfg_.updateInterval.count() <= 0)
+    throw std::invalid_argument("SimServer: update interval must be positive");
+
+  in_addr addr{};
+  if (inet_pton(AF_INET, cfg_.address.c_str(), &addr) != 1)
+    throw std::invalid_argument(std::format(
+        "SimServer: '{}' is not a numeric IPv4 address", cfg_.address));
+
+  try {
+    epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFd_ == -1)
+      throw std::system_error(errno, std::generic_category(),
+                              "SimServer: epoll_create1() failed");
+
+    wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeFd_ == -1)
+      throw std::system_error(errno, std::generic_category(),
+                              "SimServer: eventfd() failed");
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = WAKE_TAG;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev) == -1)
+      throw std::system_error(errno, std::generic_category(),
+                              "SimServer: epoll_ctl() failed");
+
+    for (int i = 0; i < cfg_.endpoints; ++i) {
+      auto ep = std::make_unique<Endpoint>();
+      ep->port = static_cast<uint16_t>(cfg_.firstPort + i);
+
+      // Every device gets its own seed, so endpoints differ in serial
+      // numbers and values but repeat from run to run
+      for (const auto &d : cfg_.devices) {
+        const uint32_t seed = cfg_.seed * 2654435761u ^
+                              (static_cast<uint32_t>(ep->port) << 8 | d.unit);
+        ep->devices.push_back(
+            std::make_unique<SimDevice>(d.profile, d.unit, seed));
+        ep->units[d.unit] = ep->devices.back().get();
+      }
+
+      ep->fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+      if (ep->fd == -1)
+        throw std::system_error(errno, std::generic_category(),
+                                "SimServer: socket() failed");
+      const int one = 1;
+      setsockopt(ep->fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+      sockaddr_in sa{};
+      sa.sin_family = AF_INET;
+      sa.sin_addr = addr;
+      sa.sin_port = htons(ep->port);
+      const int fd = ep->fd;
+      endpoints_.push_back(std::move(ep));
+
+      if (bind(fd, reinterpret_cast<const sockaddr *>(&sa), sizeof(sa)) == -1)
+        throw std::system_error(
+            errno, std::generic_category(),
+            std::format("SimServer: bind() to {}:{} failed", cfg_.address,
+                        endpoints_.back()->port));
+      if (listen(fd, SOMAXCONN) == -1)
+        throw std::system_error(errno, std::generic_category(),
+                                "SimServer: listen() failed");
+
+      ev.events = EPOLLIN;
+      ev.data.u64 = LISTENER_TAG | static_cast<uint64_t>(i);
+      if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == -1)
+        throw std::system_error(errno, std::generic_category(),
+                                "SimServer: epoll_ctl() failed");
+    }
+  } catch (...) {
+    closeAll();
+    throw;
+  }
+
+  started_ = lastUpdate_ = Clock::now();
+  thread_ = std::thread(&SimServer::run, this);
+}
+
+SimServer::~SimServer() {
+  running_.store(false);
+  const uint64_t one = 1;
+  [[maybe_unused]] ssize_t rc = write(wakeFd_, &one, sizeof(one));
+
+  if (thread_.joinable())
+    thread_.join();
+
+  closeAll();
+}
+
+void SimServer::closeAll() {
+  for (auto &[id, c] : connections_)
+    ::close(c->fd);
+  connections_.clear();
+
+  for (auto &ep : endpoints_)
+    if (ep->fd != -1)
+      ::close(ep->fd);
+  endpoints_.clear();
+
+  if (wakeFd_ != -1)
+    ::close(wakeFd_);
+  if (epollFd_ != -1)
+    ::close(epollFd_);
+  wakeFd_ = epollFd_ = -1;
+}
+
+SimServer::Stats SimServer::stats() const {
+  Stats s;
+  s.connections = connectionCount_.load();
+  s.requests = requests_.load();
+  s.responses = responses_.load();
+  s.exceptions = exceptions_.load();
+  s.timeouts = timeouts_.load();
+  s.drops = drops_.load();
+  return s;
+}
+
+/* -------------------------------------------------------------------------
+   Server thread
+   ------------------------------------------------------------------------- */
+
+void SimServer::run() {
+  std::array<epoll_event, MAX_EVENTS> events;
+
+  while (running_.load()) {
+    auto now = Clock::now();
+    dispatch(now);
+    if (now - lastUpdate_ >= cfg_.updateInterval)
+      updateDevices(now);
+
+    // Sleep until the next reply or update falls due; round up, so the
+    // wait never ends before it
+    auto wakeAt = lastUpdate_ + cfg_.updateInterval;
+    if (!replies_.empty())
+      wakeAt = std::min(wakeAt, replies_.top().due);
+    const auto wait =
+        std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now);
+    const int timeout = static_cast<int>(std::max<int64_t>(wait.count(), 0));
+
+    const int n = epoll_wait(epollFd_, events.data(), MAX_EVENTS, timeout);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      break;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      const uint64_t tag = events[i].data.u64;
+      if (tag == WAKE_TAG) {
+        uint64_t value;
+        [[maybe_unused]] ssize_t rc = read(wakeFd_, &value, sizeof(value));
+        continue;
+      }
+      if (tag & LISTENER_TAG) {
+        accept(*endpoints_[tag & ~LISTENER_TAG]);
+        continue;
+      }
+
+      // A connection may have been closed by an earlier event of the batch
+      auto it = connections_.find(tag);
+      if (it == connections_.end())
+        continue;
+      Connection &c = *it->second;
+      if (events[i].events & EPOLLOUT) {
+        flush(c);
+        if (!connections_.contains(tag))
+          continue;
+      }
+      if (events[i].events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+        receive(c);
+    }
+  }
+}
+
+void SimServer::accept(Endpoint &ep) {
+  for (;;) {
+    const int fd = accept4(ep.fd, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd == -1)
+      return; // EAGAIN, or out of descriptors until a client disconnects
+
+    const int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    auto c = std::make_unique<Connection>();
+    c->id = nextConnection_++;
+    c->fd = fd;
+    c->endpoint = &ep;
+
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = c->id;
+    if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, fd, &ev) == -1) {
+      ::close(fd);
+      continue;
+    }
+    connections_.emplace(c->id, std::move(c));
+    ++connectionCount_;
+  }
+}
+
+void SimServer::closeConnection(Connection &c) {
+  epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+  ::close(c.fd);
+  connections_.erase(c.id); // destroys c
+}
+
+/* -------------------------------------------------------------------------
+   Requests
+   ------------------------------------------------------------------------- */
+
+void SimServer::receive(Connection &c) {
+  for (;;) {
+    const ssize_t got = recv(c.fd, c.rx.data() + c.rxLen,
+                             c.rx.size() - c.rxLen, 0);
+    if (got == 0) {
+      closeConnection(c);
+      return;
+    }
+    if (got == -1) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      if (errno == EINTR)
+        continue;
+      closeConnection(c);
+      return;
+    }
+    c.rxLen += static_cast<size_t>(got);
+
+    // Split the stream into request ADUs
+    size_t pos = 0;
+    for (;;) {
+      const auto size = ModbusTcpFramer::frameSize(
+          {c.rx.data() + pos, c.rxLen - pos});
+      if (!size) {
+        closeConnection(c);
+        return;
+      }
+      if (*size == 0)
+        break;
+      handle(c, c.rx.data() + pos, *size);
+      pos += *size;
+    }
+    std::memmove(c.rx.data(), c.rx.data() + pos, c.rxLen - pos);
+    c.rxLen -= pos;
+  }
+}
+
+void SimServer::handle(Connection &c, const uint8_t *adu, size_t len) {
+  ++requests_;
+
+  // Faults apply to any request, valid or not
+  const SimFaults &f = cfg_.faults;
+  const double u = uniform_(rng_);
+  if (u < f.dropRate) {
+    schedule(c, Action::DROP, nullptr, 0);
+    return;
+  }
+  if (u < f.dropRate + f.timeoutRate) {
+    ++timeouts_;
+    return;
+  }
+
+  std::array<uint8_t, MAX_ADU_SIZE> out;
+  std::memcpy(out.data(), adu, MBAP_SIZE); // transaction, protocol, unit
+
+  const uint8_t unit = adu[6];
+  const uint8_t function = adu[7];
+  const auto exception = [&](uint8_t code) {
+    ++exceptions_;
+    out[4] = 0x00;
+    out[5] = 0x03;
+    out[7] = function | EXCEPTION_BIT;
+    out[8] = code;
+    schedule(c, Action::RESPOND, out.data(), MBAP_SIZE + 2);
+  };
+
+  if (u < f.dropRate + f.timeoutRate + f.busyRate)
+    return exception(MODBUS_EXCEPTION_SLAVE_OR_SERVER_BUSY);
+  if (function == WRITE_MULTIPLE_REGISTERS)
+    return handleWrite(c, adu, len);
+  if (function != READ_HOLDING_REGISTERS)
+    return exception(MODBUS_EXCEPTION_ILLEGAL_FUNCTION);
+  if (len != REQUEST_SIZE)
+    return exception(MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+
+  const uint16_t addr = static_cast<uint16_t>(adu[8] << 8 | adu[9]);
+  const uint16_t count = static_cast<uint16_t>(adu[10] << 8 | adu[11]);
+  if (count < 1 || count > MODBUS_MAX_READ_REGISTERS)
+    return exception(MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+
+  const SimDevice *device = c.endpoint->units[unit];
+  if (!device)
+    return exception(MODBUS_EXCEPTION_GATEWAY_TARGET);
+
+  if (const uint8_t code = device->read(addr, count, out.data() + 9))
+    return exception(code);
+
+  const uint16_t length = static_cast<uint16_t>(3 + 2 * count);
+  out[4] = static_cast<uint8_t>(length >> 8);
+  out[5] = static_cast<uint8_t>(length & 0xFF);
+  out[7] = function;
+  out[8] = static_cast<uint8_t>(2 * count);
+  schedule(c, Action::RESPOND, out.data(), MBAP_SIZE - 1 + length);
+}
+
+void SimServer::handleWrite(Connection &c, const uint8_t *adu, size_t len) {
+  std::array<uint8_t, MBAP_SIZE + 5> out;
+  std::memcpy(out.data(), adu, MBAP_SIZE); // transaction, protocol, unit
+
+  const uint8_t unit = adu[6];
+  const auto exception = [&](uint8_t code) {
+    ++exceptions_;
+    out[4] = 0x00;
+    out[5] = 0x03;
+    out[7] = WRITE_MULTIPLE_REGISTERS | EXCEPTION_BIT;
+    out[8] = code;
+    schedule(c, Action::RESPOND, out.data(), MBAP_SIZE + 2);
+  };
+
+  if (len < WRITE_HEADER_SIZE)
+    return exception(MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+
+  const uint16_t addr = static_cast<uint16_t>(adu[8] << 8 | adu[9]);
+  const uint16_t count = static_cast<uint16_t>(adu[10] << 8 | adu[11]);
+  if (count < 1 || count > MODBUS_MAX_WRITE_REGISTERS || adu[12] != 2 * count ||
+      len != WRITE_HEADER_SIZE + 2 * count)
+    return exception(MODBUS_EXCEPTION_ILLEGAL_DATA_VALUE);
+
+  SimDevice *device = c.endpoint->units[unit];
+  if (!device)
+    return exception(MODBUS_EXCEPTION_GATEWAY_TARGET);
+
+  if (const uint8_t code =
+          device->write(addr, count, adu + WRITE_HEADER_SIZE))
+    return exception(code);
+
+  // The response echoes the start address and count
+  out[4] = 0x00;
+  out[5] = 0x06;
+  out[7] = WRITE_MULTIPLE_REGISTERS;
+  std::memcpy(out.data() + 8, adu + 8, 4);
+  schedule(c, Action::RESPOND, out.data(), out.size());
+}
+
+void SimServer::schedule(Connection &c, Action action, const uint8_t *adu,
+                         size_t len) {
+  const SimFaults &f = cfg_.faults;
+  const auto jitter = std::chrono::microseconds(static_cast<int64_t>(
+      uniform_(rng_) * static_cast<double>(f.jitter.count())));
+
+  // Answer in request order, as a gateway working through its queue does
+  const auto due = std::max(Clock::now() + f.latency + jitter, c.lastDue);
+  c.lastDue = due;
+
+  Reply r;
+  r.due = due;
+  r.connection = c.id;
+  r.action = action;
+  r.len = static_cast<uint16_t>(len);
+  if (len)
+    std::memcpy(r.adu.data(), adu, len);
+  replies_.push(r);
+}
+
+void SimServer::dispatch(Clock::time_point now) {
+  while (!replies_.empty() && replies_.top().due <= now) {
+    const Reply r = replies_.top();
+    replies_.pop();
+
+    auto it = connections_.find(r.connection);
+    if (it == connections_.end())
+      continue; // closed by the client or an earlier drop
+    Connection &c = *it->second;
+
+    if (r.action == Action::DROP) {
+      ++drops_;
+      closeConnection(c);
+      continue;
+    }
+
+    ++responses_;
+    c.tx.insert(c.tx.end(), r.adu.begin(), r.adu.begin() + r.len);
+    flush(c);
+  }
+}
+
+void SimServer::flush(Connection &c) {
+  while (c.txSent < c.tx.size()) {
+    const ssize_t sent = send(c.fd, c.tx.data() + c.txSent,
+                              c.tx.size() - c.txSent, MSG_NOSIGNAL);
+    if (sent == -1) {
+      if (errno == EINTR)
+        continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        closeConnection(c);
+        return;
+      }
+
+      // Socket buffer full: continue once it drains
+      if (!c.writing) {
+        epoll_event ev{};
+        ev.events = EPOLLIN | EPOLLOUT;
+        ev.data.u64 = c.id;
+        epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &ev);
+        c.writing = true;
+      }
+      return;
+    }
+    c.txSent += static_cast<size_t>(sent);
+  }
+
+  c.tx.clear();
+  c.txSent = 0;
+  if (c.writing) {
+    epoll_event ev{};
+    ev.events = EPOLLIN;
+    ev.data.u64 = c.id;
+    epoll_ctl(epollFd_, EPOLL_CTL_MOD, c.fd, &ev);
+    c.writing = false;
+  }
+}
+
+/* -------------------------------------------------------------------------
+   Measurements
+   ------------------------------------------------------------------------- */
+
+void SimServer::updateDevices(Clock::time_point now) {
+  using Seconds = std::chrono::duration<double>;
+  const double t = Seconds(now - started_).count();
+  const double dt = Seconds(now - lastUpdate_).count();
+  lastUpdate_ = now;
+
+  for (auto &ep : endpoints_)
+    for (auto &d : ep->devices)
+      d->update(t, dt);
+}
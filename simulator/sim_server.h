@@ -0,0 +1,257 @@
+/**
+ * @file sim_server.h
+ * @brief Modbus TCP server for simulated devices, with fault injection.
+ *
+ * @details
+ * A `SimServer` listens on a range of TCP ports, one simulated endpoint
+ * (e.g. a Datamanager) per port, each serving its own `SimDevice`s under
+ * their unit IDs. One thread multiplexes every endpoint and connection
+ * over `epoll`, so a handful of servers can stand in for hundreds of
+ * endpoints.
+ *
+ * Responses are delayed by a configurable latency plus a uniformly
+ * distributed jitter. Like a real gateway, an endpoint answers the
+ * requests of one connection in order, so jitter delays a response but
+ * never overtakes an earlier one. Requests can be swallowed (the client
+ * sees a timeout), answered with a busy exception, or answered by closing
+ * the connection, each with a configurable probability.
+ *
+ * Read holding registers (0x03) and write multiple registers (0x10) are
+ * served; other functions are answered with an illegal-function
+ * exception, and unit IDs without a device with a gateway-target
+ * exception.
+ */
+
+#ifndef SIM_SERVER_H_
+#define SIM_SERVER_H_
+
+#include "modbus_tcp_framer.h"
+#include "sim_device.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <queue>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @struct SimFaults
+ * @brief Timing and failures injected into the responses of a server.
+ */
+struct SimFaults {
+  /** @brief Fixed delay of every response. */
+  std::chrono::microseconds latency{0};
+
+  /** @brief Upper bound of a uniformly distributed extra delay. */
+  std::chrono::microseconds jitter{0};
+
+  /** @brief Probability that a request is never answered. */
+  double timeoutRate{0.0};
+
+  /** @brief Probability that a request is answered with "device busy". */
+  double busyRate{0.0};
+
+  /** @brief Probability that the connection is closed instead. */
+  double dropRate{0.0};
+};
+
+/**
+ * @struct SimServerConfig
+ * @brief Endpoints, devices, and faults of one server.
+ */
+struct SimServerConfig {
+  /** @brief Numeric IPv4 address to listen on. */
+  std::string address{"127.0.0.1"};
+
+  /** @brief Port of the first endpoint. */
+  uint16_t firstPort{1502};
+
+  /** @brief Number of endpoints, on consecutive ports. */
+  int endpoints{1};
+
+  /** @brief A device served by every endpoint. */
+  struct Device {
+    SimProfile profile;
+    uint8_t unit{1};
+  };
+
+  /** @brief Devices of each endpoint; unit IDs must be unique. */
+  std::vector<Device> devices;
+
+  SimFaults faults;
+
+  /** @brief Time between measurement updates. */
+  std::chrono::milliseconds updateInterval{1000};
+
+  /** @brief Seed of the device values and the injected faults. */
+  uint32_t seed{1};
+};
+
+/**
+ * @class SimServer
+ * @brief Epoll thread serving simulated Modbus TCP endpoints.
+ *
+ * Non-copyable, non-movable. `stats()` may be called from any thread.
+ */
+class SimServer {
+public:
+  /**
+   * @struct Stats
+   * @brief Counters since the server started.
+   */
+  struct Stats {
+    uint64_t connections{0};
+    uint64_t requests{0};
+    uint64_t responses{0};
+    uint64_t exceptions{0};
+    uint64_t timeouts{0};
+    uint64_t drops{0};
+  };
+
+  /**
+   * @brief Bind the endpoints and start the server thread.
+   *
+   * @throws std::invalid_argument if the configuration is invalid: no
+   *         endpoints or devices, duplicate or out-of-range unit IDs,
+   *         negative delays, probabilities outside [0, 1] or adding up to
+   *         more than 1, or ports beyond 65535.
+   * @throws std::system_error if a socket cannot be created or bound.
+   */
+  explicit SimServer(const SimServerConfig &cfg);
+
+  /** @brief Stop the thread and close every socket. */
+  ~SimServer();
+
+  // Non-copyable, non-movable.
+  SimServer(const SimServer &) = delete;
+  SimServer &operator=(const SimServer &) = delete;
+  SimServer(SimServer &&) = delete;
+  SimServer &operator=(SimServer &&) = delete;
+
+  /** @brief Snapshot of the counters. */
+  Stats stats() const;
+
+private:
+  using Clock = std::chrono::steady_clock;
+
+  /** @brief One listening port and its devices. */
+  struct Endpoint {
+    int fd{-1};
+    uint16_t port{0};
+    std::vector<std::unique_ptr<SimDevice>> devices;
+
+    /** @brief Devices by unit ID. */
+    std::array<SimDevice *, 256> units{};
+  };
+
+  /** @brief One accepted client connection. */
+  struct Connection {
+    uint64_t id{0};
+    int fd{-1};
+    Endpoint *endpoint{nullptr};
+
+    /** @brief Received bytes not yet parsed into a request. */
+    std::array<uint8_t, 2 * ModbusTcpFramer::MAX_ADU_SIZE> rx{};
+    size_t rxLen{0};
+
+    /** @brief Encoded responses, of which `txSent` bytes were written. */
+    std::vector<uint8_t> tx;
+    size_t txSent{0};
+
+    /** @brief Due time of the last scheduled response, to keep order. */
+    Clock::time_point lastDue;
+
+    /** @brief Set while EPOLLOUT is registered. */
+    bool writing{false};
+  };
+
+  /** @brief What happens at the due time of a scheduled reply. */
+  enum class Action : uint8_t { RESPOND, DROP };
+
+  /** @brief A reply waiting for its due time. */
+  struct Reply {
+    Clock::time_point due;
+
+    /** @brief Connection ID; the reply is discarded if it has closed. */
+    uint64_t connection;
+
+    Action action;
+    uint16_t len;
+    std::array<uint8_t, ModbusTcpFramer::MAX_ADU_SIZE> adu;
+
+    bool operator>(const Reply &other) const { return due > other.due; }
+  };
+
+  /** @brief Server thread body. */
+  void run();
+
+  /** @brief Accept pending connections on `ep`. */
+  void accept(Endpoint &ep);
+
+  /** @brief Read from `c` and schedule replies to complete requests. */
+  void receive(Connection &c);
+
+  /** @brief Handle one request ADU and schedule its reply, if any. */
+  void handle(Connection &c, const uint8_t *adu, size_t len);
+
+  /** @brief Handle a write multiple registers request ADU. */
+  void handleWrite(Connection &c, const uint8_t *adu, size_t len);
+
+  /** @brief Queue a reply to `c`, after the injected delay. */
+  void schedule(Connection &c, Action action, const uint8_t *adu,
+                size_t len);
+
+  /** @brief Execute the replies that are due. */
+  void dispatch(Clock::time_point now);
+
+  /** @brief Write pending responses of `c`. */
+  void flush(Connection &c);
+
+  /** @brief Close `c` and forget it. */
+  void closeConnection(Connection &c);
+
+  /** @brief Close every descriptor; used on destruction and failed setup. */
+  void closeAll();
+
+  /** @brief Update the measurements of every device. */
+  void updateDevices(Clock::time_point now);
+
+  SimServerConfig cfg_;
+
+  std::vector<std::unique_ptr<Endpoint>> endpoints_;
+  std::unordered_map<uint64_t, std::unique_ptr<Connection>> connections_;
+  uint64_t nextConnection_{1};
+
+  std::priority_queue<Reply, std::vector<Reply>, std::greater<>> replies_;
+
+  std::mt19937 rng_;
+  std::uniform_real_distribution<double> uniform_{0.0, 1.0};
+
+  Clock::time_point started_;
+  Clock::time_point lastUpdate_;
+
+  int epollFd_{-1};
+
+  /** @brief eventfd waking the thread to stop. */
+  int wakeFd_{-1};
+
+  std::atomic<bool> running_{true};
+
+  std::atomic<uint64_t> connectionCount_{0};
+  std::atomic<uint64_t> requests_{0};
+  std::atomic<uint64_t> responses_{0};
+  std::atomic<uint64_t> exceptions_{0};
+  std::atomic<uint64_t> timeouts_{0};
+  std::atomic<uint64_t> drops_{0};
+
+  std::thread thread_;
+};
+
+#endif /* SIM_SERVER_H_ */
@@ -0,0 +1,791 @@
+#include "bus_event_loop.h"
+#include "device_scheduler.h"
+#include "fronius_bus.h"
+#include "fronius_types.h"
+#include "modbus_error.h"
+#include "modbus_tcp_framer.h"
+#include "modbus_utils.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <mutex>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <system_error>
+#include <unistd.h>
+
+namespace {
+
+// Shorthands for the log filter arguments of busLog()
+using Cat = FroniusTypes::LogCategory;
+using Lvl = FroniusTypes::LogLevel;
+
+/** Events fetched from epoll per wakeup. */
+constexpr int MAX_EVENTS = 64;
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   Construction / destruction
+   ------------------------------------------------------------------------- */
+
+BusEventLoop::BusEventLoop(int probeThreads)
+    : scheduler_(std::make_shared<DeviceScheduler>(probeThreads)) {
+  epollFd_ = epoll_create1(EPOLL_CLOEXEC);
+  if (epollFd_ == -1)
+    throw std::system_error(errno, std::generic_category(),
+                            "BusEventLoop: epoll_create1() failed");
+
+  wakeFd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (wakeFd_ == -1) {
+    const int err = errno;
+    close(epollFd_);
+    throw std::system_error(err, std::generic_category(),
+                            "BusEventLoop: eventfd() failed");
+  }
+
+  // The wakeup descriptor is the only one registered without a channel
+  epoll_event ev{};
+  ev.events = EPOLLIN;
+  ev.data.ptr = nullptr;
+  if (epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFd_, &ev) == -1) {
+    const int err = errno;
+    close(wakeFd_);
+    close(epollFd_);
+    throw std::system_error(err, std::generic_category(),
+                            "BusEventLoop: epoll_ctl() failed");
+  }
+
+  thread_ = std::thread(&BusEventLoop::run, this);
+}
+
+BusEventLoop::~BusEventLoop() {
+  running_.store(false);
+  wakePending_.store(false);
+  wake();
+
+  if (thread_.joinable())
+    thread_.join();
+
+  // Every bus detaches before it is destroyed and holds a reference to the
+  // loop, so no channel should be left; close stray sockets regardless.
+  for (auto &ch : channels_)
+    for (Connection &c : ch->connections)
+      closeSocket(c);
+
+  close(wakeFd_);
+  close(epollFd_);
+}
+
+size_t BusEventLoop::busCount() const {
+  std::lock_guard<std::mutex> lock(cmdMtx_);
+  return busCount_;
+}
+
+/* -------------------------------------------------------------------------
+   Interface used by FroniusBus
+   ------------------------------------------------------------------------- */
+
+void BusEventLoop::attach(FroniusBus *bus) {
+  {
+    std::lock_guard<std::mutex> lock(cmdMtx_);
+    commands_.push_back({bus, true});
+    ++cmdIssued_;
+  }
+  wake();
+}
+
+void BusEventLoop::detach(FroniusBus *bus) {
+  std::unique_lock<std::mutex> lock(cmdMtx_);
+  commands_.push_back({bus, false});
+  const uint64_t ticket = ++cmdIssued_;
+  wake();
+
+  cmdCv_.wait(lock, [this, ticket] { return cmdApplied_ >= ticket; });
+}
+
+void BusEventLoop::wake() {
+  if (wakePending_.exchange(true))
+    return; // the loop has not consumed the previous wakeup yet
+
+  const uint64_t one = 1;
+  [[maybe_unused]] ssize_t rc = write(wakeFd_, &one, sizeof(one));
+}
+
+/* -------------------------------------------------------------------------
+   Loop thread — run
+   ------------------------------------------------------------------------- */
+
+void BusEventLoop::run() {
+  FroniusBus::onBusThread_ = true;
+  std::array<epoll_event, MAX_EVENTS> events;
+
+  std::vector<Command> commands;
+
+  while (running_.load()) {
+    // Apply attach/detach requests outside the lock, as detaching runs the
+    // bus's shutdown notifications
+    uint64_t issued;
+    {
+      std::lock_guard<std::mutex> lock(cmdMtx_);
+      commands.swap(commands_);
+      issued = cmdIssued_;
+    }
+    if (!commands.empty()) {
+      applyCommands(commands);
+      commands.clear();
+
+      std::lock_guard<std::mutex> lock(cmdMtx_);
+      cmdApplied_ = issued;
+      busCount_ = channels_.size();
+      cmdCv_.notify_all();
+    }
+
+    // Sleep until the earliest connect attempt, connect timeout, or
+    // response deadline of any connection. Idle secondary connections of
+    // a bus that is down wait for the first one instead of a timer.
+    auto now = Clock::now();
+    auto wakeAt = Clock::time_point::max();
+    for (const auto &ch : channels_) {
+      for (const Connection &c : ch->connections) {
+        if (c.state == Connection::State::CONNECTED) {
+          for (const Request &req : c.requests)
+            if (req.active)
+              wakeAt = std::min(wakeAt, req.deadline);
+        } else if (c.state == Connection::State::CONNECTING || c.index == 0 ||
+                   ch->up) {
+          wakeAt = std::min(wakeAt, c.due);
+        }
+      }
+    }
+
+    int timeoutMs = -1;
+    if (wakeAt != Clock::time_point::max())
+      timeoutMs = static_cast<int>(std::max<int64_t>(
+          0, std::chrono::ceil<std::chrono::milliseconds>(wakeAt - now)
+                 .count()));
+
+    const int n = epoll_wait(epollFd_, events.data(), MAX_EVENTS, timeoutMs);
+
+    for (int i = 0; i < n; ++i) {
+      if (!events[i].data.ptr) {
+        // Clear the flag first, so a wake() racing with the read below
+        // writes again and is not lost
+        wakePending_.store(false);
+        uint64_t count;
+        [[maybe_unused]] ssize_t rc = read(wakeFd_, &count, sizeof(count));
+        continue;
+      }
+      onEvents(*static_cast<Connection *>(events[i].data.ptr),
+               events[i].events);
+    }
+
+    now = Clock::now();
+    for (auto &ch : channels_)
+      service(*ch, now);
+  }
+}
+
+void BusEventLoop::applyCommands(const std::vector<Command> &commands) {
+  for (const Command &cmd : commands) {
+    if (cmd.attach) {
+      const ModbusBusConfig &cfg = cmd.bus->cfg_;
+      auto ch = std::make_unique<Channel>();
+      ch->bus = cmd.bus;
+      ch->connections.resize(static_cast<size_t>(cfg.connections));
+      for (size_t i = 0; i < ch->connections.size(); ++i) {
+        Connection &c = ch->connections[i];
+        c.channel = ch.get();
+        c.index = i;
+        c.reconnectDelay = cfg.reconnectDelay;
+        c.due = Clock::now();
+        c.requests.resize(static_cast<size_t>(cfg.pipelineDepth));
+      }
+      channels_.push_back(std::move(ch));
+      continue;
+    }
+
+    auto it = std::find_if(channels_.begin(), channels_.end(),
+                           [&cmd](const std::unique_ptr<Channel> &ch) {
+                             return ch->bus == cmd.bus;
+                           });
+    if (it == channels_.end())
+      continue; // never attached
+
+    Channel &ch = **it;
+    const auto err = ModbusError::custom(
+        EINTR, "detach(): Bus is shutting down, transaction cancelled");
+    for (Connection &c : ch.connections) {
+      closeSocket(c);
+      abortAll(c, err);
+    }
+    ch.bus->handleShutdown();
+    channels_.erase(it);
+  }
+}
+
+/* -------------------------------------------------------------------------
+   Connection state machine
+   ------------------------------------------------------------------------- */
+
+void BusEventLoop::service(Channel &ch, Clock::time_point now) {
+  FroniusBus &bus = *ch.bus;
+
+  // A response arriving after its request timed out is discarded by
+  // dispatch(); the connection stays up as with libmodbus
+  for (Connection &c : ch.connections) {
+    for (Request &req : c.requests) {
+      if (!req.active || now < req.deadline)
+        continue;
+      const auto &t = req.merged;
+      finish(c, req,
+             std::unexpected(ModbusErrorEvent::of(
+                 ETIMEDOUT, "service(): Response timed out", t.slaveId,
+                 t.startAddr, t.count)));
+    }
+  }
+
+  // A fatal read error or triggerReconnect() cleared the flag
+  if (ch.up && !bus.connected_.load()) {
+    dropAll(ch, ModbusError::custom(ECONNABORTED,
+                                    "service(): Connection to '{}' closed",
+                                    bus.cfg_.tcp().host));
+    return;
+  }
+
+  bool connected = false;
+  for (Connection &c : ch.connections) {
+    switch (c.state) {
+    case Connection::State::IDLE:
+      // While the bus is down only the first connection retries, so the
+      // bus reports one connect failure per attempt
+      if (now >= c.due && (c.index == 0 || ch.up))
+        startConnect(c, now);
+      break;
+
+    case Connection::State::CONNECTING:
+      if (now >= c.due)
+        failConnect(c, ModbusError::custom(
+                           ETIMEDOUT, "service(): Connection to '{}' timed out",
+                           bus.cfg_.tcp().host));
+      break;
+
+    case Connection::State::CONNECTED:
+      connected = true;
+      break;
+    }
+  }
+  if (!connected)
+    return;
+
+  // Hand out queued reads one per connection and turn, so that a pool
+  // spreads them instead of filling the first window
+  bool queued = true;
+  while (queued && bus.running_.load()) {
+    queued = false;
+    for (Connection &c : ch.connections)
+      if (c.state == Connection::State::CONNECTED &&
+          c.inFlight < c.requests.size() && sendNext(c, now))
+        queued = true;
+  }
+
+  // Write all new requests of a connection back to back
+  for (Connection &c : ch.connections)
+    if (c.state == Connection::State::CONNECTED && c.txSent < c.txLen)
+      flush(c);
+}
+
+void BusEventLoop::onEvents(Connection &c, uint32_t events) {
+  if (c.state == Connection::State::CONNECTING) {
+    if (events & (EPOLLOUT | EPOLLERR | EPOLLHUP))
+      finishConnect(c);
+    return;
+  }
+
+  if (c.state != Connection::State::CONNECTED)
+    return;
+
+  // Errors and hangups surface through recv()
+  if (events & (EPOLLIN | EPOLLERR | EPOLLHUP))
+    receive(c);
+
+  if (c.state == Connection::State::CONNECTED && (events & EPOLLOUT))
+    flush(c);
+}
+
+/* -------------------------------------------------------------------------
+   Connection handling
+   ------------------------------------------------------------------------- */
+
+void BusEventLoop::startConnect(Connection &c, Clock::time_point now) {
+  const auto &t = c.channel->bus->cfg_.tcp();
+
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = AI_NUMERICSERV;
+
+  addrinfo *res = nullptr;
+  const int rc =
+      getaddrinfo(t.host.c_str(), std::to_string(t.port).c_str(), &hints, &res);
+  if (rc != 0) {
+    // Reported like libmodbus, which fails resolution with ECONNREFUSED
+    failConnect(c, ModbusError::custom(
+                       ECONNREFUSED, "startConnect(): Cannot resolve '{}': {}",
+                       t.host, gai_strerror(rc)));
+    return;
+  }
+
+  c.fd = socket(res->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                0);
+  if (c.fd == -1) {
+    freeaddrinfo(res);
+    failConnect(c, ModbusError::fromErrno(
+                       "startConnect(): Unable to create socket"));
+    return;
+  }
+
+  // Requests are small and latency-bound
+  const int one = 1;
+  setsockopt(c.fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+  const int crc = ::connect(c.fd, res->ai_addr, res->ai_addrlen);
+  const int savedErrno = errno;
+  freeaddrinfo(res);
+
+  if (crc == 0) {
+    finishConnect(c);
+    return;
+  }
+  if (savedErrno != EINPROGRESS) {
+    errno = savedErrno;
+    failConnect(c, ModbusError::fromErrno(
+                       "startConnect(): Connection to '{}' failed", t.host));
+    return;
+  }
+
+  c.state = Connection::State::CONNECTING;
+  c.due = now + CONNECT_TIMEOUT;
+  updateEvents(c);
+}
+
+void BusEventLoop::finishConnect(Connection &c) {
+  Channel &ch = *c.channel;
+  FroniusBus &bus = *ch.bus;
+
+  int err = 0;
+  socklen_t len = sizeof(err);
+  if (getsockopt(c.fd, SOL_SOCKET, SO_ERROR, &err, &len) == -1)
+    err = errno;
+  if (err != 0) {
+    errno = err;
+    failConnect(c, ModbusError::fromErrno(
+                       "finishConnect(): Connection to '{}' failed",
+                       bus.cfg_.tcp().host));
+    return;
+  }
+
+  c.state = Connection::State::CONNECTED;
+  c.rxLen = 0;
+  c.txLen = 0;
+  c.txSent = 0;
+  updateEvents(c);
+
+  if (ch.up) {
+    // Another connection of the pool; the bus is connected already
+    if (bus.cfg_.exponential)
+      c.reconnectDelay = bus.cfg_.reconnectDelay;
+    bus.busLog(Cat::POOL, Lvl::INFO, "[pool] connection {} to '{}' up",
+               c.index, bus.cfg_.tcp().host);
+    return;
+  }
+
+  ch.up = true;
+  bus.remoteEndpoint_ = ModbusUtils::getSocketInfo(c.fd);
+  bus.markConnected(c.reconnectDelay);
+}
+
+void BusEventLoop::failConnect(Connection &c, const ModbusError &err) {
+  closeSocket(c);
+  c.state = Connection::State::IDLE;
+
+  Channel &ch = *c.channel;
+  FroniusBus &bus = *ch.bus;
+  if (ch.up)
+    bus.busLog(Cat::POOL, Lvl::WARN,
+               "[pool] connection {} failed, retrying in {}s: {}", c.index,
+               c.reconnectDelay, err.message);
+  else
+    bus.reportConnectFailure(err, c.reconnectDelay);
+
+  // Same backoff as the bus thread: wait, then double for the next attempt
+  c.due = Clock::now() + std::chrono::seconds(c.reconnectDelay);
+  if (bus.cfg_.exponential)
+    c.reconnectDelay =
+        std::min(c.reconnectDelay * 2, bus.cfg_.reconnectDelayMax);
+}
+
+void BusEventLoop::drop(Connection &c, const ModbusError &err) {
+  Channel &ch = *c.channel;
+  FroniusBus &bus = *ch.bus;
+
+  const bool others = std::any_of(
+      ch.connections.begin(), ch.connections.end(), [&c](const Connection &o) {
+        return &o != &c && o.state == Connection::State::CONNECTED;
+      });
+  if (!others) {
+    bus.reportReadError(ModbusErrorEvent::of(err.code, "BusEventLoop"), &err);
+    dropAll(ch, err);
+    return;
+  }
+
+  // The rest of the pool carries on; this connection reconnects at once
+  closeSocket(c);
+  abortAll(c, err);
+  c.state = Connection::State::IDLE;
+  c.due = Clock::now();
+  bus.busLog(Cat::POOL, Lvl::WARN, "[pool] connection {} lost: {}", c.index,
+             err.message);
+}
+
+void BusEventLoop::dropAll(Channel &ch, const ModbusError &err) {
+  for (Connection &c : ch.connections) {
+    closeSocket(c);
+    abortAll(c, err);
+
+    // Like the bus thread, reconnect straight away after a drop
+    c.state = Connection::State::IDLE;
+    c.due = Clock::now();
+  }
+  ch.up = false;
+
+  FroniusBus &bus = *ch.bus;
+  bus.connected_.store(false);
+  if (bus.running_.load())
+    bus.handleDisconnect(ch.connections.front().reconnectDelay);
+}
+
+void BusEventLoop::closeSocket(Connection &c) {
+  if (c.fd == -1)
+    return;
+
+  epoll_ctl(epollFd_, EPOLL_CTL_DEL, c.fd, nullptr);
+  close(c.fd);
+  c.fd = -1;
+  c.events = 0;
+}
+
+void BusEventLoop::updateEvents(Connection &c) {
+  if (c.fd == -1)
+    return;
+
+  uint32_t want = EPOLLIN;
+  if (c.state == Connection::State::CONNECTING)
+    want = EPOLLOUT;
+  else if (c.txSent < c.txLen)
+    want |= EPOLLOUT;
+
+  if (want == c.events)
+    return;
+
+  epoll_event ev{};
+  ev.events = want;
+  ev.data.ptr = &c;
+  epoll_ctl(epollFd_, c.events == 0 ? EPOLL_CTL_ADD : EPOLL_CTL_MOD, c.fd,
+            &ev);
+  c.events = want;
+}
+
+/* -------------------------------------------------------------------------
+   Requests and responses
+   ------------------------------------------------------------------------- */
+
+bool BusEventLoop::sendNext(Connection &c, Clock::time_point now) {
+  Channel &ch = *c.channel;
+  FroniusBus &bus = *ch.bus;
+  Request &req = *std::find_if(c.requests.begin(), c.requests.end(),
+                               [](const Request &r) { return !r.active; });
+
+  // Reads of a slave in flight elsewhere in the pool wait for it, which
+  // keeps the reads of every slave in order
+  FroniusBus::SlaveSet busy;
+  for (const Connection &o : ch.connections)
+    if (&o != &c)
+      for (const Request &r : o.requests)
+        if (r.active)
+          busy.set(static_cast<size_t>(r.merged.slaveId) & 0xFF);
+
+  req.n = bus.dequeue(req.group, busy.any() ? &busy : nullptr);
+  if (req.n == 0)
+    return false;
+
+  if (req.n > 1) {
+    req.merged = bus.mergeGroup(req.group, req.n, req.buf.data());
+
+    // The slave rejected this merge before: send the head on its own and
+    // leave the rest to be merged differently on the next pass.
+    if (bus.spanRejected(req.merged)) {
+      bus.requeueFront({req.group.data() + 1, req.n - 1});
+      req.n = 1;
+    } else {
+      bus.busLog(Cat::COALESCE, Lvl::DEBUG,
+                 "[coalesce] slave={} addr={} count={} <- {} transactions",
+                 req.merged.slaveId, req.merged.startAddr, req.merged.count,
+                 req.n);
+    }
+  }
+  if (req.n == 1)
+    req.merged = req.group[0]->tx;
+
+  const FroniusBus::Transaction &t = req.merged;
+  req.tid = c.nextTid++;
+  req.sentAt = now;
+  req.deadline = now + bus.requestTimeout(t);
+  req.writing = t.op == FroniusBus::Transaction::Op::WRITE;
+  req.active = true;
+  ++c.inFlight;
+  encode(c, req);
+
+  bus.busLog(Cat::WIRE, Lvl::DEBUG,
+             "[tx] slave={} addr={} count={} tid={} conn={} -> sending",
+             t.slaveId, t.startAddr, t.count, req.tid, c.index);
+  return true;
+}
+
+void BusEventLoop::encode(Connection &c, const Request &req) {
+  const FroniusBus::Transaction &t = req.merged;
+
+  // Unsent bytes belong to other active requests, each at most one
+  // request long, so after compaction there is always room for one more
+  if (c.txSent > 0) {
+    std::memmove(c.tx.data(), c.tx.data() + c.txSent, c.txLen - c.txSent);
+    c.txLen -= c.txSent;
+    c.txSent = 0;
+  }
+
+  if (req.writing) {
+    const uint16_t *src =
+        t.op == FroniusBus::Transaction::Op::MODIFY ? t.dest : t.src;
+    c.txLen += ModbusTcpFramer::writeRequest(
+        {c.tx.data() + c.txLen, c.tx.size() - c.txLen}, req.tid,
+        static_cast<uint8_t>(t.slaveId), static_cast<uint16_t>(t.startAddr),
+        static_cast<uint16_t>(t.count), src);
+    return;
+  }
+
+  const auto frame = ModbusTcpFramer::readRequest(
+      req.tid, static_cast<uint8_t>(t.slaveId),
+      static_cast<uint16_t>(t.startAddr), static_cast<uint16_t>(t.count));
+  std::copy(frame.begin(), frame.end(), c.tx.begin() + c.txLen);
+  c.txLen += frame.size();
+}
+
+void BusEventLoop::flush(Connection &c) {
+  while (c.txSent < c.txLen) {
+    const ssize_t sent = send(c.fd, c.tx.data() + c.txSent,
+                              c.txLen - c.txSent, MSG_NOSIGNAL);
+    if (sent > 0) {
+      c.txSent += static_cast<size_t>(sent);
+      continue;
+    }
+    if (errno == EINTR)
+      continue;
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+      break;
+
+    drop(c, ModbusError::fromErrno("flush(): Sending to '{}' failed",
+                                   c.channel->bus->cfg_.tcp().host));
+    return;
+  }
+  updateEvents(c);
+}
+
+void BusEventLoop::receive(Connection &c) {
+  for (;;) {
+    const ssize_t got =
+        recv(c.fd, c.rx.data() + c.rxLen, c.rx.size() - c.rxLen, 0);
+
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+      return;
+    if (got <= 0) {
+      if (got == 0)
+        errno = ECONNRESET;
+      drop(c, ModbusError::fromErrno("receive(): Connection to '{}' lost",
+                                     c.channel->bus->cfg_.tcp().host));
+      return;
+    }
+    c.rxLen += static_cast<size_t>(got);
+
+    // Split off every complete frame; keep a partial one for later
+    size_t used = 0;
+    for (;;) {
+      ModbusTcpFramer::Response resp;
+      auto size = ModbusTcpFramer::parse(
+          {c.rx.data() + used, c.rxLen - used}, resp);
+      if (!size) {
+        // Frame boundaries are lost — only a new connection recovers
+        drop(c, size.error());
+        return;
+      }
+      if (*size == 0)
+        break;
+      dispatch(c, resp);
+      used += *size;
+    }
+
+    std::memmove(c.rx.data(), c.rx.data() + used, c.rxLen - used);
+    c.rxLen -= used;
+  }
+}
+
+void BusEventLoop::dispatch(Connection &c,
+                            const ModbusTcpFramer::Response &resp) {
+  auto it = std::find_if(c.requests.begin(), c.requests.end(),
+                         [&resp](const Request &r) {
+                           return r.active && r.tid == resp.tid;
+                         });
+
+  // A late answer to a request that already timed out
+  if (it == c.requests.end()) {
+    c.channel->bus->busLog(Cat::WIRE, Lvl::DEBUG,
+                           "[rx] tid={} conn={} -> no matching request, "
+                           "discarded",
+                           resp.tid, c.index);
+    return;
+  }
+
+  Request &req = *it;
+  const FroniusBus::Transaction &t = req.merged;
+
+  if (resp.unit != t.slaveId) {
+    c.channel->bus->busLog(Cat::WIRE, Lvl::DEBUG,
+                           "[rx] tid={} conn={} -> answered by unit {}",
+                           resp.tid, c.index, resp.unit);
+    finish(c, req,
+           std::unexpected(ModbusErrorEvent::of(
+               EMBBADSLAVE, "dispatch(): Response from another unit",
+               t.slaveId, t.startAddr, t.count)));
+    return;
+  }
+
+  if (resp.exception != 0) {
+    // libmodbus numbers its exception errors after the exception codes
+    finish(c, req,
+           std::unexpected(ModbusErrorEvent::of(
+               MODBUS_ENOBASE + resp.exception,
+               "dispatch(): Exception response", t.slaveId, t.startAddr,
+               t.count)));
+    return;
+  }
+
+  if (req.writing) {
+    // The response echoes the start address and count of the write
+    std::array<uint16_t, 2> echo{};
+    if (resp.function == ModbusTcpFramer::WRITE_MULTIPLE_REGISTERS)
+      ModbusTcpFramer::decodeRegisters(resp.data, echo.data());
+    if (echo[0] != t.startAddr || echo[1] != t.count) {
+      c.channel->bus->busLog(Cat::WIRE, Lvl::DEBUG,
+                             "[rx] tid={} conn={} -> confirmed {} registers "
+                             "at {}",
+                             resp.tid, c.index, echo[1], echo[0]);
+      finish(c, req,
+             std::unexpected(ModbusErrorEvent::of(
+                 EMBBADDATA, "dispatch(): Write confirmed another range",
+                 t.slaveId, t.startAddr, t.count)));
+      return;
+    }
+    finish(c, req, {});
+    return;
+  }
+
+  if (resp.function != ModbusTcpFramer::READ_HOLDING_REGISTERS ||
+      resp.data.size() != 2 * static_cast<size_t>(t.count)) {
+    finish(c, req,
+           std::unexpected(ModbusErrorEvent::of(
+               EMBBADDATA, "dispatch(): Wrong number of registers received",
+               t.slaveId, t.startAddr, t.count)));
+    return;
+  }
+
+  ModbusTcpFramer::decodeRegisters(resp.data, t.dest);
+
+  // A read-modify-write goes on with its write on the same connection;
+  // service() flushes it with the other new requests
+  if (t.op == FroniusBus::Transaction::Op::MODIFY) {
+    FroniusBus &bus = *c.channel->bus;
+    FroniusBus::applyModify(t);
+    req.writing = true;
+    req.tid = c.nextTid++;
+    req.deadline = Clock::now() + bus.requestTimeout(t);
+    encode(c, req);
+
+    bus.busLog(Cat::WIRE, Lvl::DEBUG,
+               "[tx] slave={} addr={} count={} tid={} conn={} -> writing back",
+               t.slaveId, t.startAddr, t.count, req.tid, c.index);
+    return;
+  }
+
+  finish(c, req, {});
+}
+
+void BusEventLoop::finish(Connection &c, Request &req,
+                          std::expected<void, ModbusErrorEvent> res) {
+  FroniusBus &bus = *c.channel->bus;
+
+  const int err = res ? 0 : res.error().code;
+  if (req.merged.op != FroniusBus::Transaction::Op::READ)
+    bus.recordWrite(req.merged, err, req.sentAt, Clock::now());
+  else
+    bus.recordRead(req.merged, err, req.sentAt, Clock::now());
+  retire(c, req);
+
+  if (res) {
+    if (req.n == 1)
+      FroniusBus::complete(*req.group[0], {});
+    else
+      bus.completeMerged(req.group, req.n, req.merged, req.sentAt);
+    return;
+  }
+
+  // A merged range the slave rejects is remembered, and its reads go
+  // back to the front of the queue to be sent without it
+  if (req.n > 1 && (err == EMBXILADD || err == EMBXILVAL)) {
+    bus.rejectSpan(req.merged);
+    bus.requeueFront({req.group.data(), req.n});
+    return;
+  }
+
+  bus.reportReadError(res.error());
+  for (size_t i = 0; i < req.n; ++i)
+    FroniusBus::fail(*req.group[i], res.error());
+}
+
+void BusEventLoop::retire(Connection &c, Request &req) {
+  req.active = false;
+  --c.inFlight;
+
+  if (req.merged.op != FroniusBus::Transaction::Op::READ)
+    c.channel->bus->metrics_.recordWriteLatency(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            Clock::now() - req.group[0]->queuedAt));
+}
+
+void BusEventLoop::abortAll(Connection &c, const ModbusError &err) {
+  // Aborted requests never got an answer, so they are not accounted for
+  // as reads or writes
+  for (Request &req : c.requests) {
+    if (!req.active)
+      continue;
+    retire(c, req);
+    for (size_t i = 0; i < req.n; ++i)
+      FroniusBus::complete(*req.group[i], std::unexpected(err));
+  }
+}
@@ -0,0 +1,322 @@
+#include "bus_recording.h"
+#include "modbus_error.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <fcntl.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+/** Current `system_clock` time in ns. */
+int64_t systemNs() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/** Check the header of a recording; `what` names the caller. */
+std::expected<void, ModbusError> checkHeader(const BusRecordingHeader &h,
+                                             const std::string &path,
+                                             const char *what) {
+  if (h.magic != BusRecordingHeader::MAGIC)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "{}: {} is not a bus recording", what, path));
+  if (h.byteOrder != BusRecordingHeader::BYTE_ORDER_MARK)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "{}: {} was recorded with the other byte order", what, path));
+  if (h.version != BusRecordingHeader::VERSION ||
+      h.headerSize < sizeof(BusRecordingHeader))
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "{}: Unsupported recording version {} in {}", what,
+        h.version, path));
+  return {};
+}
+
+/** Microseconds from `from` to `to`, 0 if negative. */
+uint64_t micros(Clock::time_point from, Clock::time_point to) {
+  if (to <= from)
+    return 0;
+  return static_cast<uint64_t>(
+      std::chrono::duration_cast<std::chrono::microseconds>(to - from)
+          .count());
+}
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   BusRecorder
+   ------------------------------------------------------------------------- */
+
+std::expected<std::unique_ptr<BusRecorder>, ModbusError>
+BusRecorder::open(const std::string &path) {
+  const int fd =
+      ::open(path.c_str(), O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+  if (fd == -1)
+    return std::unexpected(ModbusError::custom(
+        errno, "BusRecorder::open(): Cannot open recording {}", path));
+
+  auto fail = [fd](ModbusError err) {
+    ::close(fd);
+    return std::unexpected(std::move(err));
+  };
+
+  struct stat st{};
+  if (fstat(fd, &st) == -1)
+    return fail(ModbusError::custom(
+        errno, "BusRecorder::open(): Cannot stat recording {}", path));
+
+  BusRecordingHeader header;
+  if (st.st_size == 0) {
+    header.startNs = systemNs();
+    if (::write(fd, &header, sizeof(header)) !=
+        static_cast<ssize_t>(sizeof(header)))
+      return fail(ModbusError::custom(
+          errno ? errno : EIO,
+          "BusRecorder::open(): Cannot write recording header to {}", path));
+  } else {
+    if (pread(fd, &header, sizeof(header), 0) !=
+        static_cast<ssize_t>(sizeof(header)))
+      return fail(ModbusError::custom(
+          EINVAL, "BusRecorder::open(): {} is not a bus recording", path));
+    if (auto res = checkHeader(header, path, "BusRecorder::open()"); !res)
+      return fail(std::move(res.error()));
+
+    // Cut off a record torn by a crash, so that appended records are
+    // still reachable by a replay
+    off_t end = header.headerSize;
+    BusRecord rec;
+    while (pread(fd, &rec, sizeof(rec), end) ==
+           static_cast<ssize_t>(sizeof(rec))) {
+      const off_t next = end + static_cast<off_t>(BusRecord::size(rec.words));
+      if (next > st.st_size)
+        break;
+      end = next;
+    }
+    if (end != st.st_size && ftruncate(fd, end) == -1)
+      return fail(ModbusError::custom(
+          errno, "BusRecorder::open(): Cannot repair recording {}", path));
+  }
+
+  // Anchor the recording's start on the steady clock, so record times do
+  // not jump with the wall clock
+  const auto origin =
+      Clock::now() - std::chrono::nanoseconds(systemNs() - header.startNs);
+  return std::unique_ptr<BusRecorder>(new BusRecorder(path, fd, origin));
+}
+
+BusRecorder::~BusRecorder() {
+  if (fd_ != -1)
+    ::close(fd_);
+}
+
+std::expected<void, ModbusError>
+BusRecorder::append(int slaveId, int startAddr, int count,
+                    const uint16_t *words, int err, Clock::time_point start,
+                    Clock::time_point end, BusRecord::Op op) {
+  if (count < 0 || count > MAX_WORDS)
+    return std::unexpected(ModbusError::custom(
+        EMBMDATA, "append(): Cannot record an access of {} registers",
+        count));
+
+  BusRecord rec;
+  rec.atUs = micros(origin_, start);
+  rec.durationUs = static_cast<uint32_t>(std::min<uint64_t>(
+      micros(start, end), std::numeric_limits<uint32_t>::max()));
+  rec.err = err;
+  rec.startAddr = static_cast<uint16_t>(startAddr);
+  rec.count = static_cast<uint16_t>(count);
+  rec.slaveId = static_cast<uint8_t>(slaveId);
+  rec.op = op;
+  rec.words = err == 0 ? static_cast<uint16_t>(count) : 0;
+
+  const size_t payload = 2 * size_t{rec.words};
+  const size_t total = BusRecord::size(rec.words);
+  std::memcpy(buf_.data(), &rec, sizeof(rec));
+  if (payload != 0)
+    std::memcpy(buf_.data() + sizeof(rec), words, payload);
+  std::fill(buf_.begin() + sizeof(rec) + payload, buf_.begin() + total, 0);
+
+  // One write per record; with O_APPEND it lands at the end as a whole
+  const ssize_t n = ::write(fd_, buf_.data(), total);
+  if (n != static_cast<ssize_t>(total))
+    return std::unexpected(ModbusError::custom(
+        n == -1 ? errno : EIO, "append(): Cannot write to recording {}",
+        path_));
+  return {};
+}
+
+/* -------------------------------------------------------------------------
+   BusReplay
+   ------------------------------------------------------------------------- */
+
+std::expected<std::unique_ptr<BusReplay>, ModbusError>
+BusReplay::open(const std::string &path, double speed, bool loop) {
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return std::unexpected(ModbusError::custom(
+        errno, "BusReplay::open(): Cannot open recording {}", path));
+
+  struct stat st{};
+  if (fstat(fd, &st) == -1) {
+    const int e = errno;
+    ::close(fd);
+    return std::unexpected(ModbusError::custom(
+        e, "BusReplay::open(): Cannot stat recording {}", path));
+  }
+  if (static_cast<size_t>(st.st_size) < sizeof(BusRecordingHeader)) {
+    ::close(fd);
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "BusReplay::open(): {} is not a bus recording", path));
+  }
+
+  const size_t size = static_cast<size_t>(st.st_size);
+  void *map = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  const int mapErr = errno;
+  ::close(fd);
+  if (map == MAP_FAILED)
+    return std::unexpected(ModbusError::custom(
+        mapErr, "BusReplay::open(): Cannot map recording {}", path));
+
+  std::unique_ptr<BusReplay> replay(new BusReplay(path, speed, loop));
+  replay->base_ = static_cast<const uint8_t *>(map);
+  replay->size_ = size;
+
+  BusRecordingHeader header;
+  std::memcpy(&header, replay->base_, sizeof(header));
+  if (auto res = checkHeader(header, path, "BusReplay::open()"); !res)
+    return std::unexpected(std::move(res.error()));
+
+  // Index the records by op, slave, and range; a torn last record is
+  // ignored
+  uint64_t lastUs = 0;
+  size_t at = header.headerSize;
+  while (at + sizeof(BusRecord) <= size) {
+    const BusRecord *rec = replay->record(at);
+    const size_t total = BusRecord::size(rec->words);
+    if (at + total > size)
+      break;
+
+    if ((rec->err != 0 || rec->words == rec->count) &&
+        rec->op <= BusRecord::MODIFY) {
+      const uint64_t k = key(rec->slaveId, rec->startAddr, rec->count);
+      auto &seq = rec->op == BusRecord::READ
+                      ? replay->sequences_[k]
+                      : replay->writes_[uint64_t{rec->op} << 40 | k];
+      seq.records.push_back(at);
+      if (replay->records_++ == 0)
+        replay->firstUs_ = rec->atUs;
+      lastUs = std::max(lastUs, rec->atUs + rec->durationUs);
+    }
+    at += total;
+  }
+
+  if (replay->records_ == 0)
+    return std::unexpected(ModbusError::custom(
+        ENODATA, "BusReplay::open(): No accesses recorded in {}", path));
+
+  replay->spanUs_ = lastUs - replay->firstUs_;
+  for (auto &[k, seq] : replay->sequences_)
+    replay->aliases_.emplace(k, Alias{&seq, 0});
+
+  return replay;
+}
+
+BusReplay::~BusReplay() {
+  if (base_)
+    munmap(const_cast<uint8_t *>(base_), size_);
+}
+
+const BusReplay::Alias *BusReplay::resolve(int slaveId, int startAddr,
+                                           int count) {
+  const uint64_t k = key(slaveId, startAddr, count);
+  if (auto it = aliases_.find(k); it != aliases_.end())
+    return &it->second;
+
+  // Serve the range from the shortest recorded read containing it
+  Sequence *best = nullptr;
+  uint16_t bestStart = 0;
+  uint16_t bestCount = 0;
+  for (auto &[other, seq] : sequences_) {
+    const auto *rec = record(seq.records.front());
+    if (rec->slaveId != slaveId || rec->startAddr > startAddr ||
+        rec->startAddr + rec->count < startAddr + count)
+      continue;
+    if (!best || rec->count < bestCount) {
+      best = &seq;
+      bestStart = rec->startAddr;
+      bestCount = rec->count;
+    }
+  }
+  if (!best)
+    return nullptr;
+
+  const Alias alias{best, static_cast<uint16_t>(startAddr - bestStart)};
+  return &aliases_.emplace(k, alias).first->second;
+}
+
+std::expected<BusReplay::Response, ModbusError>
+BusReplay::next(int slaveId, int startAddr, int count) {
+  const Alias *alias = resolve(slaveId, startAddr, count);
+  if (!alias)
+    return std::unexpected(ModbusError::custom(
+        EMBXILADD, "next(): No read of slave {} covering addr={} count={} "
+                   "in {}",
+        slaveId, startAddr, count, path_));
+
+  return take(*alias->sequence, alias->offset);
+}
+
+std::expected<BusReplay::Response, ModbusError>
+BusReplay::nextWrite(BusRecord::Op op, int slaveId, int startAddr,
+                     int count) {
+  auto it = writes_.find(uint64_t{op} << 40 | key(slaveId, startAddr, count));
+  if (it == writes_.end())
+    return std::unexpected(ModbusError::custom(
+        ENOTSUP, "nextWrite(): No {} of slave {} at addr={} count={} in {}",
+        op == BusRecord::MODIFY ? "read-modify-write" : "write", slaveId,
+        startAddr, count, path_));
+
+  return take(it->second, 0);
+}
+
+std::expected<BusReplay::Response, ModbusError>
+BusReplay::take(Sequence &seq, uint16_t offset) {
+  if (seq.next == seq.records.size()) {
+    if (!loop_) {
+      finished_ = true;
+      return std::unexpected(ModbusError::custom(
+          ENODATA, "take(): Replay of {} finished", path_));
+    }
+    seq.next = 0;
+    ++seq.lap;
+  }
+
+  const BusRecord *rec = record(seq.records[seq.next++]);
+  Response res{rec, rec->data() + offset, Clock::time_point::min()};
+
+  if (speed_ > 0) {
+    const auto now = Clock::now();
+    if (!running_) {
+      started_ = now;
+      running_ = true;
+    }
+    const double us = static_cast<double>(seq.lap * spanUs_ + rec->atUs -
+                                          firstUs_ + rec->durationUs) /
+                      speed_;
+    res.due = started_ + std::chrono::microseconds(std::llround(us));
+  }
+  return res;
+}
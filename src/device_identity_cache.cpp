@@ -0,0 +1,212 @@
+#include "device_identity_cache.h"
+#include "fronius_types.h"
+#include "modbus_config.h"
+#include "modbus_error.h"
+#include "sunspec_discovery.h"
+#include <cerrno>
+#include <charconv>
+#include <cstdint>
+#include <cstdio>
+#include <expected>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/** First line of a cache file; bump the version on format changes. */
+constexpr std::string_view FILE_HEADER = "# libfronius identity cache v1";
+
+/** Tab-separated fields per entry line. */
+constexpr size_t FIELDS = 9;
+
+std::vector<std::string_view> split(std::string_view line, char sep) {
+  std::vector<std::string_view> parts;
+  size_t pos = 0;
+  for (;;) {
+    const size_t next = line.find(sep, pos);
+    parts.push_back(line.substr(pos, next - pos));
+    if (next == std::string_view::npos)
+      return parts;
+    pos = next + 1;
+  }
+}
+
+template <typename T> bool parse(std::string_view text, T &value) {
+  const auto [ptr, ec] =
+      std::from_chars(text.data(), text.data() + text.size(), value);
+  return ec == std::errc() && ptr == text.data() + text.size();
+}
+
+std::string_view mapName(FroniusTypes::RegisterMap map) {
+  return map == FroniusTypes::RegisterMap::PROPRIETARY ? "proprietary"
+                                                       : "sunspec";
+}
+
+/** Parse one entry line; nullopt if it is malformed. */
+std::optional<std::pair<std::string, DeviceIdentity>>
+parseEntry(std::string_view line) {
+  const auto fields = split(line, '\t');
+  if (fields.size() != FIELDS)
+    return std::nullopt;
+
+  DeviceIdentity identity;
+  if (fields[1] == "sunspec")
+    identity.map = FroniusTypes::RegisterMap::SUNSPEC;
+  else if (fields[1] == "proprietary")
+    identity.map = FroniusTypes::RegisterMap::PROPRIETARY;
+  else
+    return std::nullopt;
+
+  identity.serial = fields[2];
+
+  int floatRegisters = 0;
+  int hybrid = 0;
+  uint16_t endAddr = 0;
+  if (!parse(fields[3], identity.modelId) ||
+      !parse(fields[4], floatRegisters) || !parse(fields[5], identity.inputs) ||
+      !parse(fields[6], hybrid) || !parse(fields[7], endAddr))
+    return std::nullopt;
+  identity.floatRegisters = floatRegisters != 0;
+  identity.hybrid = hybrid != 0;
+
+  if (!fields[8].empty()) {
+    for (std::string_view item : split(fields[8], ',')) {
+      const auto parts = split(item, ':');
+      SunSpecModelTable::Model model;
+      if (parts.size() != 3 || !parse(parts[0], model.id) ||
+          !parse(parts[1], model.addr) || !parse(parts[2], model.length) ||
+          !identity.models.append(model))
+        return std::nullopt;
+    }
+  }
+  identity.models.terminate(endAddr);
+
+  return std::make_pair(std::string(fields[0]), std::move(identity));
+}
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   Keys and entries
+   ------------------------------------------------------------------------- */
+
+std::string DeviceIdentityCache::key(const ModbusBusConfig &bus,
+                                     int slaveId) {
+  if (bus.isTcp())
+    return "tcp://" + bus.tcp().host + ":" + std::to_string(bus.tcp().port) +
+           "/" + std::to_string(slaveId);
+  if (bus.isReplay())
+    return "replay://" + bus.replay().path + "/" + std::to_string(slaveId);
+  return "rtu://" + bus.rtu().device + "/" + std::to_string(slaveId);
+}
+
+std::optional<DeviceIdentity>
+DeviceIdentityCache::lookup(const std::string &key) const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  auto it = entries_.find(key);
+  if (it == entries_.end())
+    return std::nullopt;
+  return it->second;
+}
+
+std::expected<void, ModbusError>
+DeviceIdentityCache::store(const std::string &key,
+                           const DeviceIdentity &identity) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  entries_[key] = identity;
+  return save();
+}
+
+std::expected<void, ModbusError>
+DeviceIdentityCache::erase(const std::string &key) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (entries_.erase(key) == 0)
+    return {};
+  return save();
+}
+
+size_t DeviceIdentityCache::size() const {
+  std::lock_guard<std::mutex> lock(mtx_);
+  return entries_.size();
+}
+
+/* -------------------------------------------------------------------------
+   Persistence
+   ------------------------------------------------------------------------- */
+
+std::expected<void, ModbusError> DeviceIdentityCache::load() {
+  if (path_.empty())
+    return {};
+
+  std::ifstream in(path_);
+  if (!in) {
+    if (errno == ENOENT)
+      return {};
+    return std::unexpected(ModbusError::custom(
+        errno, "load(): Cannot open identity cache {}", path_));
+  }
+
+  std::map<std::string, DeviceIdentity> entries;
+  std::string line;
+  if (!std::getline(in, line) || line != FILE_HEADER)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "load(): Unsupported identity cache format in {}", path_));
+
+  while (std::getline(in, line)) {
+    if (auto entry = parseEntry(line))
+      entries.insert(std::move(*entry));
+  }
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  entries_ = std::move(entries);
+  return {};
+}
+
+std::expected<void, ModbusError> DeviceIdentityCache::save() const {
+  if (path_.empty())
+    return {};
+
+  // Write a sibling file and rename it over the cache, so a crash never
+  // leaves a truncated cache behind
+  const std::string tmp = path_ + ".tmp";
+  {
+    std::ofstream out(tmp, std::ios::trunc);
+    if (!out)
+      return std::unexpected(ModbusError::custom(
+          errno, "save(): Cannot write identity cache {}", tmp));
+
+    out << FILE_HEADER << '\n';
+    for (const auto &[key, identity] : entries_) {
+      out << key << '\t' << mapName(identity.map) << '\t' << identity.serial
+          << '\t' << identity.modelId << '\t' << int(identity.floatRegisters)
+          << '\t' << identity.inputs << '\t' << int(identity.hybrid) << '\t'
+          << identity.models.endAddr() << '\t';
+      bool first = true;
+      for (const auto &model : identity.models) {
+        if (!first)
+          out << ',';
+        out << model.id << ':' << model.addr << ':' << model.length;
+        first = false;
+      }
+      out << '\n';
+    }
+
+    out.flush();
+    if (!out)
+      return std::unexpected(ModbusError::custom(
+          EIO, "save(): Failed writing identity cache {}", tmp));
+  }
+
+  if (std::rename(tmp.c_str(), path_.c_str()) != 0)
+    return std::unexpected(ModbusError::custom(
+        errno, "save(): Cannot replace identity cache {}", path_));
+
+  return {};
+}
@@ -0,0 +1,170 @@
+#include "device_scheduler.h"
+#include "fronius_bus.h"
+#include "fronius_device.h"
+#include <algorithm>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+
+/* -------------------------------------------------------------------------
+   Construction / destruction
+   ------------------------------------------------------------------------- */
+
+DeviceScheduler::DeviceScheduler(int threads) {
+  if (threads < 1)
+    throw std::invalid_argument("DeviceScheduler: threads must be at least 1");
+
+  probing_.assign(static_cast<size_t>(threads), nullptr);
+  orphaned_.assign(static_cast<size_t>(threads), nullptr);
+  threads_.reserve(static_cast<size_t>(threads));
+  for (size_t i = 0; i < static_cast<size_t>(threads); ++i)
+    threads_.emplace_back(&DeviceScheduler::run, this, i);
+}
+
+DeviceScheduler::~DeviceScheduler() {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    running_ = false;
+    cv_.notify_all();
+  }
+
+  // Dropping the last reference to a device during its probe destroys
+  // the bus, and with it the scheduler, on the probing thread. That
+  // thread cannot be joined; it is told to leave without touching the
+  // scheduler again.
+  const auto self = std::this_thread::get_id();
+  for (size_t i = 0; i < threads_.size(); ++i) {
+    if (threads_[i].get_id() == self) {
+      *orphaned_[i] = true;
+      threads_[i].detach();
+    } else if (threads_[i].joinable()) {
+      threads_[i].join();
+    }
+  }
+}
+
+/* -------------------------------------------------------------------------
+   Public API
+   ------------------------------------------------------------------------- */
+
+void DeviceScheduler::schedule(FroniusBus &bus,
+                               std::shared_ptr<FroniusDevice> device) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  if (!running_)
+    return;
+
+  auto [it, inserted] = inProgress_.emplace(device.get(), &bus);
+  if (!inserted)
+    return; // retry already in flight for this device
+
+  const int delay = device->getDeviceConfig().reconnectDelay;
+  retries_.push_back({std::chrono::steady_clock::now(), device, device.get(),
+                      &bus, delay, epochs_[&bus]});
+  std::push_heap(retries_.begin(), retries_.end(), retryLater);
+  cv_.notify_one();
+}
+
+void DeviceScheduler::cancel(const FroniusBus &bus) {
+  std::lock_guard<std::mutex> lock(mtx_);
+  ++epochs_[&bus];
+  dropRetries(bus);
+}
+
+void DeviceScheduler::remove(const FroniusBus &bus) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  epochs_.erase(&bus);
+  dropRetries(bus);
+
+  // A probe of this bus running on the calling thread cannot be waited
+  // for; it finds the epoch gone and does not touch the bus again.
+  const auto self = std::this_thread::get_id();
+  idleCv_.wait(lock, [this, &bus, self] {
+    for (size_t i = 0; i < probing_.size(); ++i)
+      if (probing_[i] == &bus && threads_[i].get_id() != self)
+        return false;
+    return true;
+  });
+}
+
+void DeviceScheduler::dropRetries(const FroniusBus &bus) {
+  std::erase_if(retries_, [&bus](const Retry &r) { return r.bus == &bus; });
+  std::make_heap(retries_.begin(), retries_.end(), retryLater);
+  std::erase_if(inProgress_, [&bus](const auto &entry) {
+    return entry.second == &bus;
+  });
+  cv_.notify_all();
+}
+
+/* -------------------------------------------------------------------------
+   Probe threads
+   ------------------------------------------------------------------------- */
+
+void DeviceScheduler::run(size_t worker) {
+  std::unique_lock<std::mutex> lock(mtx_);
+
+  // Set by the destructor if it runs on this thread
+  bool orphaned = false;
+  orphaned_[worker] = &orphaned;
+
+  while (running_) {
+    // Sleep until the earliest retry is due; every change to the heap
+    // notifies, so the deadline is re-evaluated on each wakeup
+    if (retries_.empty()) {
+      cv_.wait(lock);
+      continue;
+    }
+    const auto due = retries_.front().due;
+    if (std::chrono::steady_clock::now() < due) {
+      cv_.wait_until(lock, due);
+      continue;
+    }
+
+    std::pop_heap(retries_.begin(), retries_.end(), retryLater);
+    Retry retry = std::move(retries_.back());
+    retries_.pop_back();
+    probing_[worker] = retry.bus;
+    lock.unlock();
+
+    // Probe outside the lock: onBusConnected() blocks on the bus, and its
+    // error callbacks may call schedule()
+    bool done = true;
+    int next = retry.delay;
+    if (auto device = retry.device.lock();
+        device && retry.bus->isConnected()) {
+      if (!device->isReady())
+        device->onBusConnected();
+      done = device->isReady();
+      if (!done) {
+        device->fireDeviceRetry(retry.delay);
+        const auto &cfg = device->getDeviceConfig();
+        if (cfg.exponential)
+          next = std::min(retry.delay * 2, cfg.reconnectDelayMax);
+      }
+    }
+    if (orphaned)
+      return;
+
+    lock.lock();
+    probing_[worker] = nullptr;
+    idleCv_.notify_all();
+
+    // The bus dropped meanwhile: its retries were reset with the epoch
+    auto epoch = epochs_.find(retry.bus);
+    if (epoch == epochs_.end() || epoch->second != retry.epoch)
+      continue;
+
+    if (done || !running_ || !retry.bus->isConnected()) {
+      inProgress_.erase(retry.key);
+      continue;
+    }
+
+    retry.due = std::chrono::steady_clock::now() +
+                std::chrono::seconds(retry.delay);
+    retry.delay = next;
+    retries_.push_back(std::move(retry));
+    std::push_heap(retries_.begin(), retries_.end(), retryLater);
+  }
+}
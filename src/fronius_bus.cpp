@@ -1,4 +1,6 @@
 #include "fronius_bus.h"
+#include "bus_event_loop.h"
+#include "device_scheduler.h"
 #include "fronius_device.h"
 #include "modbus_error.h"
 #include "modbus_utils.h"
@@ -6,8 +8,22 @@
 #include <cerrno>
 #include <chrono>
 #include <modbus/modbus.h>
+#include <memory>
 #include <mutex>
+#include <stdexcept>
+#include <system_error>
 #include <thread>
+#include <utility>
+
+namespace {
+
+// Shorthands for the log filter arguments of busLog()
+using Cat = FroniusTypes::LogCategory;
+using Lvl = FroniusTypes::LogLevel;
+
+} // namespace
+
+thread_local bool FroniusBus::onBusThread_ = false;
 
 /* -------------------------------------------------------------------------
    Construction / destruction
@@ -15,6 +31,58 @@
 
 FroniusBus::FroniusBus(const ModbusBusConfig &cfg) : cfg_(cfg) {
   cfg.validate();
+
+  trace_.init(static_cast<size_t>(cfg_.traceCapacity));
+  errorLimiter_.init(std::chrono::milliseconds(cfg_.errorHoldoffMs));
+
+  // Allocate the transaction pool and reserve the queue once, so that
+  // submitting and completing transactions never touches the heap.
+  slots_ = std::make_unique<Slot[]>(cfg_.queueCapacity);
+  txQueue_.reserve(cfg_.queueCapacity);
+  expired_.reserve(cfg_.queueCapacity);
+  held_.reserve(cfg_.queueCapacity);
+  rejectedSpans_.reserve(MAX_REJECTED_SPANS);
+  switchGuards_.reserve(MAX_SWITCH_GUARDS);
+
+  // Modbus RTU frames are delimited by 3.5 character times of silence;
+  // above 19200 baud the spec fixes the gap at 1.75 ms.
+  if (cfg_.isRtu()) {
+    const auto &r = cfg_.rtu();
+    const int charBits = 1 + r.dataBits + (r.parity == 'N' ? 0 : 1) +
+                         r.stopBits;
+    interFrameDelay_ = std::chrono::microseconds(
+        r.baud > 19200 ? 1750L : 3500000L * charBits / r.baud);
+  }
+
+  if (cfg_.isReplay()) {
+    const auto &r = cfg_.replay();
+    auto replay = BusReplay::open(r.path, r.speed, r.loop);
+    if (!replay)
+      throw std::system_error(replay.error().code, std::generic_category(),
+                              replay.error().message);
+    replay_ = std::move(*replay);
+  }
+
+  if (!cfg_.recordPath.empty()) {
+    auto recorder = BusRecorder::open(cfg_.recordPath);
+    if (!recorder)
+      throw std::system_error(recorder.error().code, std::generic_category(),
+                              recorder.error().message);
+    recorder_ = std::move(*recorder);
+  }
+}
+
+FroniusBus::FroniusBus(const ModbusBusConfig &cfg,
+                       std::shared_ptr<BusEventLoop> loop)
+    : FroniusBus(cfg) {
+  if (!loop)
+    throw std::invalid_argument("FroniusBus: event loop must not be null");
+  if (!cfg_.isTcp())
+    throw std::invalid_argument(
+        "FroniusBus: an event loop can only drive TCP buses");
+
+  loop_ = std::move(loop);
+  scheduler_ = loop_->scheduler_;
 }
 
 FroniusBus::~FroniusBus() {
@@ -29,10 +97,18 @@ FroniusBus::~FroniusBus() {
   if (busThread_.joinable())
     busThread_.join();
 
+  // Returns once the loop thread no longer touches this bus
+  if (loop_)
+    loop_->detach(this);
+
   // Cancel any transactions that were queued but never executed, so that
-  // callers blocked on future.get() are unblocked immediately.
+  // callers blocked on Completion::get() are unblocked immediately.
   cancelPendingTransactions();
 
+  // A probe in progress fails with the cancelled transactions above
+  if (scheduler_)
+    scheduler_->remove(*this);
+
   if (ctx_) {
     modbus_close(ctx_);
     modbus_free(ctx_);
@@ -49,7 +125,19 @@ void FroniusBus::connect() {
   if (running_.exchange(true))
     return; // already started
 
-  busThread_ = std::thread(&FroniusBus::busLoop, this);
+  // Pipelining and pooling need the non-blocking transport; a bus without
+  // a shared loop gets one of its own
+  if (!loop_ && (cfg_.pipelineDepth > 1 || cfg_.connections > 1)) {
+    loop_ = std::make_shared<BusEventLoop>(1);
+    scheduler_ = loop_->scheduler_;
+  }
+
+  if (loop_) {
+    loop_->attach(this);
+  } else {
+    scheduler_ = std::make_shared<DeviceScheduler>();
+    busThread_ = std::thread(&FroniusBus::busLoop, this);
+  }
 }
 
 void FroniusBus::triggerReconnect() {
@@ -60,37 +148,392 @@ void FroniusBus::triggerReconnect() {
 
   connected_.store(false);
   cv_.notify_all(); // wake bus thread to re-enter connection logic
+  if (loop_)
+    loop_->wake();
 }
 
 void FroniusBus::registerDevice(std::weak_ptr<FroniusDevice> device) {
   std::lock_guard<std::mutex> lock(mtx_);
+
+  if (auto live = device.lock()) {
+    const ModbusDeviceConfig &dc = live->config();
+    const auto slave = static_cast<size_t>(dc.slaveId);
+    if ((dc.adaptiveTimeout || dc.breakerThreshold > 0) &&
+        slave < health_.size() &&
+        !health_[slave].load(std::memory_order_relaxed)) {
+      SlaveHealth::Policy policy;
+      policy.adaptive = dc.adaptiveTimeout;
+      policy.margin = dc.timeoutMargin;
+      policy.minTimeout = std::chrono::milliseconds(dc.minTimeoutMs);
+      policy.breakerThreshold = dc.breakerThreshold;
+      healthStore_.push_back(std::make_unique<SlaveHealth>(policy));
+      health_[slave].store(healthStore_.back().get(),
+                           std::memory_order_release);
+    }
+  }
+
   devices_.push_back(std::move(device));
 }
 
-std::future<std::expected<void, ModbusError>>
-FroniusBus::submit(Transaction t) {
-  // Extract the future from the promise before moving the transaction
-  // into the queue — the promise is consumed by the move.
-  auto future = t.promise.get_future();
+FroniusBus::Completion FroniusBus::submit(const Transaction &t) {
+  CompletionCallback none;
+  auto slot = enqueue(t, none, true);
+  if (!slot)
+    return Completion(std::unexpected(std::move(slot.error())));
+  return Completion(*slot);
+}
+
+void FroniusBus::submit(const Transaction &t, CompletionCallback cb) {
+  // On rejection the callback is left with the caller and invoked here,
+  // on the submitting thread.
+  if (auto slot = enqueue(t, cb, true); !slot && cb)
+    cb(std::unexpected(std::move(slot.error())));
+}
+
+FroniusBus::Completion FroniusBus::trySubmit(const Transaction &t) {
+  CompletionCallback none;
+  auto slot = enqueue(t, none, false);
+  if (!slot)
+    return Completion(std::unexpected(std::move(slot.error())));
+  return Completion(*slot);
+}
+
+void FroniusBus::trySubmit(const Transaction &t, CompletionCallback cb) {
+  if (auto slot = enqueue(t, cb, false); !slot && cb)
+    cb(std::unexpected(std::move(slot.error())));
+}
+
+std::expected<FroniusBus::Slot *, ModbusError>
+FroniusBus::enqueue(const Transaction &t, CompletionCallback &cb, bool wait) {
+  using Op = Transaction::Op;
+
+  if (!t.dest && t.op != Op::WRITE) {
+    // The register range is not covered by the device's register layout.
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "submit(): No destination buffer for registers {}-{}",
+        t.startAddr, t.startAddr + t.count - 1));
+  }
+
+  if (t.op != Op::READ) {
+    const int maxCount = t.op == Op::WRITE ? MODBUS_MAX_WRITE_REGISTERS
+                                           : MAX_MODIFY_REGISTERS;
+    if (!t.src)
+      return std::unexpected(ModbusError::custom(
+          EINVAL, "submit(): No source buffer for registers {}-{}",
+          t.startAddr, t.startAddr + t.count - 1));
+    if (t.count < 1 || t.count > maxCount)
+      return std::unexpected(ModbusError::custom(
+          EINVAL, "submit(): Cannot write {} registers (1-{})", t.count,
+          maxCount));
+  }
+
+  if (!running_.load()) {
+    // Bus is shutting down: fail immediately rather than queuing a
+    // transaction that will never execute.
+    return std::unexpected(ModbusError::custom(
+        EINTR, "submit(): Bus is shutting down, transaction cancelled"));
+  }
+
+  if (!t.probe && isParked(t.slaveId)) {
+    // Keep the queue free for devices that answer until a probe succeeds
+    return std::unexpected(ModbusError::custom(
+        EHOSTDOWN, "submit(): Slave {} is parked after repeated timeouts",
+        t.slaveId));
+  }
+
+  Slot *slot = acquireSlot();
+  if (!slot && wait && cfg_.poolWaitMs > 0 && !onBusThread_)
+    slot = awaitSlot();
+  if (!slot) {
+    metrics_.recordPoolExhausted();
+    return std::unexpected(ModbusError::custom(
+        ENOBUFS, "submit(): Transaction pool exhausted (capacity {})",
+        cfg_.queueCapacity));
+  }
+  slot->tx = t;
+  slot->callback = std::move(cb);
 
   {
     std::lock_guard<std::mutex> lock(mtx_);
 
     if (!running_.load()) {
-      // Bus is shutting down: fulfill immediately with a shutdown error
-      // rather than queuing a transaction that will never execute.
-      t.promise.set_value(std::unexpected(ModbusError::custom(
-          EINTR, "submit(): Bus is shutting down, transaction cancelled")));
-      return future;
+      // Shutdown raced with the submission and the queue has already been
+      // cancelled: hand the slot and the callback back.
+      cb = std::move(slot->callback);
+      slot->callback = nullptr;
+      slot->state.store(Slot::FREE, std::memory_order_release);
+      return std::unexpected(ModbusError::custom(
+          EINTR, "submit(): Bus is shutting down, transaction cancelled"));
     }
 
-    txQueue_.push(std::move(t));
+    slot->queuedAt = std::chrono::steady_clock::now();
+    txQueue_.push_back(slot);
+    metrics_.recordQueueDepth(txQueue_.size());
   }
 
   // Wake the bus thread so it picks up the new transaction promptly.
-  cv_.notify_one();
+  if (loop_)
+    loop_->wake();
+  else
+    cv_.notify_one();
+
+  return slot;
+}
+
+/* -------------------------------------------------------------------------
+   Bus sweep
+   ------------------------------------------------------------------------- */
+
+bool FroniusBus::Sweep::ok() const {
+  return std::all_of(samples.begin(), samples.end(),
+                     [](const Sample &s) { return s.result.has_value(); });
+}
+
+std::chrono::system_clock::duration FroniusBus::Sweep::skew() const {
+  using TimePoint = std::chrono::system_clock::time_point;
+  TimePoint first = TimePoint::max();
+  TimePoint last = TimePoint::min();
+  for (const Sample &s : samples) {
+    if (!s.result)
+      continue;
+    first = std::min(first, s.snapshot.timestamp());
+    last = std::max(last, s.snapshot.timestamp());
+  }
+  return first < last ? last - first : std::chrono::system_clock::duration{};
+}
+
+FroniusBus::Sweep FroniusBus::fetchAll(FroniusTypes::Block blocks) {
+  using Block = FroniusTypes::Block;
+
+  Sweep sweep;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &wp : devices_) {
+      auto device = wp.lock();
+      if (device && device->isReady() &&
+          (blocks & device->defaultBlocks()) != Block::NONE)
+        sweep.samples.push_back({std::move(device), {}, {}});
+    }
+  }
 
-  return future;
+  // Queue the reads of each slave next to each other; devices sharing a
+  // slave ID keep their registration order
+  std::stable_sort(sweep.samples.begin(), sweep.samples.end(),
+                   [](const Sweep::Sample &a, const Sweep::Sample &b) {
+                     return a.device->config().slaveId <
+                            b.device->config().slaveId;
+                   });
+  if (sweep.samples.empty())
+    return sweep;
+
+  // The callbacks run on the bus thread, or here if a fetch is rejected
+  struct Pending {
+    std::mutex mtx;
+    std::condition_variable cv;
+    size_t remaining;
+  } pending{{}, {}, sweep.samples.size()};
+
+  sweep.timestamp = std::chrono::system_clock::now();
+  const auto start = std::chrono::steady_clock::now();
+  auto end = start;
+
+  // Hold the queue so the bus thread sees the whole sweep at once and can
+  // coalesce and group it, rather than starting on the first device while
+  // the others are still being submitted
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    ++sweepHold_;
+  }
+  for (Sweep::Sample &sample : sweep.samples) {
+    FroniusDevice &device = *sample.device;
+    device.fetchBlocksAsync(
+        blocks & device.defaultBlocks(),
+        [&sample, &pending, &end](const std::expected<void, ModbusError> &res) {
+          // Take the snapshot before the next fetch can publish over it
+          FroniusDevice::Snapshot snap;
+          if (res)
+            snap = sample.device->snapshot();
+
+          std::lock_guard<std::mutex> lock(pending.mtx);
+          sample.result = res;
+          sample.snapshot = std::move(snap);
+          end = std::chrono::steady_clock::now();
+          if (--pending.remaining == 0)
+            pending.cv.notify_one();
+        });
+  }
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    --sweepHold_;
+  }
+  if (loop_)
+    loop_->wake();
+  else
+    cv_.notify_one();
+
+  {
+    std::unique_lock<std::mutex> lock(pending.mtx);
+    pending.cv.wait(lock, [&pending] { return pending.remaining == 0; });
+  }
+  sweep.duration = end - start;
+
+  busLog(Cat::QUEUE, Lvl::DEBUG,
+         "[sweep] devices={} ok={} -> {} us, skew {} us", sweep.samples.size(),
+         sweep.ok(),
+         std::chrono::duration_cast<std::chrono::microseconds>(sweep.duration)
+             .count(),
+         std::chrono::duration_cast<std::chrono::microseconds>(sweep.skew())
+             .count());
+
+  return sweep;
+}
+
+/* -------------------------------------------------------------------------
+   Transaction pool
+   ------------------------------------------------------------------------- */
+
+FroniusBus::Slot *FroniusBus::acquireSlot() {
+  const size_t capacity = static_cast<size_t>(cfg_.queueCapacity);
+  const size_t start = slotHint_.load(std::memory_order_relaxed);
+
+  for (size_t i = 0; i < capacity; ++i) {
+    const size_t idx = (start + i) % capacity;
+    uint8_t expected = Slot::FREE;
+    if (slots_[idx].state.compare_exchange_strong(expected, Slot::PENDING,
+                                                  std::memory_order_acquire)) {
+      slotHint_.store((idx + 1) % capacity, std::memory_order_relaxed);
+      return &slots_[idx];
+    }
+  }
+  return nullptr;
+}
+
+FroniusBus::Slot *FroniusBus::awaitSlot() {
+  const auto deadline = std::chrono::steady_clock::now() +
+                        std::chrono::milliseconds(cfg_.poolWaitMs);
+
+  // Slots are freed from several places, none of which should pay for a
+  // notification; exhaustion is an overload condition, so poll instead
+  poolWaiters_.fetch_add(1);
+  if (loop_)
+    loop_->wake();
+  else
+    cv_.notify_one();
+
+  Slot *slot = nullptr;
+  while (running_.load() && std::chrono::steady_clock::now() < deadline) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    if ((slot = acquireSlot()))
+      break;
+  }
+  poolWaiters_.fetch_sub(1);
+  return slot;
+}
+
+void FroniusBus::fail(Slot &slot, const ModbusErrorEvent &failure) {
+  if (slot.callback) {
+    complete(slot, std::unexpected(failure.toError()));
+    return;
+  }
+
+  // Formatted by Completion::get(), if anyone asks
+  slot.failure = failure;
+  complete(slot, {});
+}
+
+void FroniusBus::complete(Slot &slot, std::expected<void, ModbusError> res) {
+  if (slot.callback) {
+    // Asynchronous submission: recycle the slot before notifying, so the
+    // callback can submit follow-up work against the full pool.
+    CompletionCallback cb = std::move(slot.callback);
+    slot.callback = nullptr;
+    slot.state.store(Slot::FREE, std::memory_order_release);
+    cb(res);
+    return;
+  }
+
+  slot.result = std::move(res);
+
+  if (slot.state.exchange(Slot::DONE, std::memory_order_acq_rel) ==
+      Slot::ABANDONED) {
+    // Nobody is waiting: recycle the slot straight away.
+    slot.result = {};
+    slot.failure.reset();
+    slot.state.store(Slot::FREE, std::memory_order_release);
+    return;
+  }
+  slot.state.notify_all();
+}
+
+FroniusBus::Completion::~Completion() { release(); }
+
+FroniusBus::Completion::Completion(Completion &&other) noexcept
+    : slot_(std::exchange(other.slot_, nullptr)),
+      immediate_(std::move(other.immediate_)) {
+  other.immediate_.reset();
+}
+
+FroniusBus::Completion &
+FroniusBus::Completion::operator=(Completion &&other) noexcept {
+  if (this != &other) {
+    release();
+    slot_ = std::exchange(other.slot_, nullptr);
+    immediate_ = std::move(other.immediate_);
+    other.immediate_.reset();
+  }
+  return *this;
+}
+
+bool FroniusBus::Completion::ready() const {
+  if (!slot_)
+    return immediate_.has_value();
+  return slot_->state.load(std::memory_order_acquire) != Slot::PENDING;
+}
+
+void FroniusBus::Completion::wait() const {
+  if (slot_)
+    slot_->state.wait(Slot::PENDING, std::memory_order_acquire);
+}
+
+std::expected<void, ModbusError> FroniusBus::Completion::get() {
+  if (immediate_) {
+    auto res = std::move(*immediate_);
+    immediate_.reset();
+    return res;
+  }
+
+  if (!slot_)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "Completion::get(): No result, handle is empty"));
+
+  wait();
+  std::expected<void, ModbusError> res;
+  if (slot_->failure)
+    res = std::unexpected(slot_->failure->toError());
+  else
+    res = std::move(slot_->result);
+  slot_->result = {};
+  slot_->failure.reset();
+  slot_->state.store(Slot::FREE, std::memory_order_release);
+  slot_ = nullptr;
+  return res;
+}
+
+void FroniusBus::Completion::release() {
+  immediate_.reset();
+  if (!slot_)
+    return;
+
+  // Still pending: leave the slot to the bus thread, which frees it on
+  // completion. Already done: free it here.
+  uint8_t expected = Slot::PENDING;
+  if (!slot_->state.compare_exchange_strong(expected, Slot::ABANDONED,
+                                            std::memory_order_acq_rel)) {
+    slot_->result = {};
+    slot_->failure.reset();
+    slot_->state.store(Slot::FREE, std::memory_order_release);
+  }
+  slot_ = nullptr;
 }
 
 /* -------------------------------------------------------------------------
@@ -98,6 +541,7 @@ FroniusBus::submit(Transaction t) {
    ------------------------------------------------------------------------- */
 
 void FroniusBus::busLoop() {
+  onBusThread_ = true;
   int reconnectDelay = cfg_.reconnectDelay;
 
   while (running_.load()) {
@@ -109,37 +553,9 @@ void FroniusBus::busLoop() {
       auto res = tryConnect();
 
       if (res) {
-        // Successful connection — update state and notify
-        {
-          std::lock_guard<std::mutex> lock(mtx_);
-          connected_.store(true);
-          cv_.notify_all();
-        }
-
-        // Fire all registered bus-level connect callbacks
-        for (auto &cb : onBusConnect_)
-          cb();
-
-        // Reset backoff delay after a successful connection
-        if (cfg_.exponential)
-          reconnectDelay = cfg_.reconnectDelay;
-
-        // Notify devices on a separate thread so the bus thread proceeds
-        // directly to drainQueue(). onBusConnected() submits transactions
-        // and blocks on future.get() — it must not run on the bus thread.
-        std::thread([this] { notifyDevicesConnected(); }).detach();
-
+        markConnected(reconnectDelay);
       } else {
-        // Connection failed
-        connected_.store(false);
-
-        // Report the bus error
-        for (auto &cb : onBusError_)
-          cb(res.error());
-
-        // Notify with current reconnect delay before backing off
-        for (auto &cb : onBusDisconnect_)
-          cb(reconnectDelay);
+        reportConnectFailure(res.error(), reconnectDelay);
 
         // Wait for the backoff period or until shutdown is requested
         {
@@ -168,17 +584,67 @@ void FroniusBus::busLoop() {
     // If the bus dropped while connected, notify devices and fire the
     // disconnect callback before looping back to Phase 1.
     if (!connected_.load() && running_.load()) {
-      cancelPendingTransactions();
-      notifyDevicesDisconnected();
-
+      handleDisconnect(reconnectDelay);
       if (onBusDisconnect_.empty())
         return;
-      for (auto &cb : onBusDisconnect_)
-        cb(reconnectDelay);
     }
   }
 
-  // Shut down: notify devices one final time so they can clean up
+  handleShutdown();
+}
+
+/* -------------------------------------------------------------------------
+   Connection state — shared by the bus thread and BusEventLoop
+   ------------------------------------------------------------------------- */
+
+void FroniusBus::markConnected(int &reconnectDelay) {
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    connected_.store(true);
+    cv_.notify_all();
+  }
+
+  metrics_.recordConnect();
+
+  // Fire all registered bus-level connect callbacks
+  for (auto &cb : onBusConnect_)
+    cb();
+
+  // Reset backoff delay after a successful connection
+  if (cfg_.exponential)
+    reconnectDelay = cfg_.reconnectDelay;
+
+  // Queue every device on the scheduler thread so the bus proceeds
+  // directly to draining the queue. onBusConnected() submits transactions
+  // and blocks on Completion::get() — it must not run on the bus thread.
+  notifyDevicesConnected();
+}
+
+void FroniusBus::reportConnectFailure(const ModbusError &err,
+                                      int reconnectDelay) {
+  connected_.store(false);
+  metrics_.recordConnectFailure();
+
+  // Report the bus error
+  for (auto &cb : onBusError_)
+    cb(err);
+
+  // Notify with current reconnect delay before backing off
+  for (auto &cb : onBusDisconnect_)
+    cb(reconnectDelay);
+}
+
+void FroniusBus::handleDisconnect(int reconnectDelay) {
+  metrics_.recordDisconnect();
+  cancelPendingTransactions();
+  notifyDevicesDisconnected();
+
+  for (auto &cb : onBusDisconnect_)
+    cb(reconnectDelay);
+}
+
+void FroniusBus::handleShutdown() {
+  // Notify devices one final time so they can clean up
   if (connected_.load()) {
     connected_.store(false);
     cancelPendingTransactions();
@@ -198,6 +664,14 @@ std::expected<void, ModbusError> FroniusBus::tryConnect() {
     ctx_ = nullptr;
   }
 
+  // A replay needs no context; it is connected until its responses run out
+  if (replay_) {
+    if (replay_->finished())
+      return std::unexpected(ModbusError::custom(
+          ENODATA, "tryConnect(): Replay of '{}' finished", replay_->path()));
+    return {};
+  }
+
   // Create the transport context
   if (cfg_.isTcp()) {
     const auto &t = cfg_.tcp();
@@ -278,110 +752,749 @@ FroniusBus::connectRtu(const std::string &device, int baud, char parity,
 }
 
 /* -------------------------------------------------------------------------
-   Transaction queue — called only from the bus thread
+   Transaction queue — called only from the bus thread or event loop
    ------------------------------------------------------------------------- */
 
 void FroniusBus::drainQueue() {
+  std::array<Slot *, MAX_COALESCED> group{};
+
   while (running_.load() && connected_.load()) {
 
     // Wait for a transaction to arrive or for a state change
-    std::unique_lock<std::mutex> lock(mtx_);
-    cv_.wait(lock, [this] {
-      return !txQueue_.empty() || !connected_.load() || !running_.load();
-    });
+    {
+      std::unique_lock<std::mutex> lock(mtx_);
+      cv_.wait(lock, [this] {
+        return (!txQueue_.empty() &&
+                (sweepHold_ == 0 || poolWaiters_.load() > 0)) ||
+               !connected_.load() || !running_.load();
+      });
+    }
 
     // Exit immediately if the bus dropped or a shutdown was requested
     if (!connected_.load() || !running_.load())
       return;
 
-    // Pop the next transaction under the lock, then release before
-    // executing so that submit() can enqueue new transactions concurrently
-    // while the bus is busy with the current one.
-    Transaction t = std::move(txQueue_.front());
-    txQueue_.pop();
+    const size_t n = dequeue(group);
+    if (n == 1)
+      executeTransaction(*group[0]);
+    else if (n > 1)
+      executeCoalesced(group, n);
+  }
+}
+
+size_t FroniusBus::dequeue(std::array<Slot *, MAX_COALESCED> &group,
+                           const SlaveSet *busy) {
+  size_t n = 0;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+
+    // Pull out reads that are already past their deadline; they are
+    // failed below without touching the wire.
+    takeExpired();
+
+    // Pop the next transaction, plus any reads it can be merged with,
+    // under the lock, then release before executing so that submit() can
+    // enqueue new transactions concurrently while the bus is busy.
+    if (const size_t next = nextQueueIndex(busy); next < txQueue_.size()) {
+      group[0] = txQueue_[next];
+      txQueue_.erase(txQueue_.begin() + next);
+      n = cfg_.coalesce && group[0]->tx.op == Transaction::Op::READ
+              ? takeCoalescable(group)
+              : 1;
+      metrics_.recordQueueDepth(txQueue_.size());
+
+      busLog(Cat::QUEUE, Lvl::DEBUG,
+             "[queue] depth={} -> dequeued slave={} addr={} prio={}",
+             txQueue_.size(), group[0]->tx.slaveId, group[0]->tx.startAddr,
+             FroniusTypes::toString(group[0]->tx.priority));
+    }
+  }
+
+  const auto now = std::chrono::steady_clock::now();
+  for (size_t i = 0; i < n; ++i)
+    metrics_.recordQueueWait(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            now - group[i]->queuedAt));
+
+  for (Slot *slot : expired_) {
+    const auto &t = slot->tx;
+    metrics_.recordDeadlineDrop();
+    trace(BusTraceEvent::Kind::DROP, t, ETIMEDOUT, 0, slot->queuedAt, now);
+    busLog(Cat::QUEUE, Lvl::WARN,
+           "[queue] slave={} addr={} -> deadline expired, dropped", t.slaveId,
+           t.startAddr);
+    complete(*slot, std::unexpected(ModbusError::custom(
+                        ETIMEDOUT,
+                        "drainQueue(): Transaction deadline expired "
+                        "[slave={}, addr={}, count={}]",
+                        t.slaveId, t.startAddr, t.count)));
+  }
+  expired_.clear();
+
+  for (Slot *slot : held_) {
+    const auto &t = slot->tx;
+    complete(*slot, std::unexpected(ModbusError::custom(
+                        EHOSTDOWN,
+                        "drainQueue(): Slave is parked after repeated "
+                        "timeouts [slave={}, addr={}, count={}]",
+                        t.slaveId, t.startAddr, t.count)));
+  }
+  held_.clear();
+
+  return n;
+}
+
+void FroniusBus::requeueFront(std::span<Slot *const> slots) {
+  if (slots.empty())
+    return;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  txQueue_.insert(txQueue_.begin(), slots.begin(), slots.end());
+  metrics_.recordQueueDepth(txQueue_.size());
+}
+
+void FroniusBus::takeExpired() {
+  const auto now = std::chrono::steady_clock::now();
+
+  // Compact the queue in place, preserving the order of live transactions
+  size_t kept = 0;
+  for (Slot *slot : txQueue_) {
+    if (slot->tx.deadline < now)
+      expired_.push_back(slot);
+    else if (!slot->tx.probe && isParked(slot->tx.slaveId))
+      held_.push_back(slot);
+    else
+      txQueue_[kept++] = slot;
+  }
+  txQueue_.resize(kept);
+}
+
+size_t FroniusBus::takeCoalescable(std::array<Slot *, MAX_COALESCED> &group) {
+  const Transaction &head = group[0]->tx;
+  const uint32_t gap = static_cast<uint32_t>(cfg_.coalesceGap);
+  uint32_t lo = head.startAddr;
+  uint32_t hi = lo + head.count;
+  size_t n = 1;
+
+  // Repeat until the merged range stops growing — a later transaction can
+  // close the gap to one that was skipped on the previous pass.
+  bool grown = true;
+  while (grown && n < group.size()) {
+    grown = false;
+    for (size_t i = 0; i < txQueue_.size() && n < group.size();) {
+      const Transaction &t = txQueue_[i]->tx;
+
+      // Reads submitted after a write of the slave must see its effect
+      if (t.slaveId == head.slaveId && t.op != Transaction::Op::READ)
+        break;
+
+      const uint32_t first = t.startAddr;
+      const uint32_t last = first + t.count;
+      const uint32_t mergedLo = std::min(lo, first);
+      const uint32_t mergedHi = std::max(hi, last);
+
+      // Merging across classes would serve a LOW read at HIGH urgency and
+      // hold a HIGH read to the slower class, so stay within the class
+      if (t.slaveId != head.slaveId || t.priority != head.priority ||
+          first > hi + gap || last + gap < lo ||
+          mergedHi - mergedLo > MODBUS_MAX_READ_REGISTERS) {
+        ++i;
+        continue;
+      }
+
+      lo = mergedLo;
+      hi = mergedHi;
+      group[n++] = txQueue_[i];
+      txQueue_.erase(txQueue_.begin() + i);
+      grown = true;
+    }
+  }
+
+  return n;
+}
+
+size_t FroniusBus::nextQueueIndex(const SlaveSet *busy) {
+  // A sweep still queueing its reads holds the queue until all are in,
+  // unless a submitter waits for the slots the queue occupies
+  if (sweepHold_ > 0 && poolWaiters_.load() == 0)
+    return txQueue_.size();
+
+  auto eligible = [busy](const Transaction &t) {
+    return !busy || !busy->test(static_cast<size_t>(t.slaveId) & 0xFF);
+  };
+
+  // Most urgent priority class present in the queue, and the transaction
+  // that has waited longest
+  FroniusTypes::Priority top = FroniusTypes::Priority::LOW;
+  const Slot *oldest = nullptr;
+  for (const Slot *slot : txQueue_)
+    if (eligible(slot->tx)) {
+      top = std::min(top, slot->tx.priority);
+      if (!oldest || slot->queuedAt < oldest->queuedAt)
+        oldest = slot;
+    }
+
+  // Age the reads of less urgent classes: after MAX_PRIORITY_BYPASS reads
+  // in a row overtook an older one, its class gets a turn. Sustained
+  // polling would otherwise starve LOW validation probes indefinitely.
+  // Control writes always go first.
+  if (oldest && top != FroniusTypes::Priority::CONTROL &&
+      oldest->tx.priority != top) {
+    if (++priorityBypass_ > MAX_PRIORITY_BYPASS) {
+      priorityBypass_ = 0;
+      top = oldest->tx.priority;
+    }
+  } else {
+    priorityBypass_ = 0;
+  }
+
+  // Earliest deadline first within that class; ties keep submission order
+  size_t best = txQueue_.size();
+  for (size_t i = 0; i < txQueue_.size(); ++i) {
+    const Transaction &t = txQueue_[i]->tx;
+    if (t.priority != top || !eligible(t))
+      continue;
+    if (best == txQueue_.size() || t.deadline < txQueue_[best]->tx.deadline)
+      best = i;
+  }
+  if (best == txQueue_.size())
+    return best;
+
+  const Transaction &head = txQueue_[best]->tx;
+  if (head.deadline != std::chrono::steady_clock::time_point::max() ||
+      !cfg_.groupBySlave || !cfg_.isRtu() || lastSlaveId_ == 0 ||
+      head.slaveId == lastSlaveId_ || slaveBypass_ >= MAX_SLAVE_BYPASS) {
+    slaveBypass_ = 0;
+    return best;
+  }
+
+  // Prefer a read of the slave we are already talking to
+  for (size_t i = best + 1; i < txQueue_.size(); ++i) {
+    const Transaction &t = txQueue_[i]->tx;
+    if (t.priority == top && t.slaveId == lastSlaveId_) {
+      ++slaveBypass_;
+      return i;
+    }
+  }
+
+  slaveBypass_ = 0;
+  return best;
+}
+
+std::chrono::microseconds FroniusBus::switchDelay(int from, int to) {
+  const std::chrono::microseconds fixed =
+      std::chrono::milliseconds(cfg_.slaveSwitchDelayMs);
+  if (!cfg_.adaptiveSwitchDelay)
+    return fixed;
+
+  for (const auto &g : switchGuards_)
+    if (g.from == from && g.to == to)
+      return g.delay;
+
+  const auto initial = std::min(interFrameDelay_, fixed);
+  switchGuards_.push_back({from, to, initial});
+  return initial;
+}
+
+void FroniusBus::backOffSwitchDelay(int from, int to) {
+  const std::chrono::microseconds fixed =
+      std::chrono::milliseconds(cfg_.slaveSwitchDelayMs);
+
+  for (auto &g : switchGuards_) {
+    if (g.from == from && g.to == to) {
+      g.delay = std::min(std::max(g.delay * 2, interFrameDelay_), fixed);
+      busLog(Cat::SWITCH, Lvl::INFO,
+             "[switch] slave id [{}->{}] timed out, delay now [{}us]", from,
+             to, g.delay.count());
+      return;
+    }
+  }
+}
+
+void FroniusBus::executeTransaction(Slot &slot) {
+  const Transaction &t = slot.tx;
+  const bool write = t.op != Transaction::Op::READ;
+
+  auto res = write ? writeRegisters(t) : readRegisters(t);
+  if (!res)
+    reportReadError(res.error());
+
+  if (write)
+    metrics_.recordWriteLatency(
+        std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::steady_clock::now() - slot.queuedAt));
+  if (res)
+    complete(slot, {});
+  else
+    fail(slot, res.error());
+}
+
+void FroniusBus::executeCoalesced(
+    const std::array<Slot *, MAX_COALESCED> &group, size_t n) {
+  const Transaction merged = mergeGroup(group, n, coalesceBuf_.data());
+
+  if (!spanRejected(merged)) {
+    busLog(Cat::COALESCE, Lvl::DEBUG,
+           "[coalesce] slave={} addr={} count={} <- {} transactions",
+           merged.slaveId, merged.startAddr, merged.count, n);
 
-    busLog("[queue] depth={} -> dequeued slave={} addr={}", txQueue_.size(),
-           t.slaveId, t.startAddr);
+    const auto mergeStart = std::chrono::steady_clock::now();
+    auto res = readRegisters(merged);
 
-    lock.unlock();
+    if (res) {
+      completeMerged(group, n, merged, mergeStart);
+      return;
+    }
+
+    // Anything other than a rejected range would fail the individual reads
+    // as well — report it once and fail the whole group.
+    const int code = res.error().code;
+    if (code != EMBXILADD && code != EMBXILVAL) {
+      reportReadError(res.error());
+      for (size_t i = 0; i < n; ++i)
+        fail(*group[i], res.error());
+      return;
+    }
 
-    executeTransaction(t);
+    rejectSpan(merged);
   }
+
+  for (size_t i = 0; i < n; ++i)
+    executeTransaction(*group[i]);
 }
 
-void FroniusBus::executeTransaction(Transaction &t) {
-  if (cfg_.isRtu() && lastSlaveId_ != 0 && lastSlaveId_ != t.slaveId) {
-    const int millis = 500;
-    std::this_thread::sleep_for(std::chrono::milliseconds(millis));
-    busLog("[switch] slave id [{}->{}], sleep [{}ms]", lastSlaveId_, t.slaveId,
-           millis);
+FroniusBus::Transaction
+FroniusBus::mergeGroup(const std::array<Slot *, MAX_COALESCED> &group,
+                       size_t n, uint16_t *dest) const {
+  // Build the merged read covering every transaction in the group, using
+  // the longest response timeout among them.
+  Transaction merged = group[0]->tx;
+  uint32_t lo = merged.startAddr;
+  uint32_t hi = lo + merged.count;
+  // 64-bit microseconds: seconds * 10^6 overflows a 32-bit long
+  std::chrono::microseconds timeout = configuredTimeout(merged);
+
+  for (size_t i = 1; i < n; ++i) {
+    const Transaction &t = group[i]->tx;
+    lo = std::min<uint32_t>(lo, t.startAddr);
+    hi = std::max<uint32_t>(hi, t.startAddr + t.count);
+    timeout = std::max(timeout, configuredTimeout(t));
   }
-  lastSlaveId_ = t.slaveId;
 
-  if (modbus_set_slave(ctx_, t.slaveId) == -1) {
-    t.promise.set_value(std::unexpected(ModbusError::fromErrno(
-        "executeTransaction(): modbus_set_slave({}) failed", t.slaveId)));
-    return;
+  const auto secs = std::chrono::duration_cast<std::chrono::seconds>(timeout);
+  merged.startAddr = static_cast<int>(lo);
+  merged.count = static_cast<int>(hi - lo);
+  merged.dest = dest;
+  merged.secTimeout = static_cast<int>(secs.count());
+  merged.usecTimeout = static_cast<int>((timeout - secs).count());
+  return merged;
+}
+
+bool FroniusBus::spanRejected(const Transaction &merged) const {
+  return std::any_of(rejectedSpans_.begin(), rejectedSpans_.end(),
+                     [&merged](const Span &s) {
+                       return s.slaveId == merged.slaveId &&
+                              s.startAddr == merged.startAddr &&
+                              s.count == merged.count;
+                     });
+}
+
+void FroniusBus::rejectSpan(const Transaction &merged) {
+  busLog(Cat::COALESCE, Lvl::INFO,
+         "[coalesce] slave={} addr={} count={} rejected, reading separately",
+         merged.slaveId, merged.startAddr, merged.count);
+
+  if (rejectedSpans_.size() < MAX_REJECTED_SPANS)
+    rejectedSpans_.push_back({merged.slaveId, merged.startAddr, merged.count});
+}
+
+void FroniusBus::completeMerged(const std::array<Slot *, MAX_COALESCED> &group,
+                                size_t n, const Transaction &merged,
+                                std::chrono::steady_clock::time_point start) {
+  metrics_.recordCoalesced(n);
+  trace(BusTraceEvent::Kind::COALESCE, merged, 0, static_cast<uint32_t>(n),
+        start, std::chrono::steady_clock::now());
+
+  for (size_t i = 0; i < n; ++i) {
+    const Transaction &t = group[i]->tx;
+    std::copy_n(merged.dest + (t.startAddr - merged.startAddr), t.count,
+                t.dest);
+    complete(*group[i], {});
   }
+}
+
+std::expected<int, ModbusErrorEvent>
+FroniusBus::selectSlave(const Transaction &t,
+                        std::chrono::microseconds timeout) {
+  const int prevSlaveId = lastSlaveId_;
+  const bool switched =
+      cfg_.isRtu() && prevSlaveId != 0 && prevSlaveId != t.slaveId;
+
+  if (switched) {
+    const auto delay = switchDelay(prevSlaveId, t.slaveId);
+    const auto sleepStart = std::chrono::steady_clock::now();
+    std::this_thread::sleep_for(delay);
+    trace(BusTraceEvent::Kind::SWITCH, t, 0,
+          static_cast<uint32_t>(delay.count()), sleepStart,
+          std::chrono::steady_clock::now());
+    busLog(Cat::SWITCH, Lvl::DEBUG, "[switch] slave id [{}->{}], sleep [{}us]",
+           prevSlaveId, t.slaveId, delay.count());
+  }
+  lastSlaveId_ = t.slaveId;
+
+  if (modbus_set_slave(ctx_, t.slaveId) == -1)
+    return std::unexpected(ModbusErrorEvent::of(
+        errno, "selectSlave(): modbus_set_slave() failed", t.slaveId));
 
-  modbus_set_response_timeout(ctx_, t.secTimeout, t.usecTimeout);
+  modbus_set_response_timeout(ctx_,
+                              static_cast<uint32_t>(timeout.count() / 1000000),
+                              static_cast<uint32_t>(timeout.count() % 1000000));
 
-  busLog("[tx] slave={} addr={} count={} -> sending", t.slaveId, t.startAddr,
-         t.count);
+  return switched ? prevSlaveId : 0;
+}
+
+std::expected<void, ModbusErrorEvent>
+FroniusBus::readRegisters(const Transaction &t) {
+  if (replay_)
+    return replayRegisters(t);
+
+  auto selected = selectSlave(t, requestTimeout(t));
+  if (!selected)
+    return std::unexpected(std::move(selected.error()));
+  const int prevSlaveId = *selected;
+  const bool switched = prevSlaveId != 0;
+
+  busLog(Cat::WIRE, Lvl::DEBUG, "[tx] slave={} addr={} count={} -> sending",
+         t.slaveId, t.startAddr, t.count);
 
   auto tStart = std::chrono::steady_clock::now();
 
-  int rc =
-      modbus_read_registers(ctx_, t.startAddr, t.count, t.dest + t.startAddr);
+  int rc = modbus_read_registers(ctx_, t.startAddr, t.count, t.dest);
+  const int savedErrno = errno;
 
-  auto elapsedMs = std::chrono::duration_cast<std::chrono::milliseconds>(
-                       std::chrono::steady_clock::now() - tStart)
-                       .count();
+  recordRead(t, rc == -1 ? savedErrno : 0, tStart,
+             std::chrono::steady_clock::now());
 
-  if (rc == -1) {
-    busLog("[rx] slave={} addr={} -> FAIL ({}) [{}ms]", t.slaveId, t.startAddr,
-           modbus_strerror(errno), elapsedMs);
-  } else {
-    busLog("[rx] slave={} addr={} -> ok [{}ms]", t.slaveId, t.startAddr,
-           elapsedMs);
+  if (rc == -1 && switched && savedErrno == ETIMEDOUT &&
+      cfg_.adaptiveSwitchDelay)
+    backOffSwitchDelay(prevSlaveId, t.slaveId);
+
+  busLog(Cat::WIRE, Lvl::DEBUG, "[--] slave={} addr={} guard done, queue free",
+         t.slaveId, t.startAddr);
+
+  if (rc == -1)
+    return std::unexpected(ModbusErrorEvent::of(
+        savedErrno, "readRegisters(): modbus_read_registers() failed",
+        t.slaveId, t.startAddr, t.count));
+
+  return {};
+}
+
+std::expected<void, ModbusErrorEvent>
+FroniusBus::replayRegisters(const Transaction &t) {
+  const auto tStart = std::chrono::steady_clock::now();
+
+  auto res = replay_->next(t.slaveId, t.startAddr, t.count);
+  if (!res) {
+    busLog(Cat::WIRE, Lvl::DEBUG, "[replay] {}", res.error().message);
+    return std::unexpected(
+        ModbusErrorEvent::of(res.error().code, "readRegisters(): Replay",
+                             t.slaveId, t.startAddr, t.count));
   }
 
-  busLog("[--] slave={} addr={} guard done, queue free", t.slaveId,
-         t.startAddr);
+  if (res->due > tStart) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (cv_.wait_until(lock, res->due, [this] { return !running_.load(); }))
+      return std::unexpected(ModbusErrorEvent::of(
+          EINTR, "readRegisters(): Replay interrupted by shutdown",
+          t.slaveId, t.startAddr, t.count));
+  }
 
-  if (rc == -1) {
-    auto err = ModbusError::fromErrno(
-        "executeTransaction(): modbus_read_registers() failed "
-        "[slave={}, addr={}, count={}]",
-        t.slaveId, t.startAddr, t.count);
+  const int err = res->record->err;
+  if (err == 0)
+    std::copy_n(res->words, t.count, t.dest);
+  recordRead(t, err, tStart, std::chrono::steady_clock::now());
 
-    if (err.severity == ModbusError::Severity::FATAL ||
-        err.severity == ModbusError::Severity::SHUTDOWN) {
-      connected_.store(false);
-      cv_.notify_all();
+  if (err != 0)
+    return std::unexpected(ModbusErrorEvent::of(
+        err, "readRegisters(): Recorded failure", t.slaveId, t.startAddr,
+        t.count));
+
+  return {};
+}
+
+std::expected<void, ModbusErrorEvent>
+FroniusBus::writeRegisters(const Transaction &t) {
+  if (replay_)
+    return replayWrite(t);
+
+  auto selected = selectSlave(t, requestTimeout(t));
+  if (!selected)
+    return std::unexpected(std::move(selected.error()));
+
+  const bool modify = t.op == Transaction::Op::MODIFY;
+  busLog(Cat::WIRE, Lvl::DEBUG, "[tx] slave={} addr={} count={} -> {}",
+         t.slaveId, t.startAddr, t.count, modify ? "modifying" : "writing");
+
+  const auto tStart = std::chrono::steady_clock::now();
+
+  // The read and the write of a read-modify-write go out back to back;
+  // nothing else reaches the slave in between
+  int rc = 0;
+  if (modify) {
+    rc = modbus_read_registers(ctx_, t.startAddr, t.count, t.dest);
+    if (rc != -1)
+      applyModify(t);
+  }
+  if (rc != -1)
+    rc = modbus_write_registers(ctx_, t.startAddr, t.count,
+                                modify ? t.dest : t.src);
+  const int savedErrno = errno;
+
+  recordWrite(t, rc == -1 ? savedErrno : 0, tStart,
+              std::chrono::steady_clock::now());
+
+  if (rc == -1 && *selected != 0 && savedErrno == ETIMEDOUT &&
+      cfg_.adaptiveSwitchDelay)
+    backOffSwitchDelay(*selected, t.slaveId);
+
+  if (rc == -1)
+    return std::unexpected(ModbusErrorEvent::of(
+        savedErrno,
+        modify ? "writeRegisters(): Read-modify-write failed"
+               : "writeRegisters(): modbus_write_registers() failed",
+        t.slaveId, t.startAddr, t.count));
+
+  return {};
+}
+
+std::expected<void, ModbusErrorEvent>
+FroniusBus::replayWrite(const Transaction &t) {
+  const bool modify = t.op == Transaction::Op::MODIFY;
+  const auto tStart = std::chrono::steady_clock::now();
+
+  auto res = replay_->nextWrite(modify ? BusRecord::MODIFY : BusRecord::WRITE,
+                                t.slaveId, t.startAddr, t.count);
+  if (!res) {
+    busLog(Cat::WIRE, Lvl::DEBUG, "[replay] {}", res.error().message);
+    return std::unexpected(
+        ModbusErrorEvent::of(res.error().code, "writeRegisters(): Replay",
+                             t.slaveId, t.startAddr, t.count));
+  }
+
+  if (res->due > tStart) {
+    std::unique_lock<std::mutex> lock(mtx_);
+    if (cv_.wait_until(lock, res->due, [this] { return !running_.load(); }))
+      return std::unexpected(ModbusErrorEvent::of(
+          EINTR, "writeRegisters(): Replay interrupted by shutdown",
+          t.slaveId, t.startAddr, t.count));
+  }
+
+  // A read-modify-write reports the registers as the slave got them
+  const int err = res->record->err;
+  if (err == 0 && modify)
+    std::copy_n(res->words, t.count, t.dest);
+  recordWrite(t, err, tStart, std::chrono::steady_clock::now());
+
+  if (err != 0)
+    return std::unexpected(ModbusErrorEvent::of(
+        err, "writeRegisters(): Recorded failure", t.slaveId, t.startAddr,
+        t.count));
+
+  return {};
+}
+
+void FroniusBus::recordRead(const Transaction &t, int err,
+                            std::chrono::steady_clock::time_point start,
+                            std::chrono::steady_clock::time_point end) {
+  trace(BusTraceEvent::Kind::READ, t, err, 0, start, end);
+
+  const auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  const auto elapsedMs = elapsed.count() / 1000;
+
+  recordHealth(t, err, elapsed);
+
+  // Request and response ADU sizes: RTU adds address and CRC to the PDU,
+  // TCP the 7-byte MBAP header.
+  const size_t framing = cfg_.isTcp() ? 7 : 3;
+  const size_t payload = 2 * static_cast<size_t>(t.count);
+  metrics_.recordRead(t.slaveId, t.startAddr, t.count, elapsed, err == 0,
+                      framing + 5, framing + 2 + payload);
+
+  if (recorder_) {
+    if (auto res = recorder_->append(t.slaveId, t.startAddr, t.count, t.dest,
+                                     err, start, end);
+        !res) {
+      busLog(Cat::RECORD, Lvl::WARN, "[record] {} stopped: {}",
+             recorder_->path(), res.error().message);
+      recorder_.reset();
     }
+  }
 
-    for (auto &cb : onBusError_)
-      cb(err);
+  if (err != 0) {
+    // modbus_strerror() is only worth calling if the message is delivered
+    if (logEnabled(Cat::WIRE, Lvl::WARN))
+      busLog(Cat::WIRE, Lvl::WARN, "[rx] slave={} addr={} -> FAIL ({}) [{}ms]",
+             t.slaveId, t.startAddr, modbus_strerror(err), elapsedMs);
+  } else {
+    busLog(Cat::WIRE, Lvl::DEBUG, "[rx] slave={} addr={} -> ok [{}ms]",
+           t.slaveId, t.startAddr, elapsedMs);
+  }
+}
+
+void FroniusBus::recordWrite(const Transaction &t, int err,
+                             std::chrono::steady_clock::time_point start,
+                             std::chrono::steady_clock::time_point end) {
+  const bool modify = t.op == Transaction::Op::MODIFY;
+  trace(BusTraceEvent::Kind::WRITE, t, err, modify ? 1 : 0, start, end);
+
+  const auto elapsed =
+      std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  const auto elapsedMs = elapsed.count() / 1000;
+
+  // Write request ADU carries the registers, its response echoes the
+  // range; a read-modify-write adds a read of the range in front
+  const size_t framing = cfg_.isTcp() ? 7 : 3;
+  const size_t payload = 2 * static_cast<size_t>(t.count);
+  size_t txBytes = framing + 6 + payload;
+  size_t rxBytes = framing + 5;
+  if (modify) {
+    txBytes += framing + 5;
+    rxBytes += framing + 2 + payload;
+  }
+  metrics_.recordWrite(t.count, elapsed, err == 0, txBytes, rxBytes);
+
+  if (recorder_) {
+    if (auto res = recorder_->append(
+            t.slaveId, t.startAddr, t.count, modify ? t.dest : t.src, err,
+            start, end, modify ? BusRecord::MODIFY : BusRecord::WRITE);
+        !res) {
+      busLog(Cat::RECORD, Lvl::WARN, "[record] {} stopped: {}",
+             recorder_->path(), res.error().message);
+      recorder_.reset();
+    }
+  }
+
+  if (err != 0) {
+    if (logEnabled(Cat::WIRE, Lvl::WARN))
+      busLog(Cat::WIRE, Lvl::WARN,
+             "[rx] slave={} addr={} -> write FAIL ({}) [{}ms]", t.slaveId,
+             t.startAddr, modbus_strerror(err), elapsedMs);
+  } else {
+    busLog(Cat::WIRE, Lvl::DEBUG, "[rx] slave={} addr={} -> written [{}ms]",
+           t.slaveId, t.startAddr, elapsedMs);
+  }
+}
+
+void FroniusBus::trace(BusTraceEvent::Kind kind, const Transaction &t, int rc,
+                       uint32_t aux,
+                       std::chrono::steady_clock::time_point start,
+                       std::chrono::steady_clock::time_point end) {
+  if (!trace_.enabled())
+    return;
+
+  auto ns = [](std::chrono::steady_clock::time_point tp) {
+    return static_cast<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            tp.time_since_epoch())
+            .count());
+  };
+
+  BusTraceEvent ev;
+  ev.kind = kind;
+  ev.slaveId = static_cast<uint8_t>(t.slaveId);
+  ev.startAddr = static_cast<uint16_t>(t.startAddr);
+  ev.count = static_cast<uint16_t>(t.count);
+  ev.rc = rc;
+  ev.aux = aux;
+  ev.startNs = ns(start);
+  ev.endNs = ns(end);
+  trace_.push(ev);
+}
+
+void FroniusBus::recordHealth(const Transaction &t, int err,
+                              std::chrono::microseconds elapsed) {
+  SlaveHealth *h = health(t.slaveId);
+  if (!h)
+    return;
 
-    t.promise.set_value(std::unexpected(std::move(err)));
+  if (err == 0) {
+    h->recordSuccess(elapsed);
     return;
   }
+  if (err != ETIMEDOUT) {
+    h->recordFailure();
+    return;
+  }
+  if (!h->recordTimeout(configuredTimeout(t)))
+    return;
+
+  busLog(Cat::WIRE, Lvl::WARN,
+         "[rx] slave={} -> parked after repeated timeouts", t.slaveId);
+
+  // Revalidate the slave's devices with their backoff; their probes are
+  // the only reads it gets until one of them is answered
+  std::vector<std::shared_ptr<FroniusDevice>> parked;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    for (const auto &wp : devices_) {
+      auto device = wp.lock();
+      if (device && device->config().slaveId == t.slaveId)
+        parked.push_back(std::move(device));
+    }
+  }
+  for (auto &device : parked) {
+    // The scheduler only probes devices that are not ready, so take them
+    // down first. One that is not ready is already being revalidated.
+    if (device->isReady())
+      device->markParked();
+    scheduleDeviceRetry(device);
+  }
+}
+
+void FroniusBus::reportReadError(ModbusErrorEvent ev,
+                                 const ModbusError *err) {
+  metrics_.recordError(ev);
+
+  if (ev.severity == ModbusError::Severity::FATAL ||
+      ev.severity == ModbusError::Severity::SHUTDOWN) {
+    connected_.store(false);
+    cv_.notify_all();
+  }
+
+  if (!errorLimiter_.admit(ev))
+    return;
+
+  for (auto &cb : onBusErrorEvent_)
+    cb(ev);
+  if (onBusError_.empty())
+    return;
 
-  t.promise.set_value({});
+  // The only place a wire failure gets its message formatted, unless the
+  // submitter asks for it
+  const ModbusError full = err ? *err : ev.toError();
+  for (auto &cb : onBusError_)
+    cb(full);
 }
 
 void FroniusBus::cancelPendingTransactions() {
-  std::lock_guard<std::mutex> lock(mtx_);
+  // Detach the queue under the lock, then complete outside it — completion
+  // callbacks may call submit(), which acquires mtx_.
+  std::vector<Slot *> pending;
+  {
+    std::lock_guard<std::mutex> lock(mtx_);
+    pending.swap(txQueue_);
+    txQueue_.reserve(cfg_.queueCapacity);
+  }
 
-  while (!txQueue_.empty()) {
-    auto &t = txQueue_.front();
-    t.promise.set_value(std::unexpected(ModbusError::custom(
-        EINTR,
-        "cancelPendingTransactions(): Transaction cancelled "
-        "[slave={}, addr={}, count={}]",
-        t.slaveId, t.startAddr, t.count)));
-    txQueue_.pop();
+  for (Slot *slot : pending) {
+    const auto &t = slot->tx;
+    complete(*slot, std::unexpected(ModbusError::custom(
+                        EINTR,
+                        "cancelPendingTransactions(): Transaction cancelled "
+                        "[slave={}, addr={}, count={}]",
+                        t.slaveId, t.startAddr, t.count)));
   }
 }
 
@@ -412,6 +1525,9 @@ void FroniusBus::notifyDevicesConnected() {
 }
 
 void FroniusBus::notifyDevicesDisconnected() {
+  if (scheduler_)
+    scheduler_->cancel(*this);
+
   std::vector<std::shared_ptr<FroniusDevice>> live;
   {
     std::lock_guard<std::mutex> lock(mtx_);
@@ -431,37 +1547,8 @@ void FroniusBus::notifyDevicesDisconnected() {
 }
 
 void FroniusBus::scheduleDeviceRetry(std::shared_ptr<FroniusDevice> device) {
-  std::lock_guard<std::mutex> lock(mtx_);
-  if (!running_.load() || !connected_.load())
+  if (!running_.load() || !connected_.load() || !scheduler_)
     return;
-  auto [it, inserted] = retriesInProgress_.insert(device.get());
-  if (!inserted)
-    return; // retry already in flight for this device
-  std::thread([this, device] { deviceConnectLoop(device); }).detach();
-}
-
-void FroniusBus::deviceConnectLoop(std::shared_ptr<FroniusDevice> device) {
-  const auto &cfg = device->getDeviceConfig();
-  int delay = cfg.reconnectDelay;
 
-  while (running_.load() && connected_.load()) {
-    if (!device->isReady())
-      device->onBusConnected();
-    if (device->isReady())
-      break;
-
-    device->fireDeviceRetry(delay);
-
-    {
-      std::unique_lock<std::mutex> lock(mtx_);
-      cv_.wait_for(lock, std::chrono::seconds(delay),
-                   [this] { return !running_.load() || !connected_.load(); });
-    }
-
-    if (cfg.exponential)
-      delay = std::min(delay * 2, cfg.reconnectDelayMax);
-  }
-
-  std::lock_guard<std::mutex> lock(mtx_);
-  retriesInProgress_.erase(device.get());
+  scheduler_->schedule(*this, std::move(device));
 }
@@ -3,26 +3,151 @@
 #include "modbus_error.h"
 #include "modbus_utils.h"
 #include "register_base.h"
+#include "register_buffer.h"
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
 #include <cmath>
 #include <expected>
+#include <format>
+#include <initializer_list>
+#include <memory>
 #include <modbus/modbus.h>
 #include <optional>
 #include <string>
-#include <vector>
+#include <utility>
 
 // --------------------------------------------------------------------------
 // Construction
 // --------------------------------------------------------------------------
 
-FroniusDevice::FroniusDevice(const ModbusDeviceConfig &cfg) : cfg_(cfg) {
+FroniusDevice::FroniusDevice(
+    const ModbusDeviceConfig &cfg,
+    std::initializer_list<RegisterBuffer::Segment> layout)
+    : cfg_(cfg) {
   cfg.validate();
 
-  // Size the register buffer to cover the full 16-bit Modbus address space.
-  // Every address from 0x0000 to 0xFFFE is pre-zeroed. Fetch functions write
-  // directly into this buffer via pointer arithmetic; accessor functions read
-  // from it. The buffer belongs exclusively to this device instance and is
-  // never shared with other devices on the same bus.
-  regs_.resize(0xFFFF, 0);
+  // Each register generation stores only the ranges named in the device
+  // layout, pre-zeroed. Fetch functions write directly into the generation
+  // of the open update through pointers obtained from updateRegs().data();
+  // accessor functions read from a snapshot of the published one. The
+  // buffers belong exclusively to this device instance and are never
+  // shared with other devices on the same bus.
+  for (Generation &gen : generations_)
+    gen.regs = RegisterBuffer(layout);
+
+  errorLimiter_.init(std::chrono::milliseconds(cfg_.errorHoldoffMs));
+}
+
+// -------------------------------------------------------------------------
+// Snapshots and register updates
+// -------------------------------------------------------------------------
+
+FroniusDevice::Snapshot::~Snapshot() {
+  if (gen_)
+    gen_->readers.fetch_sub(1, std::memory_order_release);
+}
+
+FroniusDevice::Snapshot::Snapshot(Snapshot &&other) noexcept
+    : gen_(std::exchange(other.gen_, nullptr)) {}
+
+FroniusDevice::Snapshot &
+FroniusDevice::Snapshot::operator=(Snapshot &&other) noexcept {
+  if (this != &other) {
+    if (gen_)
+      gen_->readers.fetch_sub(1, std::memory_order_release);
+    gen_ = std::exchange(other.gen_, nullptr);
+  }
+  return *this;
+}
+
+const RegisterBuffer &FroniusDevice::Snapshot::regs() const {
+  return gen_->regs;
+}
+
+std::chrono::system_clock::time_point
+FroniusDevice::Snapshot::timestamp() const {
+  return gen_->timestamp;
+}
+
+uint64_t FroniusDevice::Snapshot::sequence() const { return gen_->sequence; }
+
+FroniusDevice::Snapshot FroniusDevice::snapshot() const {
+  for (;;) {
+    const uint32_t idx = published_.load(std::memory_order_acquire);
+    const Generation &gen = generations_[idx];
+
+    // Register as a reader, then confirm the generation is still the
+    // published one. Otherwise the writer may have picked it for an update
+    // before seeing the reader; let go and retry on the new generation.
+    // Both steps are sequentially consistent so they order against the
+    // writer's claim in beginUpdate().
+    gen.readers.fetch_add(1);
+    if (published_.load() == idx)
+      return Snapshot(&gen);
+    gen.readers.fetch_sub(1, std::memory_order_release);
+  }
+}
+
+std::expected<void, ModbusError> FroniusDevice::beginUpdate(bool wait) {
+  while (updating_.exchange(true, std::memory_order_acquire)) {
+    if (!wait)
+      return std::unexpected(ModbusError::custom(
+          EINPROGRESS, "beginUpdate(): A fetch is already in progress"));
+    updating_.wait(true, std::memory_order_relaxed);
+  }
+
+  // Only the writer moves published_, so a relaxed load is current.
+  const uint32_t front = published_.load(std::memory_order_relaxed);
+  for (uint32_t i = 0; i < GENERATIONS; ++i) {
+    if (i == front)
+      continue;
+
+    // A spare generation is free once its last reader has gone; a reader
+    // arriving after this check finds it unpublished and backs off.
+    Generation &gen = generations_[i];
+    if (gen.readers.load() != 0)
+      continue;
+
+    // Start from the published registers so ranges the update does not
+    // read keep their values.
+    gen.regs = generations_[front].regs;
+    update_ = &gen;
+    return {};
+  }
+
+  updating_.store(false, std::memory_order_release);
+  updating_.notify_one();
+  return std::unexpected(ModbusError::custom(
+      EBUSY, "beginUpdate(): All register generations are held by readers"));
+}
+
+RegisterBuffer &FroniusDevice::updateRegs() { return update_->regs; }
+
+void FroniusDevice::publishUpdate() {
+  const Generation &front =
+      generations_[published_.load(std::memory_order_relaxed)];
+  update_->timestamp = std::chrono::system_clock::now();
+  update_->sequence = front.sequence + 1;
+
+  published_.store(static_cast<uint32_t>(update_ - generations_.data()));
+  update_ = nullptr;
+
+  // Run the hook before the next update may open, so it sees publications
+  // one at a time and in order
+  {
+    const Snapshot snap = snapshot();
+    onPublished(snap);
+  }
+
+  updating_.store(false, std::memory_order_release);
+  updating_.notify_one();
+}
+
+void FroniusDevice::abortUpdate() {
+  update_ = nullptr;
+  updating_.store(false, std::memory_order_release);
+  updating_.notify_one();
 }
 
 // -------------------------------------------------------------------------
@@ -31,12 +156,20 @@ FroniusDevice::FroniusDevice(const ModbusDeviceConfig &cfg) : cfg_(cfg) {
 
 void FroniusDevice::setReady(FroniusTypes::RegisterMap map) {
   registerMap_ = map;
+  validations_.fetch_add(1);
   ready_.store(true);
 
   if (onDeviceReady_)
     onDeviceReady_(map);
 }
 
+void FroniusDevice::markParked() {
+  ready_.store(false);
+
+  if (onDeviceUnavailable_)
+    onDeviceUnavailable_();
+}
+
 void FroniusDevice::setUnavailable() {
   ready_.store(false);
   registerMap_ = FroniusTypes::RegisterMap::UNAVAILABLE;
@@ -45,12 +178,96 @@ void FroniusDevice::setUnavailable() {
     onDeviceUnavailable_();
 }
 
+// -------------------------------------------------------------------------
+// Asynchronous fetch helpers
+// -------------------------------------------------------------------------
+
+bool FroniusDevice::beginAsyncFetch(FetchCallback done) {
+  if (auto res = beginUpdate(false); !res) {
+    if (done)
+      done(std::unexpected(std::move(res.error())));
+    return false;
+  }
+
+  fetchDone_ = std::move(done);
+  return true;
+}
+
+bool FroniusDevice::armAsyncFetch(int parts) {
+  if (parts <= 0) {
+    FetchCallback done = std::move(fetchDone_);
+    fetchDone_ = nullptr;
+    abortUpdate();
+    if (done)
+      done({});
+    return false;
+  }
+
+  fetchKeepAlive_ = weak_from_this().lock();
+  fetchFailed_.store(false);
+  fetchRemaining_.store(parts, std::memory_order_release);
+  return true;
+}
+
+void FroniusDevice::completeAsyncFetch(
+    const std::expected<void, ModbusError> &res) {
+  // Only the first failing part records its error. The write is published
+  // to the last part by the release sequence on fetchRemaining_.
+  if (!res && !fetchFailed_.exchange(true))
+    fetchError_ = res.error();
+
+  if (fetchRemaining_.fetch_sub(1, std::memory_order_acq_rel) != 1)
+    return;
+
+  FetchCallback done = std::move(fetchDone_);
+  fetchDone_ = nullptr;
+  std::optional<ModbusError> err = std::move(fetchError_);
+  fetchError_.reset();
+  auto keepAlive = std::move(fetchKeepAlive_);
+
+  // Close the update before notifying so the callback sees the new
+  // registers and can start the next fetch right away.
+  if (err) {
+    abortUpdate();
+    setUnavailable();
+    reportError<void>(std::unexpected(*err));
+    if (done)
+      done(std::unexpected(std::move(*err)));
+    return;
+  }
+
+  publishUpdate();
+  if (done)
+    done({});
+}
+
+void FroniusDevice::notifyError(const ModbusError &err, int startAddr,
+                                int count) const {
+  if (!onDeviceError_)
+    return;
+
+  auto ev = ModbusErrorEvent::of(err.code, "FroniusDevice", cfg_.slaveId,
+                                 startAddr, count);
+  ev.severity = err.severity;
+  if (errorLimiter_.enabled() && !errorLimiter_.admit(ev))
+    return;
+
+  if (ev.repeats == 0) {
+    onDeviceError_(err);
+    return;
+  }
+
+  ModbusError repeated = err;
+  repeated.message += std::format(" (repeated {} times)", ev.repeats);
+  onDeviceError_(repeated);
+}
+
 // -------------------------------------------------------------------------
 // Register decoding helpers
 // -------------------------------------------------------------------------
 
 std::expected<std::string, ModbusError>
-FroniusDevice::getModbusString(const std::vector<uint16_t> &regs,
+FroniusDevice::getModbusString(const RegisterBuffer &regs,
                                const Register &reg) const {
   std::string str;
 
@@ -60,7 +277,7 @@ FroniusDevice::getModbusString(const std::vector<uint16_t> &regs,
           EINVAL, "getModbusString(): Unsupported register {}", reg.describe());
     }
 
-    if (static_cast<size_t>(reg.ADDR + reg.NB) > regs.size()) {
+    if (!regs.contains(reg.ADDR, reg.NB)) {
       throw ModbusError::custom(
           EINVAL, "getModbusString(): Register range out of bounds {}",
           reg.describe());
@@ -95,8 +312,7 @@ FroniusDevice::getModbusString(const std::vector<uint16_t> &regs,
     }
 
   } catch (const ModbusError &e) {
-    if (onDeviceError_)
-      onDeviceError_(e);
+    notifyError(e, reg.ADDR, reg.NB);
     return std::unexpected(e);
   }
 
@@ -104,12 +320,19 @@ FroniusDevice::getModbusString(const std::vector<uint16_t> &regs,
 }
 
 std::expected<double, ModbusError>
-FroniusDevice::getModbusDouble(const std::vector<uint16_t> &regs,
+FroniusDevice::getModbusDouble(const RegisterBuffer &regs,
                                const Register &reg,
                                std::optional<Register> sf) const {
   double value = 0.0;
 
   try {
+    const uint16_t *src = regs.data(reg.ADDR, reg.NB);
+    if (!src || (sf.has_value() && !regs.contains(sf->ADDR))) {
+      throw ModbusError::custom(
+          EINVAL, "getModbusDouble(): Register range out of bounds {}",
+          reg.describe());
+    }
+
     // Compute the scale factor. When a scale-factor register is present,
     // its raw value is interpreted as a signed 16-bit exponent: scale = 10^SF.
     // When absent, scale is 1.0 (no scaling).
@@ -120,24 +343,21 @@ FroniusDevice::getModbusDouble(const std::vector<uint16_t> &regs,
 
     switch (reg.TYPE) {
     case Register::Type::INT16:
-      value = static_cast<double>(static_cast<int16_t>(regs[reg.ADDR])) * scale;
+      value = static_cast<double>(static_cast<int16_t>(*src)) * scale;
       break;
 
     case Register::Type::UINT16:
-      value = static_cast<double>(regs[reg.ADDR]) * scale;
+      value = static_cast<double>(*src) * scale;
       break;
 
     case Register::Type::UINT32:
-      value = static_cast<double>(
-                  ModbusUtils::modbus_get_uint32(regs.data() + reg.ADDR)) *
-              scale;
+      value = static_cast<double>(ModbusUtils::modbus_get_uint32(src)) * scale;
       break;
 
     case Register::Type::FLOAT:
       // 32-bit IEEE 754 float stored in ABCD byte order (big-endian words,
       // big-endian bytes within each word) — standard SunSpec encoding.
-      value =
-          static_cast<double>(modbus_get_float_abcd(regs.data() + reg.ADDR));
+      value = static_cast<double>(modbus_get_float_abcd(src));
       break;
 
     default:
@@ -146,8 +366,7 @@ FroniusDevice::getModbusDouble(const std::vector<uint16_t> &regs,
     }
 
   } catch (const ModbusError &e) {
-    if (onDeviceError_)
-      onDeviceError_(e);
+    notifyError(e, reg.ADDR, reg.NB);
     return std::unexpected(e);
   }
 
@@ -155,55 +374,77 @@ FroniusDevice::getModbusDouble(const std::vector<uint16_t> &regs,
 }
 
 std::expected<double, ModbusError>
-FroniusDevice::getModbusDouble(const std::vector<uint16_t> &regs,
+FroniusDevice::getModbusDouble(const RegisterBuffer &regs,
                                const Register &reg, double sf) const {
   // This overload is used exclusively with the proprietary Fronius RTU
   // register map, where scale factors are fixed compile-time constants
   // rather than separate scale-factor registers. The register type must
   // always be INT32 in that map, stored in little-endian word order.
   if (reg.TYPE != Register::Type::INT32) {
+    return reportError<double>(
+        std::unexpected(ModbusError::custom(
+            EINVAL, "getModbusDouble(): Unsupported register {}",
+            reg.describe())),
+        reg.ADDR, reg.NB);
+  }
+
+  const uint16_t *src = regs.data(reg.ADDR, reg.NB);
+  if (!src) {
     return reportError<double>(std::unexpected(ModbusError::custom(
-        EINVAL, "getModbusDouble(): Unsupported register {}", reg.describe())));
+        EINVAL, "getModbusDouble(): Register range out of bounds {}",
+        reg.describe())), reg.ADDR, reg.NB);
   }
 
   return static_cast<double>(
-             ModbusUtils::modbus_get_int32(regs.data() + reg.ADDR,
-                                           /*word_swap=*/true)) *
+             ModbusUtils::modbus_get_int32(src, /*word_swap=*/true)) *
          sf;
 }
 
+std::expected<double, ModbusError>
+FroniusDevice::rangeError(const Register &reg) const {
+  return reportError<double>(std::unexpected(ModbusError::custom(
+      EINVAL, "getModbusDouble(): Register range out of bounds {}",
+      reg.describe())), reg.ADDR, reg.NB);
+}
+
 // -------------------------------------------------------------------------
 // Public API
 // -------------------------------------------------------------------------
 
 std::expected<std::string, ModbusError> FroniusDevice::getManufacturer() {
-  return getModbusString(regs_, C001::MN);
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::MN);
 }
 
 std::expected<std::string, ModbusError> FroniusDevice::getDeviceModel() {
-  return getModbusString(regs_, C001::MD);
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::MD);
 }
 
 std::expected<std::string, ModbusError> FroniusDevice::getOptions() {
-  return getModbusString(regs_, C001::OPT);
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::OPT);
 }
 
 std::expected<std::string, ModbusError> FroniusDevice::getFwVersion() {
-  return getModbusString(regs_, C001::VR);
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::VR);
 }
 
 std::expected<std::string, ModbusError> FroniusDevice::getSerialNumber() {
-  return getModbusString(regs_, C001::SN);
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::SN);
 }
 
 std::expected<uint16_t, ModbusError> FroniusDevice::getModbusDeviceAddress() {
-  uint16_t val = regs_[C001::DA.ADDR];
+  uint16_t val = snapshot().regs()[C001::DA.ADDR];
 
   if ((val < 1) || (val > 247))
     return reportError<uint16_t>(std::unexpected(
         ModbusError::custom(EINVAL,
                             "getModbusDeviceAddress(): Invalid Modbus slave "
                             "address: received {}, expected 1-247",
-                            val)));
+                            val)),
+        C001::DA.ADDR, C001::DA.NB);
   return val;
 }
@@ -0,0 +1,202 @@
+#include "fronius_poller.h"
+#include "fronius_device.h"
+#include "fronius_types.h"
+#include "modbus_error.h"
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <expected>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/* -------------------------------------------------------------------------
+   Construction / destruction
+   ------------------------------------------------------------------------- */
+
+FroniusPoller::FroniusPoller() : thread_(&FroniusPoller::run, this) {}
+
+FroniusPoller::~FroniusPoller() {
+  std::unique_lock<std::mutex> lock(mtx_);
+  running_ = false;
+  cv_.notify_all();
+  cv_.wait(lock, [this] { return inFlight_ == 0; });
+  lock.unlock();
+
+  if (thread_.joinable())
+    thread_.join();
+}
+
+/* -------------------------------------------------------------------------
+   Public API
+   ------------------------------------------------------------------------- */
+
+void FroniusPoller::add(std::shared_ptr<FroniusDevice> device,
+                        std::initializer_list<Rate> rates,
+                        SampleCallback onSample,
+                        std::chrono::milliseconds phase) {
+  if (!device)
+    throw std::invalid_argument("FroniusPoller: device must not be null");
+  if (rates.size() == 0)
+    throw std::invalid_argument("FroniusPoller: rates must not be empty");
+  if (phase.count() < 0)
+    throw std::invalid_argument("FroniusPoller: phase must not be negative");
+
+  auto entry = std::make_unique<Entry>();
+  for (const Rate &rate : rates) {
+    if (rate.blocks == FroniusTypes::Block::NONE)
+      throw std::invalid_argument("FroniusPoller: rate without blocks");
+    if (rate.interval.count() < 0)
+      throw std::invalid_argument(
+          "FroniusPoller: interval must not be negative");
+    entry->schedules.push_back(
+        {rate.blocks, rate.interval, Clock::time_point::max()});
+  }
+  entry->device = device;
+  entry->key = device.get();
+  entry->onSample = std::move(onSample);
+  entry->phase = phase;
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  for (const auto &e : entries_)
+    if (e->key == entry->key && !e->removed)
+      throw std::invalid_argument("FroniusPoller: device is already polled");
+
+  entries_.push_back(std::move(entry));
+  dirty_ = true;
+  cv_.notify_all();
+}
+
+void FroniusPoller::remove(const FroniusDevice &device) {
+  std::unique_lock<std::mutex> lock(mtx_);
+  auto it = std::find_if(entries_.begin(), entries_.end(), [&](auto &e) {
+    return e->key == &device && !e->removed;
+  });
+  if (it == entries_.end())
+    return;
+
+  // The entry stays in place until its poll completed, so onFetched()
+  // can still reach it; the poller thread erases it afterwards
+  Entry *entry = it->get();
+  entry->removed = true;
+  dirty_ = true;
+  cv_.notify_all();
+  cv_.wait(lock, [entry] { return !entry->inFlight; });
+}
+
+/* -------------------------------------------------------------------------
+   Poller thread
+   ------------------------------------------------------------------------- */
+
+void FroniusPoller::run() {
+  struct Poll {
+    Entry *entry;
+    std::shared_ptr<FroniusDevice> device;
+    FroniusTypes::Block blocks;
+  };
+  std::vector<Poll> polls;
+
+  std::unique_lock<std::mutex> lock(mtx_);
+
+  while (running_) {
+    dirty_ = false;
+    const auto now = Clock::now();
+    auto wakeAt = now + READY_CHECK;
+
+    std::erase_if(entries_, [](const auto &e) {
+      return !e->inFlight && (e->removed || e->device.expired());
+    });
+
+    for (auto &e : entries_) {
+      auto device = e->removed ? nullptr : e->device.lock();
+      if (!device)
+        continue;
+
+      // Pause while the device is down; once it is validated again the
+      // one-off reads repeat and the periodic ones restart at the phase.
+      // The count catches revalidations quicker than one pass.
+      if (!device->isReady()) {
+        e->deferred = FroniusTypes::Block::NONE;
+        continue;
+      }
+      if (const uint64_t validation = device->getValidationCount();
+          validation != e->validation) {
+        e->validation = validation;
+        for (auto &s : e->schedules)
+          s.due = s.interval.count() == 0 ? now : now + e->phase;
+      }
+
+      FroniusTypes::Block due = e->deferred;
+      for (auto &s : e->schedules) {
+        if (s.due <= now) {
+          due = due | s.blocks;
+
+          // Fixed rate: step to the next slot after now, so a late poll
+          // neither drifts the schedule nor is followed by a burst
+          if (s.interval.count() == 0) {
+            s.due = Clock::time_point::max();
+          } else {
+            const auto missed = (now - s.due) / s.interval;
+            s.due += (missed + 1) * s.interval;
+          }
+        }
+        wakeAt = std::min(wakeAt, s.due);
+      }
+
+      if (due == FroniusTypes::Block::NONE)
+        continue;
+      if (e->inFlight) {
+        e->deferred = due;
+        continue;
+      }
+
+      e->deferred = FroniusTypes::Block::NONE;
+      e->inFlight = true;
+      ++inFlight_;
+      polls.push_back({e.get(), std::move(device), due});
+    }
+
+    // Submit outside the lock: a rejected fetch completes synchronously
+    if (!polls.empty()) {
+      lock.unlock();
+      for (auto &p : polls)
+        p.device->fetchBlocksAsync(
+            p.blocks, [this, entry = p.entry, device = p.device,
+                       blocks = p.blocks](const auto &res) {
+              onFetched(*entry, device, blocks, res);
+            });
+      polls.clear();
+      lock.lock();
+    }
+
+    cv_.wait_until(lock, wakeAt, [this] { return dirty_ || !running_; });
+  }
+}
+
+void FroniusPoller::onFetched(Entry &entry,
+                              const std::shared_ptr<FroniusDevice> &device,
+                              FroniusTypes::Block blocks,
+                              const std::expected<void, ModbusError> &res) {
+  // Runs before the entry is released, so remove() and the destructor
+  // wait for the callback as well
+  if (res && entry.onSample)
+    entry.onSample(*device, blocks);
+
+  std::lock_guard<std::mutex> lock(mtx_);
+  entry.inFlight = false;
+  --inFlight_;
+
+  // A fetch started by the application held the device: retry the blocks
+  // on the next pass rather than dropping a one-off read. Other errors
+  // were reported by the device and left it unavailable.
+  if (!res &&
+      (res.error().code == EINPROGRESS || res.error().code == EBUSY))
+    entry.deferred = entry.deferred | blocks;
+  else if (entry.deferred != FroniusTypes::Block::NONE)
+    dirty_ = true;
+
+  cv_.notify_all();
+}
@@ -1,24 +1,51 @@
 #include "inverter.h"
 #include "common_registers.h"
+#include "device_identity_cache.h"
 #include "fronius_bus.h"
 #include "fronius_types.h"
 #include "inverter_registers.h"
 #include "modbus_error.h"
 #include "modbus_utils.h"
+#include "sunspec_discovery.h"
 #include <array>
 #include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
 #include <expected>
 #include <optional>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+namespace {
+
+// End of the shortest SunSpec map: integer encoding, no storage model
+constexpr uint16_t SUNSPEC_MIN_END = I_END::L.ADDR + I_END::L.NB;
+
+// End of the SunSpec map: the furthest possible end block (float encoding
+// on a hybrid inverter, where the storage model precedes the end block).
+constexpr uint16_t SUNSPEC_END = I_END::L.ADDR + I_END::FLOAT_OFFSET +
+                                 I_END::STORAGE_OFFSET + I_END::L.NB;
+
+} // namespace
+
 /* -------------------------------------------------------------------------
    Construction
    ------------------------------------------------------------------------- */
 
+// Register layout: the Fronius state code register plus the SunSpec map from
+// the common block up to SUNSPEC_END.
 Inverter::Inverter(std::shared_ptr<FroniusBus> bus,
                    const ModbusDeviceConfig &cfg)
-    : FroniusDevice(cfg), bus_(std::move(bus)) {}
+    : FroniusDevice(
+          cfg, {{F::ACTIVE_STATE_CODE.ADDR, F::ACTIVE_STATE_CODE.NB},
+                {C001::SID.ADDR,
+                 static_cast<uint16_t>(SUNSPEC_END - C001::SID.ADDR)}}),
+      bus_(std::move(bus)) {}
 
 /* -------------------------------------------------------------------------
    FroniusDevice bus lifecycle
@@ -30,12 +57,39 @@ void Inverter::onBusConnected() {
   id_ = 0;
   inputs_ = 0;
   hybrid_ = false;
+  models_.clear();
+  nameplateOffset_ = 0;
+  mpptOffset_ = 0;
+  limitScale_.store(NO_SCALE);
+
+  // Probes write into a register update, published once the device has
+  // validated so readers never see a half-probed register set
+  if (auto res = beginUpdate(); !res) {
+    reportError<void>(std::unexpected(res.error()));
+    setUnavailable();
+    return;
+  }
 
-  if (auto res = validateDevice(); !res) {
+  // A known device only needs its cached identity confirmed; anything
+  // else is validated from scratch and remembered for the next connect
+  std::expected<void, ModbusError> res;
+  auto restored = restoreIdentity();
+  if (!restored)
+    res = std::unexpected(restored.error());
+  else if (!*restored) {
+    res = validateDevice();
+    if (res)
+      storeIdentity();
+  }
+  if (res)
+    res = buildDecoder();
+  if (!res) {
+    abortUpdate();
     setUnavailable();
     return;
   }
 
+  publishUpdate();
   setReady(FroniusTypes::RegisterMap::SUNSPEC);
 }
 
@@ -44,6 +98,10 @@ void Inverter::onBusDisconnected() {
   id_ = 0;
   inputs_ = 0;
   hybrid_ = false;
+  models_.clear();
+  nameplateOffset_ = 0;
+  mpptOffset_ = 0;
+  limitScale_.store(NO_SCALE);
   setUnavailable();
 }
 
@@ -51,15 +109,43 @@ void Inverter::onBusDisconnected() {
    Transaction helper
    ------------------------------------------------------------------------- */
 
-FroniusBus::Transaction Inverter::makeTransaction(int startAddr, int count,
-                                                  uint16_t *dest) {
+FroniusBus::Transaction Inverter::makeTransaction(uint16_t startAddr,
+                                                  uint16_t count) {
+  FroniusBus::Transaction t;
+  t.slaveId = cfg_.slaveId;
+  t.startAddr = startAddr;
+  t.count = count;
+  t.dest = updateRegs().data(startAddr, count);
+  t.secTimeout = cfg_.secTimeout;
+  t.usecTimeout = cfg_.usecTimeout;
+  t.priority = cfg_.priority;
+  if (cfg_.deadlineMs > 0)
+    t.deadline = std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(cfg_.deadlineMs);
+  return t;
+}
+
+FroniusBus::Transaction Inverter::makeProbeTransaction(uint16_t startAddr,
+                                                       uint16_t count) {
+  FroniusBus::Transaction t = makeTransaction(startAddr, count);
+  t.priority = FroniusTypes::Priority::LOW;
+  t.deadline = std::chrono::steady_clock::time_point::max();
+  t.probe = true;
+  return t;
+}
+
+FroniusBus::Transaction
+Inverter::makeControlTransaction(uint16_t startAddr, uint16_t count,
+                                 const uint16_t *src) {
   FroniusBus::Transaction t;
   t.slaveId = cfg_.slaveId;
   t.startAddr = startAddr;
   t.count = count;
-  t.dest = dest;
+  t.op = FroniusBus::Transaction::Op::WRITE;
+  t.src = src;
   t.secTimeout = cfg_.secTimeout;
   t.usecTimeout = cfg_.usecTimeout;
+  t.priority = FroniusTypes::Priority::CONTROL;
   return t;
 }
 
@@ -67,77 +153,116 @@ FroniusBus::Transaction Inverter::makeTransaction(int startAddr, int count,
    Data fetch
    ------------------------------------------------------------------------- */
 
-std::expected<void, ModbusError> Inverter::fetchInverterRegisters() {
-  // Active state code
-  auto fState = bus_->submit(makeTransaction(
-      F::ACTIVE_STATE_CODE.ADDR, F::ACTIVE_STATE_CODE.NB, regs_.data()));
+size_t Inverter::fetchPlan(FroniusTypes::Block blocks,
+                           std::array<FroniusBus::Transaction, 4> &plan) {
+  using Block = FroniusTypes::Block;
+  size_t n = 0;
 
-  // Main inverter register block
-  const auto &inverterBaseReg = useFloatRegisters_ ? I11X::A : I10X::A;
-  const uint16_t inverterBlockSize =
-      useFloatRegisters_ ? I11X::SIZE : I10X::SIZE;
+  if (FroniusTypes::has(blocks, Block::STATE))
+    plan[n++] =
+        makeTransaction(F::ACTIVE_STATE_CODE.ADDR, F::ACTIVE_STATE_CODE.NB);
 
-  auto fInv = bus_->submit(
-      makeTransaction(inverterBaseReg.ADDR, inverterBlockSize, regs_.data()));
+  // Main inverter register block
+  if (FroniusTypes::has(blocks, Block::INVERTER)) {
+    const auto &inverterBaseReg = useFloatRegisters_ ? I11X::A : I10X::A;
+    const uint16_t inverterBlockSize =
+        useFloatRegisters_ ? I11X::SIZE : I10X::SIZE;
+    plan[n++] = makeTransaction(inverterBaseReg.ADDR, inverterBlockSize);
+  }
 
   // Multi MPPT extension block
-  const auto &multiMpptBaseReg =
-      useFloatRegisters_ ? I160::DCA_SF.withOffset(I160::FLOAT_OFFSET)
-                         : I160::DCA_SF;
-
-  auto fMppt = bus_->submit(
-      makeTransaction(multiMpptBaseReg.ADDR, I160::SIZE, regs_.data()));
+  if (FroniusTypes::has(blocks, Block::MPPT)) {
+    const auto multiMpptBaseReg = I160::DCA_SF.withOffset(mpptOffset_);
+    plan[n++] = makeTransaction(multiMpptBaseReg.ADDR, I160::SIZE);
+  }
 
-  // Wait for all submitted transactions in order
-  if (auto res = fState.get(); !res) {
-    setUnavailable();
-    return reportError<void>(std::unexpected(res.error()));
+  // Nameplate block, header included as read during validation
+  if (FroniusTypes::has(blocks, Block::NAMEPLATE)) {
+    const auto nameplateBaseReg = I120::ID.withOffset(nameplateOffset_);
+    plan[n++] = makeTransaction(nameplateBaseReg.ADDR, I120::SIZE + 2);
   }
 
-  if (auto res = fInv.get(); !res) {
-    setUnavailable();
+  return n;
+}
+
+std::expected<void, ModbusError> Inverter::fetchInverterRegisters() {
+  if (auto res = beginUpdate(); !res)
     return reportError<void>(std::unexpected(res.error()));
+
+  std::array<FroniusBus::Transaction, 4> plan;
+  const size_t parts = fetchPlan(defaultBlocks(), plan);
+
+  // Submit every block before waiting on the first one
+  std::array<FroniusBus::Completion, plan.size()> pending;
+  for (size_t i = 0; i < parts; ++i)
+    pending[i] = bus_->submit(plan[i]);
+
+  // Wait for all submitted transactions in order, even after a failure:
+  // the bus thread writes into the update until each one has completed.
+  std::optional<ModbusError> err;
+  for (size_t i = 0; i < parts; ++i) {
+    if (auto res = pending[i].get(); !res && !err)
+      err = res.error();
   }
 
-  if (auto res = fMppt.get(); !res) {
+  if (err) {
+    abortUpdate();
     setUnavailable();
-    return reportError<void>(std::unexpected(res.error()));
+    return reportError<void>(std::unexpected(std::move(*err)));
   }
 
+  publishUpdate();
   return {};
 }
 
+void Inverter::fetchAsync(FetchCallback done) {
+  fetchBlocksAsync(defaultBlocks(), std::move(done));
+}
+
+void Inverter::fetchBlocksAsync(FroniusTypes::Block blocks,
+                                FetchCallback done) {
+  if (!beginAsyncFetch(std::move(done)))
+    return;
+
+  std::array<FroniusBus::Transaction, 4> plan;
+  const size_t parts = fetchPlan(blocks, plan);
+
+  if (!armAsyncFetch(static_cast<int>(parts)))
+    return;
+
+  for (size_t i = 0; i < parts; ++i)
+    bus_->submit(plan[i], [this](const std::expected<void, ModbusError> &res) {
+      completeAsyncFetch(res);
+    });
+}
+
+FroniusTypes::Block Inverter::defaultBlocks() const {
+  using Block = FroniusTypes::Block;
+  return Block::STATE | Block::INVERTER | Block::MPPT;
+}
+
 /* -------------------------------------------------------------------------
    Electrical measurements
    ------------------------------------------------------------------------- */
 
 std::expected<double, ModbusError>
 Inverter::getAcPowerRating(FroniusTypes::Output output) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (output) {
   case FroniusTypes::Output::ACTIVE:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I120::WRTG.withOffset(I120::FLOAT_OFFSET),
-                                 I120::WRTG_SF.withOffset(I120::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I120::WRTG, I120::WRTG_SF);
+    return getModbusDouble<ScaledValue<I120::WRTG, I120::WRTG_SF>>(
+        regs, nameplateOffset_);
   case FroniusTypes::Output::APPARENT:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I120::VARTG.withOffset(I120::FLOAT_OFFSET),
-                                 I120::VARTG_SF.withOffset(I120::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I120::VARTG, I120::VARTG_SF);
+    return getModbusDouble<ScaledValue<I120::VARTG, I120::VARTG_SF>>(
+        regs, nameplateOffset_);
   case FroniusTypes::Output::Q1_REACTIVE:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I120::VARRTGQ1.withOffset(I120::FLOAT_OFFSET),
-                                 I120::VARRTG_SF.withOffset(I120::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I120::VARRTGQ1, I120::VARRTG_SF);
+    return getModbusDouble<ScaledValue<I120::VARRTGQ1, I120::VARRTG_SF>>(
+        regs, nameplateOffset_);
   case FroniusTypes::Output::Q4_REACTIVE:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I120::VARRTGQ4.withOffset(I120::FLOAT_OFFSET),
-                                 I120::VARRTG_SF.withOffset(I120::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I120::VARRTGQ4, I120::VARRTG_SF);
+    return getModbusDouble<ScaledValue<I120::VARRTGQ4, I120::VARRTG_SF>>(
+        regs, nameplateOffset_);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcPowerRating(): Invalid output {}",
@@ -147,19 +272,18 @@ Inverter::getAcPowerRating(FroniusTypes::Output output) const {
 
 std::expected<double, ModbusError>
 Inverter::getAcCurrent(FroniusTypes::Phase ph) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (ph) {
   case FroniusTypes::Phase::TOTAL:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::A)
-                              : getModbusDouble(regs_, I10X::A, I10X::A_SF);
+    return getValue<I10X::A, I10X::A_SF, I11X::A>(regs);
   case FroniusTypes::Phase::A:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::APHA)
-                              : getModbusDouble(regs_, I10X::APHA, I10X::A_SF);
+    return getValue<I10X::APHA, I10X::A_SF, I11X::APHA>(regs);
   case FroniusTypes::Phase::B:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::APHB)
-                              : getModbusDouble(regs_, I10X::APHB, I10X::A_SF);
+    return getValue<I10X::APHB, I10X::A_SF, I11X::APHB>(regs);
   case FroniusTypes::Phase::C:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::APHC)
-                              : getModbusDouble(regs_, I10X::APHC, I10X::A_SF);
+    return getValue<I10X::APHC, I10X::A_SF, I11X::APHC>(regs);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcCurrent(): Invalid phase {}",
@@ -169,31 +293,22 @@ Inverter::getAcCurrent(FroniusTypes::Phase ph) const {
 
 std::expected<double, ModbusError>
 Inverter::getAcVoltage(FroniusTypes::Phase ph) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (ph) {
   case FroniusTypes::Phase::A:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_, I11X::PHVPHA)
-               : getModbusDouble(regs_, I10X::PHVPHA, I10X::V_SF);
+    return getValue<I10X::PHVPHA, I10X::V_SF, I11X::PHVPHA>(regs);
   case FroniusTypes::Phase::B:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_, I11X::PHVPHB)
-               : getModbusDouble(regs_, I10X::PHVPHB, I10X::V_SF);
+    return getValue<I10X::PHVPHB, I10X::V_SF, I11X::PHVPHB>(regs);
   case FroniusTypes::Phase::C:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_, I11X::PHVPHC)
-               : getModbusDouble(regs_, I10X::PHVPHC, I10X::V_SF);
+    return getValue<I10X::PHVPHC, I10X::V_SF, I11X::PHVPHC>(regs);
   case FroniusTypes::Phase::AB:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_, I11X::PPVPHAB)
-               : getModbusDouble(regs_, I10X::PPVPHAB, I10X::V_SF);
+    return getValue<I10X::PPVPHAB, I10X::V_SF, I11X::PPVPHAB>(regs);
   case FroniusTypes::Phase::BC:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_, I11X::PPVPHBC)
-               : getModbusDouble(regs_, I10X::PPVPHBC, I10X::V_SF);
+    return getValue<I10X::PPVPHBC, I10X::V_SF, I11X::PPVPHBC>(regs);
   case FroniusTypes::Phase::CA:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_, I11X::PPVPHCA)
-               : getModbusDouble(regs_, I10X::PPVPHCA, I10X::V_SF);
+    return getValue<I10X::PPVPHCA, I10X::V_SF, I11X::PPVPHCA>(regs);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcVoltage(): Invalid phase {}",
@@ -203,19 +318,18 @@ Inverter::getAcVoltage(FroniusTypes::Phase ph) const {
 
 std::expected<double, ModbusError>
 Inverter::getAcPower(FroniusTypes::Output output) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (output) {
   case FroniusTypes::Output::ACTIVE:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::W)
-                              : getModbusDouble(regs_, I10X::W, I10X::W_SF);
+    return getValue<I10X::W, I10X::W_SF, I11X::W>(regs);
   case FroniusTypes::Output::APPARENT:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::VA)
-                              : getModbusDouble(regs_, I10X::VA, I10X::VA_SF);
+    return getValue<I10X::VA, I10X::VA_SF, I11X::VA>(regs);
   case FroniusTypes::Output::REACTIVE:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::VAR)
-                              : getModbusDouble(regs_, I10X::VAR, I10X::VAR_SF);
+    return getValue<I10X::VAR, I10X::VAR_SF, I11X::VAR>(regs);
   case FroniusTypes::Output::FACTOR:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::PF)
-                              : getModbusDouble(regs_, I10X::PF, I10X::PF_SF);
+    return getValue<I10X::PF, I10X::PF_SF, I11X::PF>(regs);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcPower(): Invalid output {}",
@@ -224,33 +338,33 @@ Inverter::getAcPower(FroniusTypes::Output output) const {
 }
 
 std::expected<double, ModbusError> Inverter::getAcFrequency() const {
-  return useFloatRegisters_ ? getModbusDouble(regs_, I11X::FREQ)
-                            : getModbusDouble(regs_, I10X::FREQ, I10X::FREQ_SF);
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
+  return getValue<I10X::FREQ, I10X::FREQ_SF, I11X::FREQ>(regs);
 }
 
 std::expected<double, ModbusError> Inverter::getAcEnergy() const {
-  return useFloatRegisters_ ? getModbusDouble(regs_, I11X::WH)
-                            : getModbusDouble(regs_, I10X::WH, I10X::WH_SF);
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
+  return getValue<I10X::WH, I10X::WH_SF, I11X::WH>(regs);
 }
 
 std::expected<double, ModbusError>
 Inverter::getDcCurrent(FroniusTypes::Input input) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (input) {
   case FroniusTypes::Input::TOTAL:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::DCA)
-                              : getModbusDouble(regs_, I10X::DCA, I10X::DCA_SF);
+    return getValue<I10X::DCA, I10X::DCA_SF, I11X::DCA>(regs);
   case FroniusTypes::Input::A:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCA_1.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCA_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCA_1, I160::DCA_SF);
+    return getModbusDouble<ScaledValue<I160::DCA_1, I160::DCA_SF>>(
+        regs, mpptOffset_);
   case FroniusTypes::Input::B:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCA_2.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCA_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCA_2, I160::DCA_SF);
+    return getModbusDouble<ScaledValue<I160::DCA_2, I160::DCA_SF>>(
+        regs, mpptOffset_);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getDcCurrent(): Invalid input {}",
@@ -260,22 +374,18 @@ Inverter::getDcCurrent(FroniusTypes::Input input) const {
 
 std::expected<double, ModbusError>
 Inverter::getDcVoltage(FroniusTypes::Input input) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (input) {
   case FroniusTypes::Input::TOTAL:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::DCV)
-                              : getModbusDouble(regs_, I10X::DCV, I10X::DCV_SF);
+    return getValue<I10X::DCV, I10X::DCV_SF, I11X::DCV>(regs);
   case FroniusTypes::Input::A:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCV_1.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCV_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCV_1, I160::DCV_SF);
+    return getModbusDouble<ScaledValue<I160::DCV_1, I160::DCV_SF>>(
+        regs, mpptOffset_);
   case FroniusTypes::Input::B:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCV_2.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCV_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCV_2, I160::DCV_SF);
+    return getModbusDouble<ScaledValue<I160::DCV_2, I160::DCV_SF>>(
+        regs, mpptOffset_);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getDcVoltage(): Invalid input {}",
@@ -285,22 +395,18 @@ Inverter::getDcVoltage(FroniusTypes::Input input) const {
 
 std::expected<double, ModbusError>
 Inverter::getDcPower(FroniusTypes::Input input) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (input) {
   case FroniusTypes::Input::TOTAL:
-    return useFloatRegisters_ ? getModbusDouble(regs_, I11X::DCW)
-                              : getModbusDouble(regs_, I10X::DCW, I10X::DCW_SF);
+    return getValue<I10X::DCW, I10X::DCW_SF, I11X::DCW>(regs);
   case FroniusTypes::Input::A:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCW_1.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCW_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCW_1, I160::DCW_SF);
+    return getModbusDouble<ScaledValue<I160::DCW_1, I160::DCW_SF>>(
+        regs, mpptOffset_);
   case FroniusTypes::Input::B:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCW_2.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCW_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCW_2, I160::DCW_SF);
+    return getModbusDouble<ScaledValue<I160::DCW_2, I160::DCW_SF>>(
+        regs, mpptOffset_);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getDcPower(): Invalid input {}",
@@ -310,19 +416,16 @@ Inverter::getDcPower(FroniusTypes::Input input) const {
 
 std::expected<double, ModbusError>
 Inverter::getDcEnergy(FroniusTypes::Input input) const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   switch (input) {
   case FroniusTypes::Input::A:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCWH_1.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCWH_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCWH_1, I160::DCWH_SF);
+    return getModbusDouble<ScaledValue<I160::DCWH_1, I160::DCWH_SF>>(
+        regs, mpptOffset_);
   case FroniusTypes::Input::B:
-    return useFloatRegisters_
-               ? getModbusDouble(regs_,
-                                 I160::DCWH_2.withOffset(I160::FLOAT_OFFSET),
-                                 I160::DCWH_SF.withOffset(I160::FLOAT_OFFSET))
-               : getModbusDouble(regs_, I160::DCWH_2, I160::DCWH_SF);
+    return getModbusDouble<ScaledValue<I160::DCWH_2, I160::DCWH_SF>>(
+        regs, mpptOffset_);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getDcEnergy(): Invalid input {}",
@@ -331,12 +434,18 @@ Inverter::getDcEnergy(FroniusTypes::Input input) const {
 }
 
 int Inverter::getActiveStateCode() const {
-  return static_cast<int>(regs_[F::ACTIVE_STATE_CODE.ADDR]);
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
+  return static_cast<int>(regs[F::ACTIVE_STATE_CODE.ADDR]);
 }
 
 std::expected<std::string, ModbusError> Inverter::getState() const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   const auto reg = useFloatRegisters_ ? I11X::STVND : I10X::STVND;
-  uint16_t statusRaw = regs_[reg.ADDR];
+  uint16_t statusRaw = regs[reg.ADDR];
 
   auto strOpt =
       FroniusTypes::toString(static_cast<FroniusTypes::State>(statusRaw));
@@ -348,132 +457,255 @@ std::expected<std::string, ModbusError> Inverter::getState() const {
   return std::string(*strOpt);
 }
 
-std::expected<std::vector<std::string>, ModbusError>
-Inverter::getEvents() const {
-  std::vector<std::string> events;
+std::expected<FroniusTypes::State, ModbusError>
+Inverter::getOperatingState() const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
+  const auto reg = useFloatRegisters_ ? I11X::STVND : I10X::STVND;
+  const uint16_t statusRaw = regs[reg.ADDR];
+
+  if (statusRaw < static_cast<uint16_t>(FroniusTypes::State::POWER_OFF) ||
+      statusRaw > static_cast<uint16_t>(FroniusTypes::State::AFCI))
+    return reportError<FroniusTypes::State>(std::unexpected(
+        ModbusError::custom(EINVAL,
+                            "getOperatingState(): Unknown inverter state "
+                            "code {}",
+                            statusRaw)));
 
-  const uint16_t evtAddrs[3] = {
+  return static_cast<FroniusTypes::State>(statusRaw);
+}
+
+InverterEvents Inverter::getEventFlags() const {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
+  const uint16_t evtAddrs[InverterEvents::GROUPS] = {
       useFloatRegisters_ ? I11X::EVTVND1.ADDR : I10X::EVTVND1.ADDR,
       useFloatRegisters_ ? I11X::EVTVND2.ADDR : I10X::EVTVND2.ADDR,
       useFloatRegisters_ ? I11X::EVTVND3.ADDR : I10X::EVTVND3.ADDR};
 
-  for (int group = 0; group < 3; ++group) {
-    uint32_t raw =
-        ModbusUtils::modbus_get_uint32(regs_.data() + evtAddrs[group]);
-    uint32_t unknownBits = raw;
-
-    for (uint32_t bit = 0; bit < 32; ++bit) {
-      uint32_t mask = 1u << bit;
-      if (!(raw & mask))
-        continue;
-
-      std::optional<const char *> strOpt;
-      switch (group) {
-      case 0:
-        strOpt =
-            FroniusTypes::toString(static_cast<FroniusTypes::Event_1>(mask));
-        break;
-      case 1:
-        strOpt =
-            FroniusTypes::toString(static_cast<FroniusTypes::Event_2>(mask));
-        break;
-      case 2:
-        strOpt =
-            FroniusTypes::toString(static_cast<FroniusTypes::Event_3>(mask));
-        break;
-      }
-
-      if (strOpt) {
-        events.emplace_back(*strOpt);
-        unknownBits &= ~mask;
-      }
-    }
+  InverterEvents events;
+  for (size_t group = 0; group < InverterEvents::GROUPS; ++group)
+    events.groups[group] =
+        ModbusUtils::modbus_get_uint32(regs.data(evtAddrs[group], 2));
+  return events;
+}
 
-    if (unknownBits != 0)
+std::expected<std::vector<std::string>, ModbusError>
+Inverter::getEvents() const {
+  const InverterEvents flags = getEventFlags();
+
+  for (size_t group = 0; group < InverterEvents::GROUPS; ++group) {
+    if (const uint32_t unknownBits = flags.unknown(group); unknownBits != 0)
       return reportError<std::vector<std::string>>(
           std::unexpected(ModbusError::custom(
               EINVAL, "getEvents(): Unknown event group {} bits: 0x{:08X}",
               group + 1, unknownBits)));
   }
 
+  std::vector<std::string> events;
+  events.reserve(flags.count());
+  for (std::string_view name : flags)
+    events.emplace_back(name);
   return events;
 }
 
+/* -------------------------------------------------------------------------
+   Bulk decode
+   ------------------------------------------------------------------------- */
+
+std::expected<void, ModbusError>
+Inverter::decodeAll(InverterSample &sample) const {
+  const auto plan = decoder_.load();
+  if (!isReady() || !plan || plan->empty())
+    return reportError<void>(std::unexpected(ModbusError::custom(
+        ENODATA, "decodeAll(): Register map not yet detected")));
+
+  decode(*plan, snapshot(), sample);
+  return {};
+}
+
+void Inverter::decode(const SampleDecoder<InverterSample> &plan, const Snapshot &snap,
+                   InverterSample &sample) const {
+  const RegisterBuffer &regs = snap.regs();
+
+  sample = InverterSample{};
+  sample.timestamp = snap.timestamp();
+  sample.sequence = snap.sequence();
+  sample.activeStateCode = static_cast<int>(regs[F::ACTIVE_STATE_CODE.ADDR]);
+  plan.decode(regs, sample);
+}
+
+std::expected<void, ModbusError>
+Inverter::decodeChanges(SampleTracker<InverterSample> &tracker) const {
+  const auto plan = decoder_.load();
+  if (!isReady() || !plan || plan->empty())
+    return reportError<void>(std::unexpected(ModbusError::custom(
+        ENODATA, "decodeChanges(): Register map not yet detected")));
+
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
+  plan->decodeChanges(regs, tracker, [&](InverterSample &sample) {
+    sample.timestamp = snap.timestamp();
+    sample.sequence = snap.sequence();
+    const int code = static_cast<int>(regs[F::ACTIVE_STATE_CODE.ADDR]);
+    return std::exchange(sample.activeStateCode, code) != code;
+  });
+  return {};
+}
+
+void Inverter::onPublished(const Snapshot &snap) {
+  const auto plan = decoder_.load();
+  if (!history_ || !isReady() || !plan || plan->empty())
+    return;
+
+  InverterSample sample;
+  decode(*plan, snap, sample);
+  history_->append(sample);
+}
+
+std::expected<void, ModbusError> Inverter::buildDecoder() {
+  const RegisterBuffer &regs = updateRegs();
+  using S = InverterSample;
+
+  // Built aside and published whole: readers may hold the previous plan
+  auto plan = std::make_shared<SampleDecoder<S>>();
+  std::expected<void, ModbusError> res;
+
+  // Main block: integer registers with a shared scale factor, or floats
+  auto add = [&](double S::*field, const Register &regInt,
+                 const Register &sfInt, const Register &regFlt) {
+    if (res)
+      res = useFloatRegisters_ ? plan->add(regs, field, regFlt)
+                               : plan->add(regs, field, regInt, sfInt);
+  };
+
+  // Multi MPPT block: relocated as found in the model chain
+  auto addMppt = [&](double S::*field, const Register &reg,
+                     const Register &sf) {
+    if (res)
+      res = plan->add(regs, field, reg.withOffset(mpptOffset_),
+                         sf.withOffset(mpptOffset_));
+  };
+
+  const int phases = getPhases();
+
+  add(&S::acCurrent, I10X::A, I10X::A_SF, I11X::A);
+  add(&S::acCurrentA, I10X::APHA, I10X::A_SF, I11X::APHA);
+  add(&S::acVoltageA, I10X::PHVPHA, I10X::V_SF, I11X::PHVPHA);
+  if (phases >= 2) {
+    add(&S::acCurrentB, I10X::APHB, I10X::A_SF, I11X::APHB);
+    add(&S::acVoltageB, I10X::PHVPHB, I10X::V_SF, I11X::PHVPHB);
+    add(&S::acVoltageAB, I10X::PPVPHAB, I10X::V_SF, I11X::PPVPHAB);
+  }
+  if (phases >= 3) {
+    add(&S::acCurrentC, I10X::APHC, I10X::A_SF, I11X::APHC);
+    add(&S::acVoltageC, I10X::PHVPHC, I10X::V_SF, I11X::PHVPHC);
+    add(&S::acVoltageBC, I10X::PPVPHBC, I10X::V_SF, I11X::PPVPHBC);
+    add(&S::acVoltageCA, I10X::PPVPHCA, I10X::V_SF, I11X::PPVPHCA);
+  }
+
+  add(&S::acPowerActive, I10X::W, I10X::W_SF, I11X::W);
+  add(&S::acPowerApparent, I10X::VA, I10X::VA_SF, I11X::VA);
+  add(&S::acPowerReactive, I10X::VAR, I10X::VAR_SF, I11X::VAR);
+  add(&S::acPowerFactor, I10X::PF, I10X::PF_SF, I11X::PF);
+  add(&S::acFrequency, I10X::FREQ, I10X::FREQ_SF, I11X::FREQ);
+  add(&S::acEnergy, I10X::WH, I10X::WH_SF, I11X::WH);
+
+  add(&S::dcCurrent, I10X::DCA, I10X::DCA_SF, I11X::DCA);
+  add(&S::dcVoltage, I10X::DCV, I10X::DCV_SF, I11X::DCV);
+  add(&S::dcPower, I10X::DCW, I10X::DCW_SF, I11X::DCW);
+
+  addMppt(&S::dcCurrentA, I160::DCA_1, I160::DCA_SF);
+  addMppt(&S::dcVoltageA, I160::DCV_1, I160::DCV_SF);
+  addMppt(&S::dcPowerA, I160::DCW_1, I160::DCW_SF);
+  addMppt(&S::dcEnergyA, I160::DCWH_1, I160::DCWH_SF);
+  if (inputs_ >= 2) {
+    addMppt(&S::dcCurrentB, I160::DCA_2, I160::DCA_SF);
+    addMppt(&S::dcVoltageB, I160::DCV_2, I160::DCV_SF);
+    addMppt(&S::dcPowerB, I160::DCW_2, I160::DCW_SF);
+    addMppt(&S::dcEnergyB, I160::DCWH_2, I160::DCWH_SF);
+  }
+
+  if (!res) {
+    decoder_.store(nullptr);
+    return reportError<void>(std::unexpected(res.error()));
+  }
+
+  decoder_.store(std::move(plan));
+  return {};
+}
+
 /* -------------------------------------------------------------------------
    Private — device validation
    ------------------------------------------------------------------------- */
 
 std::expected<void, ModbusError> Inverter::validateDevice() {
-  // --- Step 1: validate common register block ---
-  if (auto res = validateCommonRegisters(); !res)
+  // --- Step 1: walk the SunSpec model chain ---
+  SunSpecDiscovery discovery(
+      *bus_, updateRegs(), [this](uint16_t start, uint16_t count) {
+        return makeProbeTransaction(start, count);
+      });
+
+  auto models = discovery.discover(C001::SID.ADDR, SUNSPEC_MIN_END,
+                                   SUNSPEC_END);
+  if (!models)
+    return reportError<void>(std::unexpected(models.error()));
+  models_ = *models;
+
+  // --- Step 2: validate common register block ---
+  if (auto res = validateCommonRegisters(discovery); !res)
     return res;
 
-  // --- Step 2: detect float vs. integer model ---
+  // --- Step 3: detect float vs. integer model ---
   if (auto res = validateInverterRegisters(); !res)
     return res;
 
-  // --- Step 3: validate multi MPPT block and detect input count ---
-  if (auto res = validateMultiMpptRegisters(); !res)
+  // --- Step 4: validate multi MPPT block and detect input count ---
+  if (auto res = validateMultiMpptRegisters(discovery); !res)
     return res;
 
-  // --- Step 4: validate storage control block (sets hybrid_) ---
+  // --- Step 5: validate storage control block (sets hybrid_) ---
   if (auto res = validateStorageRegisters(); !res)
     return res;
 
-  // --- Step 5: validate and cache nameplate block ---
+  // --- Step 6: validate and cache nameplate block ---
   if (auto res = validateNameplateRegisters(); !res)
     return res;
 
-  // --- Step 6: validate and end register block ---
-  if (auto res = validateEndRegisters(); !res)
-    return res;
-
   return {};
 }
 
-std::expected<void, ModbusError> Inverter::validateCommonRegisters() {
-
-  // read SID, ID, length and all common registers in one transaction
-  auto fSig = bus_->submit(makeTransaction(
-      C001::SID.ADDR, C001::SID.NB + C001::ID.NB + C001::L.NB + C001::SIZE,
-      regs_.data()));
-
-  if (auto res = fSig.get(); !res)
-    return reportError<void>(std::unexpected(res.error()));
+std::expected<void, ModbusError>
+Inverter::validateCommonRegisters(SunSpecDiscovery &discovery) {
+  const RegisterBuffer &regs = updateRegs();
 
-  if (!(regs_[C001::SID.ADDR] == 0x5375 && regs_[C001::SID.ADDR + 1] == 0x6e53))
-    return reportError<void>(std::unexpected(
-        ModbusError::custom(EINVAL,
-                            "validateDevice(): SunSpec signature mismatch: "
-                            "expected [0x5375, 0x6e53], received [0x{}, 0x{}]",
-                            ModbusUtils::toHex(regs_[C001::SID.ADDR]),
-                            ModbusUtils::toHex(regs_[C001::SID.ADDR + 1]))));
-
-  if (regs_[C001::ID.ADDR] != 0x1)
+  if (regs[C001::ID.ADDR] != 0x1)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
         "validateDevice(): Invalid common block ID: received {}, expected 1",
-        regs_[C001::ID.ADDR])));
+        regs[C001::ID.ADDR])));
 
-  if (regs_[C001::L.ADDR] != C001::SIZE)
+  if (regs[C001::L.ADDR] != C001::SIZE)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
         "validateDevice(): Invalid common block size: received {}, expected {}",
-        regs_[C001::L.ADDR], C001::SIZE)));
+        regs[C001::L.ADDR], C001::SIZE)));
+
+  // Normally covered by the initial sweep already
+  if (auto res = discovery.ensure(C001::MN.ADDR, C001::SIZE); !res)
+    return reportError<void>(std::unexpected(res.error()));
 
   return {};
 }
 
 std::expected<void, ModbusError> Inverter::validateInverterRegisters() {
+  const RegisterBuffer &regs = updateRegs();
 
-  // Read ID + size in one transaction
-  auto fInt = bus_->submit(
-      makeTransaction(I10X::ID.ADDR, I10X::ID.NB + I10X::L.NB, regs_.data()));
-
-  if (auto res = fInt.get(); !res)
-    return reportError<void>(std::unexpected(res.error()));
-
-  uint16_t inverterID = regs_[I10X::ID.ADDR];
+  // The inverter model directly follows the fixed-size common block
+  uint16_t inverterID = regs[I10X::ID.ADDR];
 
   static constexpr std::array<uint16_t, 6> validIDs = {101, 102, 103,
                                                        111, 112, 113};
@@ -498,7 +730,7 @@ std::expected<void, ModbusError> Inverter::validateInverterRegisters() {
   id_ = inverterID;
   useFloatRegisters_ = (inverterID / 10 % 10) != 0;
 
-  uint16_t regMapSize = regs_[I10X::L.ADDR];
+  uint16_t regMapSize = regs[I10X::L.ADDR];
   if (regMapSize != I10X::SIZE && regMapSize != I11X::SIZE)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
@@ -509,37 +741,31 @@ std::expected<void, ModbusError> Inverter::validateInverterRegisters() {
   return {};
 }
 
-std::expected<void, ModbusError> Inverter::validateMultiMpptRegisters() {
-  const auto idReg =
-      useFloatRegisters_ ? I160::ID.withOffset(I160::FLOAT_OFFSET) : I160::ID;
-
-  // Read ID + size + all MPPT extension registers in one transaction
-  auto fMulti = bus_->submit(makeTransaction(
-      idReg.ADDR, I160::ID.NB + I160::L.NB + I160::SIZE, regs_.data()));
-
-  if (auto res = fMulti.get(); !res)
-    return reportError<void>(std::unexpected(res.error()));
+std::expected<void, ModbusError>
+Inverter::validateMultiMpptRegisters(SunSpecDiscovery &discovery) {
+  const RegisterBuffer &regs = updateRegs();
 
-  if (regs_[idReg.ADDR] != 160)
+  const auto *model = models_.find(160);
+  if (!model)
     return reportError<void>(std::unexpected(ModbusError::custom(
-        EINVAL,
-        "validateMultiMpptRegisters(): Invalid multi MPPT map ID: "
-        "received {}, expected 160",
-        regs_[idReg.ADDR])));
+        EINVAL, "validateMultiMpptRegisters(): No multi MPPT map (ID 160) "
+                "in model chain")));
 
-  if (regs_[idReg.ADDR + idReg.NB] != I160::SIZE)
+  if (model->length != I160::SIZE)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
         "validateMultiMpptRegisters(): Invalid multi MPPT map size: "
         "received {}, expected {}",
-        regs_[idReg.ADDR + idReg.NB], I160::SIZE)));
+        model->length, I160::SIZE)));
+
+  mpptOffset_ = SunSpecModelTable::offset(*model, I160::ID);
 
   // Determine number of inputs from the second input string name
-  const auto inputReg = useFloatRegisters_
-                            ? I160::IDSTR_2.withOffset(I160::FLOAT_OFFSET)
-                            : I160::IDSTR_2;
+  const auto inputReg = I160::IDSTR_2.withOffset(mpptOffset_);
+  if (auto res = discovery.ensure(inputReg.ADDR, inputReg.NB); !res)
+    return reportError<void>(std::unexpected(res.error()));
 
-  auto inputStr = getModbusString(regs_, inputReg);
+  auto inputStr = getModbusString(regs, inputReg);
   if (!inputStr)
     return reportError<void>(std::unexpected(inputStr.error()));
 
@@ -551,32 +777,19 @@ std::expected<void, ModbusError> Inverter::validateMultiMpptRegisters() {
 std::expected<void, ModbusError> Inverter::validateStorageRegisters() {
   hybrid_ = false;
 
-  const auto idReg =
-      useFloatRegisters_ ? I124::ID.withOffset(I124::FLOAT_OFFSET) : I124::ID;
-
-  auto fStorage = bus_->submit(
-      makeTransaction(idReg.ADDR, I124::ID.NB + I124::L.NB, regs_.data()));
-
-  if (auto res = fStorage.get(); !res)
-    return reportError<void>(std::unexpected(res.error()));
-
-  // End-block marker (0xFFFF) means no storage block — not a hybrid inverter
-  if (regs_[idReg.ADDR] == 0xFFFF)
+  // No storage model in the chain — not a hybrid inverter
+  const auto *model = models_.find(124);
+  if (!model)
     return {};
 
-  if (regs_[idReg.ADDR] != 124)
-    return reportError<void>(std::unexpected(ModbusError::custom(
-        EINVAL,
-        "validateStorageRegisters(): Invalid storage block ID: "
-        "received {}, expected 124",
-        regs_[idReg.ADDR])));
-
-  if (regs_[idReg.ADDR + I124::ID.NB] != I124::SIZE)
+  // I124::SIZE includes the ID and length registers
+  const uint16_t expected = I124::SIZE - I124::ID.NB - I124::L.NB;
+  if (model->length != expected)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
         "validateStorageRegisters(): Invalid storage block size: "
         "received {}, expected {}",
-        regs_[idReg.ADDR + I124::ID.NB], I124::SIZE)));
+        model->length, expected)));
 
   hybrid_ = true;
 
@@ -584,65 +797,192 @@ std::expected<void, ModbusError> Inverter::validateStorageRegisters() {
 }
 
 std::expected<void, ModbusError> Inverter::validateNameplateRegisters() {
-  const auto idReg =
-      useFloatRegisters_ ? I120::ID.withOffset(I120::FLOAT_OFFSET) : I120::ID;
-
-  auto fName = bus_->submit(
-      makeTransaction(idReg.ADDR, I120::ID.NB + I120::L.NB, regs_.data()));
-
-  if (auto res = fName.get(); !res)
-    return reportError<void>(std::unexpected(res.error()));
-
-  if (regs_[idReg.ADDR] != 120)
+  const auto *model = models_.find(120);
+  if (!model)
     return reportError<void>(std::unexpected(ModbusError::custom(
-        EINVAL,
-        "validateNameplateRegisters(): Invalid nameplate block ID: "
-        "received {}, expected 120",
-        regs_[idReg.ADDR])));
+        EINVAL, "validateNameplateRegisters(): No nameplate block (ID 120) "
+                "in model chain")));
 
-  if (regs_[idReg.ADDR + idReg.NB] != I120::SIZE)
+  if (model->length != I120::SIZE)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
         "validateNameplateRegisters(): Invalid nameplate block size: "
         "received {}, expected {}",
-        regs_[idReg.ADDR + idReg.NB], I120::SIZE)));
+        model->length, I120::SIZE)));
+
+  nameplateOffset_ = SunSpecModelTable::offset(*model, I120::ID);
 
   return {};
 }
 
-std::expected<void, ModbusError> Inverter::validateEndRegisters() {
-
-  // End block — address depends on register model and hybrid flag
-  auto endBlockBaseReg = I_END::ID;
-  if (useFloatRegisters_)
-    endBlockBaseReg = endBlockBaseReg.withOffset(I_END::FLOAT_OFFSET);
-  if (hybrid_)
-    endBlockBaseReg = endBlockBaseReg.withOffset(I_END::STORAGE_OFFSET);
+/* -------------------------------------------------------------------------
+   Power control
+   ------------------------------------------------------------------------- */
 
-  auto endBlockLengthReg = I_END::L;
-  if (useFloatRegisters_)
-    endBlockLengthReg = endBlockLengthReg.withOffset(I_END::FLOAT_OFFSET);
-  if (hybrid_)
-    endBlockLengthReg = endBlockLengthReg.withOffset(I_END::STORAGE_OFFSET);
+std::expected<void, ModbusError>
+Inverter::setPowerLimit(double pct, std::chrono::seconds revert) {
+  if (!(pct >= 0.0 && pct <= 100.0) || revert.count() < 0 ||
+      revert.count() > 28800)
+    return reportError<void>(std::unexpected(ModbusError::custom(
+        EINVAL, "setPowerLimit(): Limit {}% or revert time {}s out of range",
+        pct, revert.count())));
 
-  auto fEnd = bus_->submit(makeTransaction(
-      endBlockBaseReg.ADDR, I_END::ID.NB + I_END::L.NB, regs_.data()));
+  auto offset = controlsOffset();
+  if (!offset)
+    return reportError<void>(std::unexpected(offset.error()));
 
-  if (auto res = fEnd.get(); !res) {
-    setUnavailable();
-    return reportError<void>(std::unexpected(res.error()));
-  }
+  auto scale = powerLimitScale(*offset);
+  if (!scale)
+    return reportError<void>(std::unexpected(scale.error()));
 
-  // Validate end block content
-  if (!(regs_[endBlockBaseReg.ADDR] == 0xFFFF &&
-        regs_[endBlockLengthReg.ADDR] == 0)) {
+  const long raw = std::lround(pct * std::pow(10.0, -*scale));
+  if (raw > UINT16_MAX)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
-        "fetchInverterRegisters(): Invalid end block register: "
-        "received [0x{}, {}], expected [0xFFFF, 0]",
-        ModbusUtils::toHex(regs_[endBlockBaseReg.ADDR]),
-        regs_[endBlockLengthReg.ADDR])));
+        "setPowerLimit(): Limit {}% does not fit WMaxLimPct at scale {}",
+        pct, *scale)));
+
+  // WMaxLimPct, _WinTms, _RvrtTms, _RmpTms, WMaxLim_Ena: the window and
+  // ramp time are written back as read
+  const std::array<uint16_t, 5> values = {static_cast<uint16_t>(raw), 0,
+                                          static_cast<uint16_t>(revert.count()),
+                                          0, 1};
+  std::array<uint16_t, values.size()> written{};
+
+  FroniusBus::Transaction t = makeControlTransaction(
+      I123::WMAXLIMPCT.withOffset(*offset).ADDR, values.size(),
+      values.data());
+  t.op = FroniusBus::Transaction::Op::MODIFY;
+  t.dest = written.data();
+  t.mask = 0b10101;
+
+  return reportError(bus_->submit(t).get());
+}
+
+std::expected<void, ModbusError> Inverter::clearPowerLimit() {
+  auto offset = controlsOffset();
+  if (!offset)
+    return reportError<void>(std::unexpected(offset.error()));
+
+  const uint16_t disabled = 0;
+  const FroniusBus::Transaction t = makeControlTransaction(
+      I123::WMAXLIM_ENA.withOffset(*offset).ADDR, 1, &disabled);
+  return reportError(bus_->submit(t).get());
+}
+
+std::expected<int16_t, ModbusError> Inverter::controlsOffset() const {
+  if (!isReady())
+    return std::unexpected(ModbusError::custom(
+        ENODATA, "controlsOffset(): Register map not yet detected"));
+
+  const auto *model = models_.find(123);
+  if (!model)
+    return std::unexpected(ModbusError::custom(
+        ENOTSUP, "controlsOffset(): No immediate controls block (ID 123) in "
+                 "model chain"));
+
+  return SunSpecModelTable::offset(*model, I123::ID);
+}
+
+std::expected<int, ModbusError> Inverter::powerLimitScale(int16_t offset) {
+  if (const int cached = limitScale_.load(); cached != NO_SCALE)
+    return cached;
+
+  // Read at control priority too, so the first command is not held up
+  // behind polling either
+  uint16_t raw = 0;
+  FroniusBus::Transaction t = makeControlTransaction(
+      I123::WMAXLIMPCT_SF.withOffset(offset).ADDR, 1, nullptr);
+  t.op = FroniusBus::Transaction::Op::READ;
+  t.dest = &raw;
+  if (auto res = bus_->submit(t).get(); !res)
+    return std::unexpected(res.error());
+
+  const int scale = static_cast<int16_t>(raw);
+  if (scale < -10 || scale > 10)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "powerLimitScale(): Invalid WMaxLimPct_SF {}", scale));
+
+  limitScale_.store(scale);
+  return scale;
+}
+
+/* -------------------------------------------------------------------------
+   Private — identity cache
+   ------------------------------------------------------------------------- */
+
+std::expected<bool, ModbusError> Inverter::restoreIdentity() {
+  if (!identityCache_)
+    return false;
+
+  const std::string key =
+      DeviceIdentityCache::key(bus_->getConfig(), cfg_.slaveId);
+  auto identity = identityCache_->lookup(key);
+  if (!identity || identity->map != FroniusTypes::RegisterMap::SUNSPEC)
+    return false;
+
+  const auto *nameplate = identity->models.find(120);
+  const auto *mppt = identity->models.find(160);
+  const uint16_t nameplateSize = nameplate ? nameplate->length + 2 : 0;
+  if (!nameplate || !mppt ||
+      !updateRegs().contains(nameplate->addr, nameplateSize)) {
+    identityCache_->erase(key);
+    return false;
   }
 
-  return {};
-}
\ No newline at end of file
+  // The nameplate block is not part of a fetch; queue it right away so it
+  // arrives together with the confirmation
+  auto fName = bus_->submit(
+      makeProbeTransaction(nameplate->addr, nameplateSize));
+
+  SunSpecDiscovery discovery(
+      *bus_, updateRegs(), [this](uint16_t start, uint16_t count) {
+        return makeProbeTransaction(start, count);
+      });
+
+  // Signature, common block, and inverter model header in one read
+  auto confirmed = discovery.confirm(C001::SID.ADDR, identity->models);
+  auto named = fName.get();
+  if (!confirmed)
+    return reportError<bool>(std::unexpected(confirmed.error()));
+  if (!named)
+    return reportError<bool>(std::unexpected(named.error()));
+
+  auto serial = getModbusString(updateRegs(), C001::SN);
+
+  if (!*confirmed || !serial || *serial != identity->serial) {
+    identityCache_->erase(key);
+    return false;
+  }
+
+  models_ = identity->models;
+  if (!validateInverterRegisters() || !validateStorageRegisters() ||
+      !validateNameplateRegisters()) {
+    identityCache_->erase(key);
+    models_.clear();
+    return false;
+  }
+
+  mpptOffset_ = SunSpecModelTable::offset(*mppt, I160::ID);
+  inputs_ = identity->inputs;
+
+  return true;
+}
+
+void Inverter::storeIdentity() {
+  if (!identityCache_)
+    return;
+
+  DeviceIdentity identity;
+  identity.map = FroniusTypes::RegisterMap::SUNSPEC;
+  identity.serial = getModbusString(updateRegs(), C001::SN).value_or("");
+  identity.modelId = id_;
+  identity.floatRegisters = useFloatRegisters_;
+  identity.inputs = inputs_;
+  identity.hybrid = hybrid_;
+  identity.models = models_;
+
+  // A cache that cannot be written costs only the next fast connect
+  reportError(identityCache_->store(
+      DeviceIdentityCache::key(bus_->getConfig(), cfg_.slaveId), identity));
+}
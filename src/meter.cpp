@@ -1,22 +1,54 @@
 #include "meter.h"
 #include "common_registers.h"
+#include "device_identity_cache.h"
 #include "fronius_bus.h"
 #include "fronius_types.h"
 #include "meter_registers.h"
 #include "modbus_error.h"
 #include "modbus_utils.h"
+#include "sunspec_discovery.h"
 #include <array>
 #include <cerrno>
+#include <chrono>
 #include <expected>
 #include <format>
+#include <optional>
 #include <sstream>
 
+namespace {
+
+// Proprietary TS 65A-3 register blocks read by fetchMeterRegisters()
+constexpr uint16_t SUMMARY_BLOCK_SIZE = 16; // REG::PHV ..
+constexpr uint16_t PHASE_BLOCK_SIZE = 42;   // REG::PPVPHAB ..
+constexpr uint16_t ENERGY_BLOCK_SIZE = 16;  // REG::TOT_KWH_IMP ..
+
+// End of the shortest SunSpec map: the integer-map end block
+constexpr uint16_t SUNSPEC_MIN_END = M_END::L.ADDR + M_END::L.NB;
+
+// End of the SunSpec map: the float-map end block
+constexpr uint16_t SUNSPEC_END =
+    M_END::L.ADDR + M_END::FLOAT_OFFSET + M_END::L.NB;
+
+} // namespace
+
 /* -------------------------------------------------------------------------
    Construction
    ------------------------------------------------------------------------- */
 
+// Register layout: the proprietary TS 65A-3 blocks (identifier, serial
+// number, firmware version, measurement blocks) plus the SunSpec map from
+// the common block up to SUNSPEC_END.
 Meter::Meter(std::shared_ptr<FroniusBus> bus, const ModbusDeviceConfig &cfg)
-    : FroniusDevice(cfg), bus_(std::move(bus)) {}
+    : FroniusDevice(
+          cfg, {{REG::ID.ADDR, REG::ID.NB},
+                {REG::SN.ADDR, 2},
+                {REG::VR_MAJOR.ADDR, REG::VR_MAJOR.NB + REG::VR_MINOR.NB},
+                {REG::PHV.ADDR, SUMMARY_BLOCK_SIZE},
+                {REG::PPVPHAB.ADDR, PHASE_BLOCK_SIZE},
+                {REG::TOT_KWH_IMP.ADDR, ENERGY_BLOCK_SIZE},
+                {C001::SID.ADDR,
+                 static_cast<uint16_t>(SUNSPEC_END - C001::SID.ADDR)}}),
+      bus_(std::move(bus)) {}
 
 /* -------------------------------------------------------------------------
    FroniusDevice bus lifecycle
@@ -26,19 +58,47 @@ void Meter::onBusConnected() {
   // Reset state from any previous connection cycle before probing
   useFloatRegisters_ = false;
   id_ = 0;
+  models_.clear();
 
-  auto result = validateDevice();
+  // Probes write into a register update, published once the device has
+  // validated so readers never see a half-probed register set
+  if (auto res = beginUpdate(); !res) {
+    reportError<void>(std::unexpected(res.error()));
+    setUnavailable();
+    return;
+  }
+
+  // A known device only needs its cached identity confirmed; anything
+  // else is validated from scratch and remembered for the next connect
+  std::expected<FroniusTypes::RegisterMap, ModbusError> result;
+  auto restored = restoreIdentity();
+  if (!restored)
+    result = std::unexpected(restored.error());
+  else if (*restored)
+    result = **restored;
+  else {
+    result = validateDevice();
+    if (result)
+      storeIdentity(*result);
+  }
+  if (result) {
+    if (auto res = buildDecoder(*result); !res)
+      result = std::unexpected(res.error());
+  }
   if (!result) {
+    abortUpdate();
     setUnavailable();
     return;
   }
 
+  publishUpdate();
   setReady(*result);
 }
 
 void Meter::onBusDisconnected() {
   useFloatRegisters_ = false;
   id_ = 0;
+  models_.clear();
   setUnavailable();
 }
 
@@ -46,80 +106,131 @@ void Meter::onBusDisconnected() {
    Data fetch
    ------------------------------------------------------------------------- */
 
-FroniusBus::Transaction Meter::makeTransaction(int startAddr, int count,
-                                               uint16_t *dest) {
+FroniusBus::Transaction Meter::makeTransaction(uint16_t startAddr,
+                                               uint16_t count) {
   FroniusBus::Transaction t;
   t.slaveId = cfg_.slaveId;
   t.startAddr = startAddr;
   t.count = count;
-  t.dest = dest;
+  t.dest = updateRegs().data(startAddr, count);
   t.secTimeout = cfg_.secTimeout;
   t.usecTimeout = cfg_.usecTimeout;
+  t.priority = cfg_.priority;
+  if (cfg_.deadlineMs > 0)
+    t.deadline = std::chrono::steady_clock::now() +
+                 std::chrono::milliseconds(cfg_.deadlineMs);
   return t;
 }
 
-std::expected<void, ModbusError> Meter::fetchMeterRegisters() {
+FroniusBus::Transaction Meter::makeProbeTransaction(uint16_t startAddr,
+                                                    uint16_t count) {
+  FroniusBus::Transaction t = makeTransaction(startAddr, count);
+  t.priority = FroniusTypes::Priority::LOW;
+  t.deadline = std::chrono::steady_clock::time_point::max();
+  t.probe = true;
+  return t;
+}
+
+size_t Meter::fetchPlan(FroniusTypes::Block blocks,
+                        std::array<FroniusBus::Transaction, 3> &plan) {
+  using Block = FroniusTypes::Block;
+  size_t n = 0;
 
   // --- Proprietary path ---
 
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY) {
-    // Submit all three register blocks concurrently — they will be executed
-    // sequentially by the bus thread, but submission is non-blocking so all
-    // three are in the queue before we start waiting.
-    auto fSum = bus_->submit(makeTransaction(REG::PHV.ADDR, 16, regs_.data()));
-
-    auto fPhase =
-        bus_->submit(makeTransaction(REG::PPVPHAB.ADDR, 42, regs_.data()));
-
-    auto fEnergy =
-        bus_->submit(makeTransaction(REG::TOT_KWH_IMP.ADDR, 16, regs_.data()));
-
-    // Now wait for all three in submission order
-    if (auto res = fSum.get(); !res) {
-      setUnavailable();
-      return reportError<void>(std::unexpected(res.error()));
-    }
-    if (auto res = fPhase.get(); !res) {
-      setUnavailable();
-      return reportError<void>(std::unexpected(res.error()));
-    }
-    if (auto res = fEnergy.get(); !res) {
-      setUnavailable();
-      return reportError<void>(std::unexpected(res.error()));
-    }
-
-    return {};
+    if (FroniusTypes::has(blocks, Block::METER))
+      plan[n++] = makeTransaction(REG::PHV.ADDR, SUMMARY_BLOCK_SIZE);
+    if (FroniusTypes::has(blocks, Block::METER_PHASE))
+      plan[n++] = makeTransaction(REG::PPVPHAB.ADDR, PHASE_BLOCK_SIZE);
+    if (FroniusTypes::has(blocks, Block::METER_ENERGY))
+      plan[n++] = makeTransaction(REG::TOT_KWH_IMP.ADDR, ENERGY_BLOCK_SIZE);
   }
 
   // --- SunSpec path ---
 
-  else if (registerMap_ == FroniusTypes::RegisterMap::SUNSPEC) {
+  else if (registerMap_ == FroniusTypes::RegisterMap::SUNSPEC &&
+           FroniusTypes::has(blocks, Block::METER)) {
     const auto &meterBaseReg = useFloatRegisters_ ? M21X::A : M20X::A;
     const uint16_t meterBlockSize =
         useFloatRegisters_ ? M21X::SIZE : M20X::SIZE;
 
-    auto fMeter = bus_->submit(
-        makeTransaction(meterBaseReg.ADDR, meterBlockSize, regs_.data()));
+    plan[n++] = makeTransaction(meterBaseReg.ADDR, meterBlockSize);
+  }
 
-    if (auto res = fMeter.get(); !res) {
-      setUnavailable();
-      return reportError<void>(std::unexpected(res.error()));
-    }
+  return n;
+}
+
+std::expected<void, ModbusError> Meter::fetchMeterRegisters() {
+  if (auto res = beginUpdate(); !res)
+    return reportError<void>(std::unexpected(res.error()));
+
+  std::array<FroniusBus::Transaction, 3> plan;
+  const size_t parts = fetchPlan(defaultBlocks(), plan);
+
+  // Submit every block before waiting on the first one — they are executed
+  // sequentially by the bus thread, but submission is non-blocking so all
+  // of them are queued before we start waiting.
+  std::array<FroniusBus::Completion, plan.size()> pending;
+  for (size_t i = 0; i < parts; ++i)
+    pending[i] = bus_->submit(plan[i]);
+
+  // Wait for all of them in submission order, even after a failure: the
+  // bus thread writes into the update until each one has completed.
+  std::optional<ModbusError> err;
+  for (size_t i = 0; i < parts; ++i) {
+    if (auto res = pending[i].get(); !res && !err)
+      err = res.error();
   }
 
+  if (err) {
+    abortUpdate();
+    setUnavailable();
+    return reportError<void>(std::unexpected(std::move(*err)));
+  }
+
+  publishUpdate();
   return {};
 }
 
+void Meter::fetchAsync(FetchCallback done) {
+  fetchBlocksAsync(defaultBlocks(), std::move(done));
+}
+
+void Meter::fetchBlocksAsync(FroniusTypes::Block blocks, FetchCallback done) {
+  if (!beginAsyncFetch(std::move(done)))
+    return;
+
+  std::array<FroniusBus::Transaction, 3> plan;
+  const size_t parts = fetchPlan(blocks, plan);
+
+  if (!armAsyncFetch(static_cast<int>(parts)))
+    return;
+
+  for (size_t i = 0; i < parts; ++i)
+    bus_->submit(plan[i], [this](const std::expected<void, ModbusError> &res) {
+      completeAsyncFetch(res);
+    });
+}
+
+FroniusTypes::Block Meter::defaultBlocks() const {
+  using Block = FroniusTypes::Block;
+  return Block::METER | Block::METER_PHASE | Block::METER_ENERGY;
+}
+
 /* -------------------------------------------------------------------------
    Device identity accessors
    ------------------------------------------------------------------------- */
 
 std::expected<uint16_t, ModbusError> Meter::getModbusDeviceAddress() {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY)
     return static_cast<uint16_t>(cfg_.slaveId);
 
-  // SunSpec: read from common block DA register already in regs_
-  uint16_t val = regs_[C001::DA.ADDR];
+  // SunSpec: read from common block DA register already in regs
+  uint16_t val = regs[C001::DA.ADDR];
   if (val < 1 || val > 247)
     return reportError<uint16_t>(std::unexpected(
         ModbusError::custom(EINVAL,
@@ -131,44 +242,66 @@ std::expected<uint16_t, ModbusError> Meter::getModbusDeviceAddress() {
 
 std::expected<std::string, ModbusError> Meter::getSerialNumber() {
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY) {
-    auto f =
-        bus_->submit(makeTransaction(REG::SN.ADDR, REG::SN.NB, regs_.data()));
-    if (auto res = f.get(); !res)
+    if (auto res = beginUpdate(); !res)
       return reportError<std::string>(std::unexpected(res.error()));
 
+    auto f = bus_->submit(makeTransaction(REG::SN.ADDR, REG::SN.NB));
+    if (auto res = f.get(); !res) {
+      abortUpdate();
+      return reportError<std::string>(std::unexpected(res.error()));
+    }
+
     uint32_t serial =
-        ModbusUtils::modbus_get_uint32(regs_.data() + REG::SN.ADDR);
+        ModbusUtils::modbus_get_uint32(updateRegs().data(REG::SN.ADDR, 2));
+    publishUpdate();
     return std::to_string(serial);
   }
-  return getModbusString(regs_, C001::SN);
+
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::SN);
 }
 
 std::expected<std::string, ModbusError> Meter::getManufacturer() {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY)
     return std::string("Fronius");
-  return getModbusString(regs_, C001::MN);
+  return getModbusString(regs, C001::MN);
 }
 
 std::expected<std::string, ModbusError> Meter::getDeviceModel() {
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY)
     return std::string("Smart Meter TS 65A-3");
-  return getModbusString(regs_, C001::MD);
+  return getModbusString(regs, C001::MD);
 }
 
 std::expected<std::string, ModbusError> Meter::getFwVersion() {
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY) {
     // VR_MAJOR and VR_MINOR are two consecutive UINT16 registers. Read
     // them in a single transaction starting at VR_MAJOR for efficiency.
+    if (auto res = beginUpdate(); !res)
+      return reportError<std::string>(std::unexpected(res.error()));
+
     auto f = bus_->submit(makeTransaction(REG::VR_MAJOR.ADDR,
-                                          REG::VR_MAJOR.NB + REG::VR_MINOR.NB,
-                                          regs_.data()));
-    if (auto res = f.get(); !res)
+                                          REG::VR_MAJOR.NB + REG::VR_MINOR.NB));
+    if (auto res = f.get(); !res) {
+      abortUpdate();
       return reportError<std::string>(std::unexpected(res.error()));
+    }
 
-    return std::format("{}.{}", regs_[REG::VR_MAJOR.ADDR],
-                       regs_[REG::VR_MINOR.ADDR]);
+    const RegisterBuffer &regs = updateRegs();
+    std::string version = std::format("{}.{}", regs[REG::VR_MAJOR.ADDR],
+                                      regs[REG::VR_MINOR.ADDR]);
+    publishUpdate();
+    return version;
   }
-  return getModbusString(regs_, C001::VR);
+
+  const Snapshot snap = snapshot();
+  return getModbusString(snap.regs(), C001::VR);
 }
 
 /* -------------------------------------------------------------------------
@@ -183,16 +316,16 @@ Meter::getAcCurrent(FroniusTypes::Phase ph) const {
       return reportError<double>(std::unexpected(ModbusError::custom(
           ENOTSUP, "getAcCurrent(): Phase::TOTAL not supported for "
                    "proprietary register map")));
-    return getRegValue(REG::A, REG::A_SF, M20X::A, M20X::A_SF, M21X::A);
+    return getRegValue<REG::A, REG::A_SF, M20X::A, M20X::A_SF, M21X::A>();
   case FroniusTypes::Phase::A:
-    return getRegValue(REG::APHA, REG::A_SF, M20X::APHA, M20X::A_SF,
-                       M21X::APHA);
+    return getRegValue<REG::APHA, REG::A_SF, M20X::APHA, M20X::A_SF,
+                       M21X::APHA>();
   case FroniusTypes::Phase::B:
-    return getRegValue(REG::APHB, REG::A_SF, M20X::APHB, M20X::A_SF,
-                       M21X::APHB);
+    return getRegValue<REG::APHB, REG::A_SF, M20X::APHB, M20X::A_SF,
+                       M21X::APHB>();
   case FroniusTypes::Phase::C:
-    return getRegValue(REG::APHC, REG::A_SF, M20X::APHC, M20X::A_SF,
-                       M21X::APHC);
+    return getRegValue<REG::APHC, REG::A_SF, M20X::APHC, M20X::A_SF,
+                       M21X::APHC>();
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcCurrent(): Invalid phase {}",
@@ -204,27 +337,27 @@ std::expected<double, ModbusError>
 Meter::getAcVoltage(FroniusTypes::Phase ph) const {
   switch (ph) {
   case FroniusTypes::Phase::PHV:
-    return getRegValue(REG::PHV, REG::V_SF, M20X::PHV, M20X::V_SF, M21X::PHV);
+    return getRegValue<REG::PHV, REG::V_SF, M20X::PHV, M20X::V_SF, M21X::PHV>();
   case FroniusTypes::Phase::A:
-    return getRegValue(REG::PHVPHA, REG::V_SF, M20X::PHVPHA, M20X::V_SF,
-                       M21X::PHVPHA);
+    return getRegValue<REG::PHVPHA, REG::V_SF, M20X::PHVPHA, M20X::V_SF,
+                       M21X::PHVPHA>();
   case FroniusTypes::Phase::B:
-    return getRegValue(REG::PHVPHB, REG::V_SF, M20X::PHVPHB, M20X::V_SF,
-                       M21X::PHVPHB);
+    return getRegValue<REG::PHVPHB, REG::V_SF, M20X::PHVPHB, M20X::V_SF,
+                       M21X::PHVPHB>();
   case FroniusTypes::Phase::C:
-    return getRegValue(REG::PHVPHC, REG::V_SF, M20X::PHVPHC, M20X::V_SF,
-                       M21X::PHVPHC);
+    return getRegValue<REG::PHVPHC, REG::V_SF, M20X::PHVPHC, M20X::V_SF,
+                       M21X::PHVPHC>();
   case FroniusTypes::Phase::PPV:
-    return getRegValue(REG::PPV, REG::V_SF, M20X::PPV, M20X::V_SF, M21X::PPV);
+    return getRegValue<REG::PPV, REG::V_SF, M20X::PPV, M20X::V_SF, M21X::PPV>();
   case FroniusTypes::Phase::AB:
-    return getRegValue(REG::PPVPHAB, REG::V_SF, M20X::PPVPHAB, M20X::V_SF,
-                       M21X::PPVPHAB);
+    return getRegValue<REG::PPVPHAB, REG::V_SF, M20X::PPVPHAB, M20X::V_SF,
+                       M21X::PPVPHAB>();
   case FroniusTypes::Phase::BC:
-    return getRegValue(REG::PPVPHBC, REG::V_SF, M20X::PPVPHBC, M20X::V_SF,
-                       M21X::PPVPHBC);
+    return getRegValue<REG::PPVPHBC, REG::V_SF, M20X::PPVPHBC, M20X::V_SF,
+                       M21X::PPVPHBC>();
   case FroniusTypes::Phase::CA:
-    return getRegValue(REG::PPVPHCA, REG::V_SF, M20X::PPVPHCA, M20X::V_SF,
-                       M21X::PPVPHCA);
+    return getRegValue<REG::PPVPHCA, REG::V_SF, M20X::PPVPHCA, M20X::V_SF,
+                       M21X::PPVPHCA>();
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcVoltage(): Invalid phase {}",
@@ -236,16 +369,16 @@ std::expected<double, ModbusError>
 Meter::getAcPowerActive(FroniusTypes::Phase ph) const {
   switch (ph) {
   case FroniusTypes::Phase::TOTAL:
-    return getRegValue(REG::W, REG::W_SF, M20X::W, M20X::W_SF, M21X::W);
+    return getRegValue<REG::W, REG::W_SF, M20X::W, M20X::W_SF, M21X::W>();
   case FroniusTypes::Phase::A:
-    return getRegValue(REG::WPHA, REG::W_SF, M20X::WPHA, M20X::W_SF,
-                       M21X::WPHA);
+    return getRegValue<REG::WPHA, REG::W_SF, M20X::WPHA, M20X::W_SF,
+                       M21X::WPHA>();
   case FroniusTypes::Phase::B:
-    return getRegValue(REG::WPHB, REG::W_SF, M20X::WPHB, M20X::W_SF,
-                       M21X::WPHB);
+    return getRegValue<REG::WPHB, REG::W_SF, M20X::WPHB, M20X::W_SF,
+                       M21X::WPHB>();
   case FroniusTypes::Phase::C:
-    return getRegValue(REG::WPHC, REG::W_SF, M20X::WPHC, M20X::W_SF,
-                       M21X::WPHC);
+    return getRegValue<REG::WPHC, REG::W_SF, M20X::WPHC, M20X::W_SF,
+                       M21X::WPHC>();
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcPowerActive(): Invalid phase {}",
@@ -254,24 +387,24 @@ Meter::getAcPowerActive(FroniusTypes::Phase ph) const {
 }
 
 std::expected<double, ModbusError> Meter::getAcFrequency() const {
-  return getRegValue(REG::FREQ, REG::FREQ_SF, M20X::FREQ, M20X::FREQ_SF,
-                     M21X::FREQ);
+  return getRegValue<REG::FREQ, REG::FREQ_SF, M20X::FREQ, M20X::FREQ_SF,
+                     M21X::FREQ>();
 }
 
 std::expected<double, ModbusError>
 Meter::getAcPowerApparent(FroniusTypes::Phase ph) const {
   switch (ph) {
   case FroniusTypes::Phase::TOTAL:
-    return getRegValue(REG::VA, REG::VA_SF, M20X::VA, M20X::VA_SF, M21X::VA);
+    return getRegValue<REG::VA, REG::VA_SF, M20X::VA, M20X::VA_SF, M21X::VA>();
   case FroniusTypes::Phase::A:
-    return getRegValue(REG::VAPHA, REG::VA_SF, M20X::VAPHA, M20X::VA_SF,
-                       M21X::VAPHA);
+    return getRegValue<REG::VAPHA, REG::VA_SF, M20X::VAPHA, M20X::VA_SF,
+                       M21X::VAPHA>();
   case FroniusTypes::Phase::B:
-    return getRegValue(REG::VAPHB, REG::VA_SF, M20X::VAPHB, M20X::VA_SF,
-                       M21X::VAPHB);
+    return getRegValue<REG::VAPHB, REG::VA_SF, M20X::VAPHB, M20X::VA_SF,
+                       M21X::VAPHB>();
   case FroniusTypes::Phase::C:
-    return getRegValue(REG::VAPHC, REG::VA_SF, M20X::VAPHC, M20X::VA_SF,
-                       M21X::VAPHC);
+    return getRegValue<REG::VAPHC, REG::VA_SF, M20X::VAPHC, M20X::VA_SF,
+                       M21X::VAPHC>();
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcPowerApparent(): Invalid phase {}",
@@ -283,17 +416,17 @@ std::expected<double, ModbusError>
 Meter::getAcPowerReactive(FroniusTypes::Phase ph) const {
   switch (ph) {
   case FroniusTypes::Phase::TOTAL:
-    return getRegValue(REG::VAR, REG::VAR_SF, M20X::VAR, M20X::VAR_SF,
-                       M21X::VAR);
+    return getRegValue<REG::VAR, REG::VAR_SF, M20X::VAR, M20X::VAR_SF,
+                       M21X::VAR>();
   case FroniusTypes::Phase::A:
-    return getRegValue(REG::VARPHA, REG::VAR_SF, M20X::VARPHA, M20X::VAR_SF,
-                       M21X::VARPHA);
+    return getRegValue<REG::VARPHA, REG::VAR_SF, M20X::VARPHA, M20X::VAR_SF,
+                       M21X::VARPHA>();
   case FroniusTypes::Phase::B:
-    return getRegValue(REG::VARPHB, REG::VAR_SF, M20X::VARPHB, M20X::VAR_SF,
-                       M21X::VARPHB);
+    return getRegValue<REG::VARPHB, REG::VAR_SF, M20X::VARPHB, M20X::VAR_SF,
+                       M21X::VARPHB>();
   case FroniusTypes::Phase::C:
-    return getRegValue(REG::VARPHC, REG::VAR_SF, M20X::VARPHC, M20X::VAR_SF,
-                       M21X::VARPHC);
+    return getRegValue<REG::VARPHC, REG::VAR_SF, M20X::VARPHC, M20X::VAR_SF,
+                       M21X::VARPHC>();
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcPowerReactive(): Invalid phase {}",
@@ -305,16 +438,16 @@ std::expected<double, ModbusError>
 Meter::getAcPowerFactor(FroniusTypes::Phase ph) const {
   switch (ph) {
   case FroniusTypes::Phase::AVERAGE:
-    return getRegValue(REG::PF, REG::PF_SF, M20X::PF, M20X::PF_SF, M21X::PF);
+    return getRegValue<REG::PF, REG::PF_SF, M20X::PF, M20X::PF_SF, M21X::PF>();
   case FroniusTypes::Phase::A:
-    return getRegValue(REG::PFPHA, REG::PF_SF, M20X::PFPHA, M20X::PF_SF,
-                       M21X::PFPHA);
+    return getRegValue<REG::PFPHA, REG::PF_SF, M20X::PFPHA, M20X::PF_SF,
+                       M21X::PFPHA>();
   case FroniusTypes::Phase::B:
-    return getRegValue(REG::PFPHB, REG::PF_SF, M20X::PFPHB, M20X::PF_SF,
-                       M21X::PFPHB);
+    return getRegValue<REG::PFPHB, REG::PF_SF, M20X::PFPHB, M20X::PF_SF,
+                       M21X::PFPHB>();
   case FroniusTypes::Phase::C:
-    return getRegValue(REG::PFPHC, REG::PF_SF, M20X::PFPHC, M20X::PF_SF,
-                       M21X::PFPHC);
+    return getRegValue<REG::PFPHC, REG::PF_SF, M20X::PFPHC, M20X::PF_SF,
+                       M21X::PFPHC>();
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcPowerFactor(): Invalid phase {}",
@@ -324,106 +457,251 @@ Meter::getAcPowerFactor(FroniusTypes::Phase ph) const {
 
 std::expected<double, ModbusError>
 Meter::getAcEnergyActive(FroniusTypes::EnergyDirection direction) const {
-  struct EnergyRegs {
-    Register kwh, wh;
-    Register m20x_wh, m20x_sf;
-    Register m21x_wh;
-  };
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
+  const bool proprietary =
+      registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY;
 
-  EnergyRegs eregs;
   switch (direction) {
   case FroniusTypes::EnergyDirection::EXPORT:
-    eregs = {REG::TOT_KWH_EXP, REG::TOT_WH_EXP, M20X::TOT_WH_EXP,
-             M20X::TOT_WH_SF, M21X::TOT_WH_EXP};
-    break;
+    return proprietary
+               ? getSplitEnergy<REG::TOT_KWH_EXP, REG::TOT_WH_EXP>(regs)
+               : getSunSpecValue<M20X::TOT_WH_EXP, M20X::TOT_WH_SF,
+                                 M21X::TOT_WH_EXP>(regs);
   case FroniusTypes::EnergyDirection::IMPORT:
-    eregs = {REG::TOT_KWH_IMP, REG::TOT_WH_IMP, M20X::TOT_WH_IMP,
-             M20X::TOT_WH_SF, M21X::TOT_WH_IMP};
-    break;
+    return proprietary
+               ? getSplitEnergy<REG::TOT_KWH_IMP, REG::TOT_WH_IMP>(regs)
+               : getSunSpecValue<M20X::TOT_WH_IMP, M20X::TOT_WH_SF,
+                                 M21X::TOT_WH_IMP>(regs);
   default:
     return reportError<double>(std::unexpected(
         ModbusError::custom(EINVAL, "getAcEnergyActive(): Invalid direction {}",
                             FroniusTypes::toString(direction))));
   }
-
-  if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY) {
-    auto kwh = getModbusDouble(regs_, eregs.kwh, REG::TOT_SF);
-    if (!kwh)
-      return std::unexpected(kwh.error());
-    auto wh = getModbusDouble(regs_, eregs.wh, REG::TOT_SF);
-    if (!wh)
-      return std::unexpected(wh.error());
-    return *kwh * 1000.0 + *wh;
-  }
-
-  return useFloatRegisters_
-             ? getModbusDouble(regs_, eregs.m21x_wh)
-             : getModbusDouble(regs_, eregs.m20x_wh, eregs.m20x_sf);
 }
 
 std::expected<double, ModbusError>
 Meter::getAcEnergyApparent(FroniusTypes::EnergyDirection direction) const {
-  struct EnergyRegs {
-    Register m20x_vah, m20x_sf;
-    Register m21x_vah;
-  };
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
 
-  EnergyRegs eregs;
-  switch (direction) {
-  case FroniusTypes::EnergyDirection::EXPORT:
-    eregs = {M20X::TOT_VAH_EXP, M20X::TOT_VAH_SF, M21X::TOT_VAH_EXP};
-    break;
-  case FroniusTypes::EnergyDirection::IMPORT:
-    eregs = {M20X::TOT_VAH_IMP, M20X::TOT_VAH_SF, M21X::TOT_VAH_IMP};
-    break;
-  default:
+  if (direction != FroniusTypes::EnergyDirection::EXPORT &&
+      direction != FroniusTypes::EnergyDirection::IMPORT)
     return reportError<double>(std::unexpected(ModbusError::custom(
         EINVAL, "getAcEnergyApparent(): Invalid direction {}",
         FroniusTypes::toString(direction))));
-  }
 
   if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY)
     return reportError<double>(std::unexpected(ModbusError::custom(
         ENOTSUP, "getAcEnergyApparent(): Not supported for proprietary "
                  "register map")));
 
-  return useFloatRegisters_
-             ? getModbusDouble(regs_, eregs.m21x_vah)
-             : getModbusDouble(regs_, eregs.m20x_vah, eregs.m20x_sf);
+  if (direction == FroniusTypes::EnergyDirection::EXPORT)
+    return getSunSpecValue<M20X::TOT_VAH_EXP, M20X::TOT_VAH_SF,
+                           M21X::TOT_VAH_EXP>(regs);
+  return getSunSpecValue<M20X::TOT_VAH_IMP, M20X::TOT_VAH_SF,
+                         M21X::TOT_VAH_IMP>(regs);
 }
 
 std::expected<double, ModbusError>
 Meter::getAcEnergyReactive(FroniusTypes::EnergyDirection direction) const {
-  struct EnergyRegs {
-    Register kwh, wh;
-  };
+  const Snapshot snap = snapshot();
+  const RegisterBuffer &regs = snap.regs();
 
-  EnergyRegs eregs;
-  switch (direction) {
-  case FroniusTypes::EnergyDirection::EXPORT:
-    eregs = {REG::TOT_KVARH_EXP, REG::TOT_VARH_EXP};
-    break;
-  case FroniusTypes::EnergyDirection::IMPORT:
-    eregs = {REG::TOT_KVARH_IMP, REG::TOT_VARH_IMP};
-    break;
-  default:
+  if (direction != FroniusTypes::EnergyDirection::EXPORT &&
+      direction != FroniusTypes::EnergyDirection::IMPORT)
     return reportError<double>(std::unexpected(ModbusError::custom(
         EINVAL, "getAcEnergyReactive(): Invalid direction {}",
         FroniusTypes::toString(direction))));
-  }
 
   if (registerMap_ == FroniusTypes::RegisterMap::SUNSPEC)
     return reportError<double>(std::unexpected(ModbusError::custom(
         ENOTSUP, "getAcEnergyReactive(): Not supported for SunSpec "
                  "register map")));
 
-  auto kwh = getModbusDouble(regs_, eregs.kwh, REG::TOT_SF);
-  if (!kwh)
-    return std::unexpected(kwh.error());
-  auto wh = getModbusDouble(regs_, eregs.wh, REG::TOT_SF);
-  if (!wh)
-    return std::unexpected(wh.error());
-  return *kwh * 1000.0 + *wh;
+  if (direction == FroniusTypes::EnergyDirection::EXPORT)
+    return getSplitEnergy<REG::TOT_KVARH_EXP, REG::TOT_VARH_EXP>(regs);
+  return getSplitEnergy<REG::TOT_KVARH_IMP, REG::TOT_VARH_IMP>(regs);
+}
+
+/* -------------------------------------------------------------------------
+   Bulk decode
+   ------------------------------------------------------------------------- */
+
+std::expected<void, ModbusError> Meter::decodeAll(MeterSample &sample) const {
+  const auto plan = decoder_.load();
+  if (!isReady() || !plan || plan->empty())
+    return reportError<void>(std::unexpected(ModbusError::custom(
+        ENODATA, "decodeAll(): Register map not yet detected")));
+
+  decode(*plan, snapshot(), sample);
+  return {};
+}
+
+void Meter::decode(const SampleDecoder<MeterSample> &plan, const Snapshot &snap,
+                   MeterSample &sample) const {
+  sample = MeterSample{};
+  sample.timestamp = snap.timestamp();
+  sample.sequence = snap.sequence();
+  plan.decode(snap.regs(), sample);
+}
+
+std::expected<void, ModbusError>
+Meter::decodeChanges(SampleTracker<MeterSample> &tracker) const {
+  const auto plan = decoder_.load();
+  if (!isReady() || !plan || plan->empty())
+    return reportError<void>(std::unexpected(ModbusError::custom(
+        ENODATA, "decodeChanges(): Register map not yet detected")));
+
+  const Snapshot snap = snapshot();
+
+  plan->decodeChanges(snap.regs(), tracker, [&](MeterSample &sample) {
+    sample.timestamp = snap.timestamp();
+    sample.sequence = snap.sequence();
+    return false;
+  });
+  return {};
+}
+
+void Meter::onPublished(const Snapshot &snap) {
+  const auto plan = decoder_.load();
+  if (!history_ || !isReady() || !plan || plan->empty())
+    return;
+
+  MeterSample sample;
+  decode(*plan, snap, sample);
+  history_->append(sample);
+}
+
+std::expected<void, ModbusError>
+Meter::buildDecoder(FroniusTypes::RegisterMap map) {
+  const RegisterBuffer &regs = updateRegs();
+  using S = MeterSample;
+
+  const bool proprietary = map == FroniusTypes::RegisterMap::PROPRIETARY;
+  const int phases = proprietary ? 3 : id_ % 10;
+
+  // Built aside and published whole: readers may hold the previous plan
+  auto plan = std::make_shared<SampleDecoder<S>>();
+  std::expected<void, ModbusError> res;
+
+  // Same map dispatch as getRegValue(), resolved once
+  auto add = [&](double S::*field, const Register &regProp, double sfProp,
+                 const Register &regInt, const Register &sfInt,
+                 const Register &regFlt) {
+    if (!res)
+      return;
+    if (proprietary)
+      res = plan->add(regs, field, regProp, sfProp);
+    else
+      res = useFloatRegisters_ ? plan->add(regs, field, regFlt)
+                               : plan->add(regs, field, regInt, sfInt);
+  };
+
+  // SunSpec-only value
+  auto addSunSpec = [&](double S::*field, const Register &regInt,
+                        const Register &sfInt, const Register &regFlt) {
+    if (res && !proprietary)
+      res = useFloatRegisters_ ? plan->add(regs, field, regFlt)
+                               : plan->add(regs, field, regInt, sfInt);
+  };
+
+  // Proprietary energy split into kWh and Wh registers
+  auto addEnergy = [&](double S::*field, const Register &kwh,
+                       const Register &wh) {
+    if (res)
+      res = plan->add(regs, field, kwh, REG::TOT_SF * 1000.0);
+    if (res)
+      res = plan->add(regs, field, wh, REG::TOT_SF, /*accumulate=*/true);
+  };
+
+  addSunSpec(&S::acCurrent, M20X::A, M20X::A_SF, M21X::A);
+  add(&S::acCurrentA, REG::APHA, REG::A_SF, M20X::APHA, M20X::A_SF,
+      M21X::APHA);
+  add(&S::acVoltage, REG::PHV, REG::V_SF, M20X::PHV, M20X::V_SF, M21X::PHV);
+  add(&S::acVoltageA, REG::PHVPHA, REG::V_SF, M20X::PHVPHA, M20X::V_SF,
+      M21X::PHVPHA);
+  add(&S::acPowerActive, REG::W, REG::W_SF, M20X::W, M20X::W_SF, M21X::W);
+  add(&S::acPowerActiveA, REG::WPHA, REG::W_SF, M20X::WPHA, M20X::W_SF,
+      M21X::WPHA);
+  add(&S::acPowerApparent, REG::VA, REG::VA_SF, M20X::VA, M20X::VA_SF,
+      M21X::VA);
+  add(&S::acPowerApparentA, REG::VAPHA, REG::VA_SF, M20X::VAPHA, M20X::VA_SF,
+      M21X::VAPHA);
+  add(&S::acPowerReactive, REG::VAR, REG::VAR_SF, M20X::VAR, M20X::VAR_SF,
+      M21X::VAR);
+  add(&S::acPowerReactiveA, REG::VARPHA, REG::VAR_SF, M20X::VARPHA,
+      M20X::VAR_SF, M21X::VARPHA);
+  add(&S::acPowerFactor, REG::PF, REG::PF_SF, M20X::PF, M20X::PF_SF,
+      M21X::PF);
+  add(&S::acPowerFactorA, REG::PFPHA, REG::PF_SF, M20X::PFPHA, M20X::PF_SF,
+      M21X::PFPHA);
+  add(&S::acFrequency, REG::FREQ, REG::FREQ_SF, M20X::FREQ, M20X::FREQ_SF,
+      M21X::FREQ);
+
+  if (phases >= 2) {
+    add(&S::acCurrentB, REG::APHB, REG::A_SF, M20X::APHB, M20X::A_SF,
+        M21X::APHB);
+    add(&S::acVoltageB, REG::PHVPHB, REG::V_SF, M20X::PHVPHB, M20X::V_SF,
+        M21X::PHVPHB);
+    add(&S::acVoltagePP, REG::PPV, REG::V_SF, M20X::PPV, M20X::V_SF,
+        M21X::PPV);
+    add(&S::acVoltageAB, REG::PPVPHAB, REG::V_SF, M20X::PPVPHAB, M20X::V_SF,
+        M21X::PPVPHAB);
+    add(&S::acPowerActiveB, REG::WPHB, REG::W_SF, M20X::WPHB, M20X::W_SF,
+        M21X::WPHB);
+    add(&S::acPowerApparentB, REG::VAPHB, REG::VA_SF, M20X::VAPHB,
+        M20X::VA_SF, M21X::VAPHB);
+    add(&S::acPowerReactiveB, REG::VARPHB, REG::VAR_SF, M20X::VARPHB,
+        M20X::VAR_SF, M21X::VARPHB);
+    add(&S::acPowerFactorB, REG::PFPHB, REG::PF_SF, M20X::PFPHB, M20X::PF_SF,
+        M21X::PFPHB);
+  }
+
+  if (phases >= 3) {
+    add(&S::acCurrentC, REG::APHC, REG::A_SF, M20X::APHC, M20X::A_SF,
+        M21X::APHC);
+    add(&S::acVoltageC, REG::PHVPHC, REG::V_SF, M20X::PHVPHC, M20X::V_SF,
+        M21X::PHVPHC);
+    add(&S::acVoltageBC, REG::PPVPHBC, REG::V_SF, M20X::PPVPHBC, M20X::V_SF,
+        M21X::PPVPHBC);
+    add(&S::acVoltageCA, REG::PPVPHCA, REG::V_SF, M20X::PPVPHCA, M20X::V_SF,
+        M21X::PPVPHCA);
+    add(&S::acPowerActiveC, REG::WPHC, REG::W_SF, M20X::WPHC, M20X::W_SF,
+        M21X::WPHC);
+    add(&S::acPowerApparentC, REG::VAPHC, REG::VA_SF, M20X::VAPHC,
+        M20X::VA_SF, M21X::VAPHC);
+    add(&S::acPowerReactiveC, REG::VARPHC, REG::VAR_SF, M20X::VARPHC,
+        M20X::VAR_SF, M21X::VARPHC);
+    add(&S::acPowerFactorC, REG::PFPHC, REG::PF_SF, M20X::PFPHC, M20X::PF_SF,
+        M21X::PFPHC);
+  }
+
+  if (proprietary) {
+    addEnergy(&S::acEnergyActiveImport, REG::TOT_KWH_IMP, REG::TOT_WH_IMP);
+    addEnergy(&S::acEnergyActiveExport, REG::TOT_KWH_EXP, REG::TOT_WH_EXP);
+    addEnergy(&S::acEnergyReactiveImport, REG::TOT_KVARH_IMP,
+              REG::TOT_VARH_IMP);
+    addEnergy(&S::acEnergyReactiveExport, REG::TOT_KVARH_EXP,
+              REG::TOT_VARH_EXP);
+  } else {
+    addSunSpec(&S::acEnergyActiveImport, M20X::TOT_WH_IMP, M20X::TOT_WH_SF,
+               M21X::TOT_WH_IMP);
+    addSunSpec(&S::acEnergyActiveExport, M20X::TOT_WH_EXP, M20X::TOT_WH_SF,
+               M21X::TOT_WH_EXP);
+    addSunSpec(&S::acEnergyApparentImport, M20X::TOT_VAH_IMP,
+               M20X::TOT_VAH_SF, M21X::TOT_VAH_IMP);
+    addSunSpec(&S::acEnergyApparentExport, M20X::TOT_VAH_EXP,
+               M20X::TOT_VAH_SF, M21X::TOT_VAH_EXP);
+  }
+
+  if (!res) {
+    decoder_.store(nullptr);
+    return reportError<void>(std::unexpected(res.error()));
+  }
+
+  decoder_.store(std::move(plan));
+  return {};
 }
 
 /* -------------------------------------------------------------------------
@@ -431,13 +709,14 @@ Meter::getAcEnergyReactive(FroniusTypes::EnergyDirection direction) const {
    ------------------------------------------------------------------------- */
 
 std::expected<FroniusTypes::RegisterMap, ModbusError> Meter::validateDevice() {
+  const RegisterBuffer &regs = updateRegs();
+
   // --- Step 1: probe for the proprietary register map ---
   // Read the device type register. If it responds with device type 731 this
   // is a Smart Meter TS 65A-3 using the proprietary RTU map.
   // If the register address is illegal (EMBXILADD) the device does not have
   // this register and we fall through to SunSpec probing.
-  auto fProp =
-      bus_->submit(makeTransaction(REG::ID.ADDR, REG::ID.NB, regs_.data()));
+  auto fProp = bus_->submit(makeProbeTransaction(REG::ID.ADDR, REG::ID.NB));
 
   if (auto res = fProp.get(); !res) {
     if (res.error().code != EMBXILADD)
@@ -445,67 +724,56 @@ std::expected<FroniusTypes::RegisterMap, ModbusError> Meter::validateDevice() {
           std::unexpected(res.error()));
     // EMBXILADD means address does not exist — not a proprietary device
   } else {
-    if (regs_[REG::ID.ADDR] == 731)
+    if (regs[REG::ID.ADDR] == 731)
       return FroniusTypes::RegisterMap::PROPRIETARY;
   }
 
-  // --- Step 2: validate SunSpec signature ---
-  // Read the SunSpec ID and common block header in one transaction.
-  auto fSunSpec =
-      bus_->submit(makeTransaction(C001::SID.ADDR, 4, regs_.data()));
-
-  if (auto res = fSunSpec.get(); !res)
-    return reportError<FroniusTypes::RegisterMap>(std::unexpected(res.error()));
-
-  // Verify "SunS" identifier
-  if (!(regs_[C001::SID.ADDR] == 0x5375 && regs_[C001::SID.ADDR + 1] == 0x6e53))
-    return reportError<FroniusTypes::RegisterMap>(std::unexpected(
-        ModbusError::custom(EINVAL,
-                            "validateDevice(): SunSpec signature mismatch: "
-                            "expected [0x5375, 0x6e53], received [0x{}, 0x{}]",
-                            ModbusUtils::toHex(regs_[C001::SID.ADDR]),
-                            ModbusUtils::toHex(regs_[C001::SID.ADDR + 1]))));
-
-  if (regs_[C001::ID.ADDR] != 0x1)
+  // --- Step 2: walk the SunSpec model chain ---
+  // Verifies the "SunS" identifier and the end block in a few pipelined
+  // reads covering the whole map.
+  SunSpecDiscovery discovery(
+      *bus_, updateRegs(), [this](uint16_t start, uint16_t count) {
+        return makeProbeTransaction(start, count);
+      });
+
+  auto models = discovery.discover(C001::SID.ADDR, SUNSPEC_MIN_END,
+                                   SUNSPEC_END);
+  if (!models)
+    return reportError<FroniusTypes::RegisterMap>(
+        std::unexpected(models.error()));
+  models_ = *models;
+
+  // --- Step 3: validate the common register block ---
+  if (regs[C001::ID.ADDR] != 0x1)
     return reportError<FroniusTypes::RegisterMap>(std::unexpected(
         ModbusError::custom(EINVAL,
                             "validateDevice(): Invalid common block ID: "
                             "received {}, expected 1",
-                            regs_[C001::ID.ADDR])));
+                            regs[C001::ID.ADDR])));
 
-  if (regs_[C001::L.ADDR] != C001::SIZE)
+  if (regs[C001::L.ADDR] != C001::SIZE)
     return reportError<FroniusTypes::RegisterMap>(std::unexpected(
         ModbusError::custom(EINVAL,
                             "validateDevice(): Invalid common block size: "
                             "received {}, expected {}",
-                            regs_[C001::L.ADDR], C001::SIZE)));
-
-  // --- Step 3: fetch the full common register block ---
-  auto fCommon =
-      bus_->submit(makeTransaction(C001::MN.ADDR, C001::SIZE, regs_.data()));
+                            regs[C001::L.ADDR], C001::SIZE)));
 
-  if (auto res = fCommon.get(); !res)
+  // Normally covered by the initial sweep already
+  if (auto res = discovery.ensure(C001::MN.ADDR, C001::SIZE); !res)
     return reportError<FroniusTypes::RegisterMap>(std::unexpected(res.error()));
 
   // --- Step 4: detect float vs. integer model ---
   if (auto res = detectFloatOrIntRegisters(); !res)
     return reportError<FroniusTypes::RegisterMap>(std::unexpected(res.error()));
 
-  // --- Step 5: validate the end register block ---
-  if (auto res = validateEndRegisters(); !res)
-    return reportError<FroniusTypes::RegisterMap>(std::unexpected(res.error()));
-
   return FroniusTypes::RegisterMap::SUNSPEC;
 }
 
 std::expected<void, ModbusError> Meter::detectFloatOrIntRegisters() {
-  // Read the meter model ID and map length registers
-  auto f = bus_->submit(makeTransaction(M20X::ID.ADDR, 2, regs_.data()));
+  const RegisterBuffer &regs = updateRegs();
 
-  if (auto res = f.get(); !res)
-    return reportError<void>(std::unexpected(res.error()));
-
-  uint16_t meterID = regs_[M20X::ID.ADDR];
+  // The meter model directly follows the fixed-size common block
+  uint16_t meterID = regs[M20X::ID.ADDR];
 
   static constexpr std::array<uint16_t, 6> validIDs = {201, 202, 203,
                                                        211, 212, 213};
@@ -529,7 +797,7 @@ std::expected<void, ModbusError> Meter::detectFloatOrIntRegisters() {
   id_ = meterID;
   useFloatRegisters_ = (meterID / 10 % 10) != 0;
 
-  uint16_t regMapSize = regs_[M20X::L.ADDR];
+  uint16_t regMapSize = regs[M20X::L.ADDR];
   if (regMapSize != M20X::SIZE && regMapSize != M21X::SIZE)
     return reportError<void>(std::unexpected(ModbusError::custom(
         EINVAL,
@@ -540,48 +808,115 @@ std::expected<void, ModbusError> Meter::detectFloatOrIntRegisters() {
   return {};
 }
 
-std::expected<void, ModbusError> Meter::validateEndRegisters() {
+template <Register Kilo, Register Unit>
+std::expected<double, ModbusError>
+Meter::getSplitEnergy(const RegisterBuffer &regs) const {
+  auto kilo = getModbusDouble<FixedScaledValue<Kilo, REG::TOT_SF>>(regs);
+  if (!kilo)
+    return std::unexpected(kilo.error());
+  auto unit = getModbusDouble<FixedScaledValue<Unit, REG::TOT_SF>>(regs);
+  if (!unit)
+    return std::unexpected(unit.error());
+  return *kilo * 1000.0 + *unit;
+}
 
-  // End block validation
-  const auto endBlockBaseReg = useFloatRegisters_
-                                   ? M_END::ID.withOffset(M_END::FLOAT_OFFSET)
-                                   : M_END::ID;
-  const auto endBlockLengthReg =
-      useFloatRegisters_ ? M_END::L.withOffset(M_END::FLOAT_OFFSET) : M_END::L;
+std::expected<double, ModbusError> Meter::noMapError() const {
+  return reportError<double>(std::unexpected(ModbusError::custom(
+      ENODATA, "getRegValue(): Register map not yet detected")));
+}
 
-  auto fEnd =
-      bus_->submit(makeTransaction(endBlockBaseReg.ADDR, 2, regs_.data()));
+/* -------------------------------------------------------------------------
+   Private — identity cache
+   ------------------------------------------------------------------------- */
 
-  if (auto res = fEnd.get(); !res) {
-    setUnavailable();
-    return reportError<void>(std::unexpected(res.error()));
+std::expected<std::optional<FroniusTypes::RegisterMap>, ModbusError>
+Meter::restoreIdentity() {
+  if (!identityCache_)
+    return std::nullopt;
+
+  const std::string key =
+      DeviceIdentityCache::key(bus_->getConfig(), cfg_.slaveId);
+  auto identity = identityCache_->lookup(key);
+  if (!identity)
+    return std::nullopt;
+
+  const RegisterBuffer &regs = updateRegs();
+
+  if (identity->map == FroniusTypes::RegisterMap::PROPRIETARY) {
+    // Device type and serial number, queued together
+    auto fId = bus_->submit(makeProbeTransaction(REG::ID.ADDR, REG::ID.NB));
+    auto fSn = bus_->submit(makeProbeTransaction(REG::SN.ADDR, 2));
+    auto resId = fId.get();
+    auto resSn = fSn.get();
+
+    for (const auto *res : {&resId, &resSn}) {
+      if (*res)
+        continue;
+      // No proprietary map any more — probe from scratch next time
+      if (res->error().code == EMBXILADD)
+        identityCache_->erase(key);
+      return reportError<std::optional<FroniusTypes::RegisterMap>>(
+          std::unexpected(res->error()));
+    }
+
+    const uint32_t serial =
+        ModbusUtils::modbus_get_uint32(updateRegs().data(REG::SN.ADDR, 2));
+    if (regs[REG::ID.ADDR] != 731 ||
+        std::to_string(serial) != identity->serial) {
+      identityCache_->erase(key);
+      return std::nullopt;
+    }
+
+    return FroniusTypes::RegisterMap::PROPRIETARY;
   }
 
-  if (!(regs_[endBlockBaseReg.ADDR] == 0xFFFF &&
-        regs_[endBlockLengthReg.ADDR] == 0)) {
-    setUnavailable();
-    return reportError<void>(std::unexpected(ModbusError::custom(
-        EINVAL,
-        "fetchMeterRegisters(): Invalid end block register: "
-        "received [0x{}, {}], expected [0xFFFF, 0]",
-        ModbusUtils::toHex(regs_[endBlockBaseReg.ADDR]),
-        regs_[endBlockLengthReg.ADDR])));
+  SunSpecDiscovery discovery(
+      *bus_, updateRegs(), [this](uint16_t start, uint16_t count) {
+        return makeProbeTransaction(start, count);
+      });
+
+  // Signature, common block, and meter model header in one read
+  auto confirmed = discovery.confirm(C001::SID.ADDR, identity->models);
+  if (!confirmed)
+    return reportError<std::optional<FroniusTypes::RegisterMap>>(
+        std::unexpected(confirmed.error()));
+
+  auto serial = getModbusString(regs, C001::SN);
+  if (!*confirmed || !serial || *serial != identity->serial ||
+      !detectFloatOrIntRegisters()) {
+    identityCache_->erase(key);
+    return std::nullopt;
   }
 
-  return {};
+  models_ = identity->models;
+
+  return FroniusTypes::RegisterMap::SUNSPEC;
 }
 
-std::expected<double, ModbusError>
-Meter::getRegValue(const Register &regProp, double sfProp,
-                   const Register &regInt, const Register &sfInt,
-                   const Register &regFlt) const {
-  if (registerMap_ == FroniusTypes::RegisterMap::PROPRIETARY)
-    return getModbusDouble(regs_, regProp, sfProp);
+void Meter::storeIdentity(FroniusTypes::RegisterMap map) {
+  if (!identityCache_)
+    return;
 
-  if (registerMap_ == FroniusTypes::RegisterMap::SUNSPEC)
-    return useFloatRegisters_ ? getModbusDouble(regs_, regFlt)
-                              : getModbusDouble(regs_, regInt, sfInt);
+  DeviceIdentity identity;
+  identity.map = map;
+  identity.modelId = id_;
+  identity.floatRegisters = useFloatRegisters_;
+  identity.models = models_;
+
+  if (map == FroniusTypes::RegisterMap::PROPRIETARY) {
+    // Validation only reads the device type; fetch the serial number once
+    auto f = bus_->submit(makeProbeTransaction(REG::SN.ADDR, 2));
+    if (auto res = f.get(); !res) {
+      reportError<void>(std::unexpected(res.error()));
+      return;
+    }
+    identity.serial = std::to_string(
+        ModbusUtils::modbus_get_uint32(updateRegs().data(REG::SN.ADDR, 2)));
+  } else {
+    identity.serial = getModbusString(updateRegs(), C001::SN).value_or("");
+  }
 
-  return reportError<double>(std::unexpected(ModbusError::custom(
-      ENODATA, "getRegValue(): Register map not yet detected")));
+  // A cache that cannot be written costs only the next fast connect
+  reportError(identityCache_->store(
+      DeviceIdentityCache::key(bus_->getConfig(), cfg_.slaveId), identity));
 }
@@ -0,0 +1,375 @@
+#include "sample_publisher.h"
+#include "modbus_error.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <expected>
+#include <fcntl.h>
+#include <memory>
+#include <new>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+namespace {
+
+using Kind = SampleShmChannel::Kind;
+
+/** Torn copies of the latest sample after which a reader gives up. */
+constexpr int MAX_ATTEMPTS = 16;
+
+/** `n` rounded up to whole cache lines, so channels share none. */
+constexpr size_t cacheAligned(size_t n) { return (n + 63) & ~size_t{63}; }
+
+const char *toString(Kind kind) {
+  return kind == Kind::INVERTER ? "inverter" : "meter";
+}
+
+/** Atomic load from the read-only mapping of a reader. */
+uint64_t load(const uint64_t &word, std::memory_order order) {
+  // atomic_ref<const T> only arrives with C++26; a load does not write
+  return std::atomic_ref<uint64_t>(const_cast<uint64_t &>(word)).load(order);
+}
+
+/** Copy publication `n` out of `e`; false if it was overwritten meanwhile. */
+bool copyEntry(const SampleShmEntry &e, uint64_t n, void *out, size_t size) {
+  std::array<uint64_t, SampleShmEntry::WORDS> words;
+
+  const uint64_t version = load(e.version, std::memory_order_acquire);
+  if (version != 2 * n)
+    return false;
+  for (size_t i = 0; i < words.size(); ++i)
+    words[i] = load(e.words[i], std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (load(e.version, std::memory_order_relaxed) != version)
+    return false;
+
+  std::memcpy(out, words.data(), size);
+  return true;
+}
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   SamplePublisher
+   ------------------------------------------------------------------------- */
+
+std::expected<std::unique_ptr<SamplePublisher>, ModbusError>
+SamplePublisher::create(const std::string &name,
+                        std::span<const Channel> channels, size_t ringSize) {
+  if (name.size() < 2 || name[0] != '/' ||
+      name.find('/', 1) != std::string::npos)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SamplePublisher::create(): Invalid shared memory name {}",
+        name));
+  if (channels.empty() || ringSize < 2 || ringSize > UINT16_MAX)
+    return std::unexpected(ModbusError::custom(
+        EINVAL,
+        "SamplePublisher::create(): Cannot create {} channels of {} entries",
+        channels.size(), ringSize));
+  for (const Channel &c : channels)
+    if (c.name.empty() || c.name.size() > SampleShmChannel::MAX_NAME ||
+        (c.kind != Kind::INVERTER && c.kind != Kind::METER))
+      return std::unexpected(ModbusError::custom(
+          EINVAL, "SamplePublisher::create(): Invalid channel '{}'",
+          c.name));
+
+  const size_t headerSize = cacheAligned(sizeof(SampleShmHeader));
+  const size_t channelSize = cacheAligned(
+      sizeof(SampleShmChannel) + ringSize * sizeof(SampleShmEntry));
+  const size_t size = headerSize + channels.size() * channelSize;
+
+  // Replace a segment left behind by an earlier publisher; readers still
+  // mapping it see it as stale
+  shm_unlink(name.c_str());
+  const int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd == -1)
+    return std::unexpected(ModbusError::custom(
+        errno, "SamplePublisher::create(): Cannot create shared memory {}",
+        name));
+
+  // The identity of the segment tells it apart from one that replaced it
+  struct stat st{};
+  void *map = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && ftruncate(fd, static_cast<off_t>(size)) == 0)
+    map = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  const int err = errno;
+  ::close(fd);
+  if (map == MAP_FAILED) {
+    shm_unlink(name.c_str());
+    return std::unexpected(ModbusError::custom(
+        err, "SamplePublisher::create(): Cannot map shared memory {}", name));
+  }
+
+  // The segment comes zero-filled, so every ring entry starts out empty
+  auto *base = static_cast<uint8_t *>(map);
+  auto *header = new (base) SampleShmHeader{};
+  header->headerSize = static_cast<uint32_t>(headerSize);
+  header->channels = static_cast<uint32_t>(channels.size());
+  header->ringSize = static_cast<uint32_t>(ringSize);
+  header->channelSize = static_cast<uint32_t>(channelSize);
+
+  for (size_t i = 0; i < channels.size(); ++i) {
+    auto *ch = new (base + headerSize + i * channelSize) SampleShmChannel{};
+    std::ranges::copy(channels[i].name, ch->name.begin());
+    ch->kind = channels[i].kind;
+    ch->sampleSize = static_cast<uint32_t>(
+        ch->kind == Kind::INVERTER ? sizeof(InverterSample)
+                                   : sizeof(MeterSample));
+  }
+  std::atomic_ref<uint32_t>(header->ready).store(1, std::memory_order_release);
+
+  return std::unique_ptr<SamplePublisher>(
+      new SamplePublisher(name, map, size, st.st_dev, st.st_ino));
+}
+
+SamplePublisher::~SamplePublisher() {
+  munmap(base_, size_);
+
+  // A later publisher of the same name replaced the segment; its readers
+  // must keep finding it
+  const int fd = shm_open(name_.c_str(), O_RDONLY, 0);
+  if (fd == -1)
+    return;
+  struct stat st{};
+  const bool ours =
+      fstat(fd, &st) == 0 && st.st_dev == dev_ && st.st_ino == ino_;
+  ::close(fd);
+  if (ours)
+    shm_unlink(name_.c_str());
+}
+
+std::expected<void, ModbusError>
+SamplePublisher::publish(size_t channel, const InverterSample &sample) {
+  return write(channel, Kind::INVERTER, &sample, sizeof(sample));
+}
+
+std::expected<void, ModbusError>
+SamplePublisher::publish(size_t channel, const MeterSample &sample) {
+  return write(channel, Kind::METER, &sample, sizeof(sample));
+}
+
+std::expected<void, ModbusError>
+SamplePublisher::publish(size_t channel, const Inverter &inverter) {
+  InverterSample sample;
+  if (auto res = inverter.decodeAll(sample); !res)
+    return res;
+  return publish(channel, sample);
+}
+
+std::expected<void, ModbusError>
+SamplePublisher::publish(size_t channel, const Meter &meter) {
+  MeterSample sample;
+  if (auto res = meter.decodeAll(sample); !res)
+    return res;
+  return publish(channel, sample);
+}
+
+std::expected<void, ModbusError>
+SamplePublisher::write(size_t channel, Kind kind, const void *sample,
+                       size_t size) {
+  auto *base = static_cast<uint8_t *>(base_);
+  const auto &header = *reinterpret_cast<const SampleShmHeader *>(base);
+  if (channel >= header.channels)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SamplePublisher::publish(): No channel {} in {}", channel,
+        name_));
+
+  auto &ch = *reinterpret_cast<SampleShmChannel *>(
+      base + header.headerSize + channel * header.channelSize);
+  if (ch.kind != kind)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SamplePublisher::publish(): Channel {} carries {} samples",
+        channel, toString(ch.kind)));
+
+  std::array<uint64_t, SampleShmEntry::WORDS> words{};
+  std::memcpy(words.data(), sample, size);
+
+  // Only this thread writes the channel, so its own count needs no sync
+  std::atomic_ref<uint64_t> published(ch.published);
+  const uint64_t n = published.load(std::memory_order_relaxed) + 1;
+  SampleShmEntry &e = ch.entries()[(n - 1) % header.ringSize];
+
+  // Odd version while the words are inconsistent; the fence keeps the
+  // word stores from becoming visible before it
+  std::atomic_ref<uint64_t> version(e.version);
+  version.store(2 * n - 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (size_t i = 0; i < words.size(); ++i)
+    std::atomic_ref<uint64_t>(e.words[i])
+        .store(words[i], std::memory_order_relaxed);
+  version.store(2 * n, std::memory_order_release);
+
+  published.store(n, std::memory_order_release);
+  return {};
+}
+
+/* -------------------------------------------------------------------------
+   SampleReader
+   ------------------------------------------------------------------------- */
+
+std::expected<std::unique_ptr<SampleReader>, ModbusError>
+SampleReader::open(const std::string &name) {
+  const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fd == -1)
+    return std::unexpected(ModbusError::custom(
+        errno, "SampleReader::open(): Cannot open shared memory {}", name));
+
+  auto fail = [fd](ModbusError err) {
+    ::close(fd);
+    return std::unexpected(std::move(err));
+  };
+
+  struct stat st{};
+  if (fstat(fd, &st) == -1)
+    return fail(ModbusError::custom(
+        errno, "SampleReader::open(): Cannot stat shared memory {}", name));
+
+  // Created, but not yet sized by the publisher
+  const size_t size = static_cast<size_t>(st.st_size);
+  if (size < sizeof(SampleShmHeader))
+    return fail(ModbusError::custom(
+        EAGAIN, "SampleReader::open(): {} is not laid out yet", name));
+
+  void *map = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+  if (map == MAP_FAILED)
+    return fail(ModbusError::custom(
+        errno, "SampleReader::open(): Cannot map shared memory {}", name));
+
+  // From here on the reader owns the descriptor and the mapping
+  std::unique_ptr<SampleReader> reader(new SampleReader(name, fd, map, size));
+  const auto &h = reader->header();
+
+  auto &ready = const_cast<uint32_t &>(h.ready);
+  if (std::atomic_ref<uint32_t>(ready).load(std::memory_order_acquire) == 0)
+    return std::unexpected(ModbusError::custom(
+        EAGAIN, "SampleReader::open(): {} is not laid out yet", name));
+  if (h.magic != SampleShmHeader::MAGIC)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SampleReader::open(): {} is not a sample segment", name));
+  if (h.byteOrder != SampleShmHeader::BYTE_ORDER_MARK ||
+      h.version != SampleShmHeader::VERSION ||
+      h.headerSize < sizeof(SampleShmHeader) ||
+      h.channelSize < sizeof(SampleShmChannel) +
+                          size_t{h.ringSize} * sizeof(SampleShmEntry) ||
+      h.ringSize == 0 ||
+      size < h.headerSize + size_t{h.channels} * h.channelSize)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "SampleReader::open(): Unsupported layout version {} in {}",
+        h.version, name));
+
+  return reader;
+}
+
+SampleReader::~SampleReader() {
+  munmap(const_cast<void *>(base_), size_);
+  ::close(fd_);
+}
+
+std::optional<size_t> SampleReader::find(std::string_view name) const {
+  for (size_t i = 0; i < channels(); ++i)
+    if (channelName(i) == name)
+      return i;
+  return std::nullopt;
+}
+
+uint64_t SampleReader::published(size_t channel) const {
+  return load(at(channel).published, std::memory_order_acquire);
+}
+
+std::expected<uint64_t, ModbusError>
+SampleReader::latest(size_t channel, InverterSample &out) const {
+  return readLatest(channel, Kind::INVERTER, &out, sizeof(out));
+}
+
+std::expected<uint64_t, ModbusError>
+SampleReader::latest(size_t channel, MeterSample &out) const {
+  return readLatest(channel, Kind::METER, &out, sizeof(out));
+}
+
+std::expected<void, ModbusError>
+SampleReader::read(size_t channel, uint64_t n, InverterSample &out) const {
+  return readAt(channel, Kind::INVERTER, n, &out, sizeof(out));
+}
+
+std::expected<void, ModbusError>
+SampleReader::read(size_t channel, uint64_t n, MeterSample &out) const {
+  return readAt(channel, Kind::METER, n, &out, sizeof(out));
+}
+
+bool SampleReader::stale() const {
+  // shm_unlink() drops the last link; the mapping itself stays valid
+  struct stat st{};
+  return fstat(fd_, &st) == -1 || st.st_nlink == 0;
+}
+
+std::expected<const SampleShmChannel *, ModbusError>
+SampleReader::checked(size_t channel, Kind kind, size_t size,
+                      const char *what) const {
+  if (channel >= channels())
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "{}: No channel {} in {}", what, channel, name_));
+
+  const SampleShmChannel &ch = at(channel);
+  if (ch.kind != kind)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "{}: Channel {} carries {} samples", what, channel,
+        toString(ch.kind)));
+  if (ch.sampleSize != size)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "{}: Channel {} was published with a different sample layout",
+        what, channel));
+  return &ch;
+}
+
+std::expected<uint64_t, ModbusError>
+SampleReader::readLatest(size_t channel, Kind kind, void *out,
+                         size_t size) const {
+  auto ch = checked(channel, kind, size, "SampleReader::latest()");
+  if (!ch)
+    return std::unexpected(std::move(ch.error()));
+
+  const uint32_t ringSize = header().ringSize;
+  for (int attempt = 0; attempt < MAX_ATTEMPTS; ++attempt) {
+    const uint64_t n = load((*ch)->published, std::memory_order_acquire);
+    if (n == 0)
+      return std::unexpected(ModbusError::custom(
+          ENODATA, "SampleReader::latest(): Nothing published to channel {}",
+          channel));
+    if (copyEntry((*ch)->entries()[(n - 1) % ringSize], n, out, size))
+      return n;
+  }
+
+  return std::unexpected(ModbusError::custom(
+      EAGAIN,
+      "SampleReader::latest(): Channel {} was overwritten {} times while "
+      "being read",
+      channel, MAX_ATTEMPTS));
+}
+
+std::expected<void, ModbusError>
+SampleReader::readAt(size_t channel, Kind kind, uint64_t n, void *out,
+                     size_t size) const {
+  auto ch = checked(channel, kind, size, "SampleReader::read()");
+  if (!ch)
+    return std::unexpected(std::move(ch.error()));
+
+  const uint32_t ringSize = header().ringSize;
+  const uint64_t published = load((*ch)->published, std::memory_order_acquire);
+  if (n == 0 || n > published)
+    return std::unexpected(ModbusError::custom(
+        ENODATA, "SampleReader::read(): Sample {} of channel {} not published",
+        n, channel));
+  if (published - n >= ringSize ||
+      !copyEntry((*ch)->entries()[(n - 1) % ringSize], n, out, size))
+    return std::unexpected(ModbusError::custom(
+        ENODATA,
+        "SampleReader::read(): Sample {} of channel {} was overwritten", n,
+        channel));
+  return {};
+}
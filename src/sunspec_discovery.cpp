@@ -0,0 +1,216 @@
+#include "sunspec_discovery.h"
+#include "fronius_bus.h"
+#include "modbus_error.h"
+#include "modbus_utils.h"
+#include "register_buffer.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cstdint>
+#include <expected>
+#include <modbus/modbus.h>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace {
+
+/** SunSpec signature "SunS" at the start of the map. */
+constexpr uint16_t SUNS_HI = 0x5375;
+constexpr uint16_t SUNS_LO = 0x6e53;
+
+/** ID of the end-of-map marker. */
+constexpr uint16_t END_ID = 0xFFFF;
+
+/** Size of a model header: ID and length registers. */
+constexpr uint32_t HEADER = 2;
+
+/** Reads queued at once by one sweep, i.e. up to 1000 registers. */
+constexpr size_t MAX_CHUNKS = 8;
+
+} // namespace
+
+/* -------------------------------------------------------------------------
+   Discovery
+   ------------------------------------------------------------------------- */
+
+std::expected<SunSpecModelTable, ModbusError>
+SunSpecDiscovery::discover(uint16_t start, uint16_t known, uint16_t end) {
+  covered_.clear();
+
+  // Sweep the part every supported map has in one go. Reading beyond the
+  // end of a map fails with an illegal-address exception, which the bus
+  // treats as fatal, so the walk below reads anything further on demand.
+  if (auto res = read(start, std::min(known, end)); !res)
+    return std::unexpected(res.error());
+
+  if (auto res = ensure(start, HEADER); !res)
+    return std::unexpected(res.error());
+
+  if (!(regs_[start] == SUNS_HI && regs_[start + 1] == SUNS_LO))
+    return std::unexpected(
+        ModbusError::custom(EINVAL,
+                            "discover(): SunSpec signature mismatch: "
+                            "expected [0x5375, 0x6e53], received [0x{}, 0x{}]",
+                            ModbusUtils::toHex(regs_[start]),
+                            ModbusUtils::toHex(regs_[start + 1])));
+
+  SunSpecModelTable table;
+  uint32_t pos = start + HEADER;
+
+  for (;;) {
+    if (pos + HEADER > end)
+      return std::unexpected(ModbusError::custom(
+          EINVAL, "discover(): Model chain not terminated before {}", end));
+
+    if (auto res = ensure(static_cast<uint16_t>(pos), HEADER); !res)
+      return std::unexpected(res.error());
+
+    const uint16_t id = regs_[static_cast<uint16_t>(pos)];
+    const uint16_t length = regs_[static_cast<uint16_t>(pos + 1)];
+
+    if (id == END_ID) {
+      if (length != 0)
+        return std::unexpected(ModbusError::custom(
+            EINVAL,
+            "discover(): Invalid end block length at {}: received {}, "
+            "expected 0",
+            pos, length));
+      table.terminate(static_cast<uint16_t>(pos));
+      return table;
+    }
+
+    if (!table.append({id, static_cast<uint16_t>(pos), length}))
+      return std::unexpected(ModbusError::custom(
+          EINVAL, "discover(): More than {} models in chain",
+          SunSpecModelTable::MAX_MODELS));
+
+    // Past the sweep, fetch the rest of this model's body together with
+    // the next header, so each model costs at most one more round trip.
+    const uint32_t next = pos + HEADER + length;
+    if (next + HEADER <= end && !isCovered(next, next + HEADER))
+      if (auto res = read(coveredUntil(pos + HEADER), next + HEADER); !res)
+        return std::unexpected(res.error());
+
+    pos = next;
+  }
+}
+
+std::expected<void, ModbusError> SunSpecDiscovery::ensure(uint16_t addr,
+                                                          uint16_t count) {
+  const uint32_t last = static_cast<uint32_t>(addr) + count;
+  if (isCovered(addr, last))
+    return {};
+  return read(addr, last);
+}
+
+std::expected<bool, ModbusError>
+SunSpecDiscovery::confirm(uint16_t start, const SunSpecModelTable &table) {
+  covered_.clear();
+
+  if (table.size() < 2)
+    return false;
+
+  // A stale table may point anywhere; let it fail verification
+  const SunSpecModelTable::Model *models = table.begin();
+  const uint32_t last = models[1].addr + HEADER;
+  if (last <= start ||
+      !regs_.contains(start, static_cast<uint16_t>(last - start)))
+    return false;
+
+  if (auto res = read(start, last); !res)
+    return std::unexpected(res.error());
+
+  if (!(regs_[start] == SUNS_HI && regs_[start + 1] == SUNS_LO))
+    return false;
+
+  for (size_t i = 0; i < 2; ++i) {
+    const uint16_t addr = models[i].addr;
+    if (regs_[addr] != models[i].id || regs_[addr + 1] != models[i].length)
+      return false;
+  }
+
+  return true;
+}
+
+/* -------------------------------------------------------------------------
+   Reads
+   ------------------------------------------------------------------------- */
+
+std::expected<void, ModbusError>
+SunSpecDiscovery::read(uint32_t first, uint32_t last) {
+  if (!regs_.contains(static_cast<uint16_t>(first),
+                      static_cast<uint16_t>(last - first)))
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "discover(): Range [{}, {}) outside the register layout",
+        first, last));
+
+  if (last - first > MAX_CHUNKS * MODBUS_MAX_READ_REGISTERS)
+    return std::unexpected(ModbusError::custom(
+        EINVAL, "discover(): Range [{}, {}) exceeds {} reads", first, last,
+        MAX_CHUNKS));
+
+  struct Chunk {
+    uint32_t first;
+    uint32_t last;
+    FroniusBus::Completion completion;
+  };
+
+  // Queue every chunk before waiting on the first one
+  std::array<Chunk, MAX_CHUNKS> chunks;
+  size_t n = 0;
+  for (uint32_t addr = first; addr < last;) {
+    const uint32_t end =
+        std::min<uint32_t>(last, addr + MODBUS_MAX_READ_REGISTERS);
+    chunks[n].first = addr;
+    chunks[n].last = end;
+    chunks[n].completion = bus_.submit(make_(
+        static_cast<uint16_t>(addr), static_cast<uint16_t>(end - addr)));
+    ++n;
+    addr = end;
+  }
+
+  // Wait for all of them, even after a failure: each one writes into the
+  // register update until it completes.
+  std::optional<ModbusError> err;
+  for (size_t i = 0; i < n; ++i) {
+    auto res = chunks[i].completion.get();
+    if (res) {
+      covered_.push_back({chunks[i].first, chunks[i].last});
+      continue;
+    }
+    if (!err)
+      err = res.error();
+  }
+
+  // Merge adjacent ranges so reads spanning a chunk boundary count as
+  // covered
+  std::sort(covered_.begin(), covered_.end(),
+            [](const Range &a, const Range &b) { return a.first < b.first; });
+  std::vector<Range> merged;
+  for (const Range &r : covered_) {
+    if (!merged.empty() && r.first <= merged.back().last)
+      merged.back().last = std::max(merged.back().last, r.last);
+    else
+      merged.push_back(r);
+  }
+  covered_ = std::move(merged);
+
+  if (err)
+    return std::unexpected(std::move(*err));
+  return {};
+}
+
+uint32_t SunSpecDiscovery::coveredUntil(uint32_t addr) const {
+  for (const Range &r : covered_)
+    if (addr >= r.first && addr < r.last)
+      return r.last;
+  return addr;
+}
+
+bool SunSpecDiscovery::isCovered(uint32_t first, uint32_t last) const {
+  for (const Range &r : covered_)
+    if (first >= r.first && last <= r.last)
+      return true;
+  return false;
+}